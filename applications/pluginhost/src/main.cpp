@@ -0,0 +1,159 @@
+// futureboard-pluginhost: runs one CLAP plugin on behalf of the engine's
+// SandboxedPluginNode, so a crash only takes this process down.
+//
+//   futureboard-pluginhost <channel> <file.clap> [plugin id]
+//
+// The engine creates the shared memory channel and starts this process
+// with its name. Requests are served on the main thread, which stands in
+// as the plugin's audio thread while processing.
+
+#include "audiothread.hpp"
+#include "audioworkerpool.hpp"
+#include "clappluginnode.hpp"
+#include "eventlist.hpp"
+#include "sandboxchannel.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+    #include <csignal>
+    #include <sys/prctl.h>
+    #include <unistd.h>
+#elif !defined(_WIN32)
+    #include <unistd.h>
+#endif
+
+namespace {
+
+// How often an idle host checks whether the engine is still there
+constexpr auto kIdleTimeout = std::chrono::milliseconds(500);
+
+void copyString(char* destination, size_t size, const std::string& text) {
+    size_t length = std::min(text.size(), size - 1);
+    std::memcpy(destination, text.data(), length);
+    destination[length] = '\0';
+}
+
+void fail(SandboxChannel& channel, const std::string& error) {
+    auto& header = channel.header();
+    copyString(header.error, sizeof(header.error), error);
+    header.state.store(static_cast<uint32_t>(SandboxChannel::HostState::Failed));
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::fprintf(stderr, "Usage: futureboard-pluginhost <channel> <file.clap> [plugin id]\n");
+        return 2;
+    }
+
+#if defined(__linux__)
+    // Go down with the engine. Windows does this with a job object.
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+#endif
+#ifndef _WIN32
+    const auto parent = getppid();
+#endif
+
+    SandboxChannel channel;
+    if (!channel.open(argv[1])) {
+        std::fprintf(stderr, "%s\n", channel.getError().c_str());
+        return 1;
+    }
+
+    std::string error;
+    auto node = ClapPluginNode::create(argv[2], argc > 3 ? argv[3] : "", error);
+    if (!node) {
+        fail(channel, error);
+        return 1;
+    }
+    if (node->numInputs() > SandboxChannel::kMaxChannels || node->numOutputs() > SandboxChannel::kMaxChannels) {
+        fail(channel, "Plugin has more than " + std::to_string(SandboxChannel::kMaxChannels) + " channels");
+        return 1;
+    }
+
+    auto& header = channel.header();
+    copyString(header.pluginId, sizeof(header.pluginId), node->plugin()->desc->id);
+    copyString(header.pluginName, sizeof(header.pluginName), node->name());
+    header.numInputs = node->numInputs();
+    header.numOutputs = node->numOutputs();
+
+    // The plugin works directly on the channel's audio
+    std::vector<const float*> inputs;
+    std::vector<float*> outputs;
+    for (uint32_t i = 0; i < node->numInputs(); i++) inputs.push_back(channel.input(i));
+    for (uint32_t i = 0; i < node->numOutputs(); i++) outputs.push_back(channel.output(i));
+
+    AudioWorkerPool workers;
+    EventList inEvents;
+    EventList outEvents;
+    uint32_t maxFrames = 0;
+    uint32_t lastSeen = header.requestSeq.load();
+
+    header.state.store(static_cast<uint32_t>(SandboxChannel::HostState::Ready));
+
+    bool quit = false;
+    while (!quit) {
+        if (!channel.waitForRequest(lastSeen, kIdleTimeout)) {
+#ifndef _WIN32
+            if (getppid() != parent) break;
+#endif
+            node->idle();
+            continue;
+        }
+
+        uint32_t seq = header.requestSeq.load(std::memory_order_acquire);
+        lastSeen = seq;
+        header.succeeded = 1;
+
+        switch (header.command) {
+            case SandboxChannel::Command::Process: {
+                inEvents.clear();
+                outEvents.clear();
+                SandboxChannel::readEvents(channel.inEvents(), inEvents);
+
+                AudioBlock block;
+                block.frames = std::min(header.frames, maxFrames);
+                block.steadyTime = header.steadyTime;
+                block.inputs = inputs.data();
+                block.outputs = outputs.data();
+                block.inEvents = &inEvents;
+                block.outEvents = &outEvents;
+                block.workers = &workers;
+                block.silentInputs = header.silentInputs;
+                uint64_t silentOutputs = 0;
+                block.silentOutputs = &silentOutputs;
+                {
+                    audiothread::Scope audioThread;
+                    node->process(block);
+                }
+
+                SandboxChannel::writeEvents(channel.outEvents(), outEvents);
+                header.failed = node->hasFailed() ? 1 : 0;
+                header.sleeping = node->isSleeping() ? 1 : 0;
+                header.silentOutputs = silentOutputs;
+                break;
+            }
+            case SandboxChannel::Command::Prepare:
+                maxFrames = std::min(header.frames, header.maxFrames);
+                header.succeeded = node->prepare(header.sampleRate, maxFrames) ? 1 : 0;
+                break;
+            case SandboxChannel::Command::Release:
+                node->release();
+                maxFrames = 0;
+                break;
+            case SandboxChannel::Command::Quit:
+                quit = true;
+                break;
+        }
+
+        channel.respond(seq);
+        node->idle();
+    }
+
+    return 0;
+}
@@ -0,0 +1,473 @@
+#include "BinaryInspector.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace futureboard {
+
+namespace {
+
+// Upper bound for symbol and string tables read from a single binary
+constexpr uint64_t maxTableSize = 32ull << 20;
+constexpr uint32_t maxPeNames = 1u << 16;
+constexpr uint32_t maxFatSlices = 16;
+
+class FileReader {
+public:
+    explicit FileReader(const std::filesystem::path& path)
+        : file(path, std::ios::binary)
+    {
+        std::error_code ec;
+        fileSize = std::filesystem::file_size(path, ec);
+        if (ec) fileSize = 0;
+    }
+
+    bool isOpen() const { return file.is_open() && fileSize > 0; }
+    uint64_t size() const { return fileSize; }
+
+    bool read(uint64_t offset, void* out, uint64_t count) {
+        if (offset > fileSize || count > fileSize - offset) return false;
+        file.clear();
+        file.seekg(static_cast<std::streamoff>(offset));
+        file.read(static_cast<char*>(out), static_cast<std::streamsize>(count));
+        return static_cast<uint64_t>(file.gcount()) == count;
+    }
+
+    bool read(uint64_t offset, std::vector<uint8_t>& out, uint64_t count) {
+        if (count > maxTableSize) return false;
+        out.resize(static_cast<size_t>(count));
+        return count == 0 || read(offset, out.data(), count);
+    }
+
+private:
+    std::ifstream file;
+    uint64_t fileSize = 0;
+};
+
+uint16_t load16(const uint8_t* p, bool bigEndian) {
+    return bigEndian ? static_cast<uint16_t>(p[0] << 8 | p[1])
+                     : static_cast<uint16_t>(p[1] << 8 | p[0]);
+}
+
+uint32_t load32(const uint8_t* p, bool bigEndian) {
+    return bigEndian ? (uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 | p[3])
+                     : (uint32_t(p[3]) << 24 | uint32_t(p[2]) << 16 | uint32_t(p[1]) << 8 | p[0]);
+}
+
+uint64_t load64(const uint8_t* p, bool bigEndian) {
+    uint64_t first = load32(p, bigEndian);
+    uint64_t second = load32(p + 4, bigEndian);
+    return bigEndian ? (first << 32 | second) : (second << 32 | first);
+}
+
+ProcessorArchitecture peArchitecture(uint16_t machine) {
+    switch (machine) {
+        case 0x8664: return ProcessorArchitecture::X86_64;
+        case 0x014c: return ProcessorArchitecture::X86;
+        case 0xaa64: return ProcessorArchitecture::ARM64;
+        case 0x01c0:
+        case 0x01c4: return ProcessorArchitecture::ARM32;
+        default: return ProcessorArchitecture::UNKNOWN;
+    }
+}
+
+ProcessorArchitecture elfArchitecture(uint16_t machine) {
+    switch (machine) {
+        case 62: return ProcessorArchitecture::X86_64;   // EM_X86_64
+        case 3: return ProcessorArchitecture::X86;       // EM_386
+        case 183: return ProcessorArchitecture::ARM64;   // EM_AARCH64
+        case 40: return ProcessorArchitecture::ARM32;    // EM_ARM
+        default: return ProcessorArchitecture::UNKNOWN;
+    }
+}
+
+ProcessorArchitecture machOArchitecture(uint32_t cpuType) {
+    switch (cpuType) {
+        case 0x01000007: return ProcessorArchitecture::X86_64;
+        case 0x00000007: return ProcessorArchitecture::X86;
+        case 0x0100000c: return ProcessorArchitecture::ARM64;
+        case 0x0000000c: return ProcessorArchitecture::ARM32;
+        default: return ProcessorArchitecture::UNKNOWN;
+    }
+}
+
+void noteExport(std::string_view name, BinaryInfo& info) {
+    if (name == "VSTPluginMain" || name == "main" || name == "main_macho" || name == "main_plugin") {
+        info.hasVst2Entry = true;
+    } else if (name == "GetPluginFactory") {
+        info.hasVst3Entry = true;
+    } else if (name == "clap_entry") {
+        info.hasClapEntry = true;
+    }
+}
+
+// NUL-terminated string at offset inside a table, or empty when out of range
+std::string_view tableString(const std::vector<uint8_t>& table, uint64_t offset) {
+    if (offset >= table.size()) return {};
+    auto begin = reinterpret_cast<const char*>(table.data() + offset);
+    auto end = static_cast<const char*>(std::memchr(begin, '\0', table.size() - offset));
+    return end ? std::string_view(begin, static_cast<size_t>(end - begin)) : std::string_view();
+}
+
+// PE: export directory names
+bool parsePE(FileReader& reader, BinaryInfo& info) {
+    uint8_t dos[64];
+    if (!reader.read(0, dos, sizeof(dos))) return false;
+    uint32_t peOffset = load32(dos + 0x3c, false);
+
+    uint8_t coff[24];
+    if (!reader.read(peOffset, coff, sizeof(coff)) || std::memcmp(coff, "PE\0\0", 4) != 0) return false;
+    info.format = BinaryFormat::PE;
+    info.architectures.push_back(peArchitecture(load16(coff + 4, false)));
+
+    uint16_t numSections = load16(coff + 6, false);
+    uint16_t optionalSize = load16(coff + 20, false);
+
+    std::vector<uint8_t> optional;
+    if (!reader.read(peOffset + 24, optional, optionalSize) || optionalSize < 2) return false;
+
+    // Export table is data directory 0
+    uint16_t magic = load16(optional.data(), false);
+    size_t dirCountOffset = magic == 0x20b ? 108 : 92;
+    size_t dirOffset = dirCountOffset + 4;
+    if (optional.size() < dirOffset + 8 || load32(optional.data() + dirCountOffset, false) == 0) return false;
+
+    uint32_t exportRva = load32(optional.data() + dirOffset, false);
+    if (exportRva == 0) {
+        info.exportsParsed = true;
+        return true;
+    }
+
+    std::vector<uint8_t> sections;
+    if (!reader.read(peOffset + 24 + optionalSize, sections, uint64_t(numSections) * 40)) return false;
+
+    auto rvaToOffset = [&sections, numSections](uint32_t rva, uint64_t& offset) {
+        for (uint16_t i = 0; i < numSections; i++) {
+            const uint8_t* section = sections.data() + i * 40;
+            uint32_t virtualSize = load32(section + 8, false);
+            uint32_t virtualAddress = load32(section + 12, false);
+            uint32_t rawSize = load32(section + 16, false);
+            uint32_t rawOffset = load32(section + 20, false);
+            if (rva >= virtualAddress && rva - virtualAddress < std::max(virtualSize, rawSize)) {
+                offset = uint64_t(rawOffset) + (rva - virtualAddress);
+                return true;
+            }
+        }
+        return false;
+    };
+
+    uint64_t exportOffset = 0;
+    uint8_t exportDir[40];
+    if (!rvaToOffset(exportRva, exportOffset) || !reader.read(exportOffset, exportDir, sizeof(exportDir))) return false;
+
+    uint32_t numNames = load32(exportDir + 24, false);
+    uint32_t namesRva = load32(exportDir + 32, false);
+    if (numNames > maxPeNames) return false;
+
+    uint64_t namesOffset = 0;
+    std::vector<uint8_t> nameRvas;
+    if (numNames > 0 && (!rvaToOffset(namesRva, namesOffset) ||
+                         !reader.read(namesOffset, nameRvas, uint64_t(numNames) * 4))) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < numNames; i++) {
+        uint64_t nameOffset = 0;
+        if (!rvaToOffset(load32(nameRvas.data() + i * 4, false), nameOffset)) continue;
+
+        // Every name we look for is shorter than this
+        char name[24] = {};
+        uint64_t length = std::min<uint64_t>(sizeof(name) - 1, reader.size() - nameOffset);
+        if (!reader.read(nameOffset, name, length)) continue;
+        noteExport(name, info);
+    }
+
+    info.exportsParsed = true;
+    return true;
+}
+
+// ELF: defined global symbols in .dynsym
+bool parseELF(FileReader& reader, BinaryInfo& info) {
+    uint8_t header[64];
+    if (!reader.read(0, header, 52) || std::memcmp(header, "\x7f" "ELF", 4) != 0) return false;
+    info.format = BinaryFormat::ELF;
+
+    bool is64 = header[4] == 2;
+    bool bigEndian = header[5] == 2;
+    info.architectures.push_back(elfArchitecture(load16(header + 18, bigEndian)));
+    if (is64 && !reader.read(0, header, 64)) return false;
+
+    uint64_t sectionOffset = is64 ? load64(header + 40, bigEndian) : load32(header + 32, bigEndian);
+    uint16_t sectionEntrySize = load16(header + (is64 ? 58 : 46), bigEndian);
+    uint16_t numSections = load16(header + (is64 ? 60 : 48), bigEndian);
+    if (sectionOffset == 0 || numSections == 0 || sectionEntrySize < (is64 ? 64 : 40)) return false;
+
+    std::vector<uint8_t> sections;
+    if (!reader.read(sectionOffset, sections, uint64_t(numSections) * sectionEntrySize)) return false;
+
+    struct Section { uint32_t type; uint64_t offset; uint64_t size; uint32_t link; };
+    auto section = [&](uint32_t index) {
+        const uint8_t* s = sections.data() + size_t(index) * sectionEntrySize;
+        if (is64) {
+            return Section{ load32(s + 4, bigEndian), load64(s + 24, bigEndian), load64(s + 32, bigEndian), load32(s + 40, bigEndian) };
+        }
+        return Section{ load32(s + 4, bigEndian), load32(s + 16, bigEndian), load32(s + 20, bigEndian), load32(s + 24, bigEndian) };
+    };
+
+    constexpr uint32_t SHT_DYNSYM = 11;
+    for (uint32_t i = 0; i < numSections; i++) {
+        Section symbols = section(i);
+        if (symbols.type != SHT_DYNSYM || symbols.link >= numSections) continue;
+
+        Section strings = section(symbols.link);
+        std::vector<uint8_t> symbolTable, stringTable;
+        if (!reader.read(symbols.offset, symbolTable, symbols.size) ||
+            !reader.read(strings.offset, stringTable, strings.size)) {
+            return false;
+        }
+
+        size_t symbolSize = is64 ? 24 : 16;
+        for (size_t s = 0; s + symbolSize <= symbolTable.size(); s += symbolSize) {
+            const uint8_t* symbol = symbolTable.data() + s;
+            uint8_t symbolInfo = symbol[is64 ? 4 : 12];
+            uint16_t sectionIndex = load16(symbol + (is64 ? 6 : 14), bigEndian);
+            uint8_t binding = symbolInfo >> 4;
+
+            // Defined, STB_GLOBAL or STB_WEAK
+            if (sectionIndex == 0 || (binding != 1 && binding != 2)) continue;
+            noteExport(tableString(stringTable, load32(symbol, bigEndian)), info);
+        }
+
+        info.exportsParsed = true;
+        return true;
+    }
+
+    return false;
+}
+
+// Mach-O: external symbols defined in a section, from LC_SYMTAB
+bool parseMachOSlice(FileReader& reader, uint64_t base, BinaryInfo& info) {
+    uint8_t header[32];
+    if (!reader.read(base, header, sizeof(header))) return false;
+
+    uint32_t magic = load32(header, false);
+    bool is64 = magic == 0xfeedfacf || magic == 0xcffaedfe;
+    bool bigEndian = magic == 0xcefaedfe || magic == 0xcffaedfe;
+    if (!is64 && magic != 0xfeedface && magic != 0xcefaedfe) return false;
+    info.architectures.push_back(machOArchitecture(load32(header + 4, bigEndian)));
+
+    uint32_t numCommands = load32(header + 16, bigEndian);
+    uint32_t commandsSize = load32(header + 20, bigEndian);
+    std::vector<uint8_t> commands;
+    if (!reader.read(base + (is64 ? 32 : 28), commands, commandsSize)) return false;
+
+    constexpr uint32_t LC_SYMTAB = 0x2;
+    size_t offset = 0;
+    for (uint32_t c = 0; c < numCommands && offset + 8 <= commands.size(); c++) {
+        uint32_t command = load32(commands.data() + offset, bigEndian);
+        uint32_t commandSize = load32(commands.data() + offset + 4, bigEndian);
+        if (commandSize < 8) return false;
+
+        if (command == LC_SYMTAB && offset + 24 <= commands.size()) {
+            const uint8_t* symtab = commands.data() + offset;
+            uint32_t symbolsOffset = load32(symtab + 8, bigEndian);
+            uint32_t numSymbols = load32(symtab + 12, bigEndian);
+            uint32_t stringsOffset = load32(symtab + 16, bigEndian);
+            uint32_t stringsSize = load32(symtab + 20, bigEndian);
+
+            size_t symbolSize = is64 ? 16 : 12;
+            std::vector<uint8_t> symbolTable, stringTable;
+            if (!reader.read(base + symbolsOffset, symbolTable, uint64_t(numSymbols) * symbolSize) ||
+                !reader.read(base + stringsOffset, stringTable, stringsSize)) {
+                return false;
+            }
+
+            for (size_t s = 0; s + symbolSize <= symbolTable.size(); s += symbolSize) {
+                const uint8_t* symbol = symbolTable.data() + s;
+                uint8_t type = symbol[4];
+
+                // Not a debug entry, N_EXT, and N_TYPE == N_SECT
+                if ((type & 0xe0) != 0 || (type & 0x01) == 0 || (type & 0x0e) != 0x0e) continue;
+
+                // C symbols carry a leading underscore
+                std::string_view name = tableString(stringTable, load32(symbol, bigEndian));
+                if (!name.empty() && name.front() == '_') noteExport(name.substr(1), info);
+            }
+
+            info.exportsParsed = true;
+            return true;
+        }
+        offset += commandSize;
+    }
+
+    return false;
+}
+
+bool parseMachO(FileReader& reader, BinaryInfo& info) {
+    uint8_t header[8];
+    if (!reader.read(0, header, sizeof(header))) return false;
+
+    uint32_t thinMagic = load32(header, false);
+    if (thinMagic == 0xfeedface || thinMagic == 0xfeedfacf ||
+        thinMagic == 0xcefaedfe || thinMagic == 0xcffaedfe) {
+        info.format = BinaryFormat::MachO;
+        return parseMachOSlice(reader, 0, info);
+    }
+
+    uint32_t magic = load32(header, true);
+    if (magic != 0xcafebabe && magic != 0xcafebabf) return false;
+
+    // Universal binary: big-endian fat header, 0xcafebabe is shared with Java
+    // class files but those never have such a small second word
+    bool fat64 = magic == 0xcafebabf;
+    uint32_t numSlices = load32(header + 4, true);
+    if (numSlices == 0 || numSlices > maxFatSlices) return false;
+    info.format = BinaryFormat::MachOUniversal;
+
+    size_t sliceSize = fat64 ? 32 : 20;
+    std::vector<uint8_t> slices;
+    if (!reader.read(8, slices, uint64_t(numSlices) * sliceSize)) return false;
+
+    // A symbol exported by any slice counts. The architecture comes from
+    // the fat header so that it is known even if the slice can't be parsed.
+    bool anyParsed = false;
+    for (uint32_t i = 0; i < numSlices; i++) {
+        const uint8_t* slice = slices.data() + i * sliceSize;
+        info.architectures.push_back(machOArchitecture(load32(slice, true)));
+
+        uint64_t offset = fat64 ? load64(slice + 8, true) : load32(slice + 8, true);
+        BinaryInfo sliceInfo;
+        if (parseMachOSlice(reader, offset, sliceInfo)) {
+            anyParsed = true;
+            info.hasVst2Entry |= sliceInfo.hasVst2Entry;
+            info.hasVst3Entry |= sliceInfo.hasVst3Entry;
+            info.hasClapEntry |= sliceInfo.hasClapEntry;
+        }
+    }
+
+    info.exportsParsed = anyParsed;
+    return true;
+}
+
+// VST3 bundles on Windows and Linux: Contents/<arch>-win/<name>.vst3 and
+// Contents/<arch>-linux/<name>.so
+struct BundleArchDir {
+    const char* dir;
+    ProcessorArchitecture arch;
+};
+
+constexpr BundleArchDir kBundleArchDirs[] = {
+    { "x86_64-win", ProcessorArchitecture::X86_64 },
+    { "x86_64-linux", ProcessorArchitecture::X86_64 },
+    { "x86-win", ProcessorArchitecture::X86 },
+    { "i386-linux", ProcessorArchitecture::X86 },
+    { "arm64-win", ProcessorArchitecture::ARM64 },
+    { "arm64x-win", ProcessorArchitecture::ARM64 },
+    { "arm64ec-win", ProcessorArchitecture::ARM64 },
+    { "aarch64-linux", ProcessorArchitecture::ARM64 },
+    { "arm-win", ProcessorArchitecture::ARM32 },
+    { "armv7l-linux", ProcessorArchitecture::ARM32 },
+};
+
+std::filesystem::path bundleBinary(const std::filesystem::path& bundle, const char* archDir) {
+    std::error_code ec;
+    auto dir = bundle / "Contents" / archDir;
+    if (std::filesystem::is_regular_file(dir / bundle.filename(), ec)) return dir / bundle.filename();
+    auto so = dir / bundle.stem();
+    so += ".so";
+    if (std::filesystem::is_regular_file(so, ec)) return so;
+    return {};
+}
+
+} // namespace
+
+bool BinaryInfo::canLoadIn(ProcessorArchitecture host) const {
+    if (architectures.empty()) return true;
+    return std::find(architectures.begin(), architectures.end(), host) != architectures.end();
+}
+
+ProcessorArchitecture BinaryInfo::architectureFor(ProcessorArchitecture host) const {
+    if (architectures.empty()) return ProcessorArchitecture::UNKNOWN;
+    if (canLoadIn(host)) return host;
+    return architectures.front();
+}
+
+BinaryInfo BinaryInspector::inspect(const std::filesystem::path& path) {
+    BinaryInfo info;
+
+    auto binary = resolveBinary(path);
+    if (binary.empty()) return info;
+
+    FileReader reader(binary);
+    uint8_t magic[4];
+    if (!reader.isOpen() || !reader.read(0, magic, sizeof(magic))) return info;
+
+    if (magic[0] == 'M' && magic[1] == 'Z') {
+        parsePE(reader, info);
+    } else if (std::memcmp(magic, "\x7f" "ELF", 4) == 0) {
+        parseELF(reader, info);
+    } else {
+        parseMachO(reader, info);
+    }
+
+    // A failed parse leaves the flags unreliable
+    if (!info.exportsParsed) {
+        info.hasVst2Entry = info.hasVst3Entry = info.hasClapEntry = false;
+    }
+    return info;
+}
+
+std::filesystem::path BinaryInspector::resolveBinary(const std::filesystem::path& path) {
+    std::error_code ec;
+    if (!std::filesystem::is_directory(path, ec)) return path;
+
+    auto contents = path / "Contents";
+    auto stem = path.stem();
+
+    // macOS bundles, and the Info.plist-less layout some Linux builds copy
+    auto macos = contents / "MacOS";
+    if (std::filesystem::is_regular_file(macos / stem, ec)) return macos / stem;
+    if (std::filesystem::is_directory(macos, ec)) {
+        for (const auto& entry : std::filesystem::directory_iterator(macos, ec)) {
+            if (entry.is_regular_file(ec)) return entry.path();
+        }
+    }
+
+    auto host = hostArchitecture();
+    for (const auto& archDir : kBundleArchDirs) {
+        if (archDir.arch != host) continue;
+        auto binary = bundleBinary(path, archDir.dir);
+        if (!binary.empty()) return binary;
+    }
+
+    return {};
+}
+
+std::vector<ProcessorArchitecture> BinaryInspector::bundleArchitectures(const std::filesystem::path& path) {
+    std::vector<ProcessorArchitecture> architectures;
+    for (const auto& archDir : kBundleArchDirs) {
+        if (std::find(architectures.begin(), architectures.end(), archDir.arch) != architectures.end()) continue;
+        if (!bundleBinary(path, archDir.dir).empty()) architectures.push_back(archDir.arch);
+    }
+    return architectures;
+}
+
+ProcessorArchitecture BinaryInspector::hostArchitecture() {
+#if defined(_M_ARM64) || defined(_M_ARM64EC) || defined(__aarch64__)
+    return ProcessorArchitecture::ARM64;
+#elif defined(_M_X64) || defined(__x86_64__)
+    return ProcessorArchitecture::X86_64;
+#elif defined(_M_IX86) || defined(__i386__)
+    return ProcessorArchitecture::X86;
+#elif defined(_M_ARM) || defined(__arm__)
+    return ProcessorArchitecture::ARM32;
+#else
+    return ProcessorArchitecture::UNKNOWN;
+#endif
+}
+
+} // namespace futureboard
@@ -0,0 +1,73 @@
+#pragma once
+
+// Reads just enough of a shared library's headers (PE, ELF, Mach-O and
+// universal Mach-O) to tell which plugin entry points it exports and which
+// architectures it was built for, without loading it. Used by the directory
+// walker to drop support libraries that sit next to plugins, and by the
+// scanner to skip binaries this process could never load.
+
+#include <filesystem>
+#include <vector>
+
+namespace futureboard {
+
+enum class ProcessorArchitecture {
+    X86_64,
+    X86,
+    ARM64,
+    ARM32,
+    UNKNOWN
+};
+
+enum class BinaryFormat {
+    Unknown,
+    PE,
+    ELF,
+    MachO,
+    MachOUniversal
+};
+
+struct BinaryInfo {
+    BinaryFormat format = BinaryFormat::Unknown;
+
+    // One per slice for universal binaries, empty if the header was unreadable
+    std::vector<ProcessorArchitecture> architectures;
+
+    // False when the export table couldn't be read (stripped or unusual
+    // layout). The entry point flags are then meaningless and the file
+    // should be handed to the loader as before.
+    bool exportsParsed = false;
+
+    bool hasVst2Entry = false;  // VSTPluginMain, main, main_macho, main_plugin
+    bool hasVst3Entry = false;  // GetPluginFactory
+    bool hasClapEntry = false;  // clap_entry
+
+    // True unless the architectures are known and none of them is host.
+    // A slice of unknown architecture never makes a binary loadable.
+    bool canLoadIn(ProcessorArchitecture host) const;
+
+    // host if the binary contains it, otherwise its first architecture
+    ProcessorArchitecture architectureFor(ProcessorArchitecture host) const;
+};
+
+class BinaryInspector {
+public:
+    // path may be a plugin bundle, in which case its executable is inspected
+    static BinaryInfo inspect(const std::filesystem::path& path);
+
+    // The executable inside a .vst3/.clap/.vst bundle directory, or path
+    // itself when it isn't a directory. Empty if the bundle has none.
+    static std::filesystem::path resolveBinary(const std::filesystem::path& path);
+
+    // Architectures a bundle has Contents/<arch>-win or <arch>-linux
+    // executables for, whichever resolveBinary() picks. Tells a bundle built
+    // only for other machines from one with no binary at all.
+    static std::vector<ProcessorArchitecture> bundleArchitectures(const std::filesystem::path& path);
+
+    // What this process was compiled for, i.e. what it can dlopen. Unlike
+    // PluginScanner::detectSystemArchitecture this is x86_64 for an x64
+    // build running under emulation on an ARM64 machine.
+    static ProcessorArchitecture hostArchitecture();
+};
+
+} // namespace futureboard
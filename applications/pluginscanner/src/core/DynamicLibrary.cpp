@@ -0,0 +1,56 @@
+#include "DynamicLibrary.hpp"
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <dlfcn.h>
+#endif
+
+namespace futureboard {
+
+DynamicLibrary::~DynamicLibrary() {
+    close();
+}
+
+bool DynamicLibrary::open(const std::filesystem::path& path) {
+    close();
+    error.clear();
+
+#ifdef _WIN32
+    handle = LoadLibraryW(path.wstring().c_str());
+    if (!handle) {
+        error = "Failed to load library (error " + std::to_string(GetLastError()) + ")";
+    }
+#else
+    handle = dlopen(path.c_str(), RTLD_LAZY | RTLD_LOCAL);
+    if (!handle) {
+        const char* message = dlerror();
+        error = message ? message : "Failed to load library";
+    }
+#endif
+
+    return handle != nullptr;
+}
+
+void DynamicLibrary::close() {
+    if (!handle) return;
+
+#ifdef _WIN32
+    FreeLibrary(static_cast<HMODULE>(handle));
+#else
+    dlclose(handle);
+#endif
+    handle = nullptr;
+}
+
+void* DynamicLibrary::getSymbol(const char* name) const {
+    if (!handle) return nullptr;
+
+#ifdef _WIN32
+    return reinterpret_cast<void*>(GetProcAddress(static_cast<HMODULE>(handle), name));
+#else
+    return dlsym(handle, name);
+#endif
+}
+
+} // namespace futureboard
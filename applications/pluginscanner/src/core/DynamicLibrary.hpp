@@ -0,0 +1,30 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+
+namespace futureboard {
+
+// Owns a LoadLibrary/dlopen handle and unloads it on destruction
+class DynamicLibrary {
+public:
+    DynamicLibrary() = default;
+    ~DynamicLibrary();
+
+    DynamicLibrary(const DynamicLibrary&) = delete;
+    DynamicLibrary& operator=(const DynamicLibrary&) = delete;
+
+    // On failure getError() says why
+    bool open(const std::filesystem::path& path);
+    void close();
+    bool isOpen() const { return handle != nullptr; }
+
+    void* getSymbol(const char* name) const;
+    const std::string& getError() const { return error; }
+
+private:
+    void* handle = nullptr;
+    std::string error;
+};
+
+} // namespace futureboard
@@ -0,0 +1,308 @@
+#include "PluginBenchmark.hpp"
+#include "audiothread.hpp"
+#include "clappluginnode.hpp"
+#include "eventlist.hpp"
+#include <juce_audio_processors/juce_audio_processors.h>
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+
+namespace futureboard {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr uint32_t warmupBlocks = 32;
+constexpr double secondsPerSetting = 0.5;
+constexpr uint32_t minBlocks = 100;
+
+// Long enough that the noise doesn't visibly repeat, with room for a block
+// starting at any offset
+constexpr uint32_t noiseFrames = 65536;
+constexpr uint32_t maxBlockSize = 4096;
+
+// Chords of four notes, one every chordSeconds
+constexpr double chordSeconds = 0.25;
+constexpr int chordRoots[] = { 48, 53, 55, 50 };
+constexpr int chordIntervals[] = { 0, 4, 7, 11 };
+
+std::vector<float> makeNoise() {
+    std::vector<float> noise(noiseFrames + maxBlockSize);
+    uint32_t state = 0x9e3779b9u;
+    for (auto& sample : noise) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        sample = static_cast<float>(state) / 4294967296.0f - 0.5f;
+    }
+    return noise;
+}
+
+// Start of channel's noise in block number index, different per channel
+uint32_t noiseOffset(uint64_t index, uint32_t blockSize, uint32_t channel) {
+    return static_cast<uint32_t>((index * blockSize + channel * 7919u) % noiseFrames);
+}
+
+struct NoteEvent {
+    uint32_t time;
+    int key;
+    bool on;
+};
+
+// Note changes inside the block starting at position: the previous chord
+// ends and the next one starts on every chord boundary
+void chordEvents(uint64_t position, uint32_t blockSize, uint32_t sampleRate, std::vector<NoteEvent>& events) {
+    events.clear();
+    auto period = static_cast<uint64_t>(chordSeconds * sampleRate);
+    uint64_t next = (position + period - 1) / period * period;
+    for (; next < position + blockSize; next += period) {
+        auto time = static_cast<uint32_t>(next - position);
+        uint64_t chord = next / period;
+        if (chord > 0) {
+            int root = chordRoots[(chord - 1) % std::size(chordRoots)];
+            for (int interval : chordIntervals) events.push_back({ time, root + interval, false });
+        }
+        int root = chordRoots[chord % std::size(chordRoots)];
+        for (int interval : chordIntervals) events.push_back({ time, root + interval, true });
+    }
+}
+
+} // namespace
+
+PluginBenchmark::PluginBenchmark()
+    : settings(defaultSettings())
+    , formatManager(std::make_unique<juce::AudioPluginFormatManager>())
+{
+    juce::MessageManager::getInstance();
+    formatManager->addFormat(new juce::VST3PluginFormat());
+    formatManager->addFormat(new juce::VSTPluginFormat());
+}
+
+PluginBenchmark::~PluginBenchmark() = default;
+
+std::vector<PluginBenchmark::Setting> PluginBenchmark::defaultSettings() {
+    std::vector<Setting> result;
+    for (uint32_t sampleRate : { 44100u, 48000u, 96000u }) {
+        for (uint32_t blockSize : { 64u, 128u, 256u, 512u, 1024u }) {
+            result.push_back({ sampleRate, blockSize });
+        }
+    }
+    return result;
+}
+
+void PluginBenchmark::setSettings(const std::vector<Setting>& newSettings) {
+    settings.clear();
+    for (const auto& setting : newSettings) {
+        if (setting.sampleRate > 0 && setting.blockSize > 0 && setting.blockSize <= maxBlockSize) {
+            settings.push_back(setting);
+        }
+    }
+}
+
+bool PluginBenchmark::run(PluginInfo& info, std::string& error) {
+    if (!info.isValid) {
+        error = "Plugin did not pass the scan";
+        return false;
+    }
+    if (settings.empty()) {
+        error = "No settings to benchmark";
+        return false;
+    }
+
+    std::vector<BlockTimes> times;
+    bool ok = false;
+    if (info.format == PluginFormat::CLAP) {
+        ok = runClap(info, times, error);
+    } else if (info.format == PluginFormat::VST2 || info.format == PluginFormat::VST3) {
+        ok = runJuce(info, times, error);
+    } else {
+        error = "Unsupported format";
+    }
+    if (!ok) return false;
+
+    info.costHints.clear();
+    for (size_t i = 0; i < settings.size(); i++) {
+        info.costHints.push_back(summarize(settings[i], times[i]));
+    }
+    return true;
+}
+
+bool PluginBenchmark::runClap(const PluginInfo& info, std::vector<BlockTimes>& times, std::string& error) {
+    auto node = ClapPluginNode::create(info.path, info.clapId, error);
+    if (!node) return false;
+
+    auto noise = makeNoise();
+    std::vector<const float*> inputs(node->numInputs());
+    std::vector<std::vector<float>> outputBuffers(node->numOutputs(), std::vector<float>(maxBlockSize));
+    std::vector<float*> outputs;
+    for (auto& buffer : outputBuffers) outputs.push_back(buffer.data());
+
+    EventList inEvents;
+    EventList outEvents;
+    std::vector<NoteEvent> notes;
+
+    for (const auto& setting : settings) {
+        if (!node->prepare(setting.sampleRate, setting.blockSize)) {
+            error = "Plugin failed to activate at " + std::to_string(setting.sampleRate) + " Hz, " +
+                    std::to_string(setting.blockSize) + " frames";
+            return false;
+        }
+
+        AudioBlock block;
+        block.frames = setting.blockSize;
+        block.inputs = inputs.data();
+        block.outputs = outputs.data();
+        block.inEvents = &inEvents;
+        block.outEvents = &outEvents;
+
+        uint32_t count = blocksFor(setting);
+        BlockTimes blockTimes;
+        blockTimes.reserve(count);
+        {
+            audiothread::Scope audioThread;
+            for (uint32_t i = 0; i < warmupBlocks + count; i++) {
+                block.steadyTime = int64_t(i) * setting.blockSize;
+                for (uint32_t channel = 0; channel < inputs.size(); channel++) {
+                    inputs[channel] = noise.data() + noiseOffset(i, setting.blockSize, channel);
+                }
+
+                inEvents.clear();
+                outEvents.clear();
+                chordEvents(uint64_t(block.steadyTime), setting.blockSize, setting.sampleRate, notes);
+                for (const auto& note : notes) {
+                    clap_event_note_t event{};
+                    event.header.size = sizeof(event);
+                    event.header.time = note.time;
+                    event.header.space_id = CLAP_CORE_EVENT_SPACE_ID;
+                    event.header.type = note.on ? CLAP_EVENT_NOTE_ON : CLAP_EVENT_NOTE_OFF;
+                    event.note_id = -1;
+                    event.port_index = 0;
+                    event.channel = 0;
+                    event.key = static_cast<int16_t>(note.key);
+                    event.velocity = 0.8;
+                    inEvents.push(&event.header);
+                }
+
+                auto start = Clock::now();
+                node->process(block);
+                double us = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+                if (i >= warmupBlocks) blockTimes.push_back(us);
+            }
+        }
+        bool failed = node->hasFailed();
+        node->release();
+        if (failed) {
+            error = "Plugin returned an error while processing";
+            return false;
+        }
+        times.push_back(std::move(blockTimes));
+    }
+    return true;
+}
+
+bool PluginBenchmark::runJuce(const PluginInfo& info, std::vector<BlockTimes>& times, std::string& error) {
+    juce::String formatName = info.format == PluginFormat::VST3 ? "VST3" : "VST";
+    juce::AudioPluginFormat* format = nullptr;
+    for (int i = 0; i < formatManager->getNumFormats(); i++) {
+        if (formatManager->getFormat(i)->getName() == formatName) format = formatManager->getFormat(i);
+    }
+    if (!format) {
+        error = "Unsupported format";
+        return false;
+    }
+
+    // A shell or VST3 bundle can hold several plugins
+    juce::OwnedArray<juce::PluginDescription> descriptions;
+    format->findAllTypesForFile(descriptions, info.path);
+    const juce::PluginDescription* description = nullptr;
+    for (auto* candidate : descriptions) {
+        if (juce::String(candidate->uniqueId).toStdString() == info.uniqueId ||
+            candidate->name.toStdString() == info.name) {
+            description = candidate;
+            break;
+        }
+    }
+    if (!description && !descriptions.isEmpty()) description = descriptions[0];
+    if (!description) {
+        error = "No plugin found in file";
+        return false;
+    }
+
+    const auto& first = settings.front();
+    juce::String errorMessage;
+    auto instance = formatManager->createPluginInstance(*description, first.sampleRate,
+                                                        static_cast<int>(first.blockSize), errorMessage);
+    if (!instance) {
+        error = errorMessage.isEmpty() ? "Failed to create plugin instance" : errorMessage.toStdString();
+        return false;
+    }
+
+    auto noise = makeNoise();
+    int numInputs = instance->getTotalNumInputChannels();
+    int channels = std::max(numInputs, instance->getTotalNumOutputChannels());
+    juce::AudioBuffer<float> buffer(std::max(channels, 1), static_cast<int>(maxBlockSize));
+    juce::MidiBuffer midi;
+    std::vector<NoteEvent> notes;
+    bool sendNotes = instance->acceptsMidi();
+
+    for (const auto& setting : settings) {
+        auto blockSize = static_cast<int>(setting.blockSize);
+        instance->prepareToPlay(setting.sampleRate, blockSize);
+        buffer.setSize(buffer.getNumChannels(), blockSize, false, false, true);
+
+        uint32_t count = blocksFor(setting);
+        BlockTimes blockTimes;
+        blockTimes.reserve(count);
+        for (uint32_t i = 0; i < warmupBlocks + count; i++) {
+            // Processing is in place, so the noise goes in anew every block
+            buffer.clear();
+            for (int channel = 0; channel < numInputs; channel++) {
+                buffer.copyFrom(channel, 0, noise.data() + noiseOffset(i, setting.blockSize, channel), blockSize);
+            }
+
+            midi.clear();
+            if (sendNotes) {
+                chordEvents(uint64_t(i) * setting.blockSize, setting.blockSize, setting.sampleRate, notes);
+                for (const auto& note : notes) {
+                    auto message = note.on ? juce::MidiMessage::noteOn(1, note.key, static_cast<juce::uint8>(100))
+                                           : juce::MidiMessage::noteOff(1, note.key);
+                    midi.addEvent(message, static_cast<int>(note.time));
+                }
+            }
+
+            auto start = Clock::now();
+            instance->processBlock(buffer, midi);
+            double us = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+            if (i >= warmupBlocks) blockTimes.push_back(us);
+        }
+        instance->releaseResources();
+        times.push_back(std::move(blockTimes));
+    }
+    return true;
+}
+
+uint32_t PluginBenchmark::blocksFor(const Setting& setting) {
+    auto blocks = static_cast<uint32_t>(secondsPerSetting * setting.sampleRate / setting.blockSize);
+    return std::max(blocks, minBlocks);
+}
+
+plugindb::CostHint PluginBenchmark::summarize(const Setting& setting, BlockTimes& times) {
+    plugindb::CostHint hint{};
+    hint.sampleRate = setting.sampleRate;
+    hint.blockSize = setting.blockSize;
+    if (times.empty()) return hint;
+
+    std::sort(times.begin(), times.end());
+    auto percentile = [&times](double fraction) {
+        auto index = static_cast<size_t>(fraction * static_cast<double>(times.size() - 1) + 0.5);
+        return static_cast<float>(times[index]);
+    };
+    hint.medianUs = percentile(0.5);
+    hint.p90Us = percentile(0.9);
+    hint.p99Us = percentile(0.99);
+    hint.maxUs = static_cast<float>(times.back());
+    return hint;
+}
+
+} // namespace futureboard
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "PluginScanner.hpp"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace futureboard {
+
+// Measures how much time plugins take to process audio, for the cost hints
+// kept in the plugin database (vstscanner --bench).
+//
+// A plugin is instantiated on its own and fed white noise on every input
+// and, if it takes MIDI, a four-note chord that changes every quarter
+// second. For each setting it is activated afresh, warmed up and then timed
+// block by block over half a second of audio; the per-block times become
+// one plugindb::CostHint. Everything runs on one thread, so the hints are
+// the work a plugin adds to a single audio thread.
+//
+// CLAP plugins are run through the engine's ClapPluginNode, the way the
+// DAW hosts them; VST2 and VST3 plugins through JUCE.
+class PluginBenchmark {
+public:
+    struct Setting {
+        uint32_t sampleRate;
+        uint32_t blockSize;
+    };
+
+    PluginBenchmark();
+    ~PluginBenchmark();
+
+    // 44.1, 48 and 96 kHz, each with blocks of 64 to 1024 frames
+    static std::vector<Setting> defaultSettings();
+    void setSettings(const std::vector<Setting>& newSettings);
+
+    // Replaces info.costHints. False with error when the plugin couldn't be
+    // instantiated or processed.
+    bool run(PluginInfo& info, std::string& error);
+
+    static constexpr const char* workerArgument = "--bench";
+
+private:
+    // Times one setting, in microseconds per block
+    using BlockTimes = std::vector<double>;
+    bool runClap(const PluginInfo& info, std::vector<BlockTimes>& times, std::string& error);
+    bool runJuce(const PluginInfo& info, std::vector<BlockTimes>& times, std::string& error);
+
+    static uint32_t blocksFor(const Setting& setting);
+    static plugindb::CostHint summarize(const Setting& setting, BlockTimes& times);
+
+    std::vector<Setting> settings;
+    std::unique_ptr<juce::AudioPluginFormatManager> formatManager;
+};
+
+} // namespace futureboard
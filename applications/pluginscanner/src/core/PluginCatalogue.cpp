@@ -0,0 +1,357 @@
+#include "PluginCatalogue.hpp"
+#include <algorithm>
+#include <cstring>
+
+#ifdef _MSC_VER
+    #include <intrin.h>
+#endif
+
+namespace futureboard {
+
+namespace {
+
+int popCount(uint64_t word) {
+#ifdef _MSC_VER
+    return static_cast<int>(__popcnt64(word));
+#else
+    return __builtin_popcountll(word);
+#endif
+}
+
+int lowestBit(uint64_t word) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, word);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctzll(word);
+#endif
+}
+
+uint8_t clampCount(size_t count) {
+    return static_cast<uint8_t>(std::min<size_t>(count, 255));
+}
+
+uint16_t clampChannels(int32_t channels) {
+    return static_cast<uint16_t>(std::clamp<int32_t>(channels, 0, 0xffff));
+}
+
+} // namespace
+
+// --- StringPool ---
+
+StringPool::StringPool() {
+    clear();
+}
+
+void StringPool::clear() {
+    data.assign(1, '\0');
+    offsets.assign(1, 0);
+    slots.assign(64, 0);
+}
+
+uint64_t StringPool::hash(std::string_view text) {
+    // FNV-1a, 64-bit
+    uint64_t value = 14695981039346656037ull;
+    for (unsigned char c : text) {
+        value ^= c;
+        value *= 1099511628211ull;
+    }
+    return value;
+}
+
+size_t StringPool::slotFor(std::string_view text, uint64_t textHash) const {
+    size_t mask = slots.size() - 1;
+    size_t slot = static_cast<size_t>(textHash) & mask;
+    while (slots[slot] != 0 && get(slots[slot] - 1) != text) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+void StringPool::rehash(size_t slotCount) {
+    slots.assign(slotCount, 0);
+    for (uint32_t id = 1; id < offsets.size(); id++) {
+        auto text = get(id);
+        slots[slotFor(text, hash(text))] = id + 1;
+    }
+}
+
+uint32_t StringPool::intern(std::string_view text) {
+    if (text.empty()) return 0;
+
+    size_t slot = slotFor(text, hash(text));
+    if (slots[slot] != 0) return slots[slot] - 1;
+
+    auto id = static_cast<uint32_t>(offsets.size());
+    offsets.push_back(static_cast<uint32_t>(data.size()));
+    data.insert(data.end(), text.begin(), text.end());
+    data.push_back('\0');
+    slots[slot] = id + 1;
+
+    // Keep the table at most half full
+    if (offsets.size() * 2 > slots.size()) rehash(slots.size() * 2);
+    return id;
+}
+
+uint32_t StringPool::find(std::string_view text) const {
+    if (text.empty()) return 0;
+
+    size_t slot = slotFor(text, hash(text));
+    return slots[slot] != 0 ? slots[slot] - 1 : npos;
+}
+
+size_t StringPool::memoryUsage() const {
+    return data.capacity() + offsets.capacity() * sizeof(uint32_t) + slots.capacity() * sizeof(uint32_t);
+}
+
+// --- PluginBitset ---
+
+PluginBitset::PluginBitset(size_t bitCount, bool value)
+    : words((bitCount + 63) / 64, value ? ~0ull : 0ull)
+{
+    if (value && bitCount % 64 != 0) {
+        words.back() = (1ull << (bitCount % 64)) - 1;
+    }
+}
+
+void PluginBitset::set(uint32_t index) {
+    size_t word = index / 64;
+    if (word >= words.size()) words.resize(word + 1, 0);
+    words[word] |= 1ull << (index % 64);
+}
+
+bool PluginBitset::test(uint32_t index) const {
+    size_t word = index / 64;
+    return word < words.size() && (words[word] >> (index % 64)) & 1;
+}
+
+size_t PluginBitset::count() const {
+    size_t total = 0;
+    for (uint64_t word : words) total += popCount(word);
+    return total;
+}
+
+bool PluginBitset::none() const {
+    return std::all_of(words.begin(), words.end(), [](uint64_t word) { return word == 0; });
+}
+
+void PluginBitset::intersect(const PluginBitset& other) {
+    size_t common = std::min(words.size(), other.words.size());
+    uint64_t* out = words.data();
+    const uint64_t* in = other.words.data();
+    // Plain word loop so the compiler can vectorize it
+    for (size_t i = 0; i < common; i++) out[i] &= in[i];
+    std::fill(words.begin() + common, words.end(), 0);
+}
+
+void PluginBitset::unite(const PluginBitset& other) {
+    if (other.words.size() > words.size()) words.resize(other.words.size(), 0);
+    uint64_t* out = words.data();
+    const uint64_t* in = other.words.data();
+    for (size_t i = 0; i < other.words.size(); i++) out[i] |= in[i];
+}
+
+std::vector<uint32_t> PluginBitset::indices() const {
+    std::vector<uint32_t> result;
+    result.reserve(count());
+    for (size_t i = 0; i < words.size(); i++) {
+        uint64_t word = words[i];
+        while (word != 0) {
+            result.push_back(static_cast<uint32_t>(i * 64 + lowestBit(word)));
+            word &= word - 1;
+        }
+    }
+    return result;
+}
+
+// --- PluginCatalogue ---
+
+static_assert(sizeof(PluginCatalogue::Record) == 40, "catalogue record layout changed");
+
+void PluginCatalogue::clear() {
+    strings.clear();
+    records.clear();
+    tagRefs.clear();
+    costs.clear();
+    for (auto& column : flagColumns) column = PluginBitset();
+    formatColumns.clear();
+    vendorColumns.clear();
+    categoryColumns.clear();
+    featureColumns.clear();
+}
+
+void PluginCatalogue::reserve(size_t count) {
+    records.reserve(count);
+    costs.reserve(count);
+}
+
+uint32_t PluginCatalogue::add(const PluginDatabaseEntry& entry) {
+    Record record{};
+    record.name = strings.intern(entry.name);
+    record.vendor = strings.intern(entry.vendor);
+    record.version = strings.intern(entry.version);
+    record.path = strings.intern(entry.path);
+    record.uniqueId = strings.intern(entry.uniqueId);
+    record.clapId = strings.intern(entry.clapId);
+    record.format = entry.format;
+    record.arch = entry.arch;
+    record.flags = entry.flags;
+    record.numInputChannels = clampChannels(entry.numInputChannels);
+    record.numOutputChannels = clampChannels(entry.numOutputChannels);
+
+    std::vector<uint32_t> categoryIds;
+    std::vector<uint32_t> featureIds;
+    for (const auto& category : entry.categories) categoryIds.push_back(strings.intern(category));
+    for (const auto& feature : entry.features) featureIds.push_back(strings.intern(feature));
+
+    float costUs = plugindb::estimateCostUs(entry.costHints.data(), static_cast<uint32_t>(entry.costHints.size()),
+                                            costSampleRate, costBlockSize);
+    return addRecord(record, categoryIds, featureIds, costUs);
+}
+
+void PluginCatalogue::load(const PluginDatabase& database) {
+    clear();
+    reserve(database.size());
+
+    std::vector<uint32_t> categoryIds;
+    std::vector<uint32_t> featureIds;
+    for (uint32_t i = 0; i < database.size(); i++) {
+        const auto& source = database.record(i);
+
+        Record record{};
+        record.name = strings.intern(database.string(source.name));
+        record.vendor = strings.intern(database.string(source.vendor));
+        record.version = strings.intern(database.string(source.version));
+        record.path = strings.intern(database.string(source.path));
+        record.uniqueId = strings.intern(database.string(source.uniqueId));
+        record.clapId = strings.intern(database.string(source.clapId));
+        record.format = source.format;
+        record.arch = source.arch;
+        record.flags = source.flags;
+        record.numInputChannels = clampChannels(source.numInputChannels);
+        record.numOutputChannels = clampChannels(source.numOutputChannels);
+
+        categoryIds.clear();
+        featureIds.clear();
+        for (uint32_t c = 0; c < source.categoriesCount; c++) {
+            categoryIds.push_back(strings.intern(database.category(source, c)));
+        }
+        for (uint32_t f = 0; f < source.featuresCount; f++) {
+            featureIds.push_back(strings.intern(database.feature(source, f)));
+        }
+
+        addRecord(record, categoryIds, featureIds, database.estimateCostUs(source, costSampleRate, costBlockSize));
+    }
+}
+
+uint32_t PluginCatalogue::addRecord(Record record, const std::vector<uint32_t>& categoryIds,
+                                    const std::vector<uint32_t>& featureIds, float costUs) {
+    auto index = static_cast<uint32_t>(records.size());
+
+    record.tagsBegin = static_cast<uint32_t>(tagRefs.size());
+    record.categoriesCount = clampCount(categoryIds.size());
+    record.featuresCount = clampCount(featureIds.size());
+    tagRefs.insert(tagRefs.end(), categoryIds.begin(), categoryIds.begin() + record.categoriesCount);
+    tagRefs.insert(tagRefs.end(), featureIds.begin(), featureIds.begin() + record.featuresCount);
+
+    for (int bit = 0; bit < flagCount; bit++) {
+        if (record.flags & (1u << bit)) flagColumns[bit].set(index);
+    }
+    formatColumns[record.format].set(index);
+    vendorColumns[record.vendor].set(index);
+    for (uint32_t id : categoryIds) categoryColumns[id].set(index);
+    for (uint32_t id : featureIds) featureColumns[id].set(index);
+
+    records.push_back(record);
+    costs.push_back(costUs);
+    return index;
+}
+
+std::string_view PluginCatalogue::category(const Record& record, uint32_t i) const {
+    return strings.get(tagRefs[record.tagsBegin + i]);
+}
+
+std::string_view PluginCatalogue::feature(const Record& record, uint32_t i) const {
+    return strings.get(tagRefs[record.tagsBegin + record.categoriesCount + i]);
+}
+
+void PluginCatalogue::intersectColumn(PluginBitset& result, const Columns& columns, std::string_view text) const {
+    uint32_t id = strings.find(text);
+    auto it = id == StringPool::npos ? columns.end() : columns.find(id);
+    if (it == columns.end()) {
+        result = PluginBitset();
+        return;
+    }
+    result.intersect(it->second);
+}
+
+PluginBitset PluginCatalogue::select(const Filter& filter) const {
+    PluginBitset result(records.size(), true);
+
+    for (int bit = 0; bit < flagCount; bit++) {
+        if (filter.flags & (1u << bit)) result.intersect(flagColumns[bit]);
+    }
+
+    if (filter.format >= 0) {
+        auto it = formatColumns.find(static_cast<uint32_t>(filter.format));
+        if (it == formatColumns.end()) return PluginBitset();
+        result.intersect(it->second);
+    }
+
+    if (!filter.vendor.empty()) intersectColumn(result, vendorColumns, filter.vendor);
+    for (auto category : filter.categories) intersectColumn(result, categoryColumns, category);
+    for (auto feature : filter.features) intersectColumn(result, featureColumns, feature);
+
+    for (auto tag : filter.tags) {
+        PluginBitset either;
+        uint32_t id = strings.find(tag);
+        if (id != StringPool::npos) {
+            auto category = categoryColumns.find(id);
+            if (category != categoryColumns.end()) either.unite(category->second);
+            auto feature = featureColumns.find(id);
+            if (feature != featureColumns.end()) either.unite(feature->second);
+        }
+        result.intersect(either);
+    }
+
+    if (filter.maxCostUs > 0.0f) {
+        PluginBitset affordable(records.size());
+        for (uint32_t i = 0; i < costs.size(); i++) {
+            if (costs[i] >= 0.0f && costs[i] <= filter.maxCostUs) affordable.set(i);
+        }
+        result.intersect(affordable);
+    }
+
+    return result;
+}
+
+std::vector<std::string_view> PluginCatalogue::vendors() const {
+    std::vector<std::string_view> result;
+    result.reserve(vendorColumns.size());
+    for (const auto& [id, column] : vendorColumns) {
+        if (id != 0) result.push_back(strings.get(id));
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+std::vector<std::string_view> PluginCatalogue::features() const {
+    std::vector<std::string_view> result;
+    result.reserve(featureColumns.size());
+    for (const auto& [id, column] : featureColumns) result.push_back(strings.get(id));
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+size_t PluginCatalogue::memoryUsage() const {
+    size_t total = strings.memoryUsage() + records.capacity() * sizeof(Record) +
+                   tagRefs.capacity() * sizeof(uint32_t) + costs.capacity() * sizeof(float);
+    for (const auto& column : flagColumns) total += column.memoryUsage();
+    for (const auto* columns : { &formatColumns, &vendorColumns, &categoryColumns, &featureColumns }) {
+        for (const auto& [id, column] : *columns) total += sizeof(id) + column.memoryUsage();
+    }
+    return total;
+}
+
+} // namespace futureboard
@@ -0,0 +1,156 @@
+#pragma once
+
+// Compact in-memory plugin catalogue for filtering. Like PluginDatabase.hpp
+// this only depends on the standard library and is shared with the main
+// application.
+//
+// Strings are interned once in a StringPool and records are fixed-size rows
+// of string ids. Flags, vendors, formats, categories and features are kept
+// as columns of bitsets with one bit per record, so a filter such as
+// "instruments by vendor X with feature Y" is an AND over a few bitsets,
+// 64 records per word.
+
+#include "PluginDatabase.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace futureboard {
+
+// Every distinct string is stored once, NUL-terminated, and referred to by
+// a 32-bit id. Id 0 is the empty string.
+class StringPool {
+public:
+    static constexpr uint32_t npos = 0xffffffffu;
+
+    StringPool();
+
+    void clear();
+    uint32_t intern(std::string_view text);
+    // npos when text was never interned
+    uint32_t find(std::string_view text) const;
+    std::string_view get(uint32_t id) const { return std::string_view(data.data() + offsets[id]); }
+
+    size_t size() const { return offsets.size(); }
+    size_t memoryUsage() const;
+
+private:
+    static uint64_t hash(std::string_view text);
+    size_t slotFor(std::string_view text, uint64_t textHash) const;
+    void rehash(size_t slotCount);
+
+    std::vector<char> data;
+    std::vector<uint32_t> offsets;  // id -> offset in data
+    std::vector<uint32_t> slots;    // Open addressing, id + 1, 0 is an empty slot
+};
+
+// One bit per catalogue record
+class PluginBitset {
+public:
+    PluginBitset() = default;
+    explicit PluginBitset(size_t bitCount, bool value = false);
+
+    void set(uint32_t index);
+    bool test(uint32_t index) const;
+    size_t count() const;
+    bool none() const;
+
+    // Missing words count as zero
+    void intersect(const PluginBitset& other);
+    void unite(const PluginBitset& other);
+
+    // Indices of the set bits, ascending
+    std::vector<uint32_t> indices() const;
+
+    size_t memoryUsage() const { return words.capacity() * sizeof(uint64_t); }
+
+private:
+    std::vector<uint64_t> words;
+};
+
+class PluginCatalogue {
+public:
+    // The block that costUs() is estimated for
+    static constexpr double costSampleRate = 48000.0;
+    static constexpr uint32_t costBlockSize = 256;
+
+    struct Record {
+        uint32_t name;
+        uint32_t vendor;
+        uint32_t version;
+        uint32_t path;
+        uint32_t uniqueId;
+        uint32_t clapId;
+        uint32_t tagsBegin;        // Into tagRefs: categories, then features
+        uint8_t categoriesCount;
+        uint8_t featuresCount;
+        uint8_t format;            // PluginFormat
+        uint8_t arch;              // ProcessorArchitecture
+        uint16_t flags;            // plugindb::RecordFlags
+        uint16_t numInputChannels;
+        uint16_t numOutputChannels;
+    };
+
+    // Every condition must hold; empty fields match anything
+    struct Filter {
+        uint16_t flags = 0;                 // plugindb::RecordFlags that must all be set
+        int format = -1;                    // PluginFormat, -1 for any
+        std::string_view vendor;
+        std::vector<std::string_view> categories;
+        std::vector<std::string_view> features;
+        // Each tag must be either a category or a feature
+        std::vector<std::string_view> tags;
+        // Only benchmarked plugins that cost at most this, 0 for any
+        float maxCostUs = 0.0f;
+    };
+
+    void clear();
+    void reserve(size_t count);
+    // Returns the record index
+    uint32_t add(const PluginDatabaseEntry& entry);
+    // One record per database record, at the same index
+    void load(const PluginDatabase& database);
+
+    uint32_t size() const { return static_cast<uint32_t>(records.size()); }
+    const Record& record(uint32_t index) const { return records[index]; }
+    std::string_view string(uint32_t id) const { return strings.get(id); }
+    std::string_view category(const Record& record, uint32_t i) const;
+    std::string_view feature(const Record& record, uint32_t i) const;
+    // Median microseconds per costBlockSize block, -1 when not benchmarked
+    float costUs(uint32_t index) const { return costs[index]; }
+
+    PluginBitset select(const Filter& filter) const;
+    // Record indices, ascending
+    std::vector<uint32_t> filter(const Filter& filter) const { return select(filter).indices(); }
+
+    // Distinct values, for filter menus
+    std::vector<std::string_view> vendors() const;
+    std::vector<std::string_view> features() const;
+
+    size_t memoryUsage() const;
+
+private:
+    using Columns = std::unordered_map<uint32_t, PluginBitset>;
+
+    uint32_t addRecord(Record record, const std::vector<uint32_t>& categoryIds,
+                       const std::vector<uint32_t>& featureIds, float costUs);
+    // Intersects result with the column for text; unknown values empty it
+    void intersectColumn(PluginBitset& result, const Columns& columns, std::string_view text) const;
+
+    StringPool strings;
+    std::vector<Record> records;
+    std::vector<uint32_t> tagRefs;
+    std::vector<float> costs;      // Per record
+
+    static constexpr int flagCount = 16;
+    PluginBitset flagColumns[flagCount];
+    Columns formatColumns;
+    Columns vendorColumns;
+    Columns categoryColumns;
+    Columns featureColumns;
+};
+
+} // namespace futureboard
@@ -0,0 +1,433 @@
+#include "PluginDatabase.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <unordered_map>
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+namespace futureboard {
+
+namespace {
+
+class StringTableBuilder {
+public:
+    StringTableBuilder() { data.push_back('\0'); }
+
+    uint32_t add(const std::string& value) {
+        if (value.empty()) return 0;
+
+        auto it = offsets.find(value);
+        if (it != offsets.end()) return it->second;
+
+        auto offset = static_cast<uint32_t>(data.size());
+        data.insert(data.end(), value.begin(), value.end());
+        data.push_back('\0');
+        offsets.emplace(value, offset);
+        return offset;
+    }
+
+    std::string_view get(uint32_t offset) const { return std::string_view(data.data() + offset); }
+
+    std::vector<char> data;
+
+private:
+    std::unordered_map<std::string, uint32_t> offsets;
+};
+
+template <typename T>
+void appendRaw(std::vector<uint8_t>& out, const T* values, size_t count) {
+    auto bytes = reinterpret_cast<const uint8_t*>(values);
+    out.insert(out.end(), bytes, bytes + sizeof(T) * count);
+}
+
+void alignTo(std::vector<uint8_t>& out, size_t alignment) {
+    while (out.size() % alignment != 0) out.push_back(0);
+}
+
+} // namespace
+
+float plugindb::estimateCostUs(const CostHint* hints, uint32_t count, double sampleRate, uint32_t blockSize) {
+    if (count == 0 || blockSize == 0 || sampleRate <= 0.0) return -1.0f;
+
+    // Block size matters far more than sample rate: most plugins cost about
+    // the same per sample at any rate, but per-block overhead dominates
+    // small blocks
+    const CostHint* best = nullptr;
+    double bestDistance = 0.0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (hints[i].blockSize == 0 || hints[i].sampleRate == 0) continue;
+        double distance = 4.0 * std::fabs(std::log2(double(blockSize) / hints[i].blockSize)) +
+                          std::fabs(std::log2(sampleRate / hints[i].sampleRate));
+        if (!best || distance < bestDistance) {
+            best = &hints[i];
+            bestDistance = distance;
+        }
+    }
+    if (!best) return -1.0f;
+    return best->medianUs * static_cast<float>(blockSize) / static_cast<float>(best->blockSize);
+}
+
+bool PluginDatabaseWriter::write(const std::string& filePath, const std::vector<PluginDatabaseEntry>& entries) {
+    StringTableBuilder strings;
+    std::vector<plugindb::Record> records;
+    std::vector<uint32_t> listRefs;
+    std::vector<plugindb::CostHint> costHints;
+    records.reserve(entries.size());
+
+    for (const auto& entry : entries) {
+        plugindb::Record record{};
+        record.name = strings.add(entry.name);
+        record.version = strings.add(entry.version);
+        record.path = strings.add(entry.path);
+        record.vendor = strings.add(entry.vendor);
+        record.uniqueId = strings.add(entry.uniqueId);
+        record.clapId = strings.add(entry.clapId);
+        record.error = strings.add(entry.error);
+
+        record.categoriesBegin = static_cast<uint32_t>(listRefs.size());
+        record.categoriesCount = static_cast<uint32_t>(entry.categories.size());
+        for (const auto& category : entry.categories) listRefs.push_back(strings.add(category));
+
+        record.featuresBegin = static_cast<uint32_t>(listRefs.size());
+        record.featuresCount = static_cast<uint32_t>(entry.features.size());
+        for (const auto& feature : entry.features) listRefs.push_back(strings.add(feature));
+
+        record.costHintsBegin = static_cast<uint32_t>(costHints.size());
+        record.costHintsCount = static_cast<uint32_t>(entry.costHints.size());
+        costHints.insert(costHints.end(), entry.costHints.begin(), entry.costHints.end());
+
+        record.format = entry.format;
+        record.arch = entry.arch;
+        record.flags = entry.flags;
+        record.numInputChannels = entry.numInputChannels;
+        record.numOutputChannels = entry.numOutputChannels;
+        record.fileSize = entry.fileSize;
+        record.modifiedTime = entry.modifiedTime;
+        record.contentHash = entry.contentHash;
+        records.push_back(record);
+    }
+
+    auto name = [&](uint32_t i) { return strings.get(records[i].name); };
+
+    std::vector<uint32_t> byUniqueId(records.size());
+    std::iota(byUniqueId.begin(), byUniqueId.end(), 0u);
+    std::vector<uint32_t> byVendor = byUniqueId;
+    std::vector<uint32_t> byFormat = byUniqueId;
+
+    std::stable_sort(byUniqueId.begin(), byUniqueId.end(), [&](uint32_t a, uint32_t b) {
+        return strings.get(records[a].uniqueId) < strings.get(records[b].uniqueId);
+    });
+    std::stable_sort(byVendor.begin(), byVendor.end(), [&](uint32_t a, uint32_t b) {
+        auto va = strings.get(records[a].vendor), vb = strings.get(records[b].vendor);
+        return va != vb ? va < vb : name(a) < name(b);
+    });
+    std::stable_sort(byFormat.begin(), byFormat.end(), [&](uint32_t a, uint32_t b) {
+        if (records[a].format != records[b].format) return records[a].format < records[b].format;
+        return name(a) < name(b);
+    });
+
+    std::vector<std::pair<uint32_t, uint32_t>> categoryEntries;
+    for (uint32_t i = 0; i < records.size(); i++) {
+        for (uint32_t c = 0; c < records[i].categoriesCount; c++) {
+            categoryEntries.emplace_back(listRefs[records[i].categoriesBegin + c], i);
+        }
+    }
+    std::stable_sort(categoryEntries.begin(), categoryEntries.end(), [&](const auto& a, const auto& b) {
+        auto ca = strings.get(a.first), cb = strings.get(b.first);
+        return ca != cb ? ca < cb : name(a.second) < name(b.second);
+    });
+
+    std::vector<uint32_t> categoryKeys, categoryRecords;
+    categoryKeys.reserve(categoryEntries.size());
+    categoryRecords.reserve(categoryEntries.size());
+    for (const auto& [key, record] : categoryEntries) {
+        categoryKeys.push_back(key);
+        categoryRecords.push_back(record);
+    }
+
+    plugindb::Header header{};
+    std::memcpy(header.magic, plugindb::magic, sizeof(header.magic));
+    header.version = plugindb::formatVersion;
+    header.recordCount = static_cast<uint32_t>(records.size());
+    header.recordSize = sizeof(plugindb::Record);
+    header.listRefCount = static_cast<uint32_t>(listRefs.size());
+    header.categoryEntryCount = static_cast<uint32_t>(categoryEntries.size());
+    header.costHintCount = static_cast<uint32_t>(costHints.size());
+    header.stringsSize = static_cast<uint32_t>(strings.data.size());
+
+    std::vector<uint8_t> out;
+    out.resize(sizeof(header));
+
+    header.recordsOffset = static_cast<uint32_t>(out.size());
+    appendRaw(out, records.data(), records.size());
+    header.listRefsOffset = static_cast<uint32_t>(out.size());
+    appendRaw(out, listRefs.data(), listRefs.size());
+    header.byUniqueIdOffset = static_cast<uint32_t>(out.size());
+    appendRaw(out, byUniqueId.data(), byUniqueId.size());
+    header.byVendorOffset = static_cast<uint32_t>(out.size());
+    appendRaw(out, byVendor.data(), byVendor.size());
+    header.byFormatOffset = static_cast<uint32_t>(out.size());
+    appendRaw(out, byFormat.data(), byFormat.size());
+    header.categoryKeysOffset = static_cast<uint32_t>(out.size());
+    appendRaw(out, categoryKeys.data(), categoryKeys.size());
+    header.categoryRecordsOffset = static_cast<uint32_t>(out.size());
+    appendRaw(out, categoryRecords.data(), categoryRecords.size());
+    alignTo(out, alignof(plugindb::CostHint));
+    header.costHintsOffset = static_cast<uint32_t>(out.size());
+    appendRaw(out, costHints.data(), costHints.size());
+    header.stringsOffset = static_cast<uint32_t>(out.size());
+    appendRaw(out, strings.data.data(), strings.data.size());
+    alignTo(out, 8);
+
+    std::memcpy(out.data(), &header, sizeof(header));
+
+    // Readers may have the old file mapped, so never truncate it in place
+    std::string tempPath = filePath + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file) return false;
+        file.write(reinterpret_cast<const char*>(out.data()), static_cast<std::streamsize>(out.size()));
+        if (!file) return false;
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tempPath, filePath, ec);
+    if (ec) {
+        std::filesystem::remove(tempPath, ec);
+        return false;
+    }
+    return true;
+}
+
+PluginDatabase::~PluginDatabase() {
+    close();
+}
+
+bool PluginDatabase::open(const std::string& filePath) {
+    close();
+
+#ifdef _WIN32
+    std::wstring widePath = std::filesystem::u8path(filePath).wstring();
+    HANDLE file = CreateFileW(widePath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+                              nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart < static_cast<LONGLONG>(sizeof(plugindb::Header))) {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        CloseHandle(file);
+        return false;
+    }
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    fileHandle = file;
+    mappingHandle = mapping;
+    data = static_cast<const uint8_t*>(view);
+    dataSize = static_cast<size_t>(size.QuadPart);
+#else
+    int fd = ::open(filePath.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(plugindb::Header))) {
+        ::close(fd);
+        return false;
+    }
+
+    void* view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (view == MAP_FAILED) return false;
+
+    data = static_cast<const uint8_t*>(view);
+    dataSize = static_cast<size_t>(st.st_size);
+#endif
+
+    header = reinterpret_cast<const plugindb::Header*>(data);
+    if (!validate()) {
+        close();
+        return false;
+    }
+
+    records = reinterpret_cast<const plugindb::Record*>(data + header->recordsOffset);
+    return true;
+}
+
+void PluginDatabase::close() {
+    if (data) {
+#ifdef _WIN32
+        UnmapViewOfFile(data);
+        CloseHandle(static_cast<HANDLE>(mappingHandle));
+        CloseHandle(static_cast<HANDLE>(fileHandle));
+        mappingHandle = nullptr;
+        fileHandle = nullptr;
+#else
+        munmap(const_cast<uint8_t*>(data), dataSize);
+#endif
+    }
+
+    data = nullptr;
+    dataSize = 0;
+    header = nullptr;
+    records = nullptr;
+}
+
+bool PluginDatabase::validate() const {
+    if (std::memcmp(header->magic, plugindb::magic, sizeof(header->magic)) != 0) return false;
+    if (header->version != plugindb::formatVersion) return false;
+    if (header->recordSize != sizeof(plugindb::Record)) return false;
+
+    auto fits = [this](uint64_t offset, uint64_t bytes) { return offset + bytes <= dataSize; };
+    uint64_t count = header->recordCount;
+
+    bool tablesFit = fits(header->recordsOffset, count * sizeof(plugindb::Record)) &&
+                     header->recordsOffset % alignof(plugindb::Record) == 0 &&
+                     fits(header->listRefsOffset, uint64_t(header->listRefCount) * 4) &&
+                     fits(header->byUniqueIdOffset, count * 4) &&
+                     fits(header->byVendorOffset, count * 4) &&
+                     fits(header->byFormatOffset, count * 4) &&
+                     fits(header->categoryKeysOffset, uint64_t(header->categoryEntryCount) * 4) &&
+                     fits(header->categoryRecordsOffset, uint64_t(header->categoryEntryCount) * 4) &&
+                     fits(header->costHintsOffset, uint64_t(header->costHintCount) * sizeof(plugindb::CostHint)) &&
+                     header->costHintsOffset % alignof(plugindb::CostHint) == 0 &&
+                     fits(header->stringsOffset, header->stringsSize) &&
+                     header->stringsSize > 0 &&
+                     data[header->stringsOffset + header->stringsSize - 1] == '\0';
+    if (!tablesFit) return false;
+
+    // The accessors index with what the file says, so every index entry and
+    // list range has to stay within its table. Strings needn't be checked,
+    // string() returns "" for offsets past the end.
+    const uint32_t* byUniqueId = table(header->byUniqueIdOffset);
+    const uint32_t* byVendor = table(header->byVendorOffset);
+    const uint32_t* byFormat = table(header->byFormatOffset);
+    const auto* recordTable = reinterpret_cast<const plugindb::Record*>(data + header->recordsOffset);
+    for (uint32_t i = 0; i < header->recordCount; i++) {
+        if (byUniqueId[i] >= count || byVendor[i] >= count || byFormat[i] >= count) return false;
+
+        const plugindb::Record& record = recordTable[i];
+        if (uint64_t(record.categoriesBegin) + record.categoriesCount > header->listRefCount ||
+            uint64_t(record.featuresBegin) + record.featuresCount > header->listRefCount ||
+            uint64_t(record.costHintsBegin) + record.costHintsCount > header->costHintCount) {
+            return false;
+        }
+    }
+
+    const uint32_t* categoryRecords = table(header->categoryRecordsOffset);
+    for (uint32_t i = 0; i < header->categoryEntryCount; i++) {
+        if (categoryRecords[i] >= count) return false;
+    }
+    return true;
+}
+
+const uint32_t* PluginDatabase::table(uint32_t offset) const {
+    return reinterpret_cast<const uint32_t*>(data + offset);
+}
+
+std::string_view PluginDatabase::string(uint32_t offset) const {
+    if (!header || offset >= header->stringsSize) return {};
+    return std::string_view(reinterpret_cast<const char*>(data + header->stringsOffset + offset));
+}
+
+std::string_view PluginDatabase::category(const plugindb::Record& record, uint32_t i) const {
+    return string(table(header->listRefsOffset)[record.categoriesBegin + i]);
+}
+
+std::string_view PluginDatabase::feature(const plugindb::Record& record, uint32_t i) const {
+    return string(table(header->listRefsOffset)[record.featuresBegin + i]);
+}
+
+const plugindb::CostHint& PluginDatabase::costHint(const plugindb::Record& record, uint32_t i) const {
+    return reinterpret_cast<const plugindb::CostHint*>(data + header->costHintsOffset)[record.costHintsBegin + i];
+}
+
+float PluginDatabase::estimateCostUs(const plugindb::Record& record, double sampleRate, uint32_t blockSize) const {
+    if (!header || record.costHintsCount == 0 ||
+        uint64_t(record.costHintsBegin) + record.costHintsCount > header->costHintCount) {
+        return -1.0f;
+    }
+    const auto* hints = reinterpret_cast<const plugindb::CostHint*>(data + header->costHintsOffset);
+    return plugindb::estimateCostUs(hints + record.costHintsBegin, record.costHintsCount, sampleRate, blockSize);
+}
+
+uint32_t PluginDatabase::findByUniqueId(std::string_view uniqueId) const {
+    if (!header) return 0;
+
+    const uint32_t* first = table(header->byUniqueIdOffset);
+    const uint32_t* last = first + header->recordCount;
+    auto it = std::lower_bound(first, last, uniqueId, [this](uint32_t index, std::string_view id) {
+        return string(records[index].uniqueId) < id;
+    });
+
+    if (it != last && string(records[*it].uniqueId) == uniqueId) return *it;
+    return header->recordCount;
+}
+
+PluginIndexRange PluginDatabase::findByVendor(std::string_view vendor) const {
+    auto all = allByVendor();
+    auto vendorOf = [this](uint32_t index) { return string(records[index].vendor); };
+    auto first = std::lower_bound(all.first, all.last, vendor,
+        [&](uint32_t index, std::string_view v) { return vendorOf(index) < v; });
+    auto last = std::upper_bound(first, all.last, vendor,
+        [&](std::string_view v, uint32_t index) { return v < vendorOf(index); });
+    return { first, last };
+}
+
+PluginIndexRange PluginDatabase::findByFormat(uint8_t format) const {
+    auto all = allByFormat();
+    auto first = std::lower_bound(all.first, all.last, format,
+        [this](uint32_t index, uint8_t f) { return records[index].format < f; });
+    auto last = std::upper_bound(first, all.last, format,
+        [this](uint8_t f, uint32_t index) { return f < records[index].format; });
+    return { first, last };
+}
+
+PluginIndexRange PluginDatabase::findByCategory(std::string_view category) const {
+    if (!header) return {};
+
+    const uint32_t* keys = table(header->categoryKeysOffset);
+    const uint32_t* keysEnd = keys + header->categoryEntryCount;
+    auto first = std::lower_bound(keys, keysEnd, category,
+        [this](uint32_t key, std::string_view c) { return string(key) < c; });
+    auto last = std::upper_bound(first, keysEnd, category,
+        [this](std::string_view c, uint32_t key) { return c < string(key); });
+
+    // categoryRecords runs parallel to categoryKeys
+    const uint32_t* recordsTable = table(header->categoryRecordsOffset);
+    return { recordsTable + (first - keys), recordsTable + (last - keys) };
+}
+
+PluginIndexRange PluginDatabase::allByVendor() const {
+    if (!header) return {};
+    const uint32_t* first = table(header->byVendorOffset);
+    return { first, first + header->recordCount };
+}
+
+PluginIndexRange PluginDatabase::allByFormat() const {
+    if (!header) return {};
+    const uint32_t* first = table(header->byFormatOffset);
+    return { first, first + header->recordCount };
+}
+
+} // namespace futureboard
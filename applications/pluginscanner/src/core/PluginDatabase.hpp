@@ -0,0 +1,193 @@
+#pragma once
+
+// Binary plugin database (.ftbdb) written by vstscanner and memory-mapped
+// by the DAW. This header only depends on the standard library so it can be
+// shared with the main application.
+//
+// Layout (little-endian, offsets are from the start of the file):
+//   Header
+//   Record[recordCount]            fixed-size, strings are string table offsets
+//   uint32 listRefs[]              category / feature lists referenced by records
+//   uint32 byUniqueId[recordCount] record indices sorted by uniqueId
+//   uint32 byVendor[recordCount]   sorted by vendor, then name
+//   uint32 byFormat[recordCount]   sorted by format, then name
+//   uint32 categoryKeys[n]         category string offsets, sorted by category
+//   uint32 categoryRecords[n]      record index for each categoryKeys entry
+//   CostHint costHints[]           processing cost measured by vstscanner --bench
+//   char   strings[]               deduplicated NUL-terminated strings, offset 0 is ""
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace futureboard {
+
+namespace plugindb {
+
+constexpr char magic[8] = { 'F', 'B', 'P', 'L', 'U', 'G', 'D', 'B' };
+constexpr uint32_t formatVersion = 2;
+
+enum RecordFlags : uint16_t {
+    IsValid      = 1 << 0,
+    IsSynth      = 1 << 1,
+    IsEffect     = 1 << 2,
+    AcceptsMidi  = 1 << 3,
+    ProducesMidi = 1 << 4
+};
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordCount;
+    uint32_t recordSize;
+    uint32_t recordsOffset;
+    uint32_t listRefsOffset;
+    uint32_t listRefCount;
+    uint32_t byUniqueIdOffset;
+    uint32_t byVendorOffset;
+    uint32_t byFormatOffset;
+    uint32_t categoryKeysOffset;
+    uint32_t categoryRecordsOffset;
+    uint32_t categoryEntryCount;
+    uint32_t stringsOffset;
+    uint32_t stringsSize;
+    uint32_t costHintsOffset;
+    uint32_t costHintCount;
+};
+
+struct Record {
+    uint32_t name;
+    uint32_t version;
+    uint32_t path;
+    uint32_t vendor;
+    uint32_t uniqueId;
+    uint32_t clapId;
+    uint32_t error;
+    uint32_t categoriesBegin;
+    uint32_t categoriesCount;
+    uint32_t featuresBegin;
+    uint32_t featuresCount;
+    uint8_t format;         // PluginFormat
+    uint8_t arch;           // ProcessorArchitecture
+    uint16_t flags;         // RecordFlags
+    int32_t numInputChannels;
+    int32_t numOutputChannels;
+    uint32_t costHintsBegin;
+    uint32_t costHintsCount;
+    uint64_t fileSize;
+    int64_t modifiedTime;
+    uint64_t contentHash;
+};
+
+// Time the plugin took per block at one sample rate and block size, while
+// processing noise and, if it takes MIDI, a stream of notes
+struct CostHint {
+    uint32_t sampleRate;
+    uint32_t blockSize;     // Frames
+    float medianUs;         // Microseconds per block
+    float p90Us;
+    float p99Us;
+    float maxUs;
+};
+
+static_assert(sizeof(Header) == 72, "plugin database header layout changed");
+static_assert(sizeof(Record) == 88, "plugin database record layout changed");
+static_assert(sizeof(CostHint) == 24, "plugin database cost hint layout changed");
+
+// Median microseconds per block at sampleRate and blockSize, from the hint
+// measured closest to them and scaled by block size; -1 without hints
+float estimateCostUs(const CostHint* hints, uint32_t count, double sampleRate, uint32_t blockSize);
+
+} // namespace plugindb
+
+// Input to PluginDatabaseWriter, one per plugin
+struct PluginDatabaseEntry {
+    std::string name;
+    std::string version;
+    std::string path;
+    std::string vendor;
+    std::string uniqueId;
+    std::string clapId;
+    std::string error;
+    std::vector<std::string> categories;
+    std::vector<std::string> features;
+    std::vector<plugindb::CostHint> costHints;
+    uint8_t format = 0;
+    uint8_t arch = 0;
+    uint16_t flags = 0;
+    int32_t numInputChannels = 0;
+    int32_t numOutputChannels = 0;
+    uint64_t fileSize = 0;
+    int64_t modifiedTime = 0;
+    uint64_t contentHash = 0;
+};
+
+class PluginDatabaseWriter {
+public:
+    // Writes to a temporary file and renames it over filePath
+    static bool write(const std::string& filePath, const std::vector<PluginDatabaseEntry>& entries);
+};
+
+// Range of record indices inside one of the database indexes
+struct PluginIndexRange {
+    const uint32_t* first = nullptr;
+    const uint32_t* last = nullptr;
+
+    const uint32_t* begin() const { return first; }
+    const uint32_t* end() const { return last; }
+    size_t size() const { return static_cast<size_t>(last - first); }
+    bool empty() const { return first == last; }
+};
+
+// Read-only, memory-mapped view of a .ftbdb file. Nothing is deserialized up
+// front; records and strings are read straight from the mapping.
+class PluginDatabase {
+public:
+    PluginDatabase() = default;
+    ~PluginDatabase();
+
+    PluginDatabase(const PluginDatabase&) = delete;
+    PluginDatabase& operator=(const PluginDatabase&) = delete;
+
+    bool open(const std::string& filePath);
+    void close();
+    bool isOpen() const { return header != nullptr; }
+
+    uint32_t size() const { return header ? header->recordCount : 0; }
+    const plugindb::Record& record(uint32_t index) const { return records[index]; }
+
+    std::string_view string(uint32_t offset) const;
+    std::string_view category(const plugindb::Record& record, uint32_t i) const;
+    std::string_view feature(const plugindb::Record& record, uint32_t i) const;
+    const plugindb::CostHint& costHint(const plugindb::Record& record, uint32_t i) const;
+    // See plugindb::estimateCostUs
+    float estimateCostUs(const plugindb::Record& record, double sampleRate, uint32_t blockSize) const;
+
+    // Returns size() when no record has that id
+    uint32_t findByUniqueId(std::string_view uniqueId) const;
+    PluginIndexRange findByVendor(std::string_view vendor) const;
+    PluginIndexRange findByFormat(uint8_t format) const;
+    PluginIndexRange findByCategory(std::string_view category) const;
+
+    // Whole indexes, for ordered browsing
+    PluginIndexRange allByVendor() const;
+    PluginIndexRange allByFormat() const;
+
+private:
+    bool validate() const;
+    const uint32_t* table(uint32_t offset) const;
+
+    const uint8_t* data = nullptr;
+    size_t dataSize = 0;
+    const plugindb::Header* header = nullptr;
+    const plugindb::Record* records = nullptr;
+
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#endif
+};
+
+} // namespace futureboard
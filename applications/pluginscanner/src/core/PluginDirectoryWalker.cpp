@@ -0,0 +1,125 @@
+#include "PluginDirectoryWalker.hpp"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+
+namespace futureboard {
+
+PluginDirectoryWalker::PluginDirectoryWalker(int numThreads, size_t maxQueuedDirectories)
+    : numThreads(std::max(1, numThreads))
+    , maxQueuedDirectories(std::max<size_t>(1, maxQueuedDirectories))
+{
+}
+
+std::vector<std::filesystem::path> PluginDirectoryWalker::walk(const std::vector<std::filesystem::path>& roots,
+                                                               const Classifier& classify,
+                                                               const std::atomic<bool>& stopRequested) {
+    std::mutex queueMutex;
+    std::condition_variable queueChanged;
+    std::deque<std::filesystem::path> queue;
+    size_t busyThreads = 0;
+
+    std::mutex resultsMutex;
+    std::unordered_set<std::string> visited;
+    std::vector<std::filesystem::path> accepted;
+    errors.clear();
+
+    for (const auto& root : roots) {
+        std::error_code ec;
+        if (std::filesystem::is_directory(root, ec)) queue.push_back(root);
+    }
+
+    // Identifies a directory by its resolved path so that symlinks to it,
+    // loops included, aren't listed a second time
+    auto markVisited = [&](const std::filesystem::path& dir) {
+        std::error_code ec;
+        auto canonical = std::filesystem::canonical(dir, ec);
+        std::string key = ec ? dir.lexically_normal().string() : canonical.string();
+
+        std::lock_guard<std::mutex> lock(resultsMutex);
+        return visited.insert(std::move(key)).second;
+    };
+
+    auto listDirectories = [&](std::filesystem::path start) {
+        std::vector<std::filesystem::path> stack{ std::move(start) };
+        std::vector<std::filesystem::path> found;
+        std::vector<std::string> failed;
+
+        while (!stack.empty() && !stopRequested) {
+            auto dir = std::move(stack.back());
+            stack.pop_back();
+            if (!markVisited(dir)) continue;
+
+            std::error_code ec;
+            std::filesystem::directory_iterator it(dir, std::filesystem::directory_options::skip_permission_denied, ec);
+            for (; !ec && it != std::filesystem::directory_iterator(); it.increment(ec)) {
+                if (stopRequested) break;
+
+                const auto& entry = *it;
+                Action action = classify(entry);
+                if (action == Action::Accept) {
+                    found.push_back(entry.path());
+                } else if (action == Action::Descend) {
+                    std::error_code dirError;
+                    if (!entry.is_directory(dirError)) continue;
+
+                    std::unique_lock<std::mutex> lock(queueMutex);
+                    if (queue.size() < maxQueuedDirectories) {
+                        queue.push_back(entry.path());
+                        lock.unlock();
+                        queueChanged.notify_one();
+                    } else {
+                        lock.unlock();
+                        stack.push_back(entry.path());
+                    }
+                }
+            }
+
+            if (ec) failed.push_back(dir.string() + ": " + ec.message());
+        }
+
+        std::lock_guard<std::mutex> lock(resultsMutex);
+        accepted.insert(accepted.end(), std::make_move_iterator(found.begin()), std::make_move_iterator(found.end()));
+        errors.insert(errors.end(), std::make_move_iterator(failed.begin()), std::make_move_iterator(failed.end()));
+    };
+
+    auto workerLoop = [&]() {
+        std::unique_lock<std::mutex> lock(queueMutex);
+        while (true) {
+            // Done once nothing is queued and nobody can queue more
+            while (queue.empty() && busyThreads > 0 && !stopRequested) {
+                queueChanged.wait_for(lock, std::chrono::milliseconds(50));
+            }
+            if (queue.empty() || stopRequested) break;
+
+            auto dir = std::move(queue.front());
+            queue.pop_front();
+            busyThreads++;
+            lock.unlock();
+
+            listDirectories(std::move(dir));
+
+            lock.lock();
+            busyThreads--;
+            if (busyThreads == 0 && queue.empty()) queueChanged.notify_all();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(numThreads);
+    for (int i = 0; i < numThreads; i++) {
+        threads.emplace_back(workerLoop);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    std::sort(accepted.begin(), accepted.end());
+    return accepted;
+}
+
+} // namespace futureboard
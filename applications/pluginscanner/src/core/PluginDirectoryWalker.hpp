@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace futureboard {
+
+// Walks plugin search paths with several threads. Directories waiting to be
+// listed go through a bounded queue shared by the threads; when it is full a
+// thread keeps the subdirectory on its own stack instead of blocking.
+// Symlinked directories are followed, but each real directory is only
+// listed once, so symlink loops and duplicate search paths are harmless.
+class PluginDirectoryWalker {
+public:
+    enum class Action {
+        Skip,
+        Descend,  // Only meaningful for directories
+        Accept
+    };
+
+    // Called concurrently from the walker threads for every directory entry
+    using Classifier = std::function<Action(const std::filesystem::directory_entry&)>;
+
+    explicit PluginDirectoryWalker(int numThreads, size_t maxQueuedDirectories = 256);
+
+    // Returns the accepted entries sorted by path
+    std::vector<std::filesystem::path> walk(const std::vector<std::filesystem::path>& roots,
+                                            const Classifier& classify,
+                                            const std::atomic<bool>& stopRequested);
+
+    // Directories that couldn't be listed during the last walk()
+    const std::vector<std::string>& getErrors() const { return errors; }
+
+private:
+    int numThreads;
+    size_t maxQueuedDirectories;
+    std::vector<std::string> errors;
+};
+
+} // namespace futureboard
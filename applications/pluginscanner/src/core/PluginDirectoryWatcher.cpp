@@ -0,0 +1,358 @@
+#include "PluginDirectoryWatcher.hpp"
+#include <algorithm>
+#include <thread>
+
+#ifdef _WIN32
+    #include <windows.h>
+#elif defined(__linux__)
+    #include <poll.h>
+    #include <sys/inotify.h>
+    #include <unistd.h>
+    #include <cstring>
+    #include <unordered_map>
+#else
+    #include <map>
+#endif
+
+namespace futureboard {
+
+#ifdef _WIN32
+
+struct PluginDirectoryWatcher::Platform {
+    struct Root {
+        std::filesystem::path path;
+        HANDLE directory = INVALID_HANDLE_VALUE;
+        OVERLAPPED overlapped{};
+        std::vector<DWORD> buffer = std::vector<DWORD>(16384);  // DWORD aligned, 64 KB
+    };
+
+    std::vector<std::unique_ptr<Root>> roots;
+
+    static constexpr DWORD filter = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME |
+                                    FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE;
+
+    static bool issue(Root& root) {
+        ResetEvent(root.overlapped.hEvent);
+        return ReadDirectoryChangesW(root.directory, root.buffer.data(),
+                                     static_cast<DWORD>(root.buffer.size() * sizeof(DWORD)),
+                                     TRUE, filter, nullptr, &root.overlapped, nullptr) != 0;
+    }
+
+    static void close(Root& root) {
+        CancelIoEx(root.directory, &root.overlapped);
+        DWORD bytes = 0;
+        GetOverlappedResult(root.directory, &root.overlapped, &bytes, TRUE);
+        CloseHandle(root.overlapped.hEvent);
+        CloseHandle(root.directory);
+    }
+};
+
+bool PluginDirectoryWatcher::start() {
+    errors.clear();
+    platform = std::make_unique<Platform>();
+
+    for (const auto& path : roots) {
+        // WaitForMultipleObjects takes at most 64 handles
+        if (platform->roots.size() == MAXIMUM_WAIT_OBJECTS) {
+            errors.push_back(path.string() + ": too many watched folders");
+            continue;
+        }
+
+        auto root = std::make_unique<Platform::Root>();
+        root->path = path;
+        root->directory = CreateFileW(path.wstring().c_str(), FILE_LIST_DIRECTORY,
+                                      FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+                                      OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+        if (root->directory == INVALID_HANDLE_VALUE) {
+            errors.push_back(path.string() + ": " + std::to_string(GetLastError()));
+            continue;
+        }
+
+        root->overlapped.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        if (!Platform::issue(*root)) {
+            errors.push_back(path.string() + ": " + std::to_string(GetLastError()));
+            CloseHandle(root->overlapped.hEvent);
+            CloseHandle(root->directory);
+            continue;
+        }
+        platform->roots.push_back(std::move(root));
+    }
+
+    return !platform->roots.empty();
+}
+
+void PluginDirectoryWatcher::stop() {
+    if (!platform) return;
+
+    for (auto& root : platform->roots) Platform::close(*root);
+    platform.reset();
+}
+
+void PluginDirectoryWatcher::poll(int timeoutMs) {
+    if (platform->roots.empty()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+        return;
+    }
+
+    std::vector<HANDLE> events;
+    for (const auto& root : platform->roots) events.push_back(root->overlapped.hEvent);
+
+    DWORD waited = WaitForMultipleObjects(static_cast<DWORD>(events.size()), events.data(), FALSE,
+                                          static_cast<DWORD>(timeoutMs));
+    if (waited == WAIT_TIMEOUT || waited == WAIT_FAILED) return;
+
+    for (auto it = platform->roots.begin(); it != platform->roots.end();) {
+        auto& root = *it;
+        DWORD bytes = 0;
+        if (!GetOverlappedResult(root->directory, &root->overlapped, &bytes, FALSE)) {
+            if (GetLastError() == ERROR_IO_INCOMPLETE) {
+                ++it;
+                continue;
+            }
+            // The read failed, as for an overflow reported as
+            // ERROR_NOTIFY_ENUM_DIR. Its event stays set until issue()
+            // resets it, so the root is rescanned and read again like one
+            // that overflowed.
+            bytes = 0;
+        }
+
+        if (bytes == 0) {
+            // The buffer overflowed; anything under the root may have changed
+            addChange(root->path);
+        } else {
+            auto data = reinterpret_cast<const BYTE*>(root->buffer.data());
+            for (;;) {
+                auto info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(data);
+                std::wstring name(info->FileName, info->FileNameLength / sizeof(WCHAR));
+                addChange(root->path / name);
+                if (info->NextEntryOffset == 0) break;
+                data += info->NextEntryOffset;
+            }
+        }
+
+        // A root that can't be read again, such as one that was deleted,
+        // would keep its event set and the wait returning at once
+        if (!Platform::issue(*root)) {
+            errors.push_back(root->path.string() + ": " + std::to_string(GetLastError()));
+            Platform::close(*root);
+            it = platform->roots.erase(it);
+            continue;
+        }
+        ++it;
+    }
+}
+
+#elif defined(__linux__)
+
+struct PluginDirectoryWatcher::Platform {
+    int fd = -1;
+    std::unordered_map<int, std::filesystem::path> directories;
+    // Roots that don't exist (yet), looked for again on every poll
+    std::vector<std::filesystem::path> missing;
+
+    static constexpr uint32_t mask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                                     IN_CLOSE_WRITE | IN_ATTRIB | IN_DELETE_SELF | IN_ONLYDIR;
+
+    void watchTree(const std::filesystem::path& directory, std::vector<std::string>& errors) {
+        watch(directory, errors);
+
+        // Symlinked directories aren't followed, which also keeps loops out
+        std::error_code ec;
+        auto options = std::filesystem::directory_options::skip_permission_denied;
+        for (std::filesystem::recursive_directory_iterator it(directory, options, ec), end;
+             !ec && it != end; it.increment(ec)) {
+            if (it->is_directory(ec) && !it->is_symlink(ec)) watch(it->path(), errors);
+        }
+    }
+
+    void watch(const std::filesystem::path& directory, std::vector<std::string>& errors) {
+        int wd = inotify_add_watch(fd, directory.c_str(), mask);
+        if (wd < 0) {
+            // ENOSPC means fs.inotify.max_user_watches is exhausted
+            errors.push_back(directory.string() + ": " + std::strerror(errno));
+            return;
+        }
+        directories[wd] = directory;
+    }
+};
+
+bool PluginDirectoryWatcher::start() {
+    errors.clear();
+    platform = std::make_unique<Platform>();
+    platform->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (platform->fd < 0) {
+        errors.push_back(std::string("inotify: ") + std::strerror(errno));
+        return false;
+    }
+
+    for (const auto& root : roots) {
+        std::error_code ec;
+        if (std::filesystem::is_directory(root, ec)) {
+            platform->watchTree(root, errors);
+        } else {
+            platform->missing.push_back(root);
+        }
+    }
+    return !platform->directories.empty();
+}
+
+void PluginDirectoryWatcher::stop() {
+    if (!platform) return;
+    if (platform->fd >= 0) close(platform->fd);
+    platform.reset();
+}
+
+void PluginDirectoryWatcher::poll(int timeoutMs) {
+    if (platform->fd < 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+        return;
+    }
+
+    // A plugin folder an installer creates later is watched from then on,
+    // and whatever it already holds counts as changed
+    for (auto it = platform->missing.begin(); it != platform->missing.end();) {
+        std::error_code ec;
+        if (!std::filesystem::is_directory(*it, ec)) {
+            ++it;
+            continue;
+        }
+        platform->watchTree(*it, errors);
+        addChange(*it);
+        it = platform->missing.erase(it);
+    }
+
+    pollfd pfd{ platform->fd, POLLIN, 0 };
+    if (::poll(&pfd, 1, timeoutMs) <= 0) return;
+
+    alignas(inotify_event) char buffer[65536];
+    for (;;) {
+        ssize_t length = read(platform->fd, buffer, sizeof(buffer));
+        if (length <= 0) return;
+
+        for (char* p = buffer; p < buffer + length;) {
+            auto event = reinterpret_cast<const inotify_event*>(p);
+            p += sizeof(inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                for (const auto& root : roots) addChange(root);
+                continue;
+            }
+
+            auto it = platform->directories.find(event->wd);
+            if (it == platform->directories.end()) continue;
+
+            if (event->mask & IN_IGNORED) {
+                // A deleted root is waited for like one that never existed
+                if (std::find(roots.begin(), roots.end(), it->second) != roots.end()) {
+                    platform->missing.push_back(it->second);
+                }
+                platform->directories.erase(it);
+                continue;
+            }
+
+            auto path = event->len > 0 ? it->second / event->name : it->second;
+            addChange(path);
+
+            // New folders (or bundles) need watches of their own
+            if ((event->mask & IN_ISDIR) && (event->mask & (IN_CREATE | IN_MOVED_TO))) {
+                platform->watchTree(path, errors);
+            }
+        }
+    }
+}
+
+#else
+
+// No native backend here yet: compare directory snapshots instead
+struct PluginDirectoryWatcher::Platform {
+    using Snapshot = std::map<std::filesystem::path, std::pair<std::filesystem::file_time_type, uintmax_t>>;
+
+    Snapshot snapshot;
+    std::chrono::steady_clock::time_point lastScan;
+
+    static constexpr std::chrono::seconds interval{2};
+
+    Snapshot take(const std::vector<std::filesystem::path>& roots) const {
+        Snapshot result;
+        auto options = std::filesystem::directory_options::skip_permission_denied;
+        for (const auto& root : roots) {
+            std::error_code ec;
+            for (std::filesystem::recursive_directory_iterator it(root, options, ec), end;
+                 !ec && it != end; it.increment(ec)) {
+                std::error_code entryError;
+                auto modified = it->last_write_time(entryError);
+                auto size = it->is_regular_file(entryError) ? it->file_size(entryError) : 0;
+                result[it->path()] = { modified, size };
+            }
+        }
+        return result;
+    }
+};
+
+bool PluginDirectoryWatcher::start() {
+    errors.clear();
+    platform = std::make_unique<Platform>();
+    platform->snapshot = platform->take(roots);
+    platform->lastScan = Clock::now();
+    return true;
+}
+
+void PluginDirectoryWatcher::stop() {
+    platform.reset();
+}
+
+void PluginDirectoryWatcher::poll(int timeoutMs) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+    if (Clock::now() - platform->lastScan < Platform::interval) return;
+
+    auto current = platform->take(roots);
+    for (const auto& [path, state] : current) {
+        auto it = platform->snapshot.find(path);
+        if (it == platform->snapshot.end() || it->second != state) addChange(path);
+    }
+    for (const auto& [path, state] : platform->snapshot) {
+        if (current.count(path) == 0) addChange(path);
+    }
+
+    platform->snapshot = std::move(current);
+    platform->lastScan = Clock::now();
+}
+
+#endif
+
+PluginDirectoryWatcher::PluginDirectoryWatcher(const std::vector<std::filesystem::path>& roots, int debounceMs)
+    : roots(roots)
+    , debounce(std::max(0, debounceMs))
+{
+}
+
+PluginDirectoryWatcher::~PluginDirectoryWatcher() {
+    stop();
+}
+
+void PluginDirectoryWatcher::run(const std::atomic<bool>& stopRequested, const ChangeCallback& onChanges) {
+    pending.clear();
+    if (!platform) start();
+
+    while (!stopRequested) {
+        poll(100);
+        flushIfQuiet(onChanges);
+    }
+
+    stop();
+}
+
+void PluginDirectoryWatcher::addChange(const std::filesystem::path& path) {
+    pending.insert(path);
+    lastChange = Clock::now();
+}
+
+void PluginDirectoryWatcher::flushIfQuiet(const ChangeCallback& onChanges) {
+    if (pending.empty() || Clock::now() - lastChange < debounce) return;
+
+    std::vector<std::filesystem::path> changes(pending.begin(), pending.end());
+    pending.clear();
+    if (onChanges) onChanges(changes);
+}
+
+} // namespace futureboard
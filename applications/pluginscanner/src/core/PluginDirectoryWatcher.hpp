@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace futureboard {
+
+// Watches plugin folders recursively and reports changed paths in batches.
+// Installers write a plugin in many small steps, so a batch is only handed
+// out once nothing has changed for the debounce interval.
+//
+// Linux uses inotify with one watch per directory, Windows uses
+// ReadDirectoryChangesW on each root. Elsewhere the folders are polled.
+class PluginDirectoryWatcher {
+public:
+    // Paths that were created, modified, renamed or deleted, sorted. A root
+    // is reported itself when the change queue overflowed.
+    using ChangeCallback = std::function<void(const std::vector<std::filesystem::path>&)>;
+
+    PluginDirectoryWatcher(const std::vector<std::filesystem::path>& roots, int debounceMs);
+    ~PluginDirectoryWatcher();
+
+    PluginDirectoryWatcher(const PluginDirectoryWatcher&) = delete;
+    PluginDirectoryWatcher& operator=(const PluginDirectoryWatcher&) = delete;
+
+    // Sets up the watches, errors are in getErrors(). run() calls it if needed.
+    bool start();
+    // Blocks until stopRequested is set. onChanges is called on this thread.
+    void run(const std::atomic<bool>& stopRequested, const ChangeCallback& onChanges);
+
+    // Roots or directories that couldn't be watched
+    const std::vector<std::string>& getErrors() const { return errors; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void stop();
+    // Waits up to timeoutMs for changes and adds them to pending
+    void poll(int timeoutMs);
+    void addChange(const std::filesystem::path& path);
+    void flushIfQuiet(const ChangeCallback& onChanges);
+
+    std::vector<std::filesystem::path> roots;
+    std::chrono::milliseconds debounce;
+    std::set<std::filesystem::path> pending;
+    Clock::time_point lastChange;
+    std::vector<std::string> errors;
+
+    struct Platform;
+    std::unique_ptr<Platform> platform;
+};
+
+} // namespace futureboard
@@ -0,0 +1,150 @@
+#include "PluginQuarantine.hpp"
+#include <pugixml.hpp>
+#include <chrono>
+#include <unordered_set>
+
+namespace futureboard {
+
+bool PluginQuarantine::load(const std::filesystem::path& filePath) {
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.clear();
+    modified = false;
+
+    std::error_code ec;
+    if (!std::filesystem::exists(filePath, ec)) return true;
+
+    pugi::xml_document doc;
+    if (!doc.load_file(filePath.string().c_str())) return false;
+
+    auto root = doc.child("FutureboardQuarantine");
+    for (auto entryNode : root.children("Plugin")) {
+        Entry entry;
+        entry.path = entryNode.attribute("path").as_string();
+        entry.failure = stringToFailure(entryNode.attribute("failure").as_string());
+        entry.error = entryNode.attribute("error").as_string();
+        entry.timestamp = entryNode.attribute("timestamp").as_llong();
+        entry.fingerprint.size = entryNode.attribute("size").as_ullong();
+        entry.fingerprint.modifiedTime = entryNode.attribute("modified").as_llong();
+        entry.fingerprint.contentHash = entryNode.attribute("hash").as_ullong();
+        if (entry.path.empty() || entry.failure == ScanFailure::None) continue;
+
+        entries[entry.path] = std::move(entry);
+    }
+    return true;
+}
+
+bool PluginQuarantine::save(const std::filesystem::path& filePath) const {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    pugi::xml_document doc;
+    auto declNode = doc.append_child(pugi::node_declaration);
+    declNode.append_attribute("version") = "1.0";
+    declNode.append_attribute("encoding") = "UTF-8";
+
+    auto root = doc.append_child("FutureboardQuarantine");
+    root.append_attribute("version") = "1.0";
+
+    for (const auto& [path, entry] : entries) {
+        auto entryNode = root.append_child("Plugin");
+        entryNode.append_attribute("path") = entry.path.c_str();
+        entryNode.append_attribute("failure") = failureToString(entry.failure).c_str();
+        entryNode.append_attribute("error") = entry.error.c_str();
+        entryNode.append_attribute("timestamp") = static_cast<long long>(entry.timestamp);
+        entryNode.append_attribute("size") = static_cast<unsigned long long>(entry.fingerprint.size);
+        entryNode.append_attribute("modified") = entry.fingerprint.modifiedTime;
+        entryNode.append_attribute("hash") = static_cast<unsigned long long>(entry.fingerprint.contentHash);
+    }
+
+    auto tempPath = filePath.string() + ".tmp";
+    if (!doc.save_file(tempPath.c_str())) return false;
+
+    std::error_code ec;
+    std::filesystem::rename(tempPath, filePath, ec);
+    if (ec) {
+        std::filesystem::remove(tempPath, ec);
+        return false;
+    }
+    return true;
+}
+
+bool PluginQuarantine::isModified() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return modified;
+}
+
+void PluginQuarantine::add(const std::string& path, ScanFailure failure, const std::string& error,
+                           const FileFingerprint& fingerprint) {
+    if (failure == ScanFailure::None) return;
+
+    Entry entry;
+    entry.path = path;
+    entry.failure = failure;
+    entry.error = error;
+    entry.timestamp = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    entry.fingerprint = fingerprint;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    entries[path] = std::move(entry);
+    modified = true;
+}
+
+void PluginQuarantine::remove(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (entries.erase(path) > 0) modified = true;
+}
+
+bool PluginQuarantine::find(const std::string& path, Entry& entry) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(path);
+    if (it == entries.end()) return false;
+    entry = it->second;
+    return true;
+}
+
+bool PluginQuarantine::contains(const std::string& path) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries.count(path) > 0;
+}
+
+void PluginQuarantine::retainOnly(const std::vector<std::filesystem::path>& paths) {
+    std::unordered_set<std::string> keep;
+    for (const auto& path : paths) keep.insert(path.string());
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto it = entries.begin(); it != entries.end();) {
+        if (keep.count(it->first) == 0) {
+            it = entries.erase(it);
+            modified = true;
+        } else {
+            ++it;
+        }
+    }
+}
+
+size_t PluginQuarantine::size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries.size();
+}
+
+std::filesystem::path PluginQuarantine::fileFor(const std::filesystem::path& databaseFile) {
+    auto file = databaseFile;
+    file.replace_extension(".quarantine.xml");
+    return file;
+}
+
+std::string PluginQuarantine::failureToString(ScanFailure failure) {
+    switch (failure) {
+        case ScanFailure::Crashed: return "Crashed";
+        case ScanFailure::TimedOut: return "TimedOut";
+        default: return "None";
+    }
+}
+
+ScanFailure PluginQuarantine::stringToFailure(const std::string& failureStr) {
+    if (failureStr == "Crashed") return ScanFailure::Crashed;
+    if (failureStr == "TimedOut") return ScanFailure::TimedOut;
+    return ScanFailure::None;
+}
+
+} // namespace futureboard
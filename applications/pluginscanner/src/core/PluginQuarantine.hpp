@@ -0,0 +1,54 @@
+#pragma once
+
+#include "PluginScanner.hpp"
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace futureboard {
+
+// Plugins whose scanner process crashed or timed out, kept as an XML file
+// next to the plugin database. An entry holds for as long as the binary's
+// fingerprint is unchanged, so a plugin that hangs the scanner costs one
+// timeout rather than one per scan.
+class PluginQuarantine {
+public:
+    struct Entry {
+        std::string path;
+        ScanFailure failure = ScanFailure::Crashed;
+        std::string error;
+        int64_t timestamp = 0;  // Seconds since the epoch
+        FileFingerprint fingerprint;
+    };
+
+    // A missing file is an empty quarantine
+    bool load(const std::filesystem::path& filePath);
+    // Writes to a temporary file and renames it over filePath
+    bool save(const std::filesystem::path& filePath) const;
+    bool isModified() const;
+
+    // Thread-safe
+    void add(const std::string& path, ScanFailure failure, const std::string& error,
+             const FileFingerprint& fingerprint);
+    void remove(const std::string& path);
+    bool find(const std::string& path, Entry& entry) const;
+    bool contains(const std::string& path) const;
+    // Drops entries for plugins that are no longer installed
+    void retainOnly(const std::vector<std::filesystem::path>& paths);
+    size_t size() const;
+
+    // plugins.ftbdb -> plugins.quarantine.xml
+    static std::filesystem::path fileFor(const std::filesystem::path& databaseFile);
+    static std::string failureToString(ScanFailure failure);
+    static ScanFailure stringToFailure(const std::string& failureStr);
+
+private:
+    std::unordered_map<std::string, Entry> entries;
+    bool modified = false;
+    mutable std::mutex mutex;
+};
+
+} // namespace futureboard
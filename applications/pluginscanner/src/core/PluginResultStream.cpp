@@ -0,0 +1,146 @@
+#include "PluginResultStream.hpp"
+#include "PluginQuarantine.hpp"
+#include <cstdio>
+
+namespace futureboard {
+
+namespace {
+
+void appendEscaped(std::string& out, const std::string& text) {
+    out += '"';
+    for (unsigned char c : text) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    char escaped[8];
+                    std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                    out += escaped;
+                } else {
+                    out += static_cast<char>(c);
+                }
+        }
+    }
+    out += '"';
+}
+
+void appendField(std::string& out, const char* key, const std::string& value) {
+    out += ",\"";
+    out += key;
+    out += "\":";
+    appendEscaped(out, value);
+}
+
+void appendField(std::string& out, const char* key, bool value) {
+    out += ",\"";
+    out += key;
+    out += value ? "\":true" : "\":false";
+}
+
+void appendField(std::string& out, const char* key, int value) {
+    out += ",\"";
+    out += key;
+    out += "\":";
+    out += std::to_string(value);
+}
+
+void appendField(std::string& out, const char* key, const std::vector<std::string>& values) {
+    out += ",\"";
+    out += key;
+    out += "\":[";
+    for (size_t i = 0; i < values.size(); i++) {
+        if (i > 0) out += ',';
+        appendEscaped(out, values[i]);
+    }
+    out += ']';
+}
+
+} // namespace
+
+std::string PluginResultStream::quote(const std::string& text) {
+    std::string out;
+    out.reserve(text.size() + 2);
+    appendEscaped(out, text);
+    return out;
+}
+
+bool PluginResultStream::open(const std::filesystem::path& filePath, bool append) {
+    std::lock_guard<std::mutex> lock(mutex);
+    file.close();
+    file.open(filePath, std::ios::out | std::ios::binary | (append ? std::ios::app : std::ios::trunc));
+    if (!file.is_open()) return false;
+
+    if (!append) file << "{\"event\":\"start\"}\n" << std::flush;
+    return true;
+}
+
+void PluginResultStream::close() {
+    std::lock_guard<std::mutex> lock(mutex);
+    file.close();
+}
+
+bool PluginResultStream::isOpen() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return file.is_open();
+}
+
+void PluginResultStream::writePlugin(const PluginInfo& plugin) {
+    writeLine(toJson(plugin));
+}
+
+void PluginResultStream::writeEnd(bool completed, size_t count) {
+    writeLine(std::string("{\"event\":\"") + (completed ? "complete" : "stopped") +
+              "\",\"count\":" + std::to_string(count) + "}");
+}
+
+void PluginResultStream::writeRemoved(const std::string& path) {
+    std::string line = "{\"event\":\"removed\"";
+    appendField(line, "path", path);
+    writeLine(line + "}");
+}
+
+void PluginResultStream::writeDelta(size_t added, size_t removed) {
+    writeLine("{\"event\":\"delta\",\"added\":" + std::to_string(added) +
+              ",\"removed\":" + std::to_string(removed) + "}");
+}
+
+void PluginResultStream::writeLine(const std::string& line) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!file.is_open()) return;
+
+    // A reader tailing the file only ever sees whole lines
+    file << line << '\n' << std::flush;
+}
+
+std::string PluginResultStream::toJson(const PluginInfo& plugin) {
+    std::string out = "{\"event\":\"plugin\"";
+    appendField(out, "name", plugin.name);
+    appendField(out, "version", plugin.version);
+    appendField(out, "vendor", plugin.vendor);
+    appendField(out, "path", plugin.path);
+    appendField(out, "format", PluginScanner::formatToString(plugin.format));
+    appendField(out, "arch", PluginScanner::architectureToString(plugin.arch));
+    appendField(out, "valid", plugin.isValid);
+    appendField(out, "uniqueId", plugin.uniqueId);
+    appendField(out, "clapId", plugin.clapId);
+    appendField(out, "categories", plugin.categories);
+    appendField(out, "features", plugin.features);
+    appendField(out, "synth", plugin.isSynth);
+    appendField(out, "effect", plugin.isEffect);
+    appendField(out, "acceptsMidi", plugin.acceptsMidi);
+    appendField(out, "producesMidi", plugin.producesMidi);
+    appendField(out, "inputs", plugin.numInputChannels);
+    appendField(out, "outputs", plugin.numOutputChannels);
+    if (!plugin.error.empty()) appendField(out, "error", plugin.error);
+    if (plugin.failure != ScanFailure::None) {
+        appendField(out, "failure", PluginQuarantine::failureToString(plugin.failure));
+    }
+    out += '}';
+    return out;
+}
+
+} // namespace futureboard
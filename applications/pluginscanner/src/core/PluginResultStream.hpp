@@ -0,0 +1,45 @@
+#pragma once
+
+#include "PluginScanner.hpp"
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+
+namespace futureboard {
+
+// Writes scan results as newline-delimited JSON while the scan runs, one
+// object per line, flushed as soon as it is written so another process can
+// tail the file. Lines carry an "event" field:
+//   {"event":"start"}
+//   {"event":"plugin","name":...,"path":...,...}   one per plugin
+//   {"event":"complete","count":N}                 or "stopped"
+// While watching for changes after the scan, each batch appends:
+//   {"event":"removed","path":...}                 one per removed path
+//   {"event":"plugin",...}                         one per added or rescanned plugin
+//   {"event":"delta","added":N,"removed":M}
+class PluginResultStream {
+public:
+    // append continues an existing stream instead of starting a new one
+    bool open(const std::filesystem::path& filePath, bool append = false);
+    void close();
+    bool isOpen() const;
+
+    // Thread-safe
+    void writePlugin(const PluginInfo& plugin);
+    void writeEnd(bool completed, size_t count);
+    void writeRemoved(const std::string& path);
+    void writeDelta(size_t added, size_t removed);
+
+    static std::string toJson(const PluginInfo& plugin);
+    // JSON string literal for text, quotes included
+    static std::string quote(const std::string& text);
+
+private:
+    void writeLine(const std::string& line);
+
+    std::ofstream file;
+    mutable std::mutex mutex;
+};
+
+} // namespace futureboard
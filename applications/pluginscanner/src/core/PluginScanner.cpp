@@ -1,10 +1,24 @@
 #include "PluginScanner.hpp"
+#include "ScanWorkerPool.hpp"
+#include "PluginDatabase.hpp"
+#include "BinaryInspector.hpp"
+#include "Vst3ModuleInfo.hpp"
+#include "Vst2Probe.hpp"
+#include "DynamicLibrary.hpp"
+#include "PluginResultStream.hpp"
+#include "PluginQuarantine.hpp"
+#include "PluginDirectoryWatcher.hpp"
 #include <juce_core/juce_core.h>
 #include <juce_audio_processors/juce_audio_processors.h>
 #include <pugixml.hpp>
 #include <iostream>
 #include <thread>
 #include <chrono>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <set>
 
 #ifdef _WIN32
     #include <windows.h>
@@ -14,11 +28,30 @@
     #include <mach-o/dyld.h>
 #else
     #include <sys/utsname.h>
-    #include <dlfcn.h>
 #endif
 
 namespace futureboard {
 
+namespace {
+
+// The outermost plugin file or bundle containing path, or path itself
+std::filesystem::path owningPlugin(const std::filesystem::path& path) {
+    std::filesystem::path owner = path;
+    for (auto current = path; ; current = current.parent_path()) {
+        if (PluginScanner::detectFormat(current) != PluginFormat::UNKNOWN) owner = current;
+        if (!current.has_relative_path() || current.parent_path() == current) break;
+    }
+    return owner;
+}
+
+bool isSameOrUnder(const std::string& path, const std::filesystem::path& directory) {
+    auto prefix = directory.string();
+    return path.compare(0, prefix.size(), prefix) == 0 &&
+           (path.size() == prefix.size() || path[prefix.size()] == '/' || path[prefix.size()] == '\\');
+}
+
+} // namespace
+
 std::ostream& operator<<(std::ostream& os, const PluginFormat& format) {
     switch (format) {
         case PluginFormat::VST2: return os << "VST2";
@@ -35,6 +68,13 @@ PluginScanner::PluginScanner()
     , enableVST2(true)
     , enableVST3(true)
     , enableCLAP(true)
+    , workerCount(static_cast<int>(std::max(1u, std::thread::hardware_concurrency())))
+    , pluginTimeoutMs(30000)
+    , contentHashing(false)
+    , fullRescan(false)
+    , nativeVst2Probe(true)
+    , quarantine(std::make_unique<PluginQuarantine>())
+    , retryQuarantined(false)
 {
     juce::MessageManager::getInstance(); // Ensure message manager is initialized
     initializeJuceFormats();
@@ -69,23 +109,331 @@ void PluginScanner::scanPlugins(const ProgressCallback& progress) {
         discoveredPlugins.clear();
     }
 
-    size_t totalPaths = searchPaths.size();
-    size_t currentPath = 0;
+    PluginResultStream stream;
+    if (!resultStreamFile.empty() && !stream.open(resultStreamFile)) {
+        reportProgress("Failed to open result stream: " + resultStreamFile.string(), -1.0f);
+    }
+    activeStream = stream.isOpen() ? &stream : nullptr;
+
+    if (!quarantineFile.empty() && !quarantine->load(quarantineFile)) {
+        reportProgress("Failed to read quarantine: " + quarantineFile.string(), -1.0f);
+    }
+
+    auto candidates = findPluginFiles();
+
+    if (!stopRequested) {
+        // Entries for plugins that were uninstalled are dropped
+        quarantine->retainOnly(candidates);
 
-    for (const auto& path : searchPaths) {
-        if (stopRequested) break;
+        auto changed = describeFromModuleInfo(skipUnloadable(skipQuarantined(reuseCachedResults(candidates))));
+        reportProgress("Scanning " + std::to_string(changed.size()) + " new or changed plugins", -1.0f);
+
+        if (workerExecutable.empty()) {
+            scanInProcess(changed);
+        } else {
+            scanOutOfProcess(changed);
+        }
+    }
+
+    {
+        // Workers finish in any order, keep the result list stable between scans
+        std::lock_guard<std::mutex> lock(pluginsMutex);
+        std::stable_sort(discoveredPlugins.begin(), discoveredPlugins.end(),
+            [](const PluginInfo& a, const PluginInfo& b) { return a.path < b.path; });
+    }
 
-        float pathProgress = static_cast<float>(currentPath) / totalPaths;
-        reportProgress("Scanning: " + path.string(), pathProgress);
+    if (!cacheFile.empty() && !stopRequested) {
+        saveDatabase(cacheFile.string());
+    }
 
-        scanDirectory(path);
-        currentPath++;
+    // Failures found before a stop are still worth keeping
+    if (!quarantineFile.empty() && quarantine->isModified()) {
+        quarantine->save(quarantineFile);
     }
 
+    stream.writeEnd(!stopRequested, getTotalPluginsFound());
+    activeStream = nullptr;
+
     reportProgress("Scan completed", 1.0f);
     scanning = false;
 }
 
+void PluginScanner::watchForChanges(const DeltaCallback& onDelta, int debounceMs) {
+    if (scanning) return;
+
+    scanning = true;
+    stopRequested = false;
+
+    // Changes follow the scan that preceded the watch in the same stream
+    PluginResultStream stream;
+    if (!resultStreamFile.empty() && !stream.open(resultStreamFile, true)) {
+        reportProgress("Failed to open result stream: " + resultStreamFile.string(), -1.0f);
+    }
+    activeStream = stream.isOpen() ? &stream : nullptr;
+
+    if (!quarantineFile.empty() && !quarantine->load(quarantineFile)) {
+        reportProgress("Failed to read quarantine: " + quarantineFile.string(), -1.0f);
+    }
+
+    PluginDirectoryWatcher watcher(searchPaths, debounceMs);
+    watcher.start();
+    for (const auto& error : watcher.getErrors()) {
+        reportProgress("Error watching directory: " + error, -1.0f);
+    }
+    reportProgress("Watching " + std::to_string(searchPaths.size()) + " plugin folders", -1.0f);
+
+    watcher.run(stopRequested, [this, &onDelta](const std::vector<std::filesystem::path>& changes) {
+        auto delta = rescanChangedPaths(changes);
+        if (!delta.empty() && onDelta) onDelta(delta);
+    });
+
+    activeStream = nullptr;
+    scanning = false;
+}
+
+PluginDelta PluginScanner::rescanChangedPaths(const std::vector<std::filesystem::path>& changedPaths) {
+    // A change inside a bundle is a change to the bundle. Folders that
+    // appeared (or overflowed the change queue) are walked for plugins.
+    std::set<std::filesystem::path> gone;
+    std::set<std::filesystem::path> plugins;
+    std::vector<std::filesystem::path> folders;
+    for (const auto& changed : changedPaths) {
+        auto path = owningPlugin(changed);
+        std::error_code ec;
+        if (!std::filesystem::exists(path, ec)) {
+            gone.insert(path);
+        } else if (detectFormat(path) != PluginFormat::UNKNOWN) {
+            plugins.insert(path);
+        } else if (std::filesystem::is_directory(path, ec)) {
+            folders.push_back(path);
+        }
+    }
+
+    candidateBinaries.clear();
+    auto candidates = folders.empty() ? std::vector<std::filesystem::path>() : findPluginFiles(folders);
+    for (const auto& path : plugins) {
+        std::error_code ec;
+        std::filesystem::directory_entry entry(path, ec);
+        if (!ec && classifyEntry(entry) == PluginDirectoryWalker::Action::Accept) {
+            candidates.push_back(path);
+        } else {
+            // Still there, but no longer a plugin of an enabled format
+            gone.insert(path);
+        }
+    }
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    std::unordered_map<std::string, FileFingerprint> known;
+    {
+        std::lock_guard<std::mutex> lock(pluginsMutex);
+        for (const auto& info : discoveredPlugins) known.emplace(info.path, info.fingerprint);
+    }
+
+    // Attribute changes and rewrites with identical content leave the fingerprint alone
+    candidateFingerprints.clear();
+    std::set<std::string> rescanned;
+    std::vector<std::filesystem::path> changed;
+    for (const auto& path : candidates) {
+        auto fingerprint = fingerprintFile(path, contentHashing);
+        candidateFingerprints[path.string()] = fingerprint;
+
+        auto it = known.find(path.string());
+        if (it != known.end() && it->second.matches(fingerprint)) continue;
+        rescanned.insert(path.string());
+        changed.push_back(path);
+    }
+
+    PluginDelta delta;
+    std::set<std::string> candidatePaths;
+    for (const auto& path : candidates) candidatePaths.insert(path.string());
+    for (const auto& [path, fingerprint] : known) {
+        bool removed = std::any_of(gone.begin(), gone.end(),
+                                   [&](const std::filesystem::path& dir) { return isSameOrUnder(path, dir); });
+        // A walked folder lists every plugin it still holds
+        removed = removed || (candidatePaths.count(path) == 0 &&
+                              std::any_of(folders.begin(), folders.end(),
+                                          [&](const std::filesystem::path& dir) { return isSameOrUnder(path, dir); }));
+        if (removed) delta.removed.push_back(path);
+    }
+    std::sort(delta.removed.begin(), delta.removed.end());
+
+    if (delta.removed.empty() && changed.empty()) return delta;
+
+    {
+        std::lock_guard<std::mutex> lock(pluginsMutex);
+        std::set<std::string> dropped(delta.removed.begin(), delta.removed.end());
+        dropped.insert(rescanned.begin(), rescanned.end());
+        discoveredPlugins.erase(std::remove_if(discoveredPlugins.begin(), discoveredPlugins.end(),
+            [&](const PluginInfo& info) { return dropped.count(info.path) > 0; }), discoveredPlugins.end());
+    }
+
+    for (const auto& path : delta.removed) {
+        quarantine->remove(path);
+        if (activeStream) activeStream->writeRemoved(path);
+    }
+
+    reportProgress("Rescanning " + std::to_string(changed.size()) + " changed plugins", -1.0f);
+    auto needLoading = describeFromModuleInfo(skipUnloadable(skipQuarantined(changed)));
+    if (workerExecutable.empty()) {
+        scanInProcess(needLoading);
+    } else {
+        scanOutOfProcess(needLoading);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(pluginsMutex);
+        std::stable_sort(discoveredPlugins.begin(), discoveredPlugins.end(),
+            [](const PluginInfo& a, const PluginInfo& b) { return a.path < b.path; });
+        for (const auto& info : discoveredPlugins) {
+            if (rescanned.count(info.path) > 0) delta.added.push_back(info);
+        }
+    }
+
+    if (!cacheFile.empty()) {
+        saveDatabase(cacheFile.string());
+    }
+    if (!quarantineFile.empty() && quarantine->isModified()) {
+        quarantine->save(quarantineFile);
+    }
+    if (activeStream) {
+        activeStream->writeDelta(delta.added.size(), delta.removed.size());
+    }
+
+    return delta;
+}
+
+std::vector<std::filesystem::path> PluginScanner::reuseCachedResults(
+        const std::vector<std::filesystem::path>& candidates) {
+    candidateFingerprints.clear();
+    for (const auto& path : candidates) {
+        candidateFingerprints[path.string()] = fingerprintFile(path, contentHashing);
+    }
+
+    std::unordered_map<std::string, std::vector<PluginInfo>> cached;
+    std::vector<PluginInfo> cachedList;
+    if (!cacheFile.empty() && readDatabase(cacheFile.string(), cachedList)) {
+        for (auto& info : cachedList) {
+            cached[info.path].push_back(std::move(info));
+        }
+    }
+
+    // Anything not among the candidates was deleted and simply isn't carried over
+    keptResults.clear();
+    std::vector<std::filesystem::path> changed;
+    for (const auto& path : candidates) {
+        auto it = cached.find(path.string());
+        bool unchanged = it != cached.end() && !it->second.empty() &&
+                         it->second.front().fingerprint.matches(candidateFingerprints[path.string()]);
+
+        // Quarantined plugins are settled by skipQuarantined instead
+        if (unchanged && !fullRescan && !quarantine->contains(path.string())) {
+            addScanResults(path, std::move(it->second));
+        } else {
+            if (unchanged) keptResults[path.string()] = std::move(it->second);
+            changed.push_back(path);
+        }
+    }
+
+    return changed;
+}
+
+std::vector<std::filesystem::path> PluginScanner::skipQuarantined(
+        const std::vector<std::filesystem::path>& candidates) {
+    if (quarantineFile.empty()) return candidates;
+
+    std::vector<std::filesystem::path> remaining;
+    for (const auto& path : candidates) {
+        PluginQuarantine::Entry entry;
+        if (!quarantine->find(path.string(), entry)) {
+            remaining.push_back(path);
+            continue;
+        }
+
+        // An update may well have fixed it; if not it's quarantined again
+        if (retryQuarantined || !entry.fingerprint.matches(candidateFingerprints[path.string()])) {
+            quarantine->remove(path.string());
+            remaining.push_back(path);
+            continue;
+        }
+
+        PluginInfo info;
+        info.path = path.string();
+        info.name = path.stem().string();
+        info.version = "Unknown";
+        info.vendor = "Unknown";
+        info.format = detectFormat(path);
+        auto binary = candidateBinaries.find(path.string());
+        info.arch = binary != candidateBinaries.end()
+            ? binary->second.architectureFor(BinaryInspector::hostArchitecture())
+            : BinaryInspector::hostArchitecture();
+        info.isValid = false;
+        info.failure = entry.failure;
+        info.error = "Quarantined: " + entry.error;
+        addScanResults(path, { info });
+    }
+
+    return remaining;
+}
+
+std::vector<std::filesystem::path> PluginScanner::skipUnloadable(
+        const std::vector<std::filesystem::path>& candidates) {
+    // Foreign-architecture binaries would only fail to load, slowly; record
+    // them straight away instead of handing them to a scanner process
+    std::vector<std::filesystem::path> loadable;
+    for (const auto& path : candidates) {
+        auto binary = candidateBinaries.find(path.string());
+        if (binary == candidateBinaries.end()) {
+            loadable.push_back(path);
+            continue;
+        }
+
+        PluginInfo info;
+        info.path = path.string();
+        info.format = detectFormat(path);
+        if (checkArchitecture(binary->second, info)) {
+            loadable.push_back(path);
+            continue;
+        }
+
+        info.name = path.stem().string();
+        info.version = "Unknown";
+        info.vendor = "Unknown";
+        addScanResults(path, { info });
+    }
+
+    candidateBinaries.clear();
+    return loadable;
+}
+
+std::vector<std::filesystem::path> PluginScanner::describeFromModuleInfo(
+        const std::vector<std::filesystem::path>& candidates) {
+    // VST3 bundles that ship moduleinfo.json are described from it and
+    // never loaded; everything else still needs a scanner
+    std::vector<std::filesystem::path> needLoading;
+    for (const auto& path : candidates) {
+        std::vector<PluginInfo> results;
+        if (detectFormat(path) == PluginFormat::VST3 && Vst3ModuleInfo::read(path, results)) {
+            addScanResults(path, std::move(results));
+        } else {
+            needLoading.push_back(path);
+        }
+    }
+    return needLoading;
+}
+
+bool PluginScanner::checkArchitecture(const BinaryInfo& binary, PluginInfo& info) {
+    auto host = BinaryInspector::hostArchitecture();
+    info.arch = binary.architectures.empty() ? host : binary.architectureFor(host);
+
+    if (binary.canLoadIn(host)) return true;
+
+    info.isValid = false;
+    info.error = "Built for " + architectureToString(info.arch) +
+                 ", this host runs " + architectureToString(host);
+    return false;
+}
+
 void PluginScanner::stopScanning() {
     if (scanning) {
         stopRequested = true;
@@ -95,53 +443,177 @@ void PluginScanner::stopScanning() {
     }
 }
 
-void PluginScanner::scanDirectory(const std::filesystem::path& path) {
-    if (!std::filesystem::exists(path)) return;
+std::vector<std::filesystem::path> PluginScanner::findPluginFiles() {
+    reportProgress("Searching " + std::to_string(searchPaths.size()) + " plugin folders", 0.0f);
 
-    try {
-        for (const auto& entry : std::filesystem::recursive_directory_iterator(path)) {
-            if (stopRequested) return;
+    candidateBinaries.clear();
+    return findPluginFiles(searchPaths);
+}
 
-            if (!entry.is_regular_file()) continue;
+std::vector<std::filesystem::path> PluginScanner::findPluginFiles(const std::vector<std::filesystem::path>& roots) {
+    // Listing directories and reading binary headers is I/O bound
+    int threads = static_cast<int>(std::min(8u, std::max(1u, std::thread::hardware_concurrency())));
+    PluginDirectoryWalker walker(threads);
 
-            if (isPluginFile(entry.path())) {
-                reportProgress("Scanning: " + entry.path().filename().string(), -1.0f);
-                scanAndValidatePlugin(entry.path());
-            }
+    auto candidates = walker.walk(roots,
+        [this](const std::filesystem::directory_entry& entry) { return classifyEntry(entry); },
+        stopRequested);
+
+    for (const auto& error : walker.getErrors()) {
+        reportProgress("Error scanning directory: " + error, -1.0f);
+    }
+
+    return candidates;
+}
+
+PluginDirectoryWalker::Action PluginScanner::classifyEntry(const std::filesystem::directory_entry& entry) {
+    using Action = PluginDirectoryWalker::Action;
+
+    std::error_code ec;
+    bool isDirectory = entry.is_directory(ec);
+    PluginFormat format = detectFormat(entry.path());
+
+    if (format == PluginFormat::UNKNOWN || !isFormatEnabled(format)) {
+        return isDirectory ? Action::Descend : Action::Skip;
+    }
+
+    // .vst3/.clap/.vst directories are bundles: scanned as a whole, never entered
+    if (!isDirectory && !entry.is_regular_file(ec)) return Action::Skip;
+
+    // Only the headers are read here; nothing is loaded
+    BinaryInfo binary = BinaryInspector::inspect(entry.path());
+    if (binary.format == BinaryFormat::Unknown) {
+        // A bundle built only for other architectures is still listed, as
+        // unloadable here; skipUnloadable() records it with the reason
+        if (isDirectory) binary.architectures = BinaryInspector::bundleArchitectures(entry.path());
+        if (binary.architectures.empty() || binary.canLoadIn(BinaryInspector::hostArchitecture())) {
+            // Linker scripts, text files, bundles without a binary
+            return Action::Skip;
         }
+        std::lock_guard<std::mutex> lock(candidateBinariesMutex);
+        candidateBinaries[entry.path().string()] = std::move(binary);
+        return Action::Accept;
     }
-    catch (const std::exception& e) {
-        reportProgress("Error scanning directory: " + std::string(e.what()), -1.0f);
+
+    // Can't tell without an export table, let the loader decide
+    bool hasEntry = !binary.exportsParsed ||
+                    (format == PluginFormat::VST2 && binary.hasVst2Entry) ||
+                    (format == PluginFormat::VST3 && binary.hasVst3Entry) ||
+                    (format == PluginFormat::CLAP && binary.hasClapEntry);
+    if (!hasEntry) return Action::Skip;
+
+    // Kept so the architecture check doesn't read the headers again
+    std::lock_guard<std::mutex> lock(candidateBinariesMutex);
+    candidateBinaries[entry.path().string()] = std::move(binary);
+    return Action::Accept;
+}
+
+bool PluginScanner::isFormatEnabled(PluginFormat format) const {
+    switch (format) {
+        case PluginFormat::VST2: return enableVST2;
+        case PluginFormat::VST3: return enableVST3;
+        case PluginFormat::CLAP: return enableCLAP;
+        default: return false;
     }
 }
 
-bool PluginScanner::isPluginFile(const std::filesystem::path& path) {
-    auto extension = path.extension().string();
-    return (enableVST2 && (extension == ".dll" || extension == ".so" || extension == ".vst")) ||
-           (enableVST3 && extension == ".vst3") ||
-           (enableCLAP && extension == ".clap");
+void PluginScanner::scanInProcess(const std::vector<std::filesystem::path>& candidates) {
+    size_t done = 0;
+    for (const auto& path : candidates) {
+        if (stopRequested) return;
+
+        reportProgress("Scanning: " + path.filename().string(),
+                       static_cast<float>(done) / candidates.size());
+
+        auto start = std::chrono::steady_clock::now();
+        auto results = scanPluginFile(path);
+        double totalMs = ScanTimings::elapsedMs(start);
+        for (auto& info : results) info.timings.totalMs = totalMs;
+
+        addScanResults(path, std::move(results));
+        done++;
+    }
 }
 
-void PluginScanner::scanAndValidatePlugin(const std::filesystem::path& path) {
-    PluginInfo info;
-    info.path = path.string();
-    info.arch = detectSystemArchitecture();
+void PluginScanner::scanOutOfProcess(const std::vector<std::filesystem::path>& candidates) {
+    ScanWorkerPool pool(workerExecutable, workerCount, pluginTimeoutMs);
+    if (!nativeVst2Probe) {
+        pool.setExtraArguments({ "-J" });
+    }
+    std::atomic<size_t> done{0};
+
+    pool.run(candidates, stopRequested,
+        [this, &done, total = candidates.size()](const std::filesystem::path& path,
+                                                 std::vector<PluginInfo>&& results) {
+            auto fingerprint = candidateFingerprints.find(path.string());
+            if (!quarantineFile.empty() && fingerprint != candidateFingerprints.end()) {
+                for (const auto& info : results) {
+                    quarantine->add(path.string(), info.failure, info.error, fingerprint->second);
+                }
+            }
+            addScanResults(path, std::move(results));
+            size_t finished = ++done;
+            reportProgress("Scanned: " + path.filename().string(),
+                           static_cast<float>(finished) / total);
+        });
+}
 
-    auto extension = path.extension().string();
-    if (extension == ".vst3") {
-        info.format = PluginFormat::VST3;
-    } else if (extension == ".clap") {
-        info.format = PluginFormat::CLAP;
-    } else {
-        info.format = PluginFormat::VST2;
+void PluginScanner::addScanResults(const std::filesystem::path& path, std::vector<PluginInfo>&& results) {
+    // candidateFingerprints is only written before scanning starts
+    auto fingerprint = candidateFingerprints.find(path.string());
+    auto kept = keptResults.find(path.string());
+    for (auto& info : results) {
+        if (fingerprint != candidateFingerprints.end()) {
+            info.fingerprint = fingerprint->second;
+        }
+        // The binary is the one that was measured
+        if (kept != keptResults.end() && info.costHints.empty()) {
+            for (const auto& previous : kept->second) {
+                if (previous.clapId == info.clapId && previous.uniqueId == info.uniqueId && previous.name == info.name) {
+                    info.costHints = previous.costHints;
+                    break;
+                }
+            }
+        }
+    }
+
+    if (activeStream || resultCallback) {
+        std::lock_guard<std::mutex> lock(resultMutex);
+        for (const auto& info : results) {
+            if (activeStream) activeStream->writePlugin(info);
+            if (resultCallback) resultCallback(info);
+        }
     }
 
+    std::lock_guard<std::mutex> lock(pluginsMutex);
+    discoveredPlugins.insert(discoveredPlugins.end(),
+                             std::make_move_iterator(results.begin()), std::make_move_iterator(results.end()));
+}
+
+std::vector<PluginInfo> PluginScanner::scanPluginFile(const std::filesystem::path& path) {
+    PluginInfo info;
+    info.path = path.string();
+    info.format = detectFormat(path);
+
     bool isValid = false;
 
-    if (info.format == PluginFormat::CLAP) {
-        isValid = validateCLAPPlugin(path, info);
-    } else {
-        isValid = validateWithJuce(path, info);
+    // Binaries built for another architecture are reported without loading them
+    if (checkArchitecture(BinaryInspector::inspect(path), info)) {
+        if (info.format == PluginFormat::CLAP) {
+            // One file can hold any number of CLAP plugins
+            std::vector<PluginInfo> plugins;
+            if (scanCLAPFactory(path, info, plugins, info.error)) {
+                return plugins;
+            }
+        } else if (info.format == PluginFormat::VST2 && nativeVst2Probe) {
+            auto result = Vst2Probe::probe(path, info);
+            isValid = result == Vst2Probe::Result::Ok;
+            if (result == Vst2Probe::Result::Unsupported) {
+                isValid = validateWithJuce(path, info);
+            }
+        } else {
+            isValid = validateWithJuce(path, info);
+        }
     }
 
     if (!isValid) {
@@ -150,8 +622,7 @@ void PluginScanner::scanAndValidatePlugin(const std::filesystem::path& path) {
         info.vendor = "Unknown";
     }
 
-    std::lock_guard<std::mutex> lock(pluginsMutex);
-    discoveredPlugins.push_back(info);
+    return { info };
 }
 
 bool PluginScanner::validateWithJuce(const std::filesystem::path& path, PluginInfo& info) {
@@ -172,8 +643,23 @@ bool PluginScanner::validateWithJuce(const std::filesystem::path& path, PluginIn
     }
 
     try {
+        // JUCE loads, instantiates and unloads in one call. Loading the
+        // library first (JUCE's own load then only bumps the reference count)
+        // and releasing it afterwards splits off the load and unload times.
+        using Clock = std::chrono::steady_clock;
+        DynamicLibrary preload;
+        auto start = Clock::now();
+        preload.open(BinaryInspector::resolveBinary(path));
+        info.timings.loadMs = ScanTimings::elapsedMs(start);
+
         juce::OwnedArray<juce::PluginDescription> descriptions;
+        start = Clock::now();
         format->findAllTypesForFile(descriptions, path.string());
+        info.timings.instantiateMs = ScanTimings::elapsedMs(start);
+
+        start = Clock::now();
+        preload.close();
+        info.timings.unloadMs = ScanTimings::elapsedMs(start);
 
         if (descriptions.isEmpty()) {
             info.error = "No plugin found in file";
@@ -190,8 +676,6 @@ bool PluginScanner::validateWithJuce(const std::filesystem::path& path, PluginIn
         info.name = desc->name.toStdString();
         info.version = desc->version.toStdString();
         info.vendor = desc->manufacturerName.toStdString();
-        info.formatName = desc->pluginFormatName;
-        info.manufacturerName = desc->manufacturerName;
         info.numInputChannels = desc->numInputChannels;
         info.numOutputChannels = desc->numOutputChannels;
         info.acceptsMidi = desc->isInstrument;
@@ -209,90 +693,86 @@ bool PluginScanner::validateWithJuce(const std::filesystem::path& path, PluginIn
     }
 }
 
-bool PluginScanner::validateCLAPPlugin(const std::filesystem::path& path, PluginInfo& info) {
-#ifdef _WIN32
-    HMODULE handle = LoadLibraryW(path.wstring().c_str());
-    if (!handle) {
-        info.error = "Failed to load library";
+bool PluginScanner::scanCLAPFactory(const std::filesystem::path& path, const PluginInfo& fileInfo,
+                                    std::vector<PluginInfo>& plugins, std::string& error) {
+    using Clock = std::chrono::steady_clock;
+    ScanTimings timings;
+
+    // On macOS a .clap is a bundle; clap_entry.init still gets the bundle path
+    DynamicLibrary library;
+    auto start = Clock::now();
+    if (!library.open(BinaryInspector::resolveBinary(path))) {
+        error = library.getError();
         return false;
     }
+    timings.loadMs = ScanTimings::elapsedMs(start);
 
-    auto factory = getCLAPFactory(handle, path.string());
-    if (!factory) {
-        FreeLibrary(handle);
-        info.error = "No CLAP factory found";
+    auto entry = static_cast<const clap_plugin_entry*>(library.getSymbol("clap_entry"));
+    if (!entry) {
+        error = "No clap_entry found";
         return false;
     }
-
-    uint32_t count = factory->get_plugin_count(factory);
-    if (count == 0) {
-        FreeLibrary(handle);
-        info.error = "No CLAP plugins found in factory";
+    if (!clap_version_is_compatible(entry->clap_version)) {
+        error = "Unsupported CLAP version " + std::to_string(entry->clap_version.major) + "." +
+                std::to_string(entry->clap_version.minor);
         return false;
     }
 
-    const clap_plugin_descriptor* desc = factory->get_plugin_descriptor(factory, 0);
-    if (!desc) {
-        FreeLibrary(handle);
-        info.error = "Failed to get plugin descriptor";
+    start = Clock::now();
+    if (!entry->init(path.string().c_str())) {
+        error = "clap_entry.init failed";
         return false;
     }
 
-    info.name = desc->name;
-    info.version = desc->version;
-    info.vendor = desc->vendor;
-    info.clapId = desc->id;
-
-    for (const char* const* feature = desc->features; *feature != nullptr; ++feature) {
-        info.features.push_back(*feature);
-        if (strcmp(*feature, CLAP_PLUGIN_FEATURE_INSTRUMENT) == 0) {
-            info.isSynth = true;
-        }
-        if (strcmp(*feature, CLAP_PLUGIN_FEATURE_AUDIO_EFFECT) == 0) {
-            info.isEffect = true;
+    // Descriptors are only valid between init and deinit, so everything is
+    // copied out before deinit; no plugin is ever created
+    auto factory = static_cast<const clap_plugin_factory*>(entry->get_factory(CLAP_PLUGIN_FACTORY_ID));
+    uint32_t count = factory ? factory->get_plugin_count(factory) : 0;
+    timings.entryMs = ScanTimings::elapsedMs(start);
+
+    size_t firstPlugin = plugins.size();
+    start = Clock::now();
+
+    for (uint32_t i = 0; i < count; i++) {
+        const clap_plugin_descriptor* desc = factory->get_plugin_descriptor(factory, i);
+        if (!desc || !desc->id || !desc->name) continue;
+
+        PluginInfo info = fileInfo;
+        info.name = desc->name;
+        info.version = desc->version ? desc->version : "";
+        info.vendor = desc->vendor ? desc->vendor : "";
+        info.clapId = desc->id;
+
+        for (const char* const* feature = desc->features; feature && *feature; ++feature) {
+            info.features.push_back(*feature);
+            if (strcmp(*feature, CLAP_PLUGIN_FEATURE_INSTRUMENT) == 0) {
+                info.isSynth = true;
+            }
+            if (strcmp(*feature, CLAP_PLUGIN_FEATURE_AUDIO_EFFECT) == 0) {
+                info.isEffect = true;
+            }
         }
+
+        info.isValid = true;
+        plugins.push_back(std::move(info));
     }
+    timings.instantiateMs = ScanTimings::elapsedMs(start);
 
-    info.isValid = true;
-    FreeLibrary(handle);
-    return true;
-#else
-    void* handle = dlopen(path.c_str(), RTLD_LAZY);
-    if (!handle) {
-        info.error = dlerror();
-        return false;
+    start = Clock::now();
+    entry->deinit();
+    library.close();
+    timings.unloadMs = ScanTimings::elapsedMs(start);
+
+    for (size_t i = firstPlugin; i < plugins.size(); i++) {
+        plugins[i].timings = timings;
     }
 
-    auto factory = getCLAPFactory(handle, path.string());
     if (!factory) {
-        dlclose(handle);
-        info.error = "No CLAP factory found";
-        return false;
+        error = "No CLAP factory found";
+    } else if (plugins.empty()) {
+        error = "No CLAP plugins found in factory";
     }
-
-    // Same validation as Windows...
-
-    info.isValid = true;
-    dlclose(handle);
-    return true;
-#endif
-}
-
-const clap_plugin_factory* PluginScanner::getCLAPFactory(void* library, const std::string& path) {
-#ifdef _WIN32
-    auto entryProc = reinterpret_cast<const clap_plugin_entry*>(
-        GetProcAddress((HMODULE)library, "clap_entry"));
-#else
-    auto entryProc = reinterpret_cast<const clap_plugin_entry*>(
-        dlsym(library, "clap_entry"));
-#endif
-
-    if (!entryProc) return nullptr;
-
-    if (!entryProc->init(path.c_str())) return nullptr;
-
-    return static_cast<const clap_plugin_factory*>(
-        entryProc->get_factory(CLAP_PLUGIN_FACTORY_ID));
+    return !plugins.empty();
 }
 
 void PluginScanner::addSearchPath(const std::string& path) {
@@ -311,6 +791,47 @@ void PluginScanner::setFormatsToScan(bool scanVST2, bool scanVST3, bool scanCLAP
     enableCLAP = scanCLAP;
 }
 
+void PluginScanner::setCacheFile(const std::filesystem::path& file) {
+    cacheFile = file;
+    quarantineFile = file.empty() ? std::filesystem::path() : PluginQuarantine::fileFor(file);
+}
+
+void PluginScanner::setRetryQuarantined(bool enabled) {
+    retryQuarantined = enabled;
+}
+
+void PluginScanner::setContentHashing(bool enabled) {
+    contentHashing = enabled;
+}
+
+void PluginScanner::setFullRescan(bool enabled) {
+    fullRescan = enabled;
+}
+
+void PluginScanner::setResultStream(const std::filesystem::path& streamFile) {
+    resultStreamFile = streamFile;
+}
+
+void PluginScanner::setResultCallback(const ResultCallback& callback) {
+    resultCallback = callback;
+}
+
+void PluginScanner::setNativeVst2Probe(bool enabled) {
+    nativeVst2Probe = enabled;
+}
+
+void PluginScanner::setWorkerExecutable(const std::filesystem::path& executable) {
+    workerExecutable = executable;
+}
+
+void PluginScanner::setWorkerCount(int count) {
+    workerCount = std::max(1, count);
+}
+
+void PluginScanner::setPluginTimeout(int timeoutMs) {
+    pluginTimeoutMs = std::max(1, timeoutMs);
+}
+
 std::vector<std::filesystem::path> PluginScanner::getDefaultPluginPaths() {
     std::vector<std::filesystem::path> paths;
 
@@ -376,6 +897,100 @@ ProcessorArchitecture PluginScanner::detectSystemArchitecture() {
 #endif
 }
 
+bool PluginScanner::saveDatabase(const std::string& filePath) {
+    std::lock_guard<std::mutex> lock(pluginsMutex);
+    return writeDatabase(filePath, discoveredPlugins);
+}
+
+bool PluginScanner::loadDatabase(const std::string& filePath) {
+    std::vector<PluginInfo> loadedPlugins;
+    if (!readDatabase(filePath, loadedPlugins)) return false;
+
+    std::lock_guard<std::mutex> lock(pluginsMutex);
+    discoveredPlugins = std::move(loadedPlugins);
+
+    return true;
+}
+
+bool PluginScanner::writeDatabase(const std::string& filePath, const std::vector<PluginInfo>& plugins) {
+    std::vector<PluginDatabaseEntry> entries;
+    entries.reserve(plugins.size());
+
+    for (const auto& plugin : plugins) {
+        PluginDatabaseEntry entry;
+        entry.name = plugin.name;
+        entry.version = plugin.version;
+        entry.path = plugin.path;
+        entry.vendor = plugin.vendor;
+        entry.uniqueId = plugin.uniqueId;
+        entry.clapId = plugin.clapId;
+        entry.error = plugin.error;
+        entry.categories = plugin.categories;
+        entry.features = plugin.features;
+        entry.costHints = plugin.costHints;
+        entry.format = static_cast<uint8_t>(plugin.format);
+        entry.arch = static_cast<uint8_t>(plugin.arch);
+        entry.flags = (plugin.isValid ? plugindb::IsValid : 0) |
+                      (plugin.isSynth ? plugindb::IsSynth : 0) |
+                      (plugin.isEffect ? plugindb::IsEffect : 0) |
+                      (plugin.acceptsMidi ? plugindb::AcceptsMidi : 0) |
+                      (plugin.producesMidi ? plugindb::ProducesMidi : 0);
+        entry.numInputChannels = plugin.numInputChannels;
+        entry.numOutputChannels = plugin.numOutputChannels;
+        entry.fileSize = plugin.fingerprint.size;
+        entry.modifiedTime = plugin.fingerprint.modifiedTime;
+        entry.contentHash = plugin.fingerprint.contentHash;
+        entries.push_back(std::move(entry));
+    }
+
+    return PluginDatabaseWriter::write(filePath, entries);
+}
+
+bool PluginScanner::readDatabase(const std::string& filePath, std::vector<PluginInfo>& plugins) {
+    PluginDatabase database;
+    if (!database.open(filePath)) return false;
+
+    std::vector<PluginInfo> loadedPlugins;
+    loadedPlugins.reserve(database.size());
+
+    for (uint32_t i = 0; i < database.size(); i++) {
+        const auto& record = database.record(i);
+        PluginInfo info;
+        info.name = database.string(record.name);
+        info.version = database.string(record.version);
+        info.path = database.string(record.path);
+        info.vendor = database.string(record.vendor);
+        info.uniqueId = database.string(record.uniqueId);
+        info.clapId = database.string(record.clapId);
+        info.error = database.string(record.error);
+        for (uint32_t c = 0; c < record.categoriesCount; c++) {
+            info.categories.emplace_back(database.category(record, c));
+        }
+        for (uint32_t f = 0; f < record.featuresCount; f++) {
+            info.features.emplace_back(database.feature(record, f));
+        }
+        for (uint32_t c = 0; c < record.costHintsCount; c++) {
+            info.costHints.push_back(database.costHint(record, c));
+        }
+        info.format = static_cast<PluginFormat>(record.format);
+        info.arch = static_cast<ProcessorArchitecture>(record.arch);
+        info.isValid = (record.flags & plugindb::IsValid) != 0;
+        info.isSynth = (record.flags & plugindb::IsSynth) != 0;
+        info.isEffect = (record.flags & plugindb::IsEffect) != 0;
+        info.acceptsMidi = (record.flags & plugindb::AcceptsMidi) != 0;
+        info.producesMidi = (record.flags & plugindb::ProducesMidi) != 0;
+        info.numInputChannels = record.numInputChannels;
+        info.numOutputChannels = record.numOutputChannels;
+        info.fingerprint.size = record.fileSize;
+        info.fingerprint.modifiedTime = record.modifiedTime;
+        info.fingerprint.contentHash = record.contentHash;
+        loadedPlugins.push_back(std::move(info));
+    }
+
+    plugins = std::move(loadedPlugins);
+    return true;
+}
+
 bool PluginScanner::saveToPreset(const std::string& filePath) {
     return writeXMLPreset(filePath);
 }
@@ -385,6 +1000,21 @@ bool PluginScanner::loadFromPreset(const std::string& filePath) {
 }
 
 bool PluginScanner::writeXMLPreset(const std::string& filePath) {
+    std::lock_guard<std::mutex> lock(pluginsMutex);
+    return writePluginList(filePath, discoveredPlugins);
+}
+
+bool PluginScanner::readXMLPreset(const std::string& filePath) {
+    std::vector<PluginInfo> loadedPlugins;
+    if (!readPluginList(filePath, loadedPlugins)) return false;
+
+    std::lock_guard<std::mutex> lock(pluginsMutex);
+    discoveredPlugins = std::move(loadedPlugins);
+
+    return true;
+}
+
+bool PluginScanner::writePluginList(const std::string& filePath, const std::vector<PluginInfo>& plugins) {
     pugi::xml_document doc;
     auto declNode = doc.append_child(pugi::node_declaration);
     declNode.append_attribute("version") = "1.0";
@@ -393,8 +1023,7 @@ bool PluginScanner::writeXMLPreset(const std::string& filePath) {
     auto root = doc.append_child("FutureboardPlugins");
     root.append_attribute("version") = "1.0";
 
-    std::lock_guard<std::mutex> lock(pluginsMutex);
-    for (const auto& plugin : discoveredPlugins) {
+    for (const auto& plugin : plugins) {
         auto pluginNode = root.append_child("Plugin");
         pluginNode.append_child("Name").text().set(plugin.name.c_str());
         pluginNode.append_child("Version").text().set(plugin.version.c_str());
@@ -404,10 +1033,46 @@ bool PluginScanner::writeXMLPreset(const std::string& filePath) {
         pluginNode.append_child("Format").text().set(formatToString(plugin.format).c_str());
         pluginNode.append_child("IsValid").text().set(plugin.isValid);
 
+        if (!plugin.uniqueId.empty()) {
+            pluginNode.append_child("UniqueId").text().set(plugin.uniqueId.c_str());
+        }
+
+        if (!plugin.clapId.empty()) {
+            pluginNode.append_child("ClapId").text().set(plugin.clapId.c_str());
+        }
+
         if (!plugin.error.empty()) {
             pluginNode.append_child("Error").text().set(plugin.error.c_str());
         }
 
+        const auto& timings = plugin.timings;
+        if (timings.loadMs > 0 || timings.entryMs > 0 || timings.instantiateMs > 0 || timings.unloadMs > 0) {
+            auto timingsNode = pluginNode.append_child("Timings");
+            timingsNode.append_attribute("load") = timings.loadMs;
+            timingsNode.append_attribute("entry") = timings.entryMs;
+            timingsNode.append_attribute("instantiate") = timings.instantiateMs;
+            timingsNode.append_attribute("unload") = timings.unloadMs;
+            timingsNode.append_attribute("total") = timings.totalMs;
+        }
+
+        auto fingerprintNode = pluginNode.append_child("Fingerprint");
+        fingerprintNode.append_attribute("size") = static_cast<unsigned long long>(plugin.fingerprint.size);
+        fingerprintNode.append_attribute("modified") = plugin.fingerprint.modifiedTime;
+        fingerprintNode.append_attribute("hash") = static_cast<unsigned long long>(plugin.fingerprint.contentHash);
+
+        if (!plugin.costHints.empty()) {
+            auto costsNode = pluginNode.append_child("Costs");
+            for (const auto& hint : plugin.costHints) {
+                auto costNode = costsNode.append_child("Cost");
+                costNode.append_attribute("sampleRate") = hint.sampleRate;
+                costNode.append_attribute("blockSize") = hint.blockSize;
+                costNode.append_attribute("median") = hint.medianUs;
+                costNode.append_attribute("p90") = hint.p90Us;
+                costNode.append_attribute("p99") = hint.p99Us;
+                costNode.append_attribute("max") = hint.maxUs;
+            }
+        }
+
         if (!plugin.categories.empty()) {
             auto categoriesNode = pluginNode.append_child("Categories");
             for (const auto& category : plugin.categories) {
@@ -433,7 +1098,7 @@ bool PluginScanner::writeXMLPreset(const std::string& filePath) {
     return doc.save_file(filePath.c_str());
 }
 
-bool PluginScanner::readXMLPreset(const std::string& filePath) {
+bool PluginScanner::readPluginList(const std::string& filePath, std::vector<PluginInfo>& plugins) {
     pugi::xml_document doc;
     if (!doc.load_file(filePath.c_str())) return false;
 
@@ -449,11 +1114,40 @@ bool PluginScanner::readXMLPreset(const std::string& filePath) {
         info.arch = stringToArchitecture(pluginNode.child("Architecture").text().get());
         info.format = stringToFormat(pluginNode.child("Format").text().get());
         info.isValid = pluginNode.child("IsValid").text().as_bool();
+        info.uniqueId = pluginNode.child("UniqueId").text().get();
+        info.clapId = pluginNode.child("ClapId").text().get();
 
         if (auto errorNode = pluginNode.child("Error")) {
             info.error = errorNode.text().get();
         }
 
+        if (auto timingsNode = pluginNode.child("Timings")) {
+            info.timings.loadMs = timingsNode.attribute("load").as_double();
+            info.timings.entryMs = timingsNode.attribute("entry").as_double();
+            info.timings.instantiateMs = timingsNode.attribute("instantiate").as_double();
+            info.timings.unloadMs = timingsNode.attribute("unload").as_double();
+            info.timings.totalMs = timingsNode.attribute("total").as_double();
+        }
+
+        if (auto fingerprintNode = pluginNode.child("Fingerprint")) {
+            info.fingerprint.size = fingerprintNode.attribute("size").as_ullong();
+            info.fingerprint.modifiedTime = fingerprintNode.attribute("modified").as_llong();
+            info.fingerprint.contentHash = fingerprintNode.attribute("hash").as_ullong();
+        }
+
+        if (auto costsNode = pluginNode.child("Costs")) {
+            for (auto costNode : costsNode.children("Cost")) {
+                plugindb::CostHint hint{};
+                hint.sampleRate = costNode.attribute("sampleRate").as_uint();
+                hint.blockSize = costNode.attribute("blockSize").as_uint();
+                hint.medianUs = costNode.attribute("median").as_float();
+                hint.p90Us = costNode.attribute("p90").as_float();
+                hint.p99Us = costNode.attribute("p99").as_float();
+                hint.maxUs = costNode.attribute("max").as_float();
+                info.costHints.push_back(hint);
+            }
+        }
+
         if (auto categoriesNode = pluginNode.child("Categories")) {
             for (auto categoryNode : categoriesNode.children("Category")) {
                 info.categories.push_back(categoryNode.text().get());
@@ -476,13 +1170,12 @@ bool PluginScanner::readXMLPreset(const std::string& filePath) {
         loadedPlugins.push_back(info);
     }
 
-    std::lock_guard<std::mutex> lock(pluginsMutex);
-    discoveredPlugins = std::move(loadedPlugins);
-
+    plugins = std::move(loadedPlugins);
     return true;
 }
 
 void PluginScanner::reportProgress(const std::string& message, float progress) {
+    std::lock_guard<std::mutex> lock(progressMutex);
     if (progressCallback) {
         progressCallback(message, progress);
     }
@@ -522,7 +1215,56 @@ PluginFormat PluginScanner::stringToFormat(const std::string& formatStr) {
     return PluginFormat::UNKNOWN;
 }
 
-const std::vector<PluginInfo>& PluginScanner::getPlugins() const {
+PluginFormat PluginScanner::detectFormat(const std::filesystem::path& path) {
+    auto extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+    if (extension == ".vst3") return PluginFormat::VST3;
+    if (extension == ".clap") return PluginFormat::CLAP;
+    if (extension == ".dll" || extension == ".so" || extension == ".vst") return PluginFormat::VST2;
+    return PluginFormat::UNKNOWN;
+}
+
+bool FileFingerprint::matches(const FileFingerprint& other) const {
+    if (size != other.size || modifiedTime != other.modifiedTime) return false;
+    return contentHash == 0 || other.contentHash == 0 || contentHash == other.contentHash;
+}
+
+FileFingerprint PluginScanner::fingerprintFile(const std::filesystem::path& pluginPath, bool withContentHash) {
+    FileFingerprint fingerprint;
+    std::error_code ec;
+
+    // A bundle changes when its executable does
+    auto path = BinaryInspector::resolveBinary(pluginPath);
+
+    fingerprint.size = std::filesystem::file_size(path, ec);
+    if (ec) fingerprint.size = 0;
+
+    auto modified = std::filesystem::last_write_time(path, ec);
+    if (!ec) {
+        fingerprint.modifiedTime = static_cast<long long>(modified.time_since_epoch().count());
+    }
+
+    if (withContentHash) {
+        // FNV-1a, 64-bit
+        uint64_t hash = 14695981039346656037ull;
+        std::ifstream file(path, std::ios::binary);
+        std::vector<char> buffer(1 << 16);
+        while (file) {
+            file.read(buffer.data(), buffer.size());
+            for (std::streamsize i = 0; i < file.gcount(); i++) {
+                hash ^= static_cast<unsigned char>(buffer[i]);
+                hash *= 1099511628211ull;
+            }
+        }
+        fingerprint.contentHash = hash;
+    }
+
+    return fingerprint;
+}
+
+std::vector<PluginInfo> PluginScanner::getPlugins() const {
     std::lock_guard<std::mutex> lock(pluginsMutex);
     return discoveredPlugins;
 }
@@ -3,6 +3,9 @@
 #include <juce_audio_processors/juce_audio_processors.h>
 #include <juce_core/juce_core.h>
 #include <clap/clap.h>
+#include "PluginDirectoryWalker.hpp"
+#include "BinaryInspector.hpp"
+#include "PluginDatabase.hpp"
 #include <string>
 #include <vector>
 #include <filesystem>
@@ -11,17 +14,12 @@
 #include <functional>
 #include <mutex>
 #include <ostream>
+#include <unordered_map>
+#include <cstdint>
+#include <chrono>
 
 namespace futureboard {
 
-enum class ProcessorArchitecture {
-    X86_64,
-    X86,
-    ARM64,
-    ARM32,
-    UNKNOWN
-};
-
 enum class PluginFormat {
     VST2,
     VST3,
@@ -32,6 +30,38 @@ enum class PluginFormat {
 // Forward declare operator<< for PluginFormat
 std::ostream& operator<<(std::ostream& os, const PluginFormat& format);
 
+// Identifies a plugin binary as it was when scanned. contentHash is 0 when
+// hashing was disabled and is then ignored by the comparison.
+struct FileFingerprint {
+    uintmax_t size = 0;
+    long long modifiedTime = 0;
+    uint64_t contentHash = 0;
+
+    bool matches(const FileFingerprint& other) const;
+};
+
+// Milliseconds spent in each phase of scanning one plugin file. Phases that
+// didn't happen (cached results, moduleinfo.json, failed loads) stay 0.
+struct ScanTimings {
+    double loadMs = 0.0;         // LoadLibrary/dlopen
+    double entryMs = 0.0;        // VSTPluginMain, clap_entry init and get_factory
+    double instantiateMs = 0.0;  // Opening the plugin and reading its description
+    double unloadMs = 0.0;       // Closing the plugin, deinit and unloading the library
+    double totalMs = 0.0;        // Wall time for the file, including the scanner process
+
+    static double elapsedMs(std::chrono::steady_clock::time_point since) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+    }
+};
+
+// Why a scanner process produced no result for a plugin. Only set for
+// out-of-process scans; these are what PluginQuarantine records.
+enum class ScanFailure {
+    None,
+    Crashed,
+    TimedOut
+};
+
 struct PluginInfo {
     std::string name;
     std::string version;
@@ -45,10 +75,12 @@ struct PluginInfo {
     bool isSynth = false;
     bool isEffect = false;
     std::string error;
+    ScanFailure failure = ScanFailure::None;
+    FileFingerprint fingerprint;
+    ScanTimings timings;
+    // From vstscanner --bench, kept until the binary changes
+    std::vector<plugindb::CostHint> costHints;
 
-    // JUCE specific
-    juce::String formatName;
-    juce::String manufacturerName;
     int numInputChannels = 0;
     int numOutputChannels = 0;
     bool acceptsMidi = false;
@@ -59,9 +91,24 @@ struct PluginInfo {
     std::vector<std::string> features;
 };
 
+// What changed in the plugin list after a filesystem change. Every path in
+// added replaces whatever was known for that path before; removed lists
+// paths that no longer hold a plugin.
+struct PluginDelta {
+    std::vector<PluginInfo> added;
+    std::vector<std::string> removed;
+
+    bool empty() const { return added.empty() && removed.empty(); }
+};
+
+class PluginResultStream;
+class PluginQuarantine;
+
 class PluginScanner {
 public:
     using ProgressCallback = std::function<void(const std::string&, float)>;
+    using ResultCallback = std::function<void(const PluginInfo&)>;
+    using DeltaCallback = std::function<void(const PluginDelta&)>;
 
     PluginScanner();
     ~PluginScanner();
@@ -69,13 +116,71 @@ public:
     void scanPlugins(const ProgressCallback& progress = nullptr);
     void stopScanning();
 
+    // Watches the search paths after a scan and rescans only the plugins
+    // touched by filesystem changes, once they've been quiet for debounceMs.
+    // The cache file and result stream are updated after each batch (the
+    // stream gets "removed" and "delta" events). Blocks until stopScanning().
+    void watchForChanges(const DeltaCallback& onDelta, int debounceMs = 2000);
+    // Rescans the plugins at or under the given paths and updates the results
+    PluginDelta rescanChangedPaths(const std::vector<std::filesystem::path>& changedPaths);
+
     void addSearchPath(const std::string& path);
     void clearSearchPaths();
     void setFormatsToScan(bool scanVST2, bool scanVST3, bool scanCLAP);
 
+    // Out-of-process scanning: each plugin is loaded by a separate
+    // `workerExecutable --worker <plugin> <result>` process so a crash or
+    // hang only fails that plugin. An empty path scans in-process.
+    void setWorkerExecutable(const std::filesystem::path& executable);
+    void setWorkerCount(int count);
+    void setPluginTimeout(int timeoutMs);
+
+    // Incremental rescans: results of the previous scan are kept in cacheFile
+    // (a plugin database) and reused for binaries whose fingerprint is unchanged.
+    void setCacheFile(const std::filesystem::path& cacheFile);
+    void setContentHashing(bool enabled);
+    // Loads every plugin again instead of reusing cached results. Cost hints
+    // from vstscanner --bench are still carried over for binaries whose
+    // fingerprint is unchanged, since a scan doesn't measure them.
+    void setFullRescan(bool enabled);
+
+    // Plugins that crashed or timed out in a scanner process are quarantined
+    // in a store next to the cache file (see PluginQuarantine) and skipped by
+    // later scans until their binary changes, or on every scan after
+    // setRetryQuarantined(true). Requires a cache file.
+    void setRetryQuarantined(bool enabled);
+
+    // Results as they come in, rather than at the end of the scan: written
+    // as NDJSON to streamFile (see PluginResultStream) and/or passed to the
+    // callback, which is called one result at a time from the scan threads.
+    // Cached results are included, so the stream ends up with every plugin.
+    void setResultStream(const std::filesystem::path& streamFile);
+    void setResultCallback(const ResultCallback& callback);
+
+    // VST2 plugins are described through the VST 2.4 ABI directly (see
+    // Vst2Probe) unless this is turned off, in which case JUCE loads them
+    void setNativeVst2Probe(bool enabled);
+
+    // Plugin files and bundles under the search paths, without scanning them
+    std::vector<std::filesystem::path> findPluginFiles();
+
+    // Loads and validates a single plugin file in this process
+    std::vector<PluginInfo> scanPluginFile(const std::filesystem::path& path);
+
+    static bool writePluginList(const std::string& filePath, const std::vector<PluginInfo>& plugins);
+    static bool readPluginList(const std::string& filePath, std::vector<PluginInfo>& plugins);
+    static bool writeDatabase(const std::string& filePath, const std::vector<PluginInfo>& plugins);
+    static bool readDatabase(const std::string& filePath, std::vector<PluginInfo>& plugins);
+
+    // Binary .ftbdb plugin database, see PluginDatabase.hpp
+    bool saveDatabase(const std::string& filePath);
+    bool loadDatabase(const std::string& filePath);
+
+    // XML .ftbpreset import/export
     bool saveToPreset(const std::string& filePath);
     bool loadFromPreset(const std::string& filePath);
-    const std::vector<PluginInfo>& getPlugins() const;
+    // Snapshot of the results so far; safe to call while scanning
+    std::vector<PluginInfo> getPlugins() const;
 
     bool isScanning() const;
     size_t getTotalPluginsFound() const;
@@ -85,15 +190,28 @@ public:
     static ProcessorArchitecture stringToArchitecture(const std::string& archStr);
     static std::string formatToString(PluginFormat format);
     static PluginFormat stringToFormat(const std::string& formatStr);
+    // From the file or bundle extension, UNKNOWN if it isn't a plugin extension
+    static PluginFormat detectFormat(const std::filesystem::path& path);
+    static FileFingerprint fingerprintFile(const std::filesystem::path& path, bool withContentHash);
 
 private:
-    void scanDirectory(const std::filesystem::path& path);
-    bool isPluginFile(const std::filesystem::path& path);
-    void scanAndValidatePlugin(const std::filesystem::path& path);
+    std::vector<std::filesystem::path> findPluginFiles(const std::vector<std::filesystem::path>& roots);
+    PluginDirectoryWalker::Action classifyEntry(const std::filesystem::directory_entry& entry);
+    bool isFormatEnabled(PluginFormat format) const;
+    void scanInProcess(const std::vector<std::filesystem::path>& candidates);
+    void scanOutOfProcess(const std::vector<std::filesystem::path>& candidates);
+    void addScanResults(const std::filesystem::path& path, std::vector<PluginInfo>&& results);
+    std::vector<std::filesystem::path> reuseCachedResults(const std::vector<std::filesystem::path>& candidates);
+    std::vector<std::filesystem::path> skipQuarantined(const std::vector<std::filesystem::path>& candidates);
+    std::vector<std::filesystem::path> skipUnloadable(const std::vector<std::filesystem::path>& candidates);
+    std::vector<std::filesystem::path> describeFromModuleInfo(const std::vector<std::filesystem::path>& candidates);
+    static bool checkArchitecture(const BinaryInfo& binary, PluginInfo& info);
 
     bool validatePlugin(const std::filesystem::path& path, PluginInfo& info);
     bool validateWithJuce(const std::filesystem::path& path, PluginInfo& info);
-    bool validateCLAPPlugin(const std::filesystem::path& path, PluginInfo& info);
+    // Appends one PluginInfo per descriptor in the factory, based on fileInfo
+    static bool scanCLAPFactory(const std::filesystem::path& path, const PluginInfo& fileInfo,
+                                std::vector<PluginInfo>& plugins, std::string& error);
 
     bool writeXMLPreset(const std::string& filePath);
     bool readXMLPreset(const std::string& filePath);
@@ -102,14 +220,13 @@ private:
     std::vector<std::filesystem::path> getDefaultPluginPaths();
     void initializeJuceFormats();
 
-    static const clap_plugin_factory* getCLAPFactory(void* library, const std::string& path);
-
 private:
     std::vector<std::filesystem::path> searchPaths;
     std::vector<PluginInfo> discoveredPlugins;
     std::atomic<bool> scanning;
     std::atomic<bool> stopRequested;
     ProgressCallback progressCallback;
+    std::mutex progressMutex;
     mutable std::mutex pluginsMutex;
 
     std::unique_ptr<juce::AudioPluginFormatManager> formatManager;
@@ -117,6 +234,32 @@ private:
     bool enableVST2;
     bool enableVST3;
     bool enableCLAP;
+
+    std::filesystem::path workerExecutable;
+    int workerCount;
+    int pluginTimeoutMs;
+
+    std::filesystem::path cacheFile;
+    bool contentHashing;
+    bool fullRescan;
+    // Cached results of unchanged binaries rescanned anyway, keyed by path,
+    // for their cost hints. Only written before scanning starts.
+    std::unordered_map<std::string, std::vector<PluginInfo>> keptResults;
+    bool nativeVst2Probe;
+
+    std::filesystem::path quarantineFile;
+    std::unique_ptr<PluginQuarantine> quarantine;
+    bool retryQuarantined;
+
+    std::filesystem::path resultStreamFile;
+    ResultCallback resultCallback;
+    std::mutex resultMutex;
+    PluginResultStream* activeStream = nullptr;  // Only set during scanPlugins
+    std::unordered_map<std::string, FileFingerprint> candidateFingerprints;
+
+    // Header inspection results from the directory walk, keyed by path
+    std::unordered_map<std::string, BinaryInfo> candidateBinaries;
+    std::mutex candidateBinariesMutex;
 };
 
 } // namespace futureboard
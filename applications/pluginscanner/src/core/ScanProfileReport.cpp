@@ -0,0 +1,97 @@
+#include "ScanProfileReport.hpp"
+#include "PluginResultStream.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <unordered_map>
+
+namespace futureboard {
+
+namespace {
+
+std::string formatMs(double ms) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.3f", ms);
+    return buffer;
+}
+
+std::string timingsJson(const ScanTimings& timings) {
+    return "{\"load\":" + formatMs(timings.loadMs) +
+           ",\"entry\":" + formatMs(timings.entryMs) +
+           ",\"instantiate\":" + formatMs(timings.instantiateMs) +
+           ",\"unload\":" + formatMs(timings.unloadMs) +
+           ",\"total\":" + formatMs(timings.totalMs) + "}";
+}
+
+std::string fileJson(const ScanProfileReport::FileEntry& entry) {
+    std::string out = "{\"path\":" + PluginResultStream::quote(entry.path) +
+                      ",\"format\":" + PluginResultStream::quote(entry.format) +
+                      ",\"plugins\":[";
+    for (size_t i = 0; i < entry.plugins.size(); i++) {
+        if (i > 0) out += ',';
+        out += PluginResultStream::quote(entry.plugins[i]);
+    }
+    out += "]";
+    if (!entry.error.empty()) out += ",\"error\":" + PluginResultStream::quote(entry.error);
+    out += ",\"timings\":" + timingsJson(entry.timings) + "}";
+    return out;
+}
+
+void writeArray(std::ofstream& file, const std::vector<ScanProfileReport::FileEntry>& files, size_t count) {
+    file << "[";
+    for (size_t i = 0; i < count; i++) {
+        file << (i > 0 ? ",\n    " : "\n    ") << fileJson(files[i]);
+    }
+    file << (count > 0 ? "\n  ]" : "]");
+}
+
+} // namespace
+
+ScanProfileReport::ScanProfileReport(const std::vector<PluginInfo>& plugins) {
+    std::unordered_map<std::string, size_t> byPath;
+
+    for (const auto& plugin : plugins) {
+        if (plugin.timings.totalMs <= 0.0) continue;
+
+        auto [it, inserted] = byPath.emplace(plugin.path, files.size());
+        if (inserted) {
+            FileEntry entry;
+            entry.path = plugin.path;
+            entry.format = PluginScanner::formatToString(plugin.format);
+            entry.error = plugin.error;
+            // Every plugin of a file carries the same timings, count them once
+            entry.timings = plugin.timings;
+            files.push_back(std::move(entry));
+        }
+        files[it->second].plugins.push_back(plugin.name);
+    }
+
+    for (const auto& entry : files) {
+        totals.loadMs += entry.timings.loadMs;
+        totals.entryMs += entry.timings.entryMs;
+        totals.instantiateMs += entry.timings.instantiateMs;
+        totals.unloadMs += entry.timings.unloadMs;
+        totals.totalMs += entry.timings.totalMs;
+    }
+
+    std::stable_sort(files.begin(), files.end(), [](const FileEntry& a, const FileEntry& b) {
+        return a.timings.totalMs > b.timings.totalMs;
+    });
+}
+
+bool ScanProfileReport::write(const std::filesystem::path& filePath, size_t slowestCount) const {
+    std::ofstream file(filePath, std::ios::out | std::ios::trunc | std::ios::binary);
+    if (!file.is_open()) return false;
+
+    file << "{\n  \"fileCount\": " << files.size()
+         << ",\n  \"totals\": " << timingsJson(totals)
+         << ",\n  \"slowest\": ";
+    writeArray(file, files, std::min(slowestCount, files.size()));
+    file << ",\n  \"files\": ";
+    writeArray(file, files, files.size());
+    file << "\n}\n";
+
+    return file.good();
+}
+
+} // namespace futureboard
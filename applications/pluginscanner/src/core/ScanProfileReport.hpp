@@ -0,0 +1,38 @@
+#pragma once
+
+#include "PluginScanner.hpp"
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace futureboard {
+
+// Per-file scan timings, aggregated from the plugins a scan returned. Plugins
+// sharing a file (CLAP, VST2 shells) share one entry. Files that were served
+// from the cache or described from moduleinfo.json were never loaded and are
+// left out.
+class ScanProfileReport {
+public:
+    struct FileEntry {
+        std::string path;
+        std::string format;
+        std::vector<std::string> plugins;
+        std::string error;
+        ScanTimings timings;
+    };
+
+    explicit ScanProfileReport(const std::vector<PluginInfo>& plugins);
+
+    // Slowest first
+    const std::vector<FileEntry>& getFiles() const { return files; }
+    const ScanTimings& getTotals() const { return totals; }
+
+    // {"totals":{...},"slowest":[...],"files":[...]}
+    bool write(const std::filesystem::path& filePath, size_t slowestCount = 20) const;
+
+private:
+    std::vector<FileEntry> files;
+    ScanTimings totals;
+};
+
+} // namespace futureboard
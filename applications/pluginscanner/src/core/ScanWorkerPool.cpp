@@ -0,0 +1,138 @@
+#include "ScanWorkerPool.hpp"
+#include <juce_core/juce_core.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#ifdef _WIN32
+    #include <process.h>
+    #define getpid _getpid
+#else
+    #include <unistd.h>
+#endif
+
+namespace futureboard {
+
+ScanWorkerPool::ScanWorkerPool(const std::filesystem::path& workerExecutable, int numWorkers, int timeoutMs)
+    : workerExecutable(workerExecutable)
+    , numWorkers(std::max(1, numWorkers))
+    , timeoutMs(std::max(1, timeoutMs))
+{
+}
+
+void ScanWorkerPool::setExtraArguments(const std::vector<std::string>& arguments) {
+    extraArguments = arguments;
+}
+
+void ScanWorkerPool::run(const std::vector<std::filesystem::path>& candidates,
+                         const std::atomic<bool>& stopRequested,
+                         const ResultCallback& onResult) {
+    std::atomic<size_t> nextIndex{0};
+
+    auto workerLoop = [&]() {
+        while (!stopRequested) {
+            size_t index = nextIndex++;
+            if (index >= candidates.size()) return;
+
+            const auto& pluginPath = candidates[index];
+            auto results = scanInWorker(pluginPath, stopRequested);
+            if (onResult) {
+                onResult(pluginPath, std::move(results));
+            }
+        }
+    };
+
+    size_t threadCount = std::min(static_cast<size_t>(numWorkers), candidates.size());
+    std::vector<std::thread> threads;
+    threads.reserve(threadCount);
+    for (size_t i = 0; i < threadCount; i++) {
+        threads.emplace_back(workerLoop);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+std::vector<PluginInfo> ScanWorkerPool::scanInWorker(const std::filesystem::path& pluginPath,
+                                                     const std::atomic<bool>& stopRequested) {
+    auto resultPath = makeResultPath();
+    std::error_code ec;
+    std::filesystem::remove(resultPath, ec);
+
+    juce::StringArray args;
+    args.add(juce::String(workerExecutable.string()));
+    args.add(workerArgument);
+    args.add(juce::String(pluginPath.string()));
+    args.add(juce::String(resultPath.string()));
+    for (const auto& argument : extraArguments) {
+        args.add(juce::String(argument));
+    }
+
+    auto started = std::chrono::steady_clock::now();
+
+    // No stream flags: the child's stdout/stderr go nowhere, so chatty
+    // plugins can't fill a pipe and stall the worker.
+    juce::ChildProcess child;
+    if (!child.start(args, 0)) {
+        return { makeFailedInfo(pluginPath, "Failed to start scanner process") };
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    bool timedOut = false;
+
+    while (child.isRunning()) {
+        if (stopRequested || std::chrono::steady_clock::now() >= deadline) {
+            timedOut = !stopRequested;
+            child.kill();
+            break;
+        }
+        child.waitForProcessToFinish(50);
+    }
+
+    std::vector<PluginInfo> results;
+    bool haveResults = !timedOut && PluginScanner::readPluginList(resultPath.string(), results);
+    std::filesystem::remove(resultPath, ec);
+
+    if (timedOut) {
+        results = { makeFailedInfo(pluginPath,
+            "Scan timed out after " + std::to_string(timeoutMs) + " ms") };
+        results.front().failure = ScanFailure::TimedOut;
+    } else if (!haveResults && stopRequested) {
+        // Killed by us, says nothing about the plugin
+        results = { makeFailedInfo(pluginPath, "Scan stopped") };
+    } else if (!haveResults) {
+        std::string error = "Scanner process crashed";
+        auto exitCode = child.getExitCode();
+        if (exitCode != 0) {
+            error += " (exit code " + std::to_string(exitCode) + ")";
+        }
+        results = { makeFailedInfo(pluginPath, error) };
+        results.front().failure = ScanFailure::Crashed;
+    }
+
+    // The worker measured the phases; the total includes starting the process
+    double totalMs = ScanTimings::elapsedMs(started);
+    for (auto& info : results) info.timings.totalMs = totalMs;
+    return results;
+}
+
+std::filesystem::path ScanWorkerPool::makeResultPath() {
+    auto name = "vstscanner_" + std::to_string(getpid()) + "_" +
+                std::to_string(resultCounter++) + ".xml";
+    return std::filesystem::temp_directory_path() / name;
+}
+
+PluginInfo ScanWorkerPool::makeFailedInfo(const std::filesystem::path& pluginPath, const std::string& error) {
+    PluginInfo info;
+    info.path = pluginPath.string();
+    info.name = pluginPath.stem().string();
+    info.version = "Unknown";
+    info.vendor = "Unknown";
+    info.arch = BinaryInspector::inspect(pluginPath).architectureFor(BinaryInspector::hostArchitecture());
+    info.format = PluginScanner::detectFormat(pluginPath);
+    info.isValid = false;
+    info.error = error;
+    return info;
+}
+
+} // namespace futureboard
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "PluginScanner.hpp"
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace futureboard {
+
+// Runs plugin validation in short-lived child processes, several at a time.
+// Each plugin gets its own `vstscanner --worker <plugin> <result>` process;
+// a crash or a hang past the timeout only marks that plugin as failed.
+class ScanWorkerPool {
+public:
+    using ResultCallback = std::function<void(const std::filesystem::path&, std::vector<PluginInfo>&&)>;
+
+    ScanWorkerPool(const std::filesystem::path& workerExecutable, int numWorkers, int timeoutMs);
+
+    // Appended after the result path, for scanner options the worker must honour
+    void setExtraArguments(const std::vector<std::string>& arguments);
+
+    // Blocks until every candidate has been scanned or stopRequested is set.
+    // onResult is called from the worker threads.
+    void run(const std::vector<std::filesystem::path>& candidates,
+             const std::atomic<bool>& stopRequested,
+             const ResultCallback& onResult);
+
+    static constexpr const char* workerArgument = "--worker";
+
+private:
+    std::vector<PluginInfo> scanInWorker(const std::filesystem::path& pluginPath,
+                                         const std::atomic<bool>& stopRequested);
+    std::filesystem::path makeResultPath();
+    static PluginInfo makeFailedInfo(const std::filesystem::path& pluginPath, const std::string& error);
+
+    std::filesystem::path workerExecutable;
+    int numWorkers;
+    int timeoutMs;
+    std::vector<std::string> extraArguments;
+    std::atomic<unsigned> resultCounter{0};
+};
+
+} // namespace futureboard
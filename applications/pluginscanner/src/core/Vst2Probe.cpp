@@ -0,0 +1,149 @@
+#include "Vst2Probe.hpp"
+#include "BinaryInspector.hpp"
+#include "DynamicLibrary.hpp"
+#include <pluginterfaces/vst2.x/aeffectx.h>
+#include <chrono>
+#include <cstring>
+
+namespace futureboard {
+
+namespace {
+
+using PluginEntryProc = AEffect* (VSTCALLBACK *)(audioMasterCallback host);
+
+VstIntPtr VSTCALLBACK hostCallback(AEffect*, VstInt32 opcode, VstInt32, VstIntPtr, void*, float) {
+    // Enough of a host for plugins to open; everything else is "not supported"
+    switch (opcode) {
+        case audioMasterVersion: return 2400;
+        default: return 0;
+    }
+}
+
+VstIntPtr dispatch(AEffect* effect, VstInt32 opcode, VstInt32 index = 0, VstIntPtr value = 0, void* ptr = nullptr) {
+    return effect->dispatcher(effect, opcode, index, value, ptr, 0.0f);
+}
+
+std::string getString(AEffect* effect, VstInt32 opcode) {
+    // Plugins routinely write past kVstMax*Len, hence the headroom
+    char buffer[256] = {};
+    dispatch(effect, opcode, 0, 0, buffer);
+    buffer[sizeof(buffer) - 1] = '\0';
+    return buffer;
+}
+
+bool canDo(AEffect* effect, const char* what) {
+    return dispatch(effect, effCanDo, 0, 0, const_cast<char*>(what)) > 0;
+}
+
+// Same names JUCE reports, so both paths produce the same catalogue entries
+std::string categoryName(VstIntPtr category) {
+    switch (category) {
+        case kPlugCategEffect: return "Effect";
+        case kPlugCategSynth: return "Synth";
+        case kPlugCategAnalysis: return "Analysis";
+        case kPlugCategMastering: return "Mastering";
+        case kPlugCategSpacializer: return "Spacial";
+        case kPlugCategRoomFx: return "Reverb";
+        case kPlugSurroundFx: return "Surround";
+        case kPlugCategRestoration: return "Restoration";
+        case kPlugCategGenerator: return "Tone generation";
+        case kPlugCategOfflineProcess: return "Offline";
+        default: return {};
+    }
+}
+
+// Mirrors JUCE's VST2 version formatting: decimal digits, or bytes when the
+// number is too long to be a decimal version
+std::string formatVersion(unsigned int version) {
+    if (version == 0) return {};
+
+    int parts[32];
+    int count = 0;
+    for (auto v = version; v != 0; v /= 10) parts[count++] = static_cast<int>(v % 10);
+
+    if (count > 4) {
+        count = 0;
+        for (auto v = version; v != 0; v >>= 8) parts[count++] = static_cast<int>(v & 255);
+    }
+
+    while (count > 1 && parts[count - 1] == 0) --count;
+
+    std::string text = "V";
+    while (count > 0) {
+        text += std::to_string(parts[--count]);
+        if (count > 0) text += '.';
+    }
+    return text;
+}
+
+} // namespace
+
+Vst2Probe::Result Vst2Probe::probe(const std::filesystem::path& path, PluginInfo& info) {
+    using Clock = std::chrono::steady_clock;
+
+    DynamicLibrary library;
+    auto start = Clock::now();
+    if (!library.open(BinaryInspector::resolveBinary(path))) {
+        info.error = library.getError();
+        return Result::Failed;
+    }
+    info.timings.loadMs = ScanTimings::elapsedMs(start);
+
+    auto entry = reinterpret_cast<PluginEntryProc>(library.getSymbol("VSTPluginMain"));
+    if (!entry) entry = reinterpret_cast<PluginEntryProc>(library.getSymbol("main_macho"));
+    if (!entry) entry = reinterpret_cast<PluginEntryProc>(library.getSymbol("main"));
+    if (!entry) {
+        info.error = "No VST2 entry point found";
+        return Result::Failed;
+    }
+
+    start = Clock::now();
+    AEffect* effect = entry(hostCallback);
+    info.timings.entryMs = ScanTimings::elapsedMs(start);
+    if (!effect || effect->magic != kEffectMagic || !effect->dispatcher) {
+        info.error = "Plugin returned no valid AEffect";
+        return Result::Failed;
+    }
+
+    start = Clock::now();
+    dispatch(effect, effOpen);
+
+    VstIntPtr category = dispatch(effect, effGetPlugCategory);
+    if (category == kPlugCategShell) {
+        dispatch(effect, effClose);
+        return Result::Unsupported;
+    }
+
+    info.name = getString(effect, effGetEffectName);
+    if (info.name.empty()) info.name = getString(effect, effGetProductString);
+    if (info.name.empty()) info.name = path.stem().string();
+
+    info.vendor = getString(effect, effGetVendorString);
+
+    auto version = static_cast<unsigned int>(dispatch(effect, effGetVendorVersion));
+    if (version == 0 || static_cast<int>(version) == -1) version = static_cast<unsigned int>(effect->version);
+    info.version = formatVersion(version);
+
+    info.uniqueId = std::to_string(effect->uniqueID);
+    info.numInputChannels = effect->numInputs;
+    info.numOutputChannels = effect->numOutputs;
+    info.isSynth = (effect->flags & effFlagsIsSynth) != 0;
+    info.isEffect = !info.isSynth;
+    info.acceptsMidi = info.isSynth || canDo(effect, "receiveVstEvents") || canDo(effect, "receiveVstMidiEvent");
+    info.producesMidi = canDo(effect, "sendVstEvents") || canDo(effect, "sendVstMidiEvent");
+
+    auto categoryText = categoryName(category);
+    if (!categoryText.empty()) info.categories = { categoryText };
+
+    info.isValid = true;
+    info.timings.instantiateMs = ScanTimings::elapsedMs(start);
+
+    // effClose deletes the effect; the library is unloaded after it
+    start = Clock::now();
+    dispatch(effect, effClose);
+    library.close();
+    info.timings.unloadMs = ScanTimings::elapsedMs(start);
+    return Result::Ok;
+}
+
+} // namespace futureboard
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "PluginScanner.hpp"
+#include <filesystem>
+
+namespace futureboard {
+
+// Reads a VST2 plugin's description straight through the VST 2.4 ABI
+// (SDKs/VST24): calls the entry point, opens the effect, asks for its name,
+// vendor, version, category and MIDI capabilities, and closes it again.
+// Much cheaper than a JUCE AudioPluginInstance, which also sets up buses,
+// parameters and programs that the scanner never looks at.
+class Vst2Probe {
+public:
+    enum class Result {
+        Ok,
+        Failed,       // info.error says why
+        Unsupported   // Shell plugins; use the JUCE path, which enumerates them
+    };
+
+    static Result probe(const std::filesystem::path& path, PluginInfo& info);
+};
+
+} // namespace futureboard
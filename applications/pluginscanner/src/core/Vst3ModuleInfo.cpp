@@ -0,0 +1,103 @@
+#include "Vst3ModuleInfo.hpp"
+#include <juce_core/juce_core.h>
+#include <cstdint>
+
+namespace futureboard {
+
+namespace {
+
+// kVstAudioEffectClass in the VST3 SDK
+constexpr const char* audioModuleClass = "Audio Module Class";
+
+std::string toStdString(const juce::var& value) {
+    return value.toString().toStdString();
+}
+
+} // namespace
+
+std::filesystem::path Vst3ModuleInfo::find(const std::filesystem::path& bundle) {
+    std::error_code ec;
+    if (!std::filesystem::is_directory(bundle, ec)) return {};
+
+    // SDK 3.7.5 put it directly in Contents, later versions in Resources
+    for (const auto& candidate : { bundle / "Contents" / "Resources" / "moduleinfo.json",
+                                   bundle / "Contents" / "moduleinfo.json" }) {
+        if (std::filesystem::is_regular_file(candidate, ec)) return candidate;
+    }
+    return {};
+}
+
+bool Vst3ModuleInfo::read(const std::filesystem::path& bundle, std::vector<PluginInfo>& plugins) {
+    auto moduleInfoPath = find(bundle);
+    if (moduleInfoPath.empty()) return false;
+
+    juce::var moduleInfo;
+    auto text = juce::File(juce::String(moduleInfoPath.string())).loadFileAsString();
+    if (!juce::JSON::parse(text, moduleInfo).wasOk() || !moduleInfo.isObject()) return false;
+
+    const juce::var& classes = moduleInfo["Classes"];
+    if (!classes.isArray()) return false;
+
+    std::string factoryVendor = toStdString(moduleInfo["Factory Info"]["Vendor"]);
+    std::string moduleVersion = toStdString(moduleInfo["Version"]);
+
+    std::vector<PluginInfo> found;
+    for (const auto& pluginClass : *classes.getArray()) {
+        if (pluginClass["Category"].toString() != juce::String(audioModuleClass)) continue;
+
+        PluginInfo info;
+        info.path = bundle.string();
+        info.format = PluginFormat::VST3;
+        info.arch = BinaryInspector::hostArchitecture();
+        info.name = toStdString(pluginClass["Name"]);
+        info.vendor = toStdString(pluginClass["Vendor"]);
+        info.version = toStdString(pluginClass["Version"]);
+        info.uniqueId = std::to_string(uniqueIdFromCid(toStdString(pluginClass["CID"])));
+
+        if (info.vendor.empty()) info.vendor = factoryVendor;
+        if (info.version.empty()) info.version = moduleVersion;
+
+        // Joined with '|' like the category JUCE reports for VST3
+        std::string category;
+        const juce::var& subCategories = pluginClass["Sub Categories"];
+        if (subCategories.isArray()) {
+            for (const auto& subCategory : *subCategories.getArray()) {
+                auto name = toStdString(subCategory);
+                if (name == "Instrument") info.isSynth = true;
+                if (!category.empty()) category += '|';
+                category += name;
+            }
+        }
+        if (!category.empty()) info.categories = { category };
+
+        info.isEffect = !info.isSynth;
+        info.acceptsMidi = info.isSynth;
+        info.isValid = !info.name.empty();
+        if (info.isValid) found.push_back(std::move(info));
+    }
+
+    if (found.empty()) return false;
+
+    plugins.insert(plugins.end(), std::make_move_iterator(found.begin()), std::make_move_iterator(found.end()));
+    return true;
+}
+
+int Vst3ModuleInfo::uniqueIdFromCid(const std::string& cid) {
+    // The CID string is the FUID's four 32-bit words in hex, which is what
+    // JUCE hashes after normalising the TUID byte order
+    if (cid.size() != 32) return 0;
+
+    uint32_t value = 0;
+    for (size_t word = 0; word < 4; word++) {
+        uint32_t part = 0;
+        try {
+            part = static_cast<uint32_t>(std::stoul(cid.substr(word * 8, 8), nullptr, 16));
+        } catch (const std::exception&) {
+            return 0;
+        }
+        value = value * 31 + part;
+    }
+    return static_cast<int>(value);
+}
+
+} // namespace futureboard
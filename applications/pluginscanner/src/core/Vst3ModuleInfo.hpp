@@ -0,0 +1,29 @@
+#pragma once
+
+#include "PluginScanner.hpp"
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace futureboard {
+
+// VST3 bundles built with SDK 3.7.5 or later carry a moduleinfo.json that
+// lists every class with its name, vendor, version and subcategories. This
+// reads it so the scanner can describe such bundles without loading them.
+// Channel counts aren't part of it and are left at 0.
+class Vst3ModuleInfo {
+public:
+    // Empty if the bundle has none
+    static std::filesystem::path find(const std::filesystem::path& bundle);
+
+    // Appends one PluginInfo per audio processor class. Returns false when
+    // there is no moduleinfo.json, it doesn't parse, or it lists no audio
+    // classes; the bundle then has to be loaded.
+    static bool read(const std::filesystem::path& bundle, std::vector<PluginInfo>& plugins);
+
+    // Same id JUCE reports as PluginDescription::uniqueId, so both paths
+    // agree on a plugin's identity
+    static int uniqueIdFromCid(const std::string& cid);
+};
+
+} // namespace futureboard
@@ -1,33 +1,93 @@
 #include "PluginScanner.hpp"
+#include "ScanWorkerPool.hpp"
+#include "ScanProfileReport.hpp"
+#include "PluginBenchmark.hpp"
 #include <juce_core/juce_core.h>
 #include <juce_audio_processors/juce_audio_processors.h>
-#include <windows.h>
 #include <iostream>
 #include <string>
 #include <ctime>
 #include <iomanip>
 #include <sstream>
+#include <cstdlib>
+#include <chrono>
+#include <algorithm>
+#include <filesystem>
+#include <atomic>
+#include <csignal>
+#include <thread>
+#include <mutex>
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <unistd.h>
+#endif
 
 void printUsage() {
     std::cout << "VST Scanner Usage:\n"
-              << "vstscanner -s [-o output_path]\n"
+              << "vstscanner -s [-o output_path] [-j workers] [-t timeout_ms] [-i] [-d database] [-f] [-r] [-H] [-x] [-J] [-n stream] [-p report] [-w]\n"
+              << "vstscanner --bench [-o output_path] [-d database] [-t timeout_ms] [-i] [-f]\n"
+              << "vstscanner -b folder\n"
               << "  -s           : Scan for plugins\n"
               << "  -o path      : Output directory (default: current directory)\n"
+              << "  -j workers   : Number of scanner processes (default: CPU count)\n"
+              << "  -t ms        : Per-plugin timeout in milliseconds (default: 30000)\n"
+              << "  -i           : Scan in-process (no crash isolation)\n"
+              << "  -d file      : Plugin database, also used as the scan cache (default: output_path/plugins.ftbdb)\n"
+              << "  -f           : Full rescan, ignore the scan cache (quarantined plugins stay skipped)\n"
+              << "  -r           : Retry plugins quarantined after crashing or timing out\n"
+              << "  -x           : Also export the results as an XML .ftbpreset\n"
+              << "  -H           : Also compare file content hashes when reusing cached results\n"
+              << "  -n file      : Stream results as NDJSON to file while scanning\n"
+              << "  -w           : Keep watching the plugin folders and rescan plugins as they change\n"
+              << "  -p file      : Write a JSON report of per-plugin load/entry/instantiate/unload times\n"
+              << "  -J           : Load VST2 plugins through JUCE instead of the native probe\n"
+              << "  -b folder    : Time the native VST2 probe against JUCE on the VST2 plugins in folder\n"
+              << "  --bench      : Measure the processing cost of the plugins in the database and store it there,\n"
+              << "                 after the scan when combined with -s; -f measures plugins again (default timeout: 300000)\n"
               << "Example: vstscanner -s -o C:\\Output\n";
 }
 
-void printProgress(const std::string& message) {
+enum class ConsoleColor {
+    Default,
+    Green,
+    Cyan,
+    Red
+};
+
+void setConsoleColor(ConsoleColor color) {
+#ifdef _WIN32
     static HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
-    CONSOLE_SCREEN_BUFFER_INFO csbi;
-    GetConsoleScreenBufferInfo(hConsole, &csbi);
+    switch (color) {
+        case ConsoleColor::Green: SetConsoleTextAttribute(hConsole, FOREGROUND_GREEN | FOREGROUND_INTENSITY); break;
+        case ConsoleColor::Cyan:
+            SetConsoleTextAttribute(hConsole, FOREGROUND_GREEN | FOREGROUND_BLUE | FOREGROUND_INTENSITY);
+            break;
+        case ConsoleColor::Red: SetConsoleTextAttribute(hConsole, FOREGROUND_RED | FOREGROUND_INTENSITY); break;
+        default: SetConsoleTextAttribute(hConsole, FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE); break;
+    }
+#else
+    // No escape codes when the output is a file or a pipe
+    static const bool isTerminal = isatty(STDOUT_FILENO) != 0;
+    if (!isTerminal) return;
 
-    // Clear line
-    SetConsoleCursorPosition(hConsole, { 0, csbi.dwCursorPosition.Y });
-    for (int i = 0; i < csbi.dwSize.X; i++) std::cout << " ";
-    SetConsoleCursorPosition(hConsole, { 0, csbi.dwCursorPosition.Y });
+    switch (color) {
+        case ConsoleColor::Green: std::cout << "\033[1;32m"; break;
+        case ConsoleColor::Cyan: std::cout << "\033[1;36m"; break;
+        case ConsoleColor::Red: std::cout << "\033[1;31m"; break;
+        default: std::cout << "\033[0m"; break;
+    }
+#endif
+}
 
-    // Print message
-    std::cout << message << std::flush;
+void printProgress(const std::string& message) {
+    // Overwrite the previous progress line, padding out anything longer
+    static size_t lastLength = 0;
+    std::cout << '\r' << message;
+    if (message.size() < lastLength) std::cout << std::string(lastLength - message.size(), ' ');
+    std::cout << std::flush;
+    lastLength = message.size();
 }
 
 std::string getCurrentTimestamp() {
@@ -38,6 +98,71 @@ std::string getCurrentTimestamp() {
     return ss.str();
 }
 
+volatile std::sig_atomic_t interrupted = 0;
+
+void onInterrupt(int) {
+    interrupted = 1;
+}
+
+void printDelta(const futureboard::PluginDelta& delta) {
+    std::cout << "\n";
+    for (const auto& path : delta.removed) {
+        setConsoleColor(ConsoleColor::Red);
+        std::cout << "- " << path << "\n";
+    }
+    for (const auto& plugin : delta.added) {
+        setConsoleColor(plugin.isValid ? ConsoleColor::Green : ConsoleColor::Red);
+        std::cout << "+ " << plugin.name << " (" << plugin.format << ") " << plugin.path;
+        if (!plugin.error.empty()) std::cout << ": " << plugin.error;
+        std::cout << "\n";
+    }
+    setConsoleColor(ConsoleColor::Default);
+}
+
+// Runs until Ctrl+C; the scanner stops between rescans
+void watchPlugins(futureboard::PluginScanner& scanner) {
+    std::signal(SIGINT, onInterrupt);
+
+    std::atomic<bool> finished{false};
+    std::thread watcher([&scanner, &finished]() {
+        scanner.watchForChanges(printDelta);
+        finished = true;
+    });
+
+    while (!interrupted) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    }
+    // Also covers an interrupt before the watch got going
+    while (!finished) {
+        scanner.stopScanning();
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    watcher.join();
+}
+
+void printProfile(const futureboard::ScanProfileReport& report, size_t count) {
+    const auto& files = report.getFiles();
+    const auto& totals = report.getTotals();
+
+    std::cout << "\nScan Profile (" << files.size() << " files loaded):\n";
+    std::cout << "-------------\n";
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "Load: " << totals.loadMs << " ms, entry: " << totals.entryMs
+              << " ms, instantiate: " << totals.instantiateMs << " ms, unload: " << totals.unloadMs
+              << " ms, total: " << totals.totalMs << " ms\n";
+
+    count = std::min(count, files.size());
+    if (count > 0) std::cout << "Slowest:\n";
+    for (size_t i = 0; i < count; i++) {
+        const auto& timings = files[i].timings;
+        std::cout << "  " << std::setw(9) << timings.totalMs << " ms  "
+                  << std::filesystem::path(files[i].path).filename().string()
+                  << " (load " << timings.loadMs << ", entry " << timings.entryMs
+                  << ", instantiate " << timings.instantiateMs << ", unload " << timings.unloadMs << ")\n";
+    }
+    std::cout << std::defaultfloat;
+}
+
 void printPluginInfo(const futureboard::PluginInfo& plugin) {
     std::cout << "Name: " << plugin.name << "\n";
     std::cout << "Format: " << plugin.format << "\n";
@@ -85,14 +210,235 @@ void printPluginInfo(const futureboard::PluginInfo& plugin) {
     std::cout << "-------------------\n";
 }
 
+// Child process entry used by ScanWorkerPool: scan one plugin, write the result list.
+// Trailing arguments are the scanner options of the parent (-J), and --bench
+// to measure the plugins' processing cost as well.
+int runWorker(const std::string& pluginPath, const std::string& resultPath, int argc, char* argv[]) {
+    futureboard::PluginScanner scanner;
+    bool benchmark = false;
+    for (int i = 0; i < argc; i++) {
+        if (std::string(argv[i]) == "-J") scanner.setNativeVst2Probe(false);
+        if (std::string(argv[i]) == futureboard::PluginBenchmark::workerArgument) benchmark = true;
+    }
+    auto results = scanner.scanPluginFile(pluginPath);
+
+    if (benchmark) {
+        futureboard::PluginBenchmark bench;
+        for (auto& info : results) {
+            std::string error;
+            if (info.isValid && !bench.run(info, error)) info.error = error;
+        }
+    }
+    return futureboard::PluginScanner::writePluginList(resultPath, results) ? 0 : 1;
+}
+
+// Median cost of a 256-frame block at 48 kHz as a share of its real-time budget
+std::string formatLoad(const futureboard::PluginInfo& plugin) {
+    float us = futureboard::plugindb::estimateCostUs(plugin.costHints.data(),
+                                                     static_cast<uint32_t>(plugin.costHints.size()), 48000.0, 256);
+    if (us < 0.0f) return "-";
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(1) << us << " us (" << std::setprecision(2)
+       << 100.0 * us / (1e6 * 256 / 48000.0) << "%)";
+    return ss.str();
+}
+
+// Benchmarks the valid plugins in the database that have no cost hints yet,
+// or all of them with remeasure, and writes the hints back. Plugins run one
+// at a time so they don't compete for the CPU, each file in its own scanner
+// process unless inProcess.
+int runPluginBenchmark(const std::string& databasePath, bool inProcess, int timeoutMs, bool remeasure) {
+    std::vector<futureboard::PluginInfo> plugins;
+    if (!futureboard::PluginScanner::readDatabase(databasePath, plugins)) {
+        setConsoleColor(ConsoleColor::Red);
+        std::cerr << "Cannot read plugin database " << databasePath << ", run a scan (-s) first\n";
+        setConsoleColor(ConsoleColor::Default);
+        return 1;
+    }
+
+    std::vector<std::filesystem::path> files;
+    for (const auto& plugin : plugins) {
+        if (!plugin.isValid || (!remeasure && !plugin.costHints.empty())) continue;
+        std::filesystem::path path(plugin.path);
+        if (std::find(files.begin(), files.end(), path) == files.end()) files.push_back(path);
+    }
+
+    setConsoleColor(ConsoleColor::Green);
+    std::cout << "\nBenchmarking " << files.size() << " plugin files\n\n";
+    setConsoleColor(ConsoleColor::Default);
+
+    size_t measured = 0;
+    size_t failed = 0;
+    auto merge = [&](const std::filesystem::path& path, const std::vector<futureboard::PluginInfo>& results) {
+        for (auto& plugin : plugins) {
+            if (plugin.path != path.string() || !plugin.isValid) continue;
+            auto result = std::find_if(results.begin(), results.end(), [&plugin](const futureboard::PluginInfo& info) {
+                return info.clapId == plugin.clapId && info.uniqueId == plugin.uniqueId && info.name == plugin.name;
+            });
+            if (result == results.end() && results.size() == 1) result = results.begin();
+
+            if (result != results.end() && !result->costHints.empty()) {
+                plugin.costHints = result->costHints;
+                measured++;
+                std::cout << "  " << std::setw(24) << formatLoad(plugin) << "  " << plugin.name << "\n";
+            } else {
+                failed++;
+                setConsoleColor(ConsoleColor::Red);
+                std::cout << "  " << std::setw(24) << "failed" << "  " << plugin.name;
+                if (result != results.end() && !result->error.empty()) std::cout << ": " << result->error;
+                std::cout << "\n";
+                setConsoleColor(ConsoleColor::Default);
+            }
+        }
+    };
+
+    if (inProcess) {
+        futureboard::PluginBenchmark bench;
+        for (const auto& path : files) {
+            std::vector<futureboard::PluginInfo> results;
+            for (const auto& plugin : plugins) {
+                if (plugin.path == path.string() && plugin.isValid) results.push_back(plugin);
+            }
+            for (auto& info : results) {
+                std::string error;
+                if (!bench.run(info, error)) {
+                    info.costHints.clear();
+                    info.error = error;
+                }
+            }
+            merge(path, results);
+        }
+    } else {
+        std::mutex mergeMutex;
+        std::atomic<bool> stopRequested{false};
+        auto self = juce::File::getSpecialLocation(juce::File::currentExecutableFile);
+        futureboard::ScanWorkerPool pool(self.getFullPathName().toStdString(), 1, timeoutMs > 0 ? timeoutMs : 300000);
+        pool.setExtraArguments({ futureboard::PluginBenchmark::workerArgument });
+        pool.run(files, stopRequested, [&](const std::filesystem::path& path, std::vector<futureboard::PluginInfo>&& results) {
+            std::lock_guard<std::mutex> lock(mergeMutex);
+            merge(path, results);
+        });
+    }
+
+    if (!futureboard::PluginScanner::writeDatabase(databasePath, plugins)) {
+        setConsoleColor(ConsoleColor::Red);
+        std::cerr << "Failed to write plugin database " << databasePath << "\n";
+        setConsoleColor(ConsoleColor::Default);
+        return 1;
+    }
+
+    // The most expensive plugins in the database, measured now or before
+    std::vector<const futureboard::PluginInfo*> costly;
+    for (const auto& plugin : plugins) {
+        if (!plugin.costHints.empty()) costly.push_back(&plugin);
+    }
+    auto cost = [](const futureboard::PluginInfo* plugin) {
+        return futureboard::plugindb::estimateCostUs(plugin->costHints.data(),
+                                                     static_cast<uint32_t>(plugin->costHints.size()), 48000.0, 256);
+    };
+    std::sort(costly.begin(), costly.end(), [&cost](auto* a, auto* b) { return cost(a) > cost(b); });
+
+    setConsoleColor(ConsoleColor::Green);
+    std::cout << "\nMeasured " << measured << " plugins, " << failed << " failed\n";
+    setConsoleColor(ConsoleColor::Default);
+    if (!costly.empty()) std::cout << "Most expensive (256 frames at 48 kHz):\n";
+    for (size_t i = 0; i < std::min<size_t>(costly.size(), 10); i++) {
+        std::cout << "  " << std::setw(24) << formatLoad(*costly[i]) << "  " << costly[i]->name << "\n";
+    }
+    setConsoleColor(ConsoleColor::Cyan);
+    std::cout << "\nPlugin database: " << databasePath << "\n";
+    setConsoleColor(ConsoleColor::Default);
+    return failed == 0 ? 0 : 1;
+}
+
+// Describes every VST2 plugin in folder with both the native probe and JUCE,
+// in-process, alternating which goes first to even out file cache effects
+int runVst2Benchmark(const std::string& folder) {
+    using Clock = std::chrono::steady_clock;
+
+    futureboard::PluginScanner scanner;
+    scanner.clearSearchPaths();
+    scanner.addSearchPath(folder);
+    scanner.setFormatsToScan(true, false, false);
+
+    auto files = scanner.findPluginFiles();
+    std::cout << "Benchmarking " << files.size() << " VST2 plugins in " << folder << "\n\n";
+
+    double nativeTotal = 0.0;
+    double juceTotal = 0.0;
+    size_t mismatches = 0;
+
+    auto timeScan = [&scanner](const std::filesystem::path& path, bool native, double& ms) {
+        scanner.setNativeVst2Probe(native);
+        auto start = Clock::now();
+        auto results = scanner.scanPluginFile(path);
+        ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        return results;
+    };
+
+    for (size_t i = 0; i < files.size(); i++) {
+        double nativeMs = 0.0;
+        double juceMs = 0.0;
+        std::vector<futureboard::PluginInfo> native, viaJuce;
+
+        if (i % 2 == 0) {
+            native = timeScan(files[i], true, nativeMs);
+            viaJuce = timeScan(files[i], false, juceMs);
+        } else {
+            viaJuce = timeScan(files[i], false, juceMs);
+            native = timeScan(files[i], true, nativeMs);
+        }
+
+        nativeTotal += nativeMs;
+        juceTotal += juceMs;
+
+        bool same = native.size() == viaJuce.size() && !native.empty() &&
+                    native[0].isValid == viaJuce[0].isValid &&
+                    native[0].name == viaJuce[0].name &&
+                    native[0].uniqueId == viaJuce[0].uniqueId;
+        if (!same) mismatches++;
+
+        std::cout << std::fixed << std::setprecision(1)
+                  << std::setw(8) << nativeMs << " ms native  "
+                  << std::setw(8) << juceMs << " ms JUCE  "
+                  << files[i].filename().string()
+                  << (same ? "" : "  (results differ)") << "\n";
+    }
+
+    std::cout << "\nNative probe: " << nativeTotal << " ms total\n";
+    std::cout << "JUCE:         " << juceTotal << " ms total\n";
+    if (nativeTotal > 0.0) {
+        std::cout << "Speed-up:     " << std::setprecision(2) << juceTotal / nativeTotal << "x\n";
+    }
+    std::cout << "Mismatches:   " << mismatches << "\n";
+    return 0;
+}
+
 int main(int argc, char* argv[]) {
-    // Set console title and get handle
+    if (argc >= 4 && std::string(argv[1]) == futureboard::ScanWorkerPool::workerArgument) {
+        return runWorker(argv[2], argv[3], argc - 4, argv + 4);
+    }
+
+#ifdef _WIN32
     SetConsoleTitle(TEXT("Futureboard VST Scanner"));
-    HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
+#endif
 
     // Parse command line arguments
     std::string outputPath = ".";
     bool shouldScan = false;
+    bool inProcess = false;
+    int workerCount = 0;
+    int timeoutMs = 0;
+    std::string databasePath;
+    bool fullRescan = false;
+    bool retryQuarantined = false;
+    bool exportXml = false;
+    bool contentHashing = false;
+    bool juceVst2 = false;
+    std::string streamPath;
+    std::string reportPath;
+    bool watch = false;
+    bool benchmark = false;
 
     for (int i = 1; i < argc; i++) {
         std::string arg = argv[i];
@@ -102,12 +448,61 @@ int main(int argc, char* argv[]) {
         else if (arg == "-o" && i + 1 < argc) {
             outputPath = argv[++i];
         }
+        else if (arg == "-j" && i + 1 < argc) {
+            workerCount = std::atoi(argv[++i]);
+        }
+        else if (arg == "-t" && i + 1 < argc) {
+            timeoutMs = std::atoi(argv[++i]);
+        }
+        else if (arg == "-i") {
+            inProcess = true;
+        }
+        else if (arg == "-d" && i + 1 < argc) {
+            databasePath = argv[++i];
+        }
+        else if (arg == "-x") {
+            exportXml = true;
+        }
+        else if (arg == "-f") {
+            fullRescan = true;
+        }
+        else if (arg == "-r") {
+            retryQuarantined = true;
+        }
+        else if (arg == "-H") {
+            contentHashing = true;
+        }
+        else if (arg == "-n" && i + 1 < argc) {
+            streamPath = argv[++i];
+        }
+        else if (arg == "-p" && i + 1 < argc) {
+            reportPath = argv[++i];
+        }
+        else if (arg == "-w") {
+            watch = true;
+        }
+        else if (arg == "-J") {
+            juceVst2 = true;
+        }
+        else if (arg == "-b" && i + 1 < argc) {
+            return runVst2Benchmark(argv[++i]);
+        }
+        else if (arg == "--bench") {
+            benchmark = true;
+        }
         else {
             printUsage();
             return 1;
         }
     }
 
+    if (databasePath.empty()) {
+        databasePath = (std::filesystem::path(outputPath) / "plugins.ftbdb").string();
+    }
+    if (benchmark && !shouldScan) {
+        return runPluginBenchmark(databasePath, inProcess, timeoutMs, fullRescan);
+    }
+
     if (!shouldScan) {
         printUsage();
         return 1;
@@ -116,12 +511,26 @@ int main(int argc, char* argv[]) {
     try {
         // Create scanner instance
         futureboard::PluginScanner scanner;
+        if (!inProcess) {
+            auto self = juce::File::getSpecialLocation(juce::File::currentExecutableFile);
+            scanner.setWorkerExecutable(self.getFullPathName().toStdString());
+        }
+        if (workerCount > 0) scanner.setWorkerCount(workerCount);
+        if (timeoutMs > 0) scanner.setPluginTimeout(timeoutMs);
+
+        // The database doubles as the rescan cache and is rewritten at the end of the scan
+        scanner.setCacheFile(databasePath);
+        scanner.setFullRescan(fullRescan);
+        scanner.setContentHashing(contentHashing);
+        scanner.setRetryQuarantined(retryQuarantined);
+        scanner.setNativeVst2Probe(!juceVst2);
+        if (!streamPath.empty()) scanner.setResultStream(streamPath);
 
         // Print header
-        SetConsoleTextAttribute(hConsole, FOREGROUND_GREEN | FOREGROUND_INTENSITY);
+        setConsoleColor(ConsoleColor::Green);
         std::cout << "\nFutureboard VST Scanner\n";
         std::cout << "======================\n\n";
-        SetConsoleTextAttribute(hConsole, FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE);
+        setConsoleColor(ConsoleColor::Default);
 
         // Start scanning with progress callback
         scanner.scanPlugins([](const std::string& message, float progress) {
@@ -137,33 +546,38 @@ int main(int argc, char* argv[]) {
         const auto& plugins = scanner.getPlugins();
 
         // Print results header
-        SetConsoleTextAttribute(hConsole, FOREGROUND_GREEN | FOREGROUND_INTENSITY);
+        setConsoleColor(ConsoleColor::Green);
         std::cout << "\nFound " << plugins.size() << " plugins:\n\n";
-        SetConsoleTextAttribute(hConsole, FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE);
+        setConsoleColor(ConsoleColor::Default);
 
         // Print details for each plugin
         for (const auto& plugin : plugins) {
             printPluginInfo(plugin);
         }
 
-        // Generate output filename with timestamp
-        std::filesystem::path outputFilePath = std::filesystem::path(outputPath) /
-            ("scan_result_" + getCurrentTimestamp() + ".ftbpreset");
+        setConsoleColor(ConsoleColor::Cyan);
+        std::cout << "\nPlugin database: " << databasePath << "\n";
 
-        // Save results
-        SetConsoleTextAttribute(hConsole, FOREGROUND_GREEN | FOREGROUND_BLUE | FOREGROUND_INTENSITY);
-        std::cout << "\nSaving results to: " << outputFilePath << "\n";
-
-        if (scanner.saveToPreset(outputFilePath.string())) {
-            SetConsoleTextAttribute(hConsole, FOREGROUND_GREEN | FOREGROUND_INTENSITY);
-            std::cout << "Scan completed successfully!\n";
-        }
-        else {
+        if (!std::filesystem::exists(databasePath)) {
             throw std::runtime_error("Failed to save scan results");
         }
 
+        if (exportXml) {
+            // Generate output filename with timestamp
+            std::filesystem::path outputFilePath = std::filesystem::path(outputPath) /
+                ("scan_result_" + getCurrentTimestamp() + ".ftbpreset");
+            std::cout << "Exporting XML to: " << outputFilePath << "\n";
+
+            if (!scanner.saveToPreset(outputFilePath.string())) {
+                throw std::runtime_error("Failed to export scan results");
+            }
+        }
+
+        setConsoleColor(ConsoleColor::Green);
+        std::cout << "Scan completed successfully!\n";
+
         // Print summary
-        SetConsoleTextAttribute(hConsole, FOREGROUND_GREEN | FOREGROUND_INTENSITY);
+        setConsoleColor(ConsoleColor::Green);
         std::cout << "\nScan Summary:\n";
         std::cout << "-------------\n";
         std::cout << "Total plugins found: " << plugins.size() << "\n";
@@ -174,6 +588,7 @@ int main(int argc, char* argv[]) {
         size_t clapCount = 0;
         size_t synthCount = 0;
         size_t effectCount = 0;
+        size_t quarantinedCount = 0;
 
         for (const auto& plugin : plugins) {
             if (plugin.isValid) validCount++;
@@ -182,6 +597,7 @@ int main(int argc, char* argv[]) {
             if (plugin.format == futureboard::PluginFormat::CLAP) clapCount++;
             if (plugin.isSynth) synthCount++;
             if (plugin.isEffect) effectCount++;
+            if (plugin.failure != futureboard::ScanFailure::None) quarantinedCount++;
         }
 
         std::cout << "Valid plugins: " << validCount << "\n";
@@ -190,21 +606,51 @@ int main(int argc, char* argv[]) {
         std::cout << "CLAP plugins: " << clapCount << "\n";
         std::cout << "Instruments: " << synthCount << "\n";
         std::cout << "Effects: " << effectCount << "\n";
+        std::cout << "Quarantined (crashed or timed out): " << quarantinedCount << "\n";
+
+        if (!reportPath.empty()) {
+            futureboard::ScanProfileReport report(plugins);
+            printProfile(report, 10);
+
+            setConsoleColor(ConsoleColor::Cyan);
+            std::cout << "\nProfiling report: " << reportPath << "\n";
+            if (!report.write(reportPath)) {
+                throw std::runtime_error("Failed to write profiling report");
+            }
+        }
+
+        if (benchmark) {
+            // The scan's own timeout is meant for loading, not for processing
+            int result = runPluginBenchmark(databasePath, inProcess, 0, fullRescan);
+            if (result != 0 && !watch) return result;
+            // Rescans while watching rewrite the database from the scanner's
+            // results, which have to include the hints just measured
+            if (watch && !scanner.loadDatabase(databasePath)) {
+                throw std::runtime_error("Failed to reload plugin database");
+            }
+        }
+
+        if (watch) {
+            setConsoleColor(ConsoleColor::Cyan);
+            std::cout << "\nWatching plugin folders for changes, press Ctrl+C to stop\n";
+            setConsoleColor(ConsoleColor::Default);
+            watchPlugins(scanner);
+        }
     }
     catch (const std::exception& e) {
-        SetConsoleTextAttribute(hConsole, FOREGROUND_RED | FOREGROUND_INTENSITY);
+        setConsoleColor(ConsoleColor::Red);
         std::cerr << "\nError: " << e.what() << "\n";
-        SetConsoleTextAttribute(hConsole, FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE);
+        setConsoleColor(ConsoleColor::Default);
         return 1;
     }
     catch (...) {
-        SetConsoleTextAttribute(hConsole, FOREGROUND_RED | FOREGROUND_INTENSITY);
+        setConsoleColor(ConsoleColor::Red);
         std::cerr << "\nUnknown error occurred\n";
-        SetConsoleTextAttribute(hConsole, FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE);
+        setConsoleColor(ConsoleColor::Default);
         return 1;
     }
 
     // Reset console color
-    SetConsoleTextAttribute(hConsole, FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE);
+    setConsoleColor(ConsoleColor::Default);
     return 0;
 }
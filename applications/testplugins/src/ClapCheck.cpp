@@ -0,0 +1,287 @@
+// Runs a CLAP plugin through the engine's AudioGraph without an audio
+// device: a sine goes in, the plugin's output is measured, and with the
+// test gain plugin the result is checked against the expected gain.
+//
+//   clapcheck <file.clap> [plugin id] [-g gain] [-s pluginhost] [-b]
+//
+// -s runs the plugin in a sandboxed futureboard-pluginhost process.
+// -b times 128-frame blocks in process and, with -s, sandboxed, and
+//    reports the per-block round-trip overhead of the sandbox.
+
+#include "audiograph.hpp"
+#include "audioworkerpool.hpp"
+#include "clappluginnode.hpp"
+#include "sandboxedpluginnode.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+constexpr double kSampleRate = 48000.0;
+constexpr uint32_t kMaxFrames = 256;
+// Larger than kMaxFrames so the graph has to split each block
+constexpr uint32_t kDeviceFrames = 400;
+constexpr int kBlocks = 200;
+// Input goes silent for these blocks so the plugin can go to sleep, and
+// comes back in the middle of the last one's device block
+constexpr int kSilentFrom = 80;
+constexpr int kSilentUntil = 120;
+constexpr uint32_t kResumeAt = kMaxFrames + 37;
+
+constexpr uint32_t kBenchFrames = 128;
+constexpr int kBenchWarmup = 1000;
+constexpr int kBenchBlocks = 20000;
+
+const char* kGainPluginId = "com.futureboard.test.gain";
+
+struct Options {
+    std::string path;
+    std::string pluginId;
+    std::string host;
+    double gain = 0.5;
+    bool bench = false;
+};
+
+struct Plugin {
+    std::shared_ptr<AudioNode> node;
+    std::string name;
+    std::string id;
+};
+
+bool load(const Options& options, bool sandboxed, Plugin& plugin) {
+    std::string error;
+    if (sandboxed) {
+        auto node = SandboxedPluginNode::create(options.host, options.path, options.pluginId, error);
+        if (node) {
+            plugin.name = node->name();
+            plugin.id = node->pluginId();
+            plugin.node = node;
+        }
+    } else {
+        auto node = ClapPluginNode::create(options.path, options.pluginId, error);
+        if (node) {
+            plugin.name = node->name();
+            plugin.id = node->plugin()->desc->id;
+            plugin.node = node;
+        }
+    }
+    if (!plugin.node) {
+        std::printf("Error: %s\n", error.c_str());
+        return false;
+    }
+    return true;
+}
+
+AudioGraph::NodeId insert(AudioGraph& graph, const std::shared_ptr<AudioNode>& node) {
+    auto id = graph.addNode(node);
+    for (uint32_t channel = 0; channel < 2; channel++) {
+        if (channel < node->numInputs()) graph.connect(AudioGraph::kInputNode, channel, id, channel);
+        if (channel < node->numOutputs()) graph.connect(id, channel, AudioGraph::kOutputNode, channel);
+    }
+    graph.connectEvents(AudioGraph::kInputNode, id);
+    return id;
+}
+
+bool hasFailed(const std::shared_ptr<AudioNode>& node) {
+    if (auto clap = std::dynamic_pointer_cast<ClapPluginNode>(node)) return clap->hasFailed();
+    auto sandboxed = std::static_pointer_cast<SandboxedPluginNode>(node);
+    if (sandboxed->hasCrashed()) std::printf("Error: plugin host crashed or stopped answering\n");
+    return sandboxed->hasFailed() || sandboxed->hasCrashed();
+}
+
+bool isSleeping(const std::shared_ptr<AudioNode>& node) {
+    if (auto clap = std::dynamic_pointer_cast<ClapPluginNode>(node)) return clap->isSleeping();
+    return std::static_pointer_cast<SandboxedPluginNode>(node)->isSleeping();
+}
+
+void fillSine(std::vector<float>& input, uint32_t frames, double& phase, uint32_t from = 0) {
+    std::fill(input.begin(), input.end(), 0.0f);
+    for (uint32_t i = from; i < frames; i++) {
+        float sample = static_cast<float>(0.8 * std::sin(phase));
+        input[i] = sample;
+        input[frames + i] = -sample;
+        phase += 2.0 * kPi * 440.0 / kSampleRate;
+    }
+}
+
+int check(const Options& options, const Plugin& plugin) {
+    AudioWorkerPool workers;
+    AudioGraph graph(2, 2);
+    graph.setWorkerPool(&workers);
+
+    auto id = insert(graph, plugin.node);
+    if (!graph.prepare(kSampleRate, kMaxFrames)) {
+        std::printf("Error: %s\n", graph.getError().c_str());
+        return 1;
+    }
+
+    std::vector<float> input(2 * kDeviceFrames);
+    std::vector<float> output(2 * kDeviceFrames);
+    const float* inputs[] = { input.data(), input.data() + kDeviceFrames };
+    float* outputs[] = { output.data(), output.data() + kDeviceFrames };
+
+    double phase = 0.0;
+    double inputPeak = 0.0;
+    double outputPeak = 0.0;
+    double worstError = 0.0;
+    bool checkGain = plugin.id == kGainPluginId;
+    bool slept = false;
+
+    for (int block = 0; block < kBlocks; block++) {
+        if (block < kSilentFrom || block > kSilentUntil) {
+            fillSine(input, kDeviceFrames, phase);
+        } else if (block < kSilentUntil) {
+            std::fill(input.begin(), input.end(), 0.0f);
+        } else {
+            slept = isSleeping(plugin.node);
+            fillSine(input, kDeviceFrames, phase, kResumeAt);
+        }
+
+        // Set the gain on the first block, in the middle of its second chunk
+        const uint32_t changeAt = kMaxFrames + 10;
+        if (block == 0) {
+            clap_event_param_value_t event{};
+            event.header.size = sizeof(event);
+            event.header.time = changeAt;
+            event.header.space_id = CLAP_CORE_EVENT_SPACE_ID;
+            event.header.type = CLAP_EVENT_PARAM_VALUE;
+            event.param_id = 0;
+            event.note_id = -1;
+            event.port_index = -1;
+            event.channel = -1;
+            event.key = -1;
+            event.value = options.gain;
+            graph.inputEvents().push(&event.header);
+        }
+
+        graph.process(inputs, outputs, kDeviceFrames);
+
+        for (uint32_t i = 0; i < 2 * kDeviceFrames; i++) {
+            inputPeak = std::max(inputPeak, std::fabs(static_cast<double>(input[i])));
+            outputPeak = std::max(outputPeak, std::fabs(static_cast<double>(output[i])));
+            if (checkGain) {
+                bool changed = block > 0 || i % kDeviceFrames >= changeAt;
+                double expected = input[i] * (changed ? options.gain : 1.0);
+                worstError = std::max(worstError, std::fabs(output[i] - expected));
+            }
+        }
+    }
+
+    std::printf("Input peak %.4f, output peak %.4f, %s on silence\n", inputPeak, outputPeak,
+                slept ? "slept" : "kept processing");
+    if (hasFailed(plugin.node)) {
+        std::printf("Error: plugin stopped processing\n");
+        return 1;
+    }
+
+    // Releases the node, which makes the test plugin log its pool usage
+    graph.removeNode(id);
+    graph.commit();
+
+    if (checkGain) {
+        // The test plugin can sleep once its output is quiet
+        bool ok = worstError < 1e-6 && slept && !isSleeping(plugin.node);
+        std::printf("Gain %.3f: %s (largest error %g)\n", options.gain, ok ? "ok" : "FAILED", worstError);
+        return ok ? 0 : 1;
+    }
+    return 0;
+}
+
+// Microseconds per graph.process() call, sorted
+std::vector<double> timeBlocks(const std::shared_ptr<AudioNode>& node) {
+    AudioWorkerPool workers;
+    AudioGraph graph(2, 2);
+    graph.setWorkerPool(&workers);
+    insert(graph, node);
+    if (!graph.prepare(kSampleRate, kBenchFrames)) return {};
+
+    std::vector<float> input(2 * kBenchFrames);
+    std::vector<float> output(2 * kBenchFrames);
+    const float* inputs[] = { input.data(), input.data() + kBenchFrames };
+    float* outputs[] = { output.data(), output.data() + kBenchFrames };
+    double phase = 0.0;
+
+    std::vector<double> times;
+    times.reserve(kBenchBlocks);
+    for (int block = 0; block < kBenchWarmup + kBenchBlocks; block++) {
+        fillSine(input, kBenchFrames, phase);
+        auto start = std::chrono::steady_clock::now();
+        graph.process(inputs, outputs, kBenchFrames);
+        auto elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start);
+        if (block >= kBenchWarmup) times.push_back(elapsed.count());
+    }
+    std::sort(times.begin(), times.end());
+    return times;
+}
+
+double percentile(const std::vector<double>& sorted, double fraction) {
+    return sorted[std::min(sorted.size() - 1, static_cast<size_t>(fraction * sorted.size()))];
+}
+
+void printTimes(const char* label, const std::vector<double>& times) {
+    std::printf("%-12s median %7.2f us   p99 %7.2f us   max %8.2f us\n", label, percentile(times, 0.5),
+                percentile(times, 0.99), times.back());
+}
+
+int bench(const Options& options) {
+    double budget = 1e6 * kBenchFrames / kSampleRate;
+    std::printf("%d blocks of %u frames, %.0f us each at %.0f Hz\n", kBenchBlocks, kBenchFrames, budget, kSampleRate);
+
+    Plugin local;
+    if (!load(options, false, local)) return 1;
+    auto localTimes = timeBlocks(local.node);
+    if (localTimes.empty()) return 1;
+    printTimes("In process", localTimes);
+    local.node.reset();
+
+    if (options.host.empty()) return 0;
+
+    Plugin sandboxed;
+    if (!load(options, true, sandboxed)) return 1;
+    auto sandboxedTimes = timeBlocks(sandboxed.node);
+    if (sandboxedTimes.empty() || hasFailed(sandboxed.node)) return 1;
+    printTimes("Sandboxed", sandboxedTimes);
+
+    std::printf("Round trip   median %7.2f us   p99 %7.2f us\n",
+                percentile(sandboxedTimes, 0.5) - percentile(localTimes, 0.5),
+                percentile(sandboxedTimes, 0.99) - percentile(localTimes, 0.99));
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        if (!std::strcmp(argv[i], "-g") && i + 1 < argc) {
+            options.gain = std::atof(argv[++i]);
+        } else if (!std::strcmp(argv[i], "-s") && i + 1 < argc) {
+            options.host = argv[++i];
+        } else if (!std::strcmp(argv[i], "-b")) {
+            options.bench = true;
+        } else if (options.path.empty()) {
+            options.path = argv[i];
+        } else {
+            options.pluginId = argv[i];
+        }
+    }
+    if (options.path.empty()) {
+        std::printf("Usage: clapcheck <file.clap> [plugin id] [-g gain] [-s pluginhost] [-b]\n");
+        return 2;
+    }
+
+    if (options.bench) return bench(options);
+
+    Plugin plugin;
+    if (!load(options, !options.host.empty(), plugin)) return 1;
+    std::printf("%s: %u in, %u out%s\n", plugin.name.c_str(), plugin.node->numInputs(), plugin.node->numOutputs(),
+                options.host.empty() ? "" : ", sandboxed");
+    return check(options, plugin);
+}
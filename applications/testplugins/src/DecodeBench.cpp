@@ -0,0 +1,513 @@
+// Decodes audio files through DecodingService and reports the throughput in
+// files and megabytes per second, first on one worker and then on all of
+// them. Then it measures how long a Playhead job for one second of audio
+// takes while the pool is busy with a background import, and checks that
+// cancelling a batch stops it cleanly.
+//
+//   decodebench [files or folders...] [-j threads] [-n files] [-l file seconds] [-k]
+//
+// Without files it writes 32 files of 60 s at 48 kHz into the temp folder,
+// WAV and AIFF at 16 and 24 bits, and checks every sample decoded from
+// them. Given files or folders it decodes every WAV, AIFF, FLAC and MP3 in
+// them, and checks stretches spread over each one, as decoded after a seek
+// and as split among the workers, against decoding it straight from the
+// start, and checks that lengths the decoders call exact are. -k keeps
+// the generated files for another run.
+
+#include "audiodecoder.hpp"
+#include "decodingservice.hpp"
+#include "diskfile.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cctype>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr uint32_t kSampleRate = 48000;
+constexpr uint32_t kChannels = 2;
+constexpr size_t kLocates = 50;
+constexpr double kLocateSeconds = 1.0;
+constexpr size_t kWindows = 16;
+constexpr uint32_t kWindowFrames = 4096;
+// MP3 may come out of a seek off by rounding; the others have to be exact
+constexpr float kMp3Tolerance = 1e-4f;
+
+int16_t sampleFor(size_t file, uint32_t channel, uint64_t frame) {
+    return static_cast<int16_t>(int((frame * 13 + channel * 5000 + file * 331) % 65536) - 32768);
+}
+
+// Frames of a given file as decoded straight from the start
+struct Window {
+    uint64_t start = 0;
+    std::vector<std::vector<float>> channels;
+};
+
+struct BenchFile {
+    std::filesystem::path path;
+    uint64_t bytes = 0;
+    uint64_t frames = 0;
+    // Written by the bench, so every sample can be checked
+    bool generated = false;
+    size_t index = 0;
+    // Given files are checked where they have windows
+    std::vector<Window> windows;
+    float tolerance = 0.0f;
+    // What the given file's header says about its length
+    uint64_t headerFrames = 0;
+    bool exactLength = false;
+};
+
+// Decodes the file from the start without seeking, once to count its
+// frames, which an MP3 only estimates and a FLAC file may not have, and
+// once to keep the windows spread over it
+bool readWindows(BenchFile& file, std::string& error) {
+    std::vector<std::vector<float>> buffers;
+    std::vector<float*> channels;
+    auto readAll = [&](const std::function<void(uint64_t, uint32_t)>& onRead) {
+        auto decoder = AudioDecoder::open(file.path, error);
+        if (!decoder) return false;
+        buffers.assign(decoder->info().channels, std::vector<float>(kWindowFrames));
+        channels.clear();
+        for (auto& buffer : buffers) channels.push_back(buffer.data());
+        uint64_t frame = 0;
+        while (uint32_t frames = decoder->read(channels.data(), kWindowFrames)) {
+            onRead(frame, frames);
+            frame += frames;
+        }
+        if (decoder->hasFailed()) {
+            error = decoder->getError();
+            return false;
+        }
+        return true;
+    };
+
+    uint64_t total = 0;
+    if (!readAll([&total](uint64_t, uint32_t frames) { total += frames; })) return false;
+    file.frames = total;
+    file.windows.clear();
+    if (total < kWindowFrames) return true;
+
+    // The first and last frames and odd places between them
+    for (size_t i = 0; i < kWindows; i++) {
+        Window window;
+        window.start = (total - kWindowFrames) * i / (kWindows - 1);
+        if (i > 0 && i + 1 < kWindows) window.start -= window.start % 997;
+        file.windows.push_back(std::move(window));
+    }
+    return readAll([&file, &buffers](uint64_t frame, uint32_t frames) {
+        for (auto& window : file.windows) {
+            uint64_t from = std::max(frame, window.start);
+            uint64_t to = std::min(frame + frames, window.start + kWindowFrames);
+            if (from >= to) continue;
+            window.channels.resize(buffers.size(), std::vector<float>(kWindowFrames));
+            for (size_t channel = 0; channel < buffers.size(); channel++) {
+                std::copy(buffers[channel].data() + (from - frame), buffers[channel].data() + (to - frame),
+                          window.channels[channel].data() + (from - window.start));
+            }
+        }
+    });
+}
+
+// Samples of a block that differ from the file's windows
+uint64_t compareWindows(const BenchFile& file, const DecodingService::Block& block) {
+    uint64_t wrong = 0;
+    for (const auto& window : file.windows) {
+        uint64_t from = std::max(block.startFrame, window.start);
+        uint64_t to = std::min(block.startFrame + block.frames, window.start + kWindowFrames);
+        if (from >= to) continue;
+        for (uint32_t channel = 0; channel < block.channels; channel++) {
+            const float* samples = block.channel(channel) + (from - block.startFrame);
+            const float* expected = window.channels[channel].data() + (from - window.start);
+            for (uint64_t i = 0; i < to - from; i++) {
+                if (std::abs(samples[i] - expected[i]) > file.tolerance) wrong++;
+            }
+        }
+    }
+    return wrong;
+}
+
+void put(std::vector<uint8_t>& out, uint64_t value, int bytes, bool bigEndian) {
+    for (int i = 0; i < bytes; i++) {
+        int shift = 8 * (bigEndian ? bytes - 1 - i : i);
+        out.push_back(static_cast<uint8_t>(value >> shift));
+    }
+}
+
+void putTag(std::vector<uint8_t>& out, const char* tag) {
+    out.insert(out.end(), tag, tag + 4);
+}
+
+// AIFF's 80-bit extended float, for a whole number
+void putExtended(std::vector<uint8_t>& out, uint32_t value) {
+    int top = 31;
+    while (top > 0 && !(value & (1u << top))) top--;
+    put(out, uint64_t(16383 + top), 2, true);
+    put(out, uint64_t(value) << (63 - top), 8, true);
+}
+
+bool writeFile(const BenchFile& file, bool aiff, uint32_t bits, std::string& error) {
+    uint32_t sampleBytes = bits / 8;
+    uint64_t dataBytes = file.frames * kChannels * sampleBytes;
+    std::vector<uint8_t> header;
+    if (aiff) {
+        putTag(header, "FORM");
+        put(header, 4 + 26 + 16 + dataBytes, 4, true);
+        putTag(header, "AIFF");
+        putTag(header, "COMM");
+        put(header, 18, 4, true);
+        put(header, kChannels, 2, true);
+        put(header, file.frames, 4, true);
+        put(header, bits, 2, true);
+        putExtended(header, kSampleRate);
+        putTag(header, "SSND");
+        put(header, 8 + dataBytes, 4, true);
+        put(header, 0, 8, true);
+    } else {
+        putTag(header, "RIFF");
+        put(header, 36 + dataBytes, 4, false);
+        putTag(header, "WAVE");
+        putTag(header, "fmt ");
+        put(header, 16, 4, false);
+        put(header, 1, 2, false);
+        put(header, kChannels, 2, false);
+        put(header, kSampleRate, 4, false);
+        put(header, kSampleRate * kChannels * sampleBytes, 4, false);
+        put(header, kChannels * sampleBytes, 2, false);
+        put(header, bits, 2, false);
+        putTag(header, "data");
+        put(header, dataBytes, 4, false);
+    }
+
+    DiskFile out;
+    if (!out.open(file.path, DiskFile::Mode::Create, false) || !out.writeAt(0, header.data(), header.size())) {
+        error = out.getError();
+        return false;
+    }
+    std::vector<uint8_t> data;
+    for (uint64_t frame = 0; frame < file.frames; frame += 65536) {
+        uint64_t count = std::min<uint64_t>(65536, file.frames - frame);
+        data.clear();
+        for (uint64_t i = 0; i < count; i++) {
+            for (uint32_t channel = 0; channel < kChannels; channel++) {
+                // 24-bit files hold the same value, so it decodes the same
+                auto value = uint64_t(uint32_t(int32_t(sampleFor(file.index, channel, frame + i))) << (bits - 16));
+                put(data, value, int(sampleBytes), aiff);
+            }
+        }
+        if (!out.writeAt(header.size() + frame * kChannels * sampleBytes, data.data(), data.size())) {
+            error = out.getError();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool isAudioFile(const std::filesystem::path& path) {
+    std::string extension = path.extension().string();
+    for (char& c : extension) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    for (const char* known : { ".wav", ".w64", ".aif", ".aiff", ".aifc", ".flac", ".mp3" }) {
+        if (extension == known) return true;
+    }
+    return false;
+}
+
+// Waits for a batch of jobs and counts what they delivered
+struct Batch {
+    std::mutex mutex;
+    std::condition_variable finished;
+    size_t pending = 0;
+    size_t failed = 0;
+    size_t cancelled = 0;
+    std::atomic<uint64_t> frames{0};
+    std::atomic<uint64_t> wrongSamples{0};
+    std::atomic<uint64_t> lateBlocks{0};
+
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [this] { return pending == 0; });
+    }
+};
+
+DecodingService::JobId decodeInto(DecodingService& service, Batch& batch, const BenchFile& file,
+                                  uint64_t startFrame, uint64_t frames, DecodingService::Priority priority,
+                                  std::shared_ptr<std::atomic<bool>> done = nullptr) {
+    {
+        std::lock_guard<std::mutex> lock(batch.mutex);
+        batch.pending++;
+    }
+    if (!done) done = std::make_shared<std::atomic<bool>>(false);
+    auto onBlock = [&batch, &file, done](DecodingService::Block&& block) {
+        if (done->load()) batch.lateBlocks++;
+        batch.frames += block.frames;
+        if (!file.generated) {
+            batch.wrongSamples += compareWindows(file, block);
+            return;
+        }
+        uint64_t wrong = 0;
+        for (uint32_t channel = 0; channel < block.channels; channel++) {
+            const float* samples = block.channel(channel);
+            for (uint32_t i = 0; i < block.frames; i++) {
+                float expected = float(sampleFor(file.index, channel, block.startFrame + i)) / 32768.0f;
+                if (samples[i] != expected) wrong++;
+            }
+        }
+        batch.wrongSamples += wrong;
+    };
+    auto onFinished = [&batch, &file, done](DecodingService::JobId, DecodingService::Result result,
+                                            const std::string& error) {
+        done->store(true);
+        std::lock_guard<std::mutex> lock(batch.mutex);
+        if (result == DecodingService::Result::Failed) {
+            std::printf("Error: %s: %s\n", file.path.string().c_str(), error.c_str());
+            batch.failed++;
+        } else if (result == DecodingService::Result::Cancelled) {
+            batch.cancelled++;
+        }
+        if (--batch.pending == 0) batch.finished.notify_all();
+    };
+    return service.decode(file.path, startFrame, frames, priority, onBlock, onFinished);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::vector<std::filesystem::path> inputs;
+    uint32_t threads = 0;
+    size_t fileCount = 32;
+    double fileSeconds = 60.0;
+    bool keep = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "-j" && hasValue) {
+            threads = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "-n" && hasValue) {
+            fileCount = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "-l" && hasValue) {
+            fileSeconds = std::strtod(argv[++i], nullptr);
+        } else if (arg == "-k") {
+            keep = true;
+        } else if (!arg.empty() && arg[0] == '-') {
+            std::printf("Usage: decodebench [files or folders...] [-j threads] [-n files] [-l file seconds] [-k]\n");
+            return 2;
+        } else {
+            inputs.push_back(arg);
+        }
+    }
+
+    std::error_code ec;
+    std::string error;
+    std::vector<BenchFile> files;
+    for (const auto& input : inputs) {
+        std::vector<std::filesystem::path> paths;
+        if (std::filesystem::is_directory(input, ec)) {
+            for (const auto& entry : std::filesystem::recursive_directory_iterator(input, ec)) {
+                if (entry.is_regular_file(ec) && isAudioFile(entry.path())) paths.push_back(entry.path());
+            }
+        } else {
+            paths.push_back(input);
+        }
+        for (const auto& path : paths) {
+            auto decoder = AudioDecoder::open(path, error);
+            if (!decoder) {
+                std::printf("Skipping %s: %s\n", path.string().c_str(), error.c_str());
+                continue;
+            }
+            BenchFile file;
+            file.path = path;
+            file.bytes = std::filesystem::file_size(path, ec);
+            file.tolerance = std::string(decoder->info().format) == "MP3" ? kMp3Tolerance : 0.0f;
+            file.headerFrames = decoder->info().frames;
+            file.exactLength = decoder->info().exactLength;
+            if (!readWindows(file, error)) {
+                std::printf("Skipping %s: %s\n", path.string().c_str(), error.c_str());
+                continue;
+            }
+            files.push_back(std::move(file));
+        }
+    }
+
+    std::filesystem::path folder;
+    if (inputs.empty()) {
+        folder = std::filesystem::temp_directory_path() / "decodebench";
+        std::filesystem::create_directories(folder, ec);
+        auto begin = Clock::now();
+        for (size_t i = 0; i < fileCount; i++) {
+            bool aiff = i % 2 == 1;
+            uint32_t bits = i % 4 < 2 ? 16 : 24;
+            BenchFile file;
+            file.path = folder / ("file" + std::to_string(i + 1) + (aiff ? ".aif" : ".wav"));
+            file.frames = static_cast<uint64_t>(fileSeconds * kSampleRate);
+            file.generated = true;
+            file.index = i;
+            auto decoder = std::filesystem::exists(file.path, ec) ? AudioDecoder::open(file.path, error) : nullptr;
+            if ((!decoder || decoder->info().frames != file.frames) && !writeFile(file, aiff, bits, error)) {
+                std::printf("Error: %s\n", error.c_str());
+                return 1;
+            }
+            file.bytes = std::filesystem::file_size(file.path, ec);
+            files.push_back(file);
+        }
+        std::printf("%zu files of %.0f s ready in %.1f s\n", files.size(), fileSeconds,
+                    std::chrono::duration<double>(Clock::now() - begin).count());
+    }
+    if (files.empty()) {
+        std::printf("No audio files to decode\n");
+        return 1;
+    }
+
+    uint64_t totalBytes = 0;
+    uint64_t totalFrames = 0;
+    for (const auto& file : files) {
+        totalBytes += file.bytes;
+        totalFrames += file.frames;
+    }
+
+    bool passed = true;
+    uint32_t allThreads = threads > 0 ? threads : std::max(std::thread::hardware_concurrency(), 1u);
+    std::vector<uint32_t> threadCounts = { 1 };
+    if (allThreads > 1) threadCounts.push_back(allThreads);
+
+    // Whole files, as an import does
+    for (uint32_t count : threadCounts) {
+        DecodingService service;
+        DecodingService::Options options;
+        options.threads = count;
+        if (!service.start(options, error)) {
+            std::printf("Error: %s\n", error.c_str());
+            return 1;
+        }
+        Batch batch;
+        auto begin = Clock::now();
+        for (const auto& file : files) {
+            decodeInto(service, batch, file, 0, DecodingService::kToEnd, DecodingService::Priority::Normal);
+        }
+        batch.wait();
+        double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+        service.stop();
+
+        std::printf("%u thread%s: %zu files in %.2f s, %.1f files/s, %.1f MB/s read, %.0fx real time\n", count,
+                    count == 1 ? "" : "s", files.size(), seconds, double(files.size()) / seconds,
+                    double(totalBytes) / 1e6 / seconds, double(totalFrames) / kSampleRate / seconds);
+        if (batch.failed > 0 || batch.wrongSamples > 0 || batch.frames < totalFrames) {
+            std::printf("  %zu failed, %llu frames of %llu, %llu wrong samples\n", batch.failed,
+                        static_cast<unsigned long long>(batch.frames.load()),
+                        static_cast<unsigned long long>(totalFrames),
+                        static_cast<unsigned long long>(batch.wrongSamples.load()));
+            passed = false;
+        }
+    }
+
+    DecodingService service;
+    DecodingService::Options options;
+    options.threads = allThreads;
+    if (!service.start(options, error)) {
+        std::printf("Error: %s\n", error.c_str());
+        return 1;
+    }
+
+    // A length the decoder calls exact has to be what decoding yields; FLAC
+    // streams without a sample count and MP3s without a Xing/Info or VBRI
+    // frame count are listed with what the header said
+    if (inputs.size() > 0) {
+        size_t exact = 0;
+        size_t wrong = 0;
+        for (const auto& file : files) {
+            if (file.exactLength && file.headerFrames == file.frames) {
+                exact++;
+                continue;
+            }
+            if (file.exactLength) wrong++;
+            const char* kind = file.exactLength ? "exact" : file.headerFrames > 0 ? "estimated" : "unknown";
+            std::printf("  %s: %llu frames decoded, header length %s (%llu)\n", file.path.filename().string().c_str(),
+                        static_cast<unsigned long long>(file.frames), kind,
+                        static_cast<unsigned long long>(file.headerFrames));
+        }
+        std::printf("%zu of %zu files have an exact length, %zu of those wrong\n", exact + wrong, files.size(), wrong);
+        if (wrong > 0) passed = false;
+    }
+
+    // Each window of the given files on its own, from a seek
+    if (inputs.size() > 0) {
+        Batch batch;
+        size_t seeks = 0;
+        for (const auto& file : files) {
+            for (const auto& window : file.windows) {
+                decodeInto(service, batch, file, window.start, kWindowFrames, DecodingService::Priority::Playhead);
+                seeks++;
+            }
+        }
+        batch.wait();
+        std::printf("%zu seeks into %zu files: %llu samples differ from decoding from the start\n", seeks,
+                    files.size(), static_cast<unsigned long long>(batch.wrongSamples.load()));
+        if (batch.failed > 0 || batch.wrongSamples > 0 || batch.frames < seeks * kWindowFrames) passed = false;
+    }
+
+    // One second somewhere under the playhead, against a full background load
+    {
+        Batch background;
+        for (const auto& file : files) {
+            decodeInto(service, background, file, 0, DecodingService::kToEnd, DecodingService::Priority::Background);
+        }
+        std::mt19937_64 random(11);
+        std::vector<double> latencyMs;
+        Batch located;
+        for (size_t i = 0; i < kLocates; i++) {
+            const auto& file = files[random() % files.size()];
+            auto frames = static_cast<uint64_t>(kLocateSeconds * kSampleRate);
+            uint64_t start = file.frames > frames ? random() % (file.frames - frames) : 0;
+            auto begin = Clock::now();
+            decodeInto(service, located, file, start, frames, DecodingService::Priority::Playhead);
+            located.wait();
+            latencyMs.push_back(std::chrono::duration<double, std::milli>(Clock::now() - begin).count());
+        }
+        background.wait();
+        std::sort(latencyMs.begin(), latencyMs.end());
+        std::printf("%zu locates during a background import: median %.1f ms, worst %.1f ms, %llu segments "
+                    "handed back\n",
+                    latencyMs.size(), latencyMs[latencyMs.size() / 2], latencyMs.back(),
+                    static_cast<unsigned long long>(service.stats().yields));
+        if (located.failed > 0 || located.wrongSamples > 0 || background.wrongSamples > 0) passed = false;
+    }
+
+    // A batch cancelled right after it starts
+    {
+        Batch batch;
+        std::vector<DecodingService::JobId> jobs;
+        std::vector<std::shared_ptr<std::atomic<bool>>> done;
+        for (const auto& file : files) {
+            done.push_back(std::make_shared<std::atomic<bool>>(false));
+            jobs.push_back(decodeInto(service, batch, file, 0, DecodingService::kToEnd,
+                                      DecodingService::Priority::Normal, done.back()));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        auto begin = Clock::now();
+        for (auto job : jobs) service.cancel(job);
+        batch.wait();
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+        std::printf("cancelled %zu of %zu jobs in %.1f ms, %.1f%% of their frames decoded, %llu blocks after "
+                    "finishing\n",
+                    batch.cancelled, jobs.size(), ms, 100.0 * double(batch.frames.load()) / double(totalFrames),
+                    static_cast<unsigned long long>(batch.lateBlocks.load()));
+        if (batch.failed > 0 || batch.lateBlocks > 0 || batch.wrongSamples > 0) passed = false;
+    }
+    service.stop();
+
+    if (!folder.empty() && !keep) std::filesystem::remove_all(folder, ec);
+    std::printf(passed ? "passed\n" : "FAILED\n");
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,376 @@
+// Minimal stereo gain effect for exercising the CLAP host on any platform.
+//
+// Parameter 0 sets the linear gain through CLAP_EVENT_PARAM_VALUE events
+// (sample accurate), note events are passed through to the output events
+// and each block is processed one channel per task on the host thread pool
+// when the host offers one. On deactivate it logs how many blocks went
+// through the pool so a host can check that clap.thread-pool works.
+//
+// clap.params exposes the gain and clap.state saves it followed by any
+// extra bytes the last loaded state carried. Those are read in full and
+// kept, the way a sampler keeps its sample data, so a host can measure
+// loading large states with this plugin.
+
+#include <clap/clap.h>
+#include <atomic>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr uint32_t kChannels = 2;
+constexpr clap_id kGainParam = 0;
+
+const char* const s_features[] = {
+    CLAP_PLUGIN_FEATURE_AUDIO_EFFECT,
+    CLAP_PLUGIN_FEATURE_UTILITY,
+    CLAP_PLUGIN_FEATURE_STEREO,
+    nullptr,
+};
+
+const clap_plugin_descriptor_t s_descriptor = {
+    CLAP_VERSION_INIT,
+    "com.futureboard.test.gain",
+    "Futureboard Test Gain",
+    "Futureboard",
+    "",
+    "",
+    "",
+    "1.0.0",
+    "Stereo gain used to test the CLAP host",
+    s_features,
+};
+
+struct GainPlugin {
+    clap_plugin_t plugin;
+    const clap_host_t* host = nullptr;
+    const clap_host_thread_pool_t* hostThreadPool = nullptr;
+    const clap_host_log_t* hostLog = nullptr;
+
+    float gain = 1.0f;
+    std::vector<uint8_t> sampleData;
+
+    // The block being processed, for the pool tasks
+    const clap_process_t* process = nullptr;
+    float blockGain = 1.0f;
+
+    uint64_t blocks = 0;
+    uint64_t pooledBlocks = 0;
+    std::atomic<uint32_t> pooledTasks{0};
+
+    void log(clap_log_severity severity, const std::string& message) const {
+        if (hostLog) hostLog->log(host, severity, message.c_str());
+    }
+};
+
+GainPlugin* self(const clap_plugin_t* plugin) {
+    return static_cast<GainPlugin*>(plugin->plugin_data);
+}
+
+void processChannel(GainPlugin* gain, uint32_t channel) {
+    const auto* process = gain->process;
+    const float* in = process->audio_inputs[0].data32[channel];
+    float* out = process->audio_outputs[0].data32[channel];
+    for (uint32_t i = 0; i < process->frames_count; i++) out[i] = in[i] * gain->blockGain;
+}
+
+// --- clap.audio-ports
+
+uint32_t audioPortsCount(const clap_plugin_t*, bool) {
+    return 1;
+}
+
+bool audioPortsGet(const clap_plugin_t*, uint32_t index, bool isInput, clap_audio_port_info_t* info) {
+    if (index != 0) return false;
+    info->id = 0;
+    std::strcpy(info->name, isInput ? "Input" : "Output");
+    info->flags = CLAP_AUDIO_PORT_IS_MAIN;
+    info->channel_count = kChannels;
+    info->port_type = "stereo";
+    info->in_place_pair = 0;
+    return true;
+}
+
+const clap_plugin_audio_ports_t s_audioPorts = {
+    audioPortsCount,
+    audioPortsGet,
+};
+
+// --- clap.thread-pool
+
+void threadPoolExec(const clap_plugin_t* plugin, uint32_t taskIndex) {
+    auto* gain = self(plugin);
+    processChannel(gain, taskIndex);
+    gain->pooledTasks.fetch_add(1, std::memory_order_relaxed);
+}
+
+const clap_plugin_thread_pool_t s_threadPool = {
+    threadPoolExec,
+};
+
+// --- clap.params
+
+uint32_t paramsCount(const clap_plugin_t*) {
+    return 1;
+}
+
+bool paramsGetInfo(const clap_plugin_t*, uint32_t index, clap_param_info_t* info) {
+    if (index != 0) return false;
+    *info = clap_param_info_t{};
+    info->id = kGainParam;
+    info->flags = CLAP_PARAM_IS_AUTOMATABLE;
+    std::strcpy(info->name, "Gain");
+    info->min_value = 0.0;
+    info->max_value = 2.0;
+    info->default_value = 1.0;
+    return true;
+}
+
+bool paramsGetValue(const clap_plugin_t* plugin, clap_id id, double* value) {
+    if (id != kGainParam) return false;
+    *value = self(plugin)->gain;
+    return true;
+}
+
+bool paramsValueToText(const clap_plugin_t*, clap_id id, double value, char* text, uint32_t capacity) {
+    if (id != kGainParam) return false;
+    std::snprintf(text, capacity, "%.3f", value);
+    return true;
+}
+
+bool paramsTextToValue(const clap_plugin_t*, clap_id id, const char* text, double* value) {
+    if (id != kGainParam) return false;
+    *value = std::strtod(text, nullptr);
+    return true;
+}
+
+void paramsFlush(const clap_plugin_t* plugin, const clap_input_events_t* in, const clap_output_events_t*) {
+    for (uint32_t e = 0; e < in->size(in); e++) {
+        const auto* event = in->get(in, e);
+        if (event->space_id != CLAP_CORE_EVENT_SPACE_ID || event->type != CLAP_EVENT_PARAM_VALUE) continue;
+        const auto* param = reinterpret_cast<const clap_event_param_value_t*>(event);
+        if (param->param_id == kGainParam) self(plugin)->gain = static_cast<float>(param->value);
+    }
+}
+
+const clap_plugin_params_t s_params = {
+    paramsCount,
+    paramsGetInfo,
+    paramsGetValue,
+    paramsValueToText,
+    paramsTextToValue,
+    paramsFlush,
+};
+
+// --- clap.state
+
+bool stateSave(const clap_plugin_t* plugin, const clap_ostream_t* stream) {
+    auto* gain = self(plugin);
+    double value = gain->gain;
+    if (stream->write(stream, &value, sizeof(value)) != sizeof(value)) return false;
+
+    size_t written = 0;
+    while (written < gain->sampleData.size()) {
+        int64_t count = stream->write(stream, gain->sampleData.data() + written, gain->sampleData.size() - written);
+        if (count <= 0) return false;
+        written += static_cast<size_t>(count);
+    }
+    return true;
+}
+
+bool stateLoad(const clap_plugin_t* plugin, const clap_istream_t* stream) {
+    auto* gain = self(plugin);
+    double value;
+    if (stream->read(stream, &value, sizeof(value)) != sizeof(value)) return false;
+
+    std::vector<uint8_t> sampleData;
+    uint8_t buffer[64 * 1024];
+    for (;;) {
+        int64_t count = stream->read(stream, buffer, sizeof(buffer));
+        if (count < 0) return false;
+        if (count == 0) break;
+        sampleData.insert(sampleData.end(), buffer, buffer + count);
+    }
+
+    gain->gain = static_cast<float>(value);
+    gain->sampleData = std::move(sampleData);
+    return true;
+}
+
+const clap_plugin_state_t s_state = {
+    stateSave,
+    stateLoad,
+};
+
+// --- clap_plugin
+
+bool pluginInit(const clap_plugin_t* plugin) {
+    auto* gain = self(plugin);
+    gain->hostThreadPool = static_cast<const clap_host_thread_pool_t*>(
+        gain->host->get_extension(gain->host, CLAP_EXT_THREAD_POOL));
+    gain->hostLog = static_cast<const clap_host_log_t*>(gain->host->get_extension(gain->host, CLAP_EXT_LOG));
+    return true;
+}
+
+void pluginDestroy(const clap_plugin_t* plugin) {
+    delete self(plugin);
+}
+
+bool pluginActivate(const clap_plugin_t* plugin, double, uint32_t, uint32_t) {
+    auto* gain = self(plugin);
+    gain->blocks = 0;
+    gain->pooledBlocks = 0;
+    gain->pooledTasks = 0;
+    return true;
+}
+
+void pluginDeactivate(const clap_plugin_t* plugin) {
+    auto* gain = self(plugin);
+    gain->log(CLAP_LOG_INFO, std::to_string(gain->blocks) + " blocks, " + std::to_string(gain->pooledBlocks) +
+                                 " on the host thread pool (" + std::to_string(gain->pooledTasks.load()) + " tasks)");
+}
+
+bool pluginStartProcessing(const clap_plugin_t*) {
+    return true;
+}
+
+void pluginStopProcessing(const clap_plugin_t*) {
+}
+
+void pluginReset(const clap_plugin_t*) {
+}
+
+void renderRange(GainPlugin* gain, const clap_process_t* process, uint32_t begin, uint32_t end) {
+    // Views of the block from begin to end, so the pool tasks see a whole
+    // block at the current gain
+    float* inputs[kChannels];
+    float* outputs[kChannels];
+    for (uint32_t c = 0; c < kChannels; c++) {
+        inputs[c] = process->audio_inputs[0].data32[c] + begin;
+        outputs[c] = process->audio_outputs[0].data32[c] + begin;
+    }
+    clap_audio_buffer_t in = process->audio_inputs[0];
+    clap_audio_buffer_t out = process->audio_outputs[0];
+    in.data32 = inputs;
+    out.data32 = outputs;
+
+    clap_process_t range = *process;
+    range.frames_count = end - begin;
+    range.audio_inputs = &in;
+    range.audio_outputs = &out;
+
+    gain->process = &range;
+    gain->blockGain = gain->gain;
+    if (gain->hostThreadPool && gain->hostThreadPool->request_exec(gain->host, kChannels)) {
+        gain->pooledBlocks++;
+    } else {
+        for (uint32_t c = 0; c < kChannels; c++) processChannel(gain, c);
+    }
+    gain->process = nullptr;
+}
+
+clap_process_status pluginProcess(const clap_plugin_t* plugin, const clap_process_t* process) {
+    auto* gain = self(plugin);
+    if (process->audio_inputs_count < 1 || process->audio_outputs_count < 1) return CLAP_PROCESS_ERROR;
+    gain->blocks++;
+
+    // Render up to each gain change
+    uint32_t begin = 0;
+    uint32_t eventCount = process->in_events->size(process->in_events);
+    for (uint32_t e = 0; e < eventCount; e++) {
+        const auto* event = process->in_events->get(process->in_events, e);
+        if (event->space_id != CLAP_CORE_EVENT_SPACE_ID) continue;
+
+        switch (event->type) {
+            case CLAP_EVENT_PARAM_VALUE: {
+                const auto* param = reinterpret_cast<const clap_event_param_value_t*>(event);
+                if (param->param_id != kGainParam) break;
+                uint32_t time = event->time < process->frames_count ? event->time : process->frames_count;
+                if (time > begin) renderRange(gain, process, begin, time);
+                begin = time;
+                gain->gain = static_cast<float>(param->value);
+                break;
+            }
+            case CLAP_EVENT_NOTE_ON:
+            case CLAP_EVENT_NOTE_OFF:
+            case CLAP_EVENT_MIDI:
+                process->out_events->try_push(process->out_events, event);
+                break;
+            default:
+                break;
+        }
+    }
+    if (begin < process->frames_count) renderRange(gain, process, begin, process->frames_count);
+
+    return CLAP_PROCESS_CONTINUE_IF_NOT_QUIET;
+}
+
+const void* pluginGetExtension(const clap_plugin_t*, const char* id) {
+    if (!std::strcmp(id, CLAP_EXT_AUDIO_PORTS)) return &s_audioPorts;
+    if (!std::strcmp(id, CLAP_EXT_THREAD_POOL)) return &s_threadPool;
+    if (!std::strcmp(id, CLAP_EXT_PARAMS)) return &s_params;
+    if (!std::strcmp(id, CLAP_EXT_STATE)) return &s_state;
+    return nullptr;
+}
+
+void pluginOnMainThread(const clap_plugin_t*) {
+}
+
+// --- Factory and entry
+
+uint32_t factoryGetPluginCount(const clap_plugin_factory_t*) {
+    return 1;
+}
+
+const clap_plugin_descriptor_t* factoryGetPluginDescriptor(const clap_plugin_factory_t*, uint32_t index) {
+    return index == 0 ? &s_descriptor : nullptr;
+}
+
+const clap_plugin_t* factoryCreatePlugin(const clap_plugin_factory_t*, const clap_host_t* host, const char* id) {
+    if (!clap_version_is_compatible(host->clap_version) || std::strcmp(id, s_descriptor.id) != 0) return nullptr;
+
+    auto* gain = new GainPlugin();
+    gain->host = host;
+    gain->plugin.desc = &s_descriptor;
+    gain->plugin.plugin_data = gain;
+    gain->plugin.init = pluginInit;
+    gain->plugin.destroy = pluginDestroy;
+    gain->plugin.activate = pluginActivate;
+    gain->plugin.deactivate = pluginDeactivate;
+    gain->plugin.start_processing = pluginStartProcessing;
+    gain->plugin.stop_processing = pluginStopProcessing;
+    gain->plugin.reset = pluginReset;
+    gain->plugin.process = pluginProcess;
+    gain->plugin.get_extension = pluginGetExtension;
+    gain->plugin.on_main_thread = pluginOnMainThread;
+    return &gain->plugin;
+}
+
+const clap_plugin_factory_t s_factory = {
+    factoryGetPluginCount,
+    factoryGetPluginDescriptor,
+    factoryCreatePlugin,
+};
+
+bool entryInit(const char*) {
+    return true;
+}
+
+void entryDeinit() {
+}
+
+const void* entryGetFactory(const char* id) {
+    return !std::strcmp(id, CLAP_PLUGIN_FACTORY_ID) ? &s_factory : nullptr;
+}
+
+} // namespace
+
+extern "C" CLAP_EXPORT const clap_plugin_entry_t clap_entry = {
+    CLAP_VERSION_INIT,
+    entryInit,
+    entryDeinit,
+    entryGetFactory,
+};
@@ -0,0 +1,257 @@
+// Loads the metronome sounds through MetronomeNode, checks that clicks land
+// on the exact frames the tempo and time signature put them on, whatever
+// the block size, and times a block while the metronome waits for its next
+// click, while it clicks and while it's stopped.
+//
+//   metronomebench [sound folder] [-r sample rate] [-b block size]
+//
+// The folder holds CB_Tick.wav, CB_Tock.wav, SQ_Tick.wav and SQ_Tock.wav,
+// resources/audio/metronome by default.
+
+#include "metronomenode.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Click {
+    int64_t frame;
+    bool accent;
+
+    bool operator==(const Click& other) const { return frame == other.frame && accent == other.accent; }
+};
+
+bool loadSound(const std::filesystem::path& path, MetronomeNode::Sound& sound, std::string& error) {
+    std::ifstream in(path, std::ios::binary);
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (!in && !in.eof()) {
+        error = "Cannot read " + path.string();
+        return false;
+    }
+    return MetronomeNode::Sound::fromWav(data.data(), data.size(), sound, error);
+}
+
+// A one-frame click, told apart by its level
+MetronomeNode::Sound impulse(uint32_t sampleRate, float level) {
+    MetronomeNode::Sound sound;
+    sound.channels = 1;
+    sound.sampleRate = sampleRate;
+    sound.samples = { level };
+    return sound;
+}
+
+class Renderer {
+public:
+    Renderer(MetronomeNode& node, uint32_t maxFrames)
+        : m_node(node)
+        , m_left(maxFrames)
+        , m_right(maxFrames)
+    {
+        m_outputs[0] = m_left.data();
+        m_outputs[1] = m_right.data();
+    }
+
+    // True when the block was flagged silent
+    bool render(uint32_t frames) {
+        uint64_t silent = 0;
+        AudioBlock block;
+        block.frames = frames;
+        block.outputs = m_outputs;
+        block.silentOutputs = &silent;
+        m_node.process(block);
+        return silent == 3;
+    }
+
+    const float* left() const { return m_left.data(); }
+
+private:
+    MetronomeNode& m_node;
+    std::vector<float> m_left;
+    std::vector<float> m_right;
+    float* m_outputs[2];
+};
+
+// Frames of beats from beat on, spaced framesPerBeat apart from the one at
+// anchorFrame, as MetronomeNode rounds them
+int64_t beatFrame(int64_t anchorFrame, int64_t anchorBeat, double framesPerBeat, int64_t beat) {
+    return anchorFrame + std::llround(double(beat - anchorBeat) * framesPerBeat);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::filesystem::path folder = "resources/audio/metronome";
+    uint32_t sampleRate = 44100;
+    uint32_t blockSize = 256;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "-r" && hasValue) {
+            sampleRate = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "-b" && hasValue) {
+            blockSize = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (!arg.empty() && arg[0] != '-') {
+            folder = arg;
+        } else {
+            std::printf("Usage: metronomebench [sound folder] [-r sample rate] [-b block size]\n");
+            return 2;
+        }
+    }
+    if (sampleRate == 0 || blockSize == 0) {
+        std::printf("Invalid sample rate or block size\n");
+        return 2;
+    }
+
+    MetronomeNode node;
+    std::string error;
+    const char* sets[][2] = { { "CB_Tick.wav", "CB_Tock.wav" }, { "SQ_Tick.wav", "SQ_Tock.wav" } };
+    double soundSeconds[2] = {};
+    std::vector<double> originalEnergy;
+    for (uint32_t set = 0; set < 2; set++) {
+        MetronomeNode::Sound accent;
+        MetronomeNode::Sound beat;
+        if (!loadSound(folder / sets[set][0], accent, error) || !loadSound(folder / sets[set][1], beat, error)) {
+            std::printf("Error: %s\n", error.c_str());
+            return 1;
+        }
+        double energy = 0.0;
+        for (size_t i = 0; i < accent.samples.size(); i += accent.channels) {
+            energy += double(accent.samples[i]) * accent.samples[i];
+        }
+        originalEnergy.push_back(energy / accent.sampleRate);
+        soundSeconds[set] = double(beat.samples.size() / beat.channels) / beat.sampleRate;
+        node.addSoundSet(std::move(accent), std::move(beat));
+    }
+    uint32_t impulses = node.addSoundSet(impulse(sampleRate, 1.0f), impulse(sampleRate, 0.5f));
+
+    auto begin = Clock::now();
+    if (!node.prepare(sampleRate, 512)) {
+        std::printf("Error: cannot prepare at %u Hz\n", sampleRate);
+        return 1;
+    }
+    double prepareMs = std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+    std::printf("sounds of %.2f and %.2f s resampled to %u Hz in %.1f ms\n", soundSeconds[0], soundSeconds[1],
+                sampleRate, prepareMs);
+
+    bool passed = true;
+    Renderer renderer(node, 512);
+
+    // A resampled accent carries the same energy per second as the original
+    for (uint32_t set = 0; set < 2; set++) {
+        node.setSoundSet(set);
+        node.setEnabled(true);
+        node.setTempo(MetronomeNode::kMinTempo);
+        node.start(0, 0);
+        double energy = 0.0;
+        for (uint64_t frame = 0; frame < uint64_t(soundSeconds[set] * sampleRate) + 512; frame += 512) {
+            renderer.render(512);
+            for (uint32_t i = 0; i < 512; i++) energy += double(renderer.left()[i]) * renderer.left()[i];
+        }
+        node.stop();
+        double db = 10.0 * std::log10(energy / sampleRate / originalEnergy[set]);
+        std::printf("%s at %u Hz: %+.3f dB from the original\n", sets[set][0], sampleRate, db);
+        if (std::abs(db) > 0.1) passed = false;
+    }
+
+    // Two bars of count-in with the metronome off, switched on between
+    // beats 1 and 2, then a tempo that doesn't divide the rate and 7/8,
+    // each set between two beats
+    double quarter = sampleRate * 60.0 / 120.0;
+    double changedTempo = 97.0;
+    double changedQuarter = sampleRate * 60.0 / changedTempo;
+    int64_t countIn = std::llround(8 * quarter);
+    int64_t enableAt = std::llround(1.5 * quarter);
+    int64_t tempoAt = std::llround(8.5 * quarter);
+    int64_t tempoFrame = beatFrame(0, 0, quarter, 9);
+    int64_t signatureAt = beatFrame(tempoFrame, 9, changedQuarter, 13) + std::llround(changedQuarter / 2);
+    int64_t signatureFrame = beatFrame(tempoFrame, 9, changedQuarter, 14);
+    int64_t end = signatureFrame + std::llround(20 * changedQuarter / 2);
+
+    std::vector<Click> expected;
+    for (int64_t beat = -8; ; beat++) {
+        int64_t frame;
+        bool accent;
+        if (beat <= 9) {
+            frame = beatFrame(0, 0, quarter, beat);
+            accent = beat % 4 == 0;
+        } else if (beat <= 14) {
+            frame = beatFrame(tempoFrame, 9, changedQuarter, beat);
+            accent = beat % 4 == 0;
+        } else {
+            frame = beatFrame(signatureFrame, 14, changedQuarter / 2, beat);
+            accent = (beat - 14) % 7 == 0;
+        }
+        if (beat == 14) accent = true;
+        if (frame >= end) break;
+        if (beat < 0 || frame >= enableAt) expected.push_back({ frame, accent });
+    }
+
+    std::mt19937 random(7);
+    const char* sizes[] = { "fixed", "odd", "random" };
+    for (int size = 0; size < 3; size++) {
+        node.setSoundSet(impulses);
+        node.setEnabled(false);
+        node.setTempo(120.0);
+        node.setTimeSignature(4, 4);
+        node.start(0, 2);
+        std::vector<Click> clicks;
+        int64_t frame = -countIn;
+        while (frame < end) {
+            if (frame >= enableAt) node.setEnabled(true);
+            if (frame >= tempoAt) node.setTempo(changedTempo);
+            if (frame >= signatureAt) node.setTimeSignature(7, 8);
+            uint32_t frames = blockSize;
+            if (size == 1) frames = 97;
+            if (size == 2) frames = 1 + random() % 512;
+            frames = static_cast<uint32_t>(std::min<int64_t>(std::min(frames, 512u), end - frame));
+            renderer.render(frames);
+            for (uint32_t i = 0; i < frames; i++) {
+                if (renderer.left()[i] != 0.0f) clicks.push_back({ frame + i, renderer.left()[i] == 1.0f });
+            }
+            frame += frames;
+        }
+        node.stop();
+        renderer.render(1);
+        bool exact = clicks == expected && node.position() == end;
+        std::printf("%zu of %zu clicks on their frames with %s blocks\n", exact ? clicks.size() : 0, expected.size(),
+                    sizes[size]);
+        if (!exact) passed = false;
+    }
+
+    // What a block costs stopped, running between clicks and while a long
+    // click rings
+    node.setSoundSet(1);
+    node.setEnabled(true);
+    node.setTempo(120.0);
+    node.setTimeSignature(4, 4);
+    auto timeBlocks = [&](const char* what, uint32_t blocks) {
+        uint32_t silent = 0;
+        auto begin = Clock::now();
+        for (uint32_t i = 0; i < blocks; i++) silent += renderer.render(blockSize);
+        double ns = std::chrono::duration<double, std::nano>(Clock::now() - begin).count() / blocks;
+        std::printf("  %-22s %7.0f ns per %u frame block, %u of %u silent\n", what, ns, blockSize, silent, blocks);
+        return silent;
+    };
+    uint32_t blocks = static_cast<uint32_t>(quarter * 0.9 / blockSize);
+    if (timeBlocks("stopped", blocks) != blocks) passed = false;
+
+    // Starting just past a beat leaves most of one to wait through
+    node.start(1, 0);
+    if (timeBlocks("waiting for a click", blocks) != blocks) passed = false;
+    node.start(0, 0);
+    timeBlocks("clicking", blocks);
+    node.stop();
+
+    std::printf(passed ? "passed\n" : "FAILED\n");
+    return passed ? 0 : 1;
+}
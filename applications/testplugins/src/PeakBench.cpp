@@ -0,0 +1,318 @@
+// Computes peak files through PeakCache and reports how fast, then checks
+// that asking again finds them up to date without decoding anything, times
+// drawing a screen-wide waveform at every zoom, and compares what is drawn
+// with the audio and with peaks written without the length up front.
+//
+//   peakbench [folder] [-n files] [-l file seconds] [-j threads] [-k]
+//
+// Writes 8 stereo 16-bit WAV files of 3 minutes into folder, the temp
+// folder by default. -k keeps the files for another run; their peak files
+// are rebuilt every run.
+
+#include "audiofile.hpp"
+#include "diskfile.hpp"
+#include "peakcache.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr uint32_t kSampleRate = 48000;
+constexpr uint32_t kChannels = 2;
+constexpr uint32_t kScreenPixels = 1920;
+
+// Exact as 16-bit; a sawtooth that differs per file and channel
+int16_t sampleFor(size_t file, uint32_t channel, uint64_t frame) {
+    return static_cast<int16_t>(int((frame * 13 + channel * 5000 + file * 331) % 65536) - 32768);
+}
+
+bool writeFile(const std::filesystem::path& path, size_t index, uint64_t frames, std::string& error) {
+    std::vector<uint8_t> header;
+    auto put32 = [&header](uint32_t value) {
+        for (int i = 0; i < 4; i++) header.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    };
+    auto put16 = [&header](uint16_t value) {
+        header.push_back(static_cast<uint8_t>(value));
+        header.push_back(static_cast<uint8_t>(value >> 8));
+    };
+    auto dataBytes = static_cast<uint32_t>(frames * kChannels * 2);
+    header.insert(header.end(), { 'R', 'I', 'F', 'F' });
+    put32(36 + dataBytes);
+    header.insert(header.end(), { 'W', 'A', 'V', 'E', 'f', 'm', 't', ' ' });
+    put32(16);
+    put16(1);
+    put16(kChannels);
+    put32(kSampleRate);
+    put32(kSampleRate * kChannels * 2);
+    put16(kChannels * 2);
+    put16(16);
+    header.insert(header.end(), { 'd', 'a', 't', 'a' });
+    put32(dataBytes);
+
+    DiskFile file;
+    if (!file.open(path, DiskFile::Mode::Create, false) || !file.writeAt(0, header.data(), header.size())) {
+        error = file.getError();
+        return false;
+    }
+    std::vector<int16_t> data(65536 * kChannels);
+    for (uint64_t frame = 0; frame < frames; frame += 65536) {
+        uint64_t count = std::min<uint64_t>(65536, frames - frame);
+        for (uint64_t i = 0; i < count; i++) {
+            for (uint32_t channel = 0; channel < kChannels; channel++) {
+                data[i * kChannels + channel] = sampleFor(index, channel, frame + i);
+            }
+        }
+        if (!file.writeAt(header.size() + frame * kChannels * 2, data.data(), size_t(count * kChannels * 2))) {
+            error = file.getError();
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::filesystem::path folder = std::filesystem::temp_directory_path() / "peakbench";
+    size_t fileCount = 8;
+    double fileSeconds = 180.0;
+    bool keep = false;
+    PeakCache::Options options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "-n" && hasValue) {
+            fileCount = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "-l" && hasValue) {
+            fileSeconds = std::strtod(argv[++i], nullptr);
+        } else if (arg == "-j" && hasValue) {
+            options.threads = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "-k") {
+            keep = true;
+        } else if (!arg.empty() && arg[0] != '-') {
+            folder = arg;
+        } else {
+            std::printf("Usage: peakbench [folder] [-n files] [-l file seconds] [-j threads] [-k]\n");
+            return 2;
+        }
+    }
+    if (fileCount == 0) {
+        std::printf("No files to compute\n");
+        return 2;
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(folder, ec);
+    auto frames = static_cast<uint64_t>(fileSeconds * kSampleRate);
+    std::vector<std::filesystem::path> paths;
+    std::string error;
+    uint64_t totalBytes = 0;
+    for (size_t i = 0; i < fileCount; i++) {
+        paths.push_back(folder / ("take" + std::to_string(i + 1) + ".wav"));
+        AudioFileInfo info;
+        bool current = std::filesystem::exists(paths.back(), ec) &&
+                       AudioFile::readInfo(paths.back(), info, error) && info.frames() == frames;
+        if (!current && !writeFile(paths.back(), i, frames, error)) {
+            std::printf("Error: %s\n", error.c_str());
+            return 1;
+        }
+        totalBytes += std::filesystem::file_size(paths.back(), ec);
+    }
+
+    PeakCache cache;
+    if (!cache.start(options, error)) {
+        std::printf("Error: %s\n", error.c_str());
+        return 1;
+    }
+    for (const auto& path : paths) std::filesystem::remove(cache.peakPath(path), ec);
+
+    bool passed = true;
+    {
+        std::mutex mutex;
+        std::condition_variable finished;
+        size_t pending = paths.size();
+        size_t failed = 0;
+        auto begin = Clock::now();
+        for (const auto& path : paths) {
+            bool ready = cache.ensure(path, DecodingService::Priority::Normal,
+                [&](const std::filesystem::path& source, DecodingService::Result result, const std::string& error) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (result != DecodingService::Result::Done) {
+                        std::printf("Error: %s: %s\n", source.string().c_str(), error.c_str());
+                        failed++;
+                    }
+                    if (--pending == 0) finished.notify_all();
+                });
+            if (ready) {
+                std::printf("Error: %s had peaks already\n", path.string().c_str());
+                return 1;
+            }
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [&] { return pending == 0; });
+        double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+
+        uint64_t peakBytes = 0;
+        for (const auto& path : paths) peakBytes += std::filesystem::file_size(cache.peakPath(path), ec);
+        std::printf("%zu files of %.0f s: peaks in %.2f s, %.1f files/s, %.1f MB/s, %.0fx real time\n", paths.size(),
+                    fileSeconds, seconds, double(paths.size()) / seconds, double(totalBytes) / 1e6 / seconds,
+                    double(frames * paths.size()) / kSampleRate / seconds);
+        std::printf("peak files are %.1f%% of the audio\n", 100.0 * double(peakBytes) / double(totalBytes));
+        passed = failed == 0;
+    }
+
+    // Reopening a project
+    {
+        auto begin = Clock::now();
+        size_t ready = 0;
+        for (const auto& path : paths) {
+            if (cache.ensure(path, DecodingService::Priority::Normal, nullptr)) ready++;
+        }
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+        std::printf("asked again: %zu of %zu up to date in %.2f ms\n", ready, paths.size(), ms);
+        if (ready != paths.size()) passed = false;
+    }
+
+    // Drawing the first file at every zoom, from a screen of a few samples
+    // per pixel out to the whole file on a fraction of the screen
+    auto peaks = cache.open(paths[0], error);
+    if (!peaks) {
+        std::printf("Error: %s\n", error.c_str());
+        return 1;
+    }
+    std::vector<PeakFile::Peak> row(kScreenPixels);
+    uint64_t wrong = 0;
+    double widest = std::max(double(frames) / kScreenPixels, 4.0 * PeakFile::kSamplesPerBin[PeakFile::kLevels - 1]);
+    for (double framesPerPixel = 16.0; framesPerPixel <= widest; framesPerPixel *= 4.0) {
+        // Start on a bin of the level drawn from, so each pixel covers
+        // exactly the frames checked below
+        uint32_t level = PeakFile::levelFor(framesPerPixel);
+        uint32_t binFrames = PeakFile::kSamplesPerBin[level];
+        uint64_t maxStart = frames > uint64_t(framesPerPixel * kScreenPixels)
+                                ? frames - uint64_t(framesPerPixel * kScreenPixels) : 0;
+        uint64_t start = maxStart / 3 / binFrames * binFrames;
+
+        auto begin = Clock::now();
+        constexpr int kDraws = 20;
+        for (int draw = 0; draw < kDraws; draw++) {
+            for (uint32_t channel = 0; channel < kChannels; channel++) {
+                if (!peaks->read(channel, double(start), framesPerPixel, kScreenPixels, row.data())) {
+                    std::printf("Error: %s\n", peaks->getError().c_str());
+                    return 1;
+                }
+            }
+        }
+        double us = std::chrono::duration<double, std::micro>(Clock::now() - begin).count() / kDraws;
+
+        // Only pixels made of whole bins are exact
+        uint32_t checked = 0;
+        if (framesPerPixel >= binFrames && std::fmod(framesPerPixel, binFrames) == 0.0) {
+            for (uint32_t pixel = 0; pixel < kScreenPixels; pixel++) {
+                auto from = static_cast<uint64_t>(double(start) + framesPerPixel * pixel);
+                auto to = std::min(frames, static_cast<uint64_t>(double(from) + framesPerPixel));
+                if (from >= to) break;
+                int low = INT16_MAX;
+                int high = INT16_MIN;
+                for (uint64_t frame = from; frame < to; frame++) {
+                    int value = sampleFor(0, kChannels - 1, frame);
+                    low = std::min(low, value);
+                    high = std::max(high, value);
+                }
+                // 16-bit in, quantized to 1/32767 on the way out
+                if (std::abs(row[pixel].min - float(low) / 32768.0f) > 1.5f / 32767.0f ||
+                    std::abs(row[pixel].max - float(high) / 32768.0f) > 1.5f / 32767.0f) {
+                    wrong++;
+                }
+                checked++;
+            }
+        }
+        std::printf("  %9.0f frames per pixel, level %u: %7.1f us per %u pixel stereo draw%s\n", framesPerPixel,
+                    level, us, kScreenPixels, checked > 0 ? ", checked" : "");
+    }
+    std::printf("%llu pixels differ from the audio\n", static_cast<unsigned long long>(wrong));
+    if (wrong > 0) passed = false;
+
+    // A changed file isn't taken for its old peaks. The first frame is
+    // silenced and then put back.
+    {
+        int16_t original[kChannels];
+        int16_t silence[kChannels] = {};
+        for (uint32_t channel = 0; channel < kChannels; channel++) {
+            original[channel] = sampleFor(paths.size() - 1, channel, 0);
+        }
+        auto overwrite = [&paths](const int16_t* frame) {
+            std::FILE* out = std::fopen(paths.back().string().c_str(), "r+b");
+            bool written = out && std::fseek(out, 44, SEEK_SET) == 0 && std::fwrite(frame, 2, kChannels, out) == kChannels;
+            if (out) std::fclose(out);
+            return written;
+        };
+        bool changed = overwrite(silence);
+        bool stale = !cache.open(paths.back(), error);
+        changed = overwrite(original) && changed;
+        std::printf("after changing a file its peaks are %s\n", stale ? "stale" : "still taken");
+        if (!changed || !stale) passed = false;
+    }
+
+    // Without the length up front, as for a FLAC stream written without
+    // one, the peaks are the same. Blocks go in back to front.
+    {
+        std::filesystem::path unknownPath = folder / ("unknown" + std::string(PeakFile::kExtension));
+        PeakWriter writer;
+        bool written = writer.create(unknownPath, kChannels, kSampleRate, PeakWriter::kUnknownLength,
+                                     PeakFingerprint(), error);
+        constexpr uint32_t kBlock = 4 * PeakWriter::kAlignment;
+        std::vector<float> samples(size_t(kBlock) * kChannels);
+        for (uint64_t start = (frames - 1) / kBlock * kBlock; written; start -= kBlock) {
+            auto count = static_cast<uint32_t>(std::min<uint64_t>(kBlock, frames - start));
+            const float* channels[kChannels];
+            for (uint32_t channel = 0; channel < kChannels; channel++) {
+                float* samplesOut = samples.data() + size_t(channel) * kBlock;
+                for (uint32_t i = 0; i < count; i++) samplesOut[i] = sampleFor(0, channel, start + i) / 32768.0f;
+                channels[channel] = samplesOut;
+            }
+            written = writer.add(start, channels, count);
+            if (start == 0) break;
+        }
+        PeakFile unknown;
+        written = writer.finish(error) && written && unknown.open(unknownPath, nullptr, error);
+        uint64_t differ = 0;
+        for (uint32_t level = 0; written && level < PeakFile::kLevels; level++) {
+            uint32_t binFrames = PeakFile::kSamplesPerBin[level];
+            auto bins = static_cast<uint32_t>((frames + binFrames - 1) / binFrames);
+            std::vector<PeakFile::Peak> expected(bins);
+            std::vector<PeakFile::Peak> actual(bins);
+            for (uint32_t channel = 0; written && channel < kChannels; channel++) {
+                written = peaks->read(channel, 0.0, binFrames, bins, expected.data()) &&
+                          unknown.read(channel, 0.0, binFrames, bins, actual.data());
+                if (!written) error = peaks->getError() + unknown.getError();
+                for (uint32_t bin = 0; written && bin < bins; bin++) {
+                    if (std::memcmp(&expected[bin], &actual[bin], sizeof(PeakFile::Peak)) != 0) differ++;
+                }
+            }
+        }
+        if (!written) std::printf("Error: %s\n", error.c_str());
+        std::printf("written without the length, %llu bins differ\n", static_cast<unsigned long long>(differ));
+        if (!written || differ > 0 || unknown.frames() != frames) passed = false;
+        std::filesystem::remove(unknownPath, ec);
+    }
+    cache.stop();
+
+    for (const auto& path : paths) {
+        std::filesystem::remove(cache.peakPath(path), ec);
+        if (!keep) std::filesystem::remove(path, ec);
+    }
+    if (!keep) std::filesystem::remove(folder, ec);
+    std::printf(passed ? "passed\n" : "FAILED\n");
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,209 @@
+// Loads large presets into the test gain plugin while a simulated audio
+// thread renders through AudioGraph in real time, the way AudioEngine does
+// when the user browses presets during playback.
+//
+//   presetbench <futureboard-testgain.clap> [megabytes ...]
+//
+// For each state size it writes a .ftpreset, then repeatedly reads it,
+// loads it into a fresh instance and swaps that in with replaceNode() and
+// commit(). It reports how long each step takes on the loading side and
+// the slowest audio block seen meanwhile, which should stay far below the
+// block's real-time budget however large the state is.
+
+#include "audiograph.hpp"
+#include "audiothread.hpp"
+#include "clappluginnode.hpp"
+#include "presetfile.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr double kSampleRate = 48000.0;
+constexpr uint32_t kFrames = 128;
+constexpr int kLoads = 10;
+const char* kGainPluginId = "com.futureboard.test.gain";
+
+double elapsedMs(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+double median(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+// Renders blocks on its own thread, paced like a device callback
+class AudioThread {
+public:
+    explicit AudioThread(AudioGraph& graph) : m_graph(graph) {
+        m_thread = std::thread([this] { run(); });
+    }
+
+    ~AudioThread() {
+        m_running = false;
+        m_thread.join();
+    }
+
+    // Slowest block since the last call, in milliseconds
+    double takeWorstBlock() { return m_worstBlock.exchange(0.0); }
+    float lastOutputPeak() const { return m_peak; }
+
+private:
+    void run() {
+        audiothread::Scope audioThread;
+        std::vector<float> input(2 * kFrames), output(2 * kFrames);
+        const float* inputs[] = { input.data(), input.data() + kFrames };
+        float* outputs[] = { output.data(), output.data() + kFrames };
+        std::fill(input.begin(), input.end(), 0.5f);
+
+        auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(kFrames / kSampleRate));
+        auto next = Clock::now();
+        while (m_running) {
+            auto start = Clock::now();
+            m_graph.process(inputs, outputs, kFrames);
+            double took = elapsedMs(start);
+
+            double worst = m_worstBlock.load();
+            while (took > worst && !m_worstBlock.compare_exchange_weak(worst, took)) {}
+            float peak = 0.0f;
+            for (float sample : output) peak = std::max(peak, std::fabs(sample));
+            m_peak = peak;
+
+            next += period;
+            std::this_thread::sleep_until(next);
+        }
+    }
+
+    AudioGraph& m_graph;
+    std::thread m_thread;
+    std::atomic<bool> m_running{true};
+    std::atomic<double> m_worstBlock{0.0};
+    std::atomic<float> m_peak{0.0f};
+};
+
+int bench(const std::filesystem::path& pluginPath, size_t megabytes) {
+    std::string error;
+    auto first = ClapPluginNode::create(pluginPath, kGainPluginId, error);
+    if (!first) {
+        std::printf("Error: %s\n", error.c_str());
+        return 1;
+    }
+
+    AudioGraph graph(2, 2);
+    auto id = graph.addNode(first);
+    for (uint32_t channel = 0; channel < 2; channel++) {
+        graph.connect(AudioGraph::kInputNode, channel, id, channel);
+        graph.connect(id, channel, AudioGraph::kOutputNode, channel);
+    }
+    if (!graph.prepare(kSampleRate, kFrames)) {
+        std::printf("Error: %s\n", graph.getError().c_str());
+        return 1;
+    }
+
+    // The plugin's own state followed by the "sample data"
+    PluginPreset preset;
+    if (!first->saveState(preset, error)) {
+        std::printf("Error: %s\n", error.c_str());
+        return 1;
+    }
+    const double gain = 0.25;
+    std::memcpy(preset.state.data(), &gain, sizeof(gain));
+    std::mt19937_64 random(42);
+    size_t stateBytes = megabytes * 1024 * 1024;
+    preset.state.resize(sizeof(gain) + stateBytes);
+    for (size_t i = sizeof(gain); i + 8 <= preset.state.size(); i += 8) {
+        uint64_t word = random();
+        std::memcpy(&preset.state[i], &word, 8);
+    }
+
+    auto file = std::filesystem::temp_directory_path() / ("presetbench-" + std::to_string(megabytes) + ".ftpreset");
+    auto start = Clock::now();
+    if (!PresetFile::write(file, preset, error)) {
+        std::printf("Error: %s\n", error.c_str());
+        return 1;
+    }
+    double writeMs = elapsedMs(start);
+    preset = PluginPreset();
+
+    std::vector<double> readMs, createMs, loadMs, swapMs;
+    double worstBlock = 0.0;
+    bool ok = true;
+    {
+        AudioThread audio(graph);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        audio.takeWorstBlock();
+
+        for (int i = 0; i < kLoads && ok; i++) {
+            // What AudioEngine::load_preset does on a worker thread
+            PluginPreset loaded;
+            start = Clock::now();
+            ok = PresetFile::read(file, loaded, error);
+            readMs.push_back(elapsedMs(start));
+
+            // And what applyPreset does on the main thread
+            start = Clock::now();
+            auto node = ok ? ClapPluginNode::create(pluginPath, loaded.pluginId, error) : nullptr;
+            createMs.push_back(elapsedMs(start));
+            ok = ok && node;
+
+            start = Clock::now();
+            ok = ok && node->loadState(loaded, error);
+            loadMs.push_back(elapsedMs(start));
+
+            start = Clock::now();
+            ok = ok && graph.replaceNode(id, node) && graph.commit();
+            swapMs.push_back(elapsedMs(start));
+            if (!ok && error.empty()) error = graph.getError();
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        worstBlock = audio.takeWorstBlock();
+        if (ok && std::fabs(audio.lastOutputPeak() - 0.5f * gain) > 1e-6) {
+            error = "output doesn't reflect the preset's gain";
+            ok = false;
+        }
+    }
+    std::filesystem::remove(file);
+
+    if (!ok) {
+        std::printf("Error: %s\n", error.c_str());
+        return 1;
+    }
+
+    double budgetMs = 1000.0 * kFrames / kSampleRate;
+    std::printf("%5zu MB  write %8.1f ms  read %8.1f ms  create %6.2f ms  load %8.1f ms  swap %6.2f ms  "
+                "worst block %6.3f ms of %.3f\n",
+                megabytes, writeMs, median(readMs), median(createMs), median(loadMs), median(swapMs), worstBlock,
+                budgetMs);
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::printf("Usage: presetbench <futureboard-testgain.clap> [megabytes ...]\n");
+        return 2;
+    }
+
+    std::vector<size_t> sizes;
+    for (int i = 2; i < argc; i++) sizes.push_back(std::strtoul(argv[i], nullptr, 10));
+    if (sizes.empty()) sizes = { 1, 16, 64, 256 };
+
+    std::printf("%d loads per size, medians; blocks of %u frames at %.0f Hz\n", kLoads, kFrames, kSampleRate);
+    for (size_t megabytes : sizes) {
+        if (int result = bench(argv[1], megabytes)) return result;
+    }
+    return 0;
+}
@@ -0,0 +1,194 @@
+// Records many tracks at once through DiskRecorder while a simulated audio
+// thread hands it blocks in real time, the way AudioEngine records takes.
+//
+//   recordbench <folder> [-t tracks] [-r rate] [-s seconds] [-f wav|rf64|w64] [-d] [-k]
+//
+// Defaults to 128 mono tracks at 96 kHz for 20 seconds. -d uses direct
+// I/O, -k keeps the files. It reports how long the write() calls take,
+// which must stay far below the block's budget however busy the disk is,
+// the frames dropped because a ring filled up, how full the rings got and
+// the rate written; then it reads every file back and checks its samples.
+
+#include "audiofile.hpp"
+#include "audiothread.hpp"
+#include "diskfile.hpp"
+#include "diskrecorder.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr uint32_t kFrames = 128;
+
+// Exactly representable and different for every track and nearby frame,
+// so a sample out of place shows up
+float sampleFor(size_t track, uint64_t frame) {
+    return static_cast<float>((frame * 31 + track * 977) % 65536) / 65536.0f;
+}
+
+bool verify(const std::filesystem::path& path, size_t track, uint32_t sampleRate, uint64_t expectedFrames,
+            std::string& error) {
+    AudioFileInfo info;
+    if (!AudioFile::readInfo(path, info, error)) return false;
+    if (info.channels != 1 || info.sampleRate != sampleRate || !info.isFloat || info.bitsPerSample != 32) {
+        error = "wrong format";
+        return false;
+    }
+    if (info.frames() != expectedFrames) {
+        error = std::to_string(info.frames()) + " frames instead of " + std::to_string(expectedFrames);
+        return false;
+    }
+
+    DiskFile file;
+    if (!file.open(path, DiskFile::Mode::Read, false)) {
+        error = file.getError();
+        return false;
+    }
+    std::vector<float> samples(1 << 16);
+    for (uint64_t frame = 0; frame < info.frames(); frame += samples.size()) {
+        size_t count = static_cast<size_t>(std::min<uint64_t>(samples.size(), info.frames() - frame));
+        if (file.readAt(info.dataOffset + frame * 4, samples.data(), count * 4) != int64_t(count * 4)) {
+            error = "short read";
+            return false;
+        }
+        for (size_t i = 0; i < count; i++) {
+            if (samples[i] != sampleFor(track, frame + i)) {
+                error = "wrong sample at frame " + std::to_string(frame + i);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::printf("Usage: recordbench <folder> [-t tracks] [-r rate] [-s seconds] [-f wav|rf64|w64] [-d] [-k]\n");
+        return 2;
+    }
+
+    std::filesystem::path folder = argv[1];
+    size_t trackCount = 128;
+    uint32_t sampleRate = 96000;
+    double seconds = 20.0;
+    bool keep = false;
+    DiskRecorder::Options options;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "-t" && hasValue) {
+            trackCount = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "-r" && hasValue) {
+            sampleRate = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "-s" && hasValue) {
+            seconds = std::strtod(argv[++i], nullptr);
+        } else if (arg == "-f" && hasValue) {
+            std::string format = argv[++i];
+            options.format = format == "w64" ? AudioFileFormat::W64
+                           : format == "rf64" ? AudioFileFormat::Rf64 : AudioFileFormat::Wav;
+        } else if (arg == "-d") {
+            options.directIo = true;
+        } else if (arg == "-k") {
+            keep = true;
+        } else {
+            std::printf("Unknown option %s\n", arg.c_str());
+            return 2;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(folder, ec);
+    std::vector<DiskRecorder::Track> tracks;
+    for (size_t i = 0; i < trackCount; i++) {
+        tracks.push_back({ folder / ("track" + std::to_string(i + 1) + AudioFile::extension(options.format)), 1 });
+    }
+
+    DiskRecorder recorder;
+    std::string error;
+    if (!recorder.start(tracks, sampleRate, options, error)) {
+        std::printf("Error: %s\n", error.c_str());
+        return 1;
+    }
+
+    // The audio thread: every track's block each period, nothing else
+    auto blocks = static_cast<uint64_t>(seconds * sampleRate / kFrames);
+    std::vector<std::vector<float>> buffers(trackCount, std::vector<float>(kFrames));
+    std::vector<double> blockUs;
+    blockUs.reserve(blocks);
+    auto begin = Clock::now();
+    {
+        audiothread::Scope audioThread;
+        auto period = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(double(kFrames) / sampleRate));
+        auto next = Clock::now();
+        for (uint64_t block = 0; block < blocks; block++) {
+            for (size_t track = 0; track < trackCount; track++) {
+                for (uint32_t i = 0; i < kFrames; i++) buffers[track][i] = sampleFor(track, block * kFrames + i);
+            }
+
+            auto start = Clock::now();
+            for (size_t track = 0; track < trackCount; track++) {
+                const float* channels[] = { buffers[track].data() };
+                recorder.write(track, channels, kFrames);
+            }
+            double took = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+            blockUs.push_back(took);
+
+            next += period;
+            std::this_thread::sleep_until(next);
+        }
+    }
+    double elapsed = std::chrono::duration<double>(Clock::now() - begin).count();
+
+    auto stopStart = Clock::now();
+    bool stopped = recorder.stop(error);
+    double stopMs = std::chrono::duration<double, std::milli>(Clock::now() - stopStart).count();
+    auto stats = recorder.stats();
+    if (!stopped) {
+        std::printf("Error: %s\n", error.c_str());
+        return 1;
+    }
+
+    double budgetUs = 1e6 * kFrames / sampleRate;
+    std::printf("%zu tracks at %u Hz, %.1f s in blocks of %u frames%s\n", trackCount, sampleRate, seconds, kFrames,
+                options.directIo ? ", direct I/O" : "");
+    // On a machine with fewer cores than threads the worst block includes
+    // the writer thread preempting this one, which an audio thread's
+    // priority prevents; the percentiles show the work itself
+    std::sort(blockUs.begin(), blockUs.end());
+    auto percentile = [&blockUs](double fraction) {
+        return blockUs.empty() ? 0.0 : blockUs[static_cast<size_t>(fraction * double(blockUs.size() - 1))];
+    };
+    std::printf("write() for all tracks: median %.1f us, 99%% %.1f us, 99.9%% %.1f us, worst %.1f us of %.1f us "
+                "per block\n",
+                percentile(0.5), percentile(0.99), percentile(0.999), percentile(1.0), budgetUs);
+    std::printf("dropped %llu frames, rings at most %.0f%% full, %.1f MB/s written, stop took %.1f ms\n",
+                static_cast<unsigned long long>(stats.droppedFrames), 100.0 * stats.maxBufferFill,
+                double(stats.bytesWritten) / elapsed / 1e6, stopMs);
+
+    bool ok = stats.droppedFrames == 0;
+    if (ok) {
+        for (size_t track = 0; track < trackCount && ok; track++) {
+            if (!verify(tracks[track].path, track, sampleRate, blocks * kFrames, error)) {
+                std::printf("Error: %s: %s\n", tracks[track].path.string().c_str(), error.c_str());
+                ok = false;
+            }
+        }
+        if (ok) std::printf("All files verified\n");
+    }
+
+    if (!keep) {
+        for (const auto& track : tracks) std::filesystem::remove(track.path, ec);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,299 @@
+// Plays many clips at once through DiskStreamer from a simulated audio
+// thread, locating tracks at random the whole time, the way a session is
+// scrubbed around during playback.
+//
+//   streambench <folder> [-t tracks] [-l file seconds] [-s seconds] [-m cache MB] [-k]
+//
+// Defaults to 200 tracks of 30 second files, half stereo float and half
+// mono 16-bit, played for 20 seconds at 48 kHz with a 512 MB cache. Every
+// quarter second a tenth of the tracks jump somewhere else; like a
+// transport, the bench holds a track back after a jump until
+// DiskStreamer::isReady() says its data is there. Every fourth track loops
+// a stretch of its clip. Every sample played is checked, and no frame
+// should ever be missed. -k keeps the files for another run.
+
+#include "audiofile.hpp"
+#include "audiothread.hpp"
+#include "diskfile.hpp"
+#include "diskstreamer.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr uint32_t kSampleRate = 48000;
+constexpr uint32_t kFrames = 256;
+constexpr double kSeekSeconds = 0.25;
+constexpr double kSeekFraction = 0.1;
+constexpr double kLoopSeconds = 1.5;
+
+// Exact both as float and as 16-bit, different per track, channel and frame
+int16_t sampleFor(size_t track, uint32_t channel, uint64_t frame) {
+    return static_cast<int16_t>(int((frame * 13 + channel * 5000 + track * 331) % 65536) - 32768);
+}
+
+uint32_t channelsFor(size_t track) {
+    return track % 2 == 0 ? 2 : 1;
+}
+
+bool writeClip(const std::filesystem::path& path, size_t track, uint64_t frames, std::string& error) {
+    DiskFile file;
+    if (!file.open(path, DiskFile::Mode::Create, false)) {
+        error = file.getError();
+        return false;
+    }
+    uint32_t channels = channelsFor(track);
+    bool isFloat = channels == 2;
+    uint32_t sampleBytes = isFloat ? 4 : 2;
+
+    // The float files get the recorder's header, the 16-bit ones the plain
+    // 44-byte one most software writes
+    std::vector<uint8_t> header;
+    if (isFloat) {
+        header.resize(AudioFile::kHeaderSize);
+        AudioFile::writeHeader(header.data(), AudioFileFormat::Wav, channels, kSampleRate,
+                               frames * channels * sampleBytes);
+    } else {
+        auto put32 = [&header](uint32_t value) {
+            for (int i = 0; i < 4; i++) header.push_back(static_cast<uint8_t>(value >> (8 * i)));
+        };
+        auto put16 = [&header](uint16_t value) {
+            header.push_back(static_cast<uint8_t>(value));
+            header.push_back(static_cast<uint8_t>(value >> 8));
+        };
+        auto dataBytes = static_cast<uint32_t>(frames * 2);
+        header.insert(header.end(), { 'R', 'I', 'F', 'F' });
+        put32(36 + dataBytes);
+        header.insert(header.end(), { 'W', 'A', 'V', 'E', 'f', 'm', 't', ' ' });
+        put32(16);
+        put16(1);
+        put16(1);
+        put32(kSampleRate);
+        put32(kSampleRate * 2);
+        put16(2);
+        put16(16);
+        header.insert(header.end(), { 'd', 'a', 't', 'a' });
+        put32(dataBytes);
+    }
+    if (!file.writeAt(0, header.data(), header.size())) {
+        error = file.getError();
+        return false;
+    }
+
+    std::vector<uint8_t> data(65536 * channels * sampleBytes);
+    for (uint64_t frame = 0; frame < frames; frame += 65536) {
+        uint64_t count = std::min<uint64_t>(65536, frames - frame);
+        for (uint64_t i = 0; i < count; i++) {
+            for (uint32_t channel = 0; channel < channels; channel++) {
+                int16_t value = sampleFor(track, channel, frame + i);
+                uint8_t* p = data.data() + (i * channels + channel) * sampleBytes;
+                if (isFloat) {
+                    float sample = float(value) / 32768.0f;
+                    std::memcpy(p, &sample, 4);
+                } else {
+                    std::memcpy(p, &value, 2);
+                }
+            }
+        }
+        uint64_t offset = header.size() + frame * channels * sampleBytes;
+        if (!file.writeAt(offset, data.data(), size_t(count * channels * sampleBytes))) {
+            error = file.getError();
+            return false;
+        }
+    }
+    return true;
+}
+
+// What the bench expects a track to be playing
+struct TrackState {
+    DiskStreamer::ClipId clip = DiskStreamer::kInvalidClip;
+    uint64_t frames = 0;
+    uint64_t position = 0;
+    uint64_t loopStart = 0;
+    uint64_t loopEnd = 0;
+    bool waiting = false;
+    uint64_t seekBlock = 0;
+};
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::printf("Usage: streambench <folder> [-t tracks] [-l file seconds] [-s seconds] [-m cache MB] [-k]\n");
+        return 2;
+    }
+
+    std::filesystem::path folder = argv[1];
+    size_t trackCount = 200;
+    double fileSeconds = 30.0;
+    double seconds = 20.0;
+    bool keep = false;
+    DiskStreamer::Options options;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "-t" && hasValue) {
+            trackCount = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "-l" && hasValue) {
+            fileSeconds = std::strtod(argv[++i], nullptr);
+        } else if (arg == "-s" && hasValue) {
+            seconds = std::strtod(argv[++i], nullptr);
+        } else if (arg == "-m" && hasValue) {
+            options.memoryBudget = size_t(std::strtoul(argv[++i], nullptr, 10)) * 1024 * 1024;
+        } else if (arg == "-k") {
+            keep = true;
+        } else {
+            std::printf("Unknown option %s\n", arg.c_str());
+            return 2;
+        }
+    }
+
+    auto fileFrames = static_cast<uint64_t>(fileSeconds * kSampleRate);
+    std::error_code ec;
+    std::filesystem::create_directories(folder, ec);
+    std::vector<std::filesystem::path> paths;
+    std::string error;
+    auto begin = Clock::now();
+    for (size_t track = 0; track < trackCount; track++) {
+        paths.push_back(folder / ("clip" + std::to_string(track + 1) + ".wav"));
+        AudioFileInfo info;
+        bool current = std::filesystem::exists(paths.back(), ec) &&
+                       AudioFile::readInfo(paths.back(), info, error) && info.frames() == fileFrames;
+        if (!current && !writeClip(paths.back(), track, fileFrames, error)) {
+            std::printf("Error: %s\n", error.c_str());
+            return 1;
+        }
+    }
+    std::printf("%zu clips of %.0f s ready in %.1f s\n", trackCount, fileSeconds,
+                std::chrono::duration<double>(Clock::now() - begin).count());
+
+    DiskStreamer streamer;
+    if (!streamer.start(options, error)) {
+        std::printf("Error: %s\n", error.c_str());
+        return 1;
+    }
+
+    std::mt19937_64 random(7);
+    auto randomFrame = [&random, fileFrames]() { return random() % fileFrames; };
+    std::vector<TrackState> tracks(trackCount);
+    for (size_t track = 0; track < trackCount; track++) {
+        auto& state = tracks[track];
+        state.clip = streamer.addClip(paths[track], error);
+        if (state.clip == DiskStreamer::kInvalidClip) {
+            std::printf("Error: %s\n", error.c_str());
+            return 1;
+        }
+        state.frames = fileFrames;
+        if (track % 4 == 3) {
+            state.loopStart = randomFrame() / 2;
+            state.loopEnd = state.loopStart + static_cast<uint64_t>(kLoopSeconds * kSampleRate);
+            streamer.setLoop(state.clip, state.loopStart, state.loopEnd);
+        }
+        state.position = randomFrame();
+        streamer.seek(state.clip, state.position);
+        state.waiting = true;
+    }
+
+    // The audio thread, which also plays transport and locates tracks
+    auto blocks = static_cast<uint64_t>(seconds * kSampleRate / kFrames);
+    auto seekEvery = static_cast<uint64_t>(kSeekSeconds * kSampleRate / kFrames);
+    auto seeksPerRound = std::max<size_t>(1, static_cast<size_t>(double(trackCount) * kSeekFraction));
+    std::vector<float> left(kFrames), right(kFrames);
+    float* outputs[] = { left.data(), right.data() };
+    std::vector<double> blockUs;
+    std::vector<double> locateMs;
+    blockUs.reserve(blocks);
+    uint64_t wrongSamples = 0;
+    uint64_t waitingBlocks = 0;
+    uint64_t missedFrames = 0;
+    {
+        audiothread::Scope audioThread;
+        auto period = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(double(kFrames) / kSampleRate));
+        auto next = Clock::now();
+        for (uint64_t block = 0; block < blocks; block++) {
+            if (block > 0 && block % seekEvery == 0) {
+                for (size_t i = 0; i < seeksPerRound; i++) {
+                    auto& state = tracks[random() % trackCount];
+                    state.position = randomFrame();
+                    streamer.seek(state.clip, state.position);
+                    state.waiting = true;
+                    state.seekBlock = block;
+                }
+            }
+
+            // Only the play() calls count; the checking is the bench's own
+            double playUs = 0.0;
+            for (size_t track = 0; track < trackCount; track++) {
+                auto& state = tracks[track];
+                if (state.waiting) {
+                    if (!streamer.isReady(state.clip)) {
+                        waitingBlocks++;
+                        continue;
+                    }
+                    state.waiting = false;
+                    if (state.seekBlock > 0) {
+                        locateMs.push_back(1000.0 * double(block - state.seekBlock) * kFrames / kSampleRate);
+                    }
+                }
+
+                auto start = Clock::now();
+                missedFrames += streamer.play(state.clip, outputs, 2, kFrames);
+                playUs += std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+
+                bool looping = state.loopEnd > state.loopStart;
+                uint32_t channels = channelsFor(track);
+                for (uint32_t i = 0; i < kFrames; i++) {
+                    if (looping && state.position >= state.loopEnd) state.position = state.loopStart;
+                    bool inside = state.position < (looping ? state.loopEnd : state.frames);
+                    for (uint32_t channel = 0; channel < 2; channel++) {
+                        float expected = inside
+                            ? float(sampleFor(track, std::min(channel, channels - 1), state.position)) / 32768.0f
+                            : 0.0f;
+                        if (outputs[channel][i] != expected) wrongSamples++;
+                    }
+                    if (inside) state.position++;
+                }
+            }
+            blockUs.push_back(playUs);
+
+            next += period;
+            std::this_thread::sleep_until(next);
+        }
+    }
+    auto stats = streamer.stats();
+    streamer.stop();
+
+    std::sort(blockUs.begin(), blockUs.end());
+    std::sort(locateMs.begin(), locateMs.end());
+    auto percentile = [](const std::vector<double>& values, double fraction) {
+        return values.empty() ? 0.0 : values[static_cast<size_t>(fraction * double(values.size() - 1))];
+    };
+    std::printf("%zu tracks, %.1f s in blocks of %u frames at %u Hz, %zu locates\n", trackCount, seconds, kFrames,
+                kSampleRate, locateMs.size());
+    std::printf("play() for all tracks: median %.1f us, 99%% %.1f us, worst %.1f us of %.1f us\n",
+                percentile(blockUs, 0.5), percentile(blockUs, 0.99), percentile(blockUs, 1.0),
+                1e6 * kFrames / kSampleRate);
+    std::printf("locate to ready: median %.1f ms, 99%% %.1f ms, worst %.1f ms\n", percentile(locateMs, 0.5),
+                percentile(locateMs, 0.99), percentile(locateMs, 1.0));
+    std::printf("cache: %zu of %zu blocks resident, %llu loaded, %llu evicted, %.1f MB read\n", stats.residentBlocks,
+                stats.poolBlocks, static_cast<unsigned long long>(stats.blocksLoaded),
+                static_cast<unsigned long long>(stats.evictions), double(stats.bytesRead) / 1e6);
+    std::printf("missed %llu frames, %llu wrong samples, %llu track blocks held back after locating\n",
+                static_cast<unsigned long long>(missedFrames), static_cast<unsigned long long>(wrongSamples),
+                static_cast<unsigned long long>(waitingBlocks));
+
+    if (!keep) {
+        for (const auto& path : paths) std::filesystem::remove(path, ec);
+    }
+    return missedFrames == 0 && wrongSamples == 0 ? 0 : 1;
+}
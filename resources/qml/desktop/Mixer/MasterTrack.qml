@@ -345,10 +345,10 @@ Rectangle {
     FileDialog {
         id: savePresetDialog
         title: "Save Master Preset"
-        nameFilters: ["XML files (*.xml)"]
+        nameFilters: ["Futureboard presets (*.ftpreset)"]
         fileMode: FileDialog.SaveFile
         onAccepted: {
-            audioEngine.save_preset(selectedFile)
+            AudioEngine.save_preset(selectedFile)
         }
     }
 }
@@ -245,6 +245,20 @@ Rectangle {
             border.color: "#0A0B08"
         }
 
+        // Scanned plugins, reloaded whenever a running scanner reports changes
+        PluginBrowserModel {
+            id: pluginBrowser
+            query: searchField.text
+            formatFilter: pluginTypeBar.currentItem ? pluginTypeBar.currentItem.text : ""
+            Component.onCompleted: loadDatabase(ConfigManager.pluginDatabasePath)
+        }
+
+        PluginScanFeed {
+            streamPath: ConfigManager.pluginScanStreamPath
+            onPluginsChanged: pluginBrowser.reloadDatabase()
+            onScanCompleted: pluginBrowser.reloadDatabase()
+        }
+
         ColumnLayout {
             anchors.fill: parent
             anchors.margins: 8
@@ -297,6 +311,20 @@ Rectangle {
                         verticalAlignment: Text.AlignVCenter
                     }
                 }
+                TabButton {
+                    text: "CLAP"
+                    font.family: "Inter"
+                    background: Rectangle {
+                        color: parent.checked ? "#353B41" : "#272C32"
+                    }
+                    contentItem: Text {
+                        text: parent.text
+                        color: "white"
+                        font: parent.font
+                        horizontalAlignment: Text.AlignHCenter
+                        verticalAlignment: Text.AlignVCenter
+                    }
+                }
             }
 
             ListView {
@@ -304,13 +332,7 @@ Rectangle {
                 Layout.fillWidth: true
                 Layout.fillHeight: true
                 clip: true
-                model: ListModel {
-                    id: pluginModel
-                    // Placeholder items
-                    ListElement { name: "EQ Plugin"; type: "VST2"; path: "" }
-                    ListElement { name: "Compressor"; type: "VST3"; path: "" }
-                    ListElement { name: "Reverb"; type: "VST2"; path: "" }
-                }
+                model: pluginBrowser
 
                 delegate: Rectangle {
                     width: ListView.view.width
@@ -330,7 +352,7 @@ Rectangle {
                         }
 
                         Text {
-                            text: type
+                            text: vendor
                             color: "#8193A1"
                             font.family: "Inter"
                         }
@@ -341,10 +363,15 @@ Rectangle {
                         anchors.fill: parent
                         hoverEnabled: true
                         onClicked: {
+                            // The engine hosts CLAP plugins, warm from the
+                            // instance pool when one is ready
+                            var nodeId = format === "CLAP" ? AudioEngine.insertPlugin(path, pluginId) : -1
+                            if (format === "CLAP" && nodeId < 0) return
                             efxModel.insert(efxList.count, { 
                                 "name": name,
-                                "type": type,
+                                "type": format,
                                 "path": path,
+                                "nodeId": nodeId,
                                 "isEnabled": true
                             })
                             pluginSelectorPopup.close()
@@ -402,6 +429,8 @@ Rectangle {
                     text: "\uE792"  // Save icon
                     color: "#272C32"
                     font.family: "Segoe Fluent Icons"
+                    opacity: enabled ? 1.0 : 0.4
+                    enabled: AudioEngine.presetNode >= 0
                     MouseArea {
                         anchors.fill: parent
                         onClicked: savePresetDialog.open()
@@ -411,6 +440,8 @@ Rectangle {
                     text: "\uE7C1"  // Open icon
                     color: "#272C32"
                     font.family: "Segoe Fluent Icons"
+                    opacity: enabled ? 1.0 : 0.4
+                    enabled: AudioEngine.presetNode >= 0
                     MouseArea {
                         anchors.fill: parent
                         onClicked: loadPresetDialog.open()
@@ -570,9 +601,15 @@ Rectangle {
                     delegate: Rectangle {
                         width: parent.width
                         height: 30
-                        color: "#1B1F24"
+                        color: nodeId >= 0 && nodeId === AudioEngine.presetNode ? "#252B31" : "#1B1F24"
                         border.color: "#0A0B08"
 
+                        // Selects the plugin the preset buttons act on
+                        MouseArea {
+                            anchors.fill: parent
+                            onClicked: AudioEngine.presetNode = nodeId
+                        }
+
                         RowLayout {
                             anchors.fill: parent
                             anchors.margins: 4
@@ -616,7 +653,10 @@ Rectangle {
                                 font.family: "Segoe Fluent Icons"
                                 MouseArea {
                                     anchors.fill: parent
-                                    onClicked: efxModel.remove(index)
+                                    onClicked: {
+                                        AudioEngine.removePlugin(nodeId)
+                                        efxModel.remove(index)
+                                    }
                                 }
                             }
                         }
@@ -885,20 +925,20 @@ Rectangle {
     FileDialog {
         id: savePresetDialog
         title: "Save Preset"
-        nameFilters: ["XML files (*.xml)"]
+        nameFilters: ["Futureboard presets (*.ftpreset)"]
         fileMode: FileDialog.SaveFile
         onAccepted: {
-            audioEngine.save_preset(selectedFile)
+            AudioEngine.save_preset(selectedFile)
         }
     }
 
     FileDialog {
         id: loadPresetDialog
         title: "Load Preset"
-        nameFilters: ["XML files (*.xml)"]
+        nameFilters: ["Futureboard presets (*.ftpreset)"]
         fileMode: FileDialog.OpenFile
         onAccepted: {
-            audioEngine.load_preset(selectedFile)
+            AudioEngine.load_preset(selectedFile)
         }
     }
 }
\ No newline at end of file
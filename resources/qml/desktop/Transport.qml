@@ -196,7 +196,12 @@ Rectangle {
                     onPressed: parent.color = "#353B41"
                     onReleased: parent.color = "#272C32"
                     onClicked: {
-                        // Add your click handling logic here
+                        if (index === 2) {
+                            if (AudioEngine.metronomeRunning) AudioEngine.stopMetronome()
+                            else AudioEngine.startMetronome()
+                        } else if (index === 4) {
+                            AudioEngine.metronomeEnabled = !AudioEngine.metronomeEnabled
+                        }
                     }
                 }
             }
@@ -297,11 +302,13 @@ Rectangle {
 
     function updateTempo(tempo) {
         currentTempo = tempo
+        AudioEngine.tempo = parseFloat(tempo)
     }
 
     function updateTimeSignature(num, denom) {
         signatureNumerator = num
         signatureDenominator = denom
+        AudioEngine.setTimeSignature(num, denom)
     }
 
     function updateTimeDisplay(time, beat) {
@@ -1,14 +1,42 @@
 // audioengine.cpp
 #include "audioengine.hpp"
 #include "core/config/configmanager.hpp"
+#include "core/engine/clappluginnode.hpp"
+#include "core/plugins/plugininstancepool.hpp"
+#include <QDateTime>
 #include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QThreadPool>
+#include <QTimer>
+#include <QUrl>
+#include <algorithm>
 #include <stdexcept>
+#include <thread>
 // #include <asiosys.h>
 // #include <asio.h>
 // #include <asiodrivers.h>
 
 AudioEngine* AudioEngine::s_instance = nullptr;
 
+namespace {
+
+// How often messages plugins logged off the main thread are passed on, in ms
+constexpr int kPluginLogInterval = 250;
+
+void logPluginMessage(const char* plugin, clap_log_severity severity, const char* message) {
+    QString line = QStringLiteral("[%1] %2").arg(QString::fromUtf8(plugin), QString::fromUtf8(message));
+    if (severity == CLAP_LOG_DEBUG) {
+        qDebug().noquote() << line;
+    } else if (severity == CLAP_LOG_INFO) {
+        qInfo().noquote() << line;
+    } else {
+        qWarning().noquote() << line;
+    }
+}
+
+} // namespace
+
 AudioEngine& AudioEngine::instance() {
     if (!s_instance) {
         s_instance = new AudioEngine();
@@ -30,6 +58,23 @@ AudioEngine::AudioEngine()
     , m_captureClient(nullptr)
     , m_mixFormat(nullptr)
 {
+    m_graph.setWorkerPool(&m_workers);
+    loadMetronome();
+
+    // Plugins also log from the audio thread, which only queues messages
+    ClapPluginNode::setLogHandler(logPluginMessage);
+    auto* pluginLogTimer = new QTimer(this);
+    connect(pluginLogTimer, &QTimer::timeout, this, []() { ClapPluginNode::flushLog(); });
+    pluginLogTimer->start(kPluginLogInterval);
+
+    // Peaks are background work; leave a core to the audio thread
+    PeakCache::Options peakOptions;
+    peakOptions.threads = std::max(2u, std::thread::hardware_concurrency()) - 1;
+    std::string peakError;
+    if (!m_peaks.start(peakOptions, peakError)) {
+        qWarning() << "Cannot compute waveform peaks:" << QString::fromStdString(peakError);
+    }
+
     // Initialize COM for WASAPI
     HRESULT hr = CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED);
     if (SUCCEEDED(hr)) {
@@ -41,6 +86,7 @@ AudioEngine::AudioEngine()
 }
 
 AudioEngine::~AudioEngine() {
+    m_peaks.stop();
     m_isCapturing = false;
     cleanupAudio();
     
@@ -110,17 +156,23 @@ void AudioEngine::startPortAudioStream(int deviceIndex) {
     PaStreamParameters inputParams;
     inputParams.device = deviceIndex;
     inputParams.channelCount = 2;
-    inputParams.sampleFormat = paFloat32;
+    inputParams.sampleFormat = paFloat32 | paNonInterleaved;
     inputParams.suggestedLatency = deviceInfo->defaultLowInputLatency;
     inputParams.hostApiSpecificStreamInfo = nullptr;
 
     PaStreamParameters outputParams;
     outputParams.device = deviceIndex;
     outputParams.channelCount = 2;
-    outputParams.sampleFormat = paFloat32;
+    outputParams.sampleFormat = paFloat32 | paNonInterleaved;
     outputParams.suggestedLatency = deviceInfo->defaultLowOutputLatency;
     outputParams.hostApiSpecificStreamInfo = nullptr;
 
+    if (!m_graph.prepare(44100, m_bufferSize)) {
+        qWarning() << "Error preparing engine graph:" << QString::fromStdString(m_graph.getError());
+    }
+    // Preparing stops the metronome
+    emit metronomeRunningChanged();
+
     PaError err = Pa_OpenStream(
         &m_paStream,
         deviceInfo->maxInputChannels > 0 ? &inputParams : nullptr,
@@ -508,27 +560,330 @@ int AudioEngine::streamCallback(
     void* userData
 ) {
     AudioEngine* engine = static_cast<AudioEngine*>(userData);
-    const float* in = static_cast<const float*>(input);
+    // Non-interleaved: one buffer per channel
+    const float* const* in = static_cast<const float* const*>(input);
+    float* const* out = static_cast<float* const*>(output);
     
     if (in && engine->m_isCapturing) {
         float leftSum = 0.0f, rightSum = 0.0f;
         for (unsigned long i = 0; i < frameCount; i++) {
-            leftSum += std::abs(in[i * 2]);
-            rightSum += std::abs(in[i * 2 + 1]);
+            leftSum += std::abs(in[0][i]);
+            rightSum += std::abs(in[1][i]);
         }
         
         emit engine->levelsChanged(leftSum / frameCount, rightSum / frameCount);
     }
+
+    if (in) {
+        engine->m_recorder.write(0, in, static_cast<uint32_t>(frameCount));
+    }
+
+    if (out) {
+        engine->m_graph.process(in, out, static_cast<uint32_t>(frameCount));
+    }
     
     return paContinue;
 }
 
+namespace {
+
+// Long enough for a reverb or delay tail to die away smoothly, short
+// enough that the two instances don't both run for long
+constexpr double kPresetFadeSeconds = 0.5;
+
+// The file dialogs hand over URLs
+QString presetPath(const QString& path) {
+    QUrl url(path);
+    return url.isLocalFile() ? url.toLocalFile() : path;
+}
+
+std::filesystem::path toPath(const QString& path) {
+    return std::filesystem::path(path.toStdU16String());
+}
+
+} // namespace
+
 void AudioEngine::save_preset(const QString& path) {
-    qDebug() << "Saving preset to:" << path;
+    auto* node = dynamic_cast<ClapPluginNode*>(m_graph.node(m_presetNode));
+    if (!node) {
+        emit errorOccurred("No plugin selected to save a preset from");
+        return;
+    }
+
+    // The plugin hands over its state on the main thread; writing it out
+    // can happen elsewhere
+    auto preset = std::make_shared<PluginPreset>();
+    std::string error;
+    if (!node->saveState(*preset, error)) {
+        emit errorOccurred(QString::fromStdString(error));
+        return;
+    }
+
+    QString filePath = presetPath(path);
+    QThreadPool::globalInstance()->start([this, preset, filePath]() {
+        std::string error;
+        bool saved = PresetFile::write(toPath(filePath), *preset, error);
+        QMetaObject::invokeMethod(this, [this, saved, filePath, error]() {
+            if (saved) {
+                emit presetSaved(filePath);
+            } else {
+                emit errorOccurred(QString::fromStdString(error));
+            }
+        }, Qt::QueuedConnection);
+    });
 }
 
 void AudioEngine::load_preset(const QString& path) {
-    qDebug() << "Loading preset from:" << path;
+    // Browsing quickly through presets queues up reads; only the newest counts
+    quint64 generation = ++m_presetGeneration;
+    QString filePath = presetPath(path);
+    QThreadPool::globalInstance()->start([this, generation, filePath]() {
+        auto preset = std::make_shared<PluginPreset>();
+        std::string error;
+        bool loaded = PresetFile::read(toPath(filePath), *preset, error);
+        QMetaObject::invokeMethod(this, [this, generation, filePath, preset, loaded, error]() {
+            if (generation != m_presetGeneration) return;
+            if (loaded) {
+                applyPreset(filePath, *preset);
+            } else {
+                emit errorOccurred(QString::fromStdString(error));
+            }
+        }, Qt::QueuedConnection);
+    });
+}
+
+void AudioEngine::applyPreset(const QString& path, const PluginPreset& preset) {
+    auto* current = dynamic_cast<ClapPluginNode*>(m_graph.node(m_presetNode));
+    if (!current) {
+        emit errorOccurred("No plugin selected to load the preset into");
+        return;
+    }
+
+    // A second instance takes the preset and is activated while the current
+    // one keeps playing, so the audio thread never waits on the plugin
+    // loading its state. Rather than swapping them between two blocks,
+    // which would cut off the old one's notes and tails mid-playback, the
+    // graph cross-fades from the old instance to the new one. Browsing
+    // presets isn't inserting the plugin, so it doesn't count for the pool.
+    QString error;
+    auto node = PluginInstancePool::instance().takeReplacement(
+        QString::fromStdU16String(current->path().u16string()), QString::fromStdString(preset.pluginId), &error);
+    if (!node) {
+        emit errorOccurred(error);
+        return;
+    }
+
+    std::string message;
+    if (!node->loadState(preset, message) || !m_graph.crossfadeNode(m_presetNode, node, kPresetFadeSeconds) ||
+        !m_graph.commit()) {
+        if (message.empty()) message = m_graph.getError();
+        emit errorOccurred(QString::fromStdString(message));
+        return;
+    }
+    // Drops the old instance once it has faded out
+    QTimer::singleShot(static_cast<int>(kPresetFadeSeconds * 1000) + 100, this, [this]() { m_graph.commit(); });
+    emit presetLoaded(path);
+}
+
+int AudioEngine::insertPlugin(const QString& path, const QString& pluginId) {
+    QString error;
+    auto node = PluginInstancePool::instance().take(path, pluginId, &error);
+    if (!node) {
+        emit errorOccurred(error);
+        return -1;
+    }
+
+    connectInserts(false);
+    AudioGraph::NodeId id = m_graph.addNode(node);
+    m_inserts.push_back(id);
+    connectInserts(true);
+    // Without a running stream the graph is committed once it's prepared
+    if (m_paStream && !m_graph.commit()) {
+        emit errorOccurred(QString::fromStdString(m_graph.getError()));
+        connectInserts(false);
+        m_inserts.pop_back();
+        m_graph.removeNode(id);
+        connectInserts(true);
+        return -1;
+    }
+    setPresetNode(static_cast<int>(id));
+    return static_cast<int>(id);
+}
+
+void AudioEngine::removePlugin(int nodeId) {
+    auto id = static_cast<AudioGraph::NodeId>(nodeId);
+    auto it = std::find(m_inserts.begin(), m_inserts.end(), id);
+    if (it == m_inserts.end()) return;
+
+    connectInserts(false);
+    m_inserts.erase(it);
+    if (id == m_presetNode) setPresetNode(-1);
+    m_graph.removeNode(id);
+    connectInserts(true);
+    if (m_paStream) m_graph.commit();
+}
+
+int AudioEngine::getPresetNode() const {
+    return m_presetNode == AudioGraph::kInvalidNode ? -1 : static_cast<int>(m_presetNode);
+}
+
+void AudioEngine::setPresetNode(int nodeId) {
+    // Only inserted plugins take presets
+    auto id = static_cast<AudioGraph::NodeId>(nodeId);
+    if (std::find(m_inserts.begin(), m_inserts.end(), id) == m_inserts.end()) id = AudioGraph::kInvalidNode;
+    if (id == m_presetNode) return;
+    m_presetNode = id;
+    emit presetNodeChanged();
+}
+
+void AudioEngine::connectInserts(bool connected) {
+    // Nothing passes the inputs through while there are no inserts
+    if (m_inserts.empty()) return;
+
+    AudioGraph::NodeId source = AudioGraph::kInputNode;
+    auto link = [&](AudioGraph::NodeId destination) {
+        for (uint32_t channel = 0; channel < 2; channel++) {
+            if (connected) {
+                m_graph.connect(source, channel, destination, channel);
+            } else {
+                m_graph.disconnect(source, channel, destination, channel);
+            }
+        }
+        source = destination;
+    };
+    for (AudioGraph::NodeId id : m_inserts) link(id);
+    link(AudioGraph::kOutputNode);
+}
+
+void AudioEngine::startRecording(const QString& folder) {
+    if (m_recorder.isRecording()) return;
+    if (!m_paStream) {
+        emit errorOccurred("Start the audio device before recording");
+        return;
+    }
+
+    QDir dir(presetPath(folder));
+    if (!dir.mkpath(".")) {
+        emit errorOccurred("Cannot create " + dir.path());
+        return;
+    }
+
+    DiskRecorder::Options options;
+    QString name = "Take " + QDateTime::currentDateTime().toString("yyyyMMdd-HHmmss") + AudioFile::extension(options.format);
+    m_recordingPath = dir.filePath(name);
+
+    const PaStreamInfo* info = Pa_GetStreamInfo(m_paStream);
+    auto sampleRate = static_cast<uint32_t>(info && info->sampleRate > 0 ? info->sampleRate : 44100);
+
+    std::string error;
+    if (!m_recorder.start({ { toPath(m_recordingPath), 2 } }, sampleRate, options, error)) {
+        emit errorOccurred(QString::fromStdString(error));
+        return;
+    }
+    emit recordingChanged();
+}
+
+void AudioEngine::stopRecording() {
+    if (!m_recorder.isRecording()) return;
+
+    std::string error;
+    bool saved = m_recorder.stop(error);
+    auto stats = m_recorder.stats();
+    if (stats.droppedFrames > 0) {
+        qWarning() << "Recording dropped" << stats.droppedFrames << "frames, the disk did not keep up";
+    }
+    emit recordingChanged();
+    if (saved) {
+        emit recordingSaved(m_recordingPath);
+        requestPeaks(m_recordingPath);
+    } else {
+        emit errorOccurred(QString::fromStdString(error));
+    }
+}
+
+bool AudioEngine::requestPeaks(const QString& path, bool visible) {
+    auto priority = visible ? DecodingService::Priority::Playhead : DecodingService::Priority::Background;
+    return m_peaks.ensure(toPath(path), priority,
+        [this, path](const std::filesystem::path&, DecodingService::Result result, const std::string& error) {
+            QMetaObject::invokeMethod(this, [this, path, result, error]() {
+                if (result == DecodingService::Result::Done) {
+                    emit peaksReady(path);
+                } else if (result == DecodingService::Result::Failed) {
+                    emit errorOccurred(QString::fromStdString(error));
+                }
+            }, Qt::QueuedConnection);
+        });
+}
+
+void AudioEngine::loadMetronome() {
+    // Each set has a sound for the first beat of a bar and one for the rest
+    const char* sets[][2] = { { "CB_Tick.wav", "CB_Tock.wav" }, { "SQ_Tick.wav", "SQ_Tock.wav" } };
+    m_metronome = std::make_shared<MetronomeNode>();
+    for (const auto& set : sets) {
+        MetronomeNode::Sound sounds[2];
+        for (int i = 0; i < 2; i++) {
+            QFile file(QString(":/audio/metronome/") + set[i]);
+            QByteArray data = file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+            std::string error;
+            if (!MetronomeNode::Sound::fromWav(reinterpret_cast<const uint8_t*>(data.constData()),
+                                               static_cast<size_t>(data.size()), sounds[i], error)) {
+                qWarning() << "Cannot load metronome sound" << set[i] << ":" << QString::fromStdString(error);
+            }
+        }
+        m_metronome->addSoundSet(std::move(sounds[0]), std::move(sounds[1]));
+    }
+    m_metronome->setTempo(m_tempo);
+
+    AudioGraph::NodeId id = m_graph.addNode(m_metronome);
+    m_graph.connect(id, 0, AudioGraph::kOutputNode, 0);
+    m_graph.connect(id, 1, AudioGraph::kOutputNode, 1);
+}
+
+void AudioEngine::setMetronomeEnabled(bool enabled) {
+    if (enabled == m_metronome->isEnabled()) return;
+    m_metronome->setEnabled(enabled);
+    emit metronomeChanged();
+}
+
+void AudioEngine::setMetronomeSound(int sound) {
+    if (sound < 0 || sound == m_metronomeSound) return;
+    m_metronomeSound = sound;
+    m_metronome->setSoundSet(static_cast<uint32_t>(sound));
+    emit metronomeChanged();
+}
+
+void AudioEngine::setCountInBars(int bars) {
+    bars = std::max(0, bars);
+    if (bars == m_countInBars) return;
+    m_countInBars = bars;
+    emit metronomeChanged();
+}
+
+void AudioEngine::setTempo(double bpm) {
+    bpm = std::clamp(bpm, MetronomeNode::kMinTempo, MetronomeNode::kMaxTempo);
+    if (bpm == m_tempo) return;
+    m_tempo = bpm;
+    m_metronome->setTempo(bpm);
+    emit tempoChanged();
+}
+
+void AudioEngine::setTimeSignature(int numerator, int denominator) {
+    if (numerator <= 0 || denominator <= 0) return;
+    m_metronome->setTimeSignature(static_cast<uint32_t>(numerator), static_cast<uint32_t>(denominator));
+}
+
+void AudioEngine::startMetronome() {
+    if (!m_paStream) {
+        emit errorOccurred("Start the audio device before the metronome");
+        return;
+    }
+    m_metronome->start(0, static_cast<uint32_t>(m_countInBars));
+    emit metronomeRunningChanged();
+}
+
+void AudioEngine::stopMetronome() {
+    m_metronome->stop();
+    emit metronomeRunningChanged();
 }
 
 // WASAPI methods
@@ -10,6 +10,12 @@
 #include <audioclient.h>
 #include <functiondiscoverykeys_devpkey.h>
 #include "../config/configmanager.hpp"  // Add this line
+#include "../engine/audiograph.hpp"
+#include "../engine/audioworkerpool.hpp"
+#include "../engine/diskrecorder.hpp"
+#include "../engine/metronomenode.hpp"
+#include "../engine/peakcache.hpp"
+#include "../engine/presetfile.hpp"
 
 class AudioEngine : public QObject {
     Q_OBJECT
@@ -39,6 +45,13 @@ public:
     Q_PROPERTY(QString currentInput READ getCurrentInput WRITE setCurrentInput NOTIFY currentInputChanged)
     Q_PROPERTY(QStringList devices READ getDevices NOTIFY devicesChanged)
     Q_PROPERTY(QStringList asioDevices READ getAsioDevices NOTIFY asioDevicesChanged)
+    Q_PROPERTY(bool isRecording READ isRecording NOTIFY recordingChanged)
+    Q_PROPERTY(bool metronomeEnabled READ isMetronomeEnabled WRITE setMetronomeEnabled NOTIFY metronomeChanged)
+    Q_PROPERTY(bool metronomeRunning READ isMetronomeRunning NOTIFY metronomeRunningChanged)
+    Q_PROPERTY(int metronomeSound READ getMetronomeSound WRITE setMetronomeSound NOTIFY metronomeChanged)
+    Q_PROPERTY(int countInBars READ getCountInBars WRITE setCountInBars NOTIFY metronomeChanged)
+    Q_PROPERTY(double tempo READ getTempo WRITE setTempo NOTIFY tempoChanged)
+    Q_PROPERTY(int presetNode READ getPresetNode WRITE setPresetNode NOTIFY presetNodeChanged)
 
     // Getters
     QStringList getAudioApis() const { return m_audioApis; }
@@ -75,10 +88,48 @@ public:
     Q_INVOKABLE void showAsioPanel();
     Q_INVOKABLE void save_preset(const QString& path);
     Q_INVOKABLE void load_preset(const QString& path);
+    // Records the device inputs into a new file in folder
+    Q_INVOKABLE void startRecording(const QString& folder);
+    Q_INVOKABLE void stopRecording();
+    bool isRecording() const { return m_recorder.isRecording(); }
+    // Makes sure the audio file has a peak file to draw its waveform from.
+    // Returns true when it's already there, otherwise peaksReady() follows
+    // once it's computed; asking again for a file being drawn right now
+    // moves it ahead of the rest.
+    Q_INVOKABLE bool requestPeaks(const QString& path, bool visible = false);
+    PeakCache& peaks() { return m_peaks; }
+
+    // The metronome clicks while it runs and is enabled; the count-in
+    // before it clicks either way
+    bool isMetronomeEnabled() const { return m_metronome->isEnabled(); }
+    void setMetronomeEnabled(bool enabled);
+    bool isMetronomeRunning() const { return m_metronome->isRunning(); }
+    int getMetronomeSound() const { return m_metronomeSound; }
+    void setMetronomeSound(int sound);
+    int getCountInBars() const { return m_countInBars; }
+    void setCountInBars(int bars);
+    double getTempo() const { return m_tempo; }
+    void setTempo(double bpm);
+    Q_INVOKABLE void setTimeSignature(int numerator, int denominator);
+    Q_INVOKABLE void startMetronome();
+    Q_INVOKABLE void stopMetronome();
 
     bool initializePortAudio();  // Move from private to public
     bool hasScannedDevices() const;
 
+    // What the stream renders: two device inputs and two outputs. Edit on
+    // the main thread, changes are heard after AudioGraph::commit().
+    AudioGraph& graph() { return m_graph; }
+    // Adds a plugin to the end of the insert chain between the device
+    // inputs and outputs, taking a warm instance from PluginInstancePool
+    // when there is one, and selects it for presets. Returns the plugin's
+    // node id, or -1 after errorOccurred() when it can't be loaded.
+    Q_INVOKABLE int insertPlugin(const QString& path, const QString& pluginId);
+    Q_INVOKABLE void removePlugin(int nodeId);
+    // The inserted plugin save_preset() and load_preset() act on, -1 for none
+    int getPresetNode() const;
+    void setPresetNode(int nodeId);
+
 signals:
     void levelsChanged(float left, float right);
     void devicesChanged();
@@ -100,6 +151,15 @@ signals:
     void asioDevicesChanged();
     void deviceChanged();
     void errorOccurred(const QString& error);
+    void presetSaved(const QString& path);
+    void presetLoaded(const QString& path);
+    void recordingChanged();
+    void recordingSaved(const QString& path);
+    void peaksReady(const QString& path);
+    void metronomeChanged();
+    void metronomeRunningChanged();
+    void tempoChanged();
+    void presetNodeChanged();
 
 public slots:
 
@@ -159,6 +219,37 @@ private:
     // PortAudio
     PaStream* m_paStream;
 
+    // Engine graph and the threads hosted plugins may use
+    AudioWorkerPool m_workers;
+    AudioGraph m_graph{ 2, 2 };
+
+    // Presets are read on a worker thread; only the last one asked for is
+    // applied once it arrives
+    void applyPreset(const QString& path, const PluginPreset& preset);
+    AudioGraph::NodeId m_presetNode = AudioGraph::kInvalidNode;
+
+    // Inserted plugins in signal order; connectInserts() wires or unwires
+    // the chain from the device inputs through them to the outputs
+    void connectInserts(bool connected);
+    std::vector<AudioGraph::NodeId> m_inserts;
+    quint64 m_presetGeneration = 0;
+
+    // Takes are written by the recorder's own thread; the callback only
+    // hands it the input
+    DiskRecorder m_recorder;
+    QString m_recordingPath;
+
+    // Waveform overviews, computed in the background on their own threads
+    PeakCache m_peaks;
+
+    // Decoded from the resources once; prepared with the graph, which
+    // resamples the sounds to the device rate
+    void loadMetronome();
+    std::shared_ptr<MetronomeNode> m_metronome;
+    int m_metronomeSound = 0;
+    int m_countInBars = 1;
+    double m_tempo = 120.0;
+
     // WASAPI
     IMMDeviceEnumerator* m_deviceEnumerator;
     IMMDevice* m_currentDevice;
@@ -4,6 +4,7 @@
 #include <QStandardPaths>
 #include <QDir>
 #include <QFile>
+#include <QFileInfo>
 #include <QJsonDocument>
 #include <QJsonArray>
 #include <QJsonObject>
@@ -80,6 +81,14 @@ QString ConfigManager::getConfigPath() const {
     return m_configPath;
 }
 
+QString ConfigManager::getPluginDatabasePath() const {
+    return QFileInfo(m_configPath).dir().filePath("plugins.ftbdb");
+}
+
+QString ConfigManager::getPluginScanStreamPath() const {
+    return QFileInfo(m_configPath).dir().filePath("pluginscan.ndjson");
+}
+
 void ConfigManager::setConfig(const QJsonObject& config) {
     m_config = config;
     emit configChanged();
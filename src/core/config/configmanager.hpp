@@ -13,6 +13,8 @@ class ConfigManager : public QObject {
     Q_PROPERTY(QString lastOutputDevice READ getLastOutputDevice NOTIFY configChanged)
     Q_PROPERTY(int lastBufferSize READ getLastBufferSize NOTIFY configChanged)
     Q_PROPERTY(int lastAudioAPI READ getLastAudioAPI NOTIFY configChanged)
+    Q_PROPERTY(QString pluginDatabasePath READ getPluginDatabasePath CONSTANT)
+    Q_PROPERTY(QString pluginScanStreamPath READ getPluginScanStreamPath CONSTANT)
 
 public:
     static ConfigManager& instance();
@@ -36,6 +38,11 @@ public:
     Q_INVOKABLE void setLastInputDevice(const QString& device);
     Q_INVOKABLE void setLastOutputDevice(const QString& device);
 
+    // Where `vstscanner -s -w -o <app data> -n <stream>` keeps the plugin
+    // database and writes its result stream
+    QString getPluginDatabasePath() const;
+    QString getPluginScanStreamPath() const;
+
     // Device scanning methods
     void saveInitialDeviceScan(const QStringList& asioDevices,
                               const QStringList& wasapiDevices,
@@ -0,0 +1,266 @@
+#include "audiodecoder.hpp"
+#include "audiofile.hpp"
+#include "diskfile.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <initializer_list>
+#include <vector>
+
+namespace {
+
+// Frames converted per pass through the scratch buffers
+constexpr uint32_t kChunkFrames = 4096;
+
+uint16_t getBe16(const uint8_t* p) {
+    return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+uint32_t getBe32(const uint8_t* p) {
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+uint64_t getBe64(const uint8_t* p) {
+    return (uint64_t(getBe32(p)) << 32) | getBe32(p + 4);
+}
+
+// AIFF stores the sample rate as an 80-bit extended float
+double getExtended(const uint8_t* p) {
+    int exponent = ((p[0] & 0x7F) << 8) | p[1];
+    uint64_t mantissa = getBe64(p + 2);
+    if (exponent == 0 && mantissa == 0) return 0.0;
+    double value = std::ldexp(double(mantissa), exponent - 16383 - 63);
+    return p[0] & 0x80 ? -value : value;
+}
+
+// The big-endian counterpart of AudioFile::decode(); 8-bit AIFF is signed
+void decodeBigEndian(const AudioFileInfo& info, const uint8_t* data, size_t samples, float* output) {
+    if (info.isFloat) {
+        for (size_t i = 0; i < samples; i++) {
+            if (info.bitsPerSample == 32) {
+                uint32_t bits = getBe32(data + i * 4);
+                float value;
+                std::memcpy(&value, &bits, sizeof(value));
+                output[i] = value;
+            } else {
+                uint64_t bits = getBe64(data + i * 8);
+                double value;
+                std::memcpy(&value, &bits, sizeof(value));
+                output[i] = static_cast<float>(value);
+            }
+        }
+        return;
+    }
+
+    uint32_t bytes = info.bitsPerSample / 8;
+    for (size_t i = 0; i < samples; i++) {
+        const uint8_t* p = data + i * bytes;
+        // Gather into the top of an int32 so the sign comes along
+        uint32_t bits = 0;
+        for (uint32_t b = 0; b < bytes; b++) bits |= uint32_t(p[b]) << (24 - 8 * b);
+        output[i] = float(static_cast<int32_t>(bits)) * (1.0f / 2147483648.0f);
+    }
+}
+
+// Uncompressed samples at a known place in the file: WAV and AIFF
+class PcmDecoder : public AudioDecoder {
+public:
+    bool open(const std::filesystem::path& path, const AudioFileInfo& layout, bool bigEndian, const char* format,
+              std::string& error) {
+        if (!m_file.open(path, DiskFile::Mode::Read, false)) {
+            error = m_file.getError();
+            return false;
+        }
+        m_layout = layout;
+        m_bigEndian = bigEndian;
+        m_info.channels = layout.channels;
+        m_info.sampleRate = layout.sampleRate;
+        m_info.frames = layout.frames();
+        m_info.exactLength = true;
+        m_info.format = format;
+        m_bytes.resize(size_t(kChunkFrames) * layout.bytesPerFrame());
+        m_samples.resize(size_t(kChunkFrames) * layout.channels);
+        return true;
+    }
+
+    bool seek(uint64_t frame) override {
+        m_position = std::min(frame, m_info.frames);
+        return true;
+    }
+
+    uint32_t read(float* const* channels, uint32_t frames) override {
+        uint32_t done = 0;
+        uint32_t channelCount = m_info.channels;
+        uint32_t bytesPerFrame = m_layout.bytesPerFrame();
+        while (done < frames && m_position < m_info.frames) {
+            auto count = static_cast<uint32_t>(std::min<uint64_t>({ frames - done, kChunkFrames,
+                                                                    m_info.frames - m_position }));
+            size_t bytes = size_t(count) * bytesPerFrame;
+            int64_t read = m_file.readAt(m_layout.dataOffset + m_position * bytesPerFrame, m_bytes.data(), bytes);
+            if (read < 0) {
+                m_error = m_file.getError();
+                break;
+            }
+            count = static_cast<uint32_t>(size_t(read) / bytesPerFrame);
+            if (count == 0) break;
+
+            size_t samples = size_t(count) * channelCount;
+            if (m_bigEndian) {
+                decodeBigEndian(m_layout, m_bytes.data(), samples, m_samples.data());
+            } else {
+                AudioFile::decode(m_layout, m_bytes.data(), samples, m_samples.data());
+            }
+            for (uint32_t channel = 0; channel < channelCount; channel++) {
+                float* dest = channels[channel] + done;
+                const float* source = m_samples.data() + channel;
+                for (uint32_t i = 0; i < count; i++) dest[i] = source[size_t(i) * channelCount];
+            }
+            m_position += count;
+            done += count;
+        }
+        return done;
+    }
+
+private:
+    DiskFile m_file;
+    AudioFileInfo m_layout;
+    bool m_bigEndian = false;
+    uint64_t m_position = 0;
+    std::vector<uint8_t> m_bytes;
+    std::vector<float> m_samples;
+};
+
+bool readAiffLayout(DiskFile& file, AudioFileInfo& layout, bool& bigEndian, std::string& error) {
+    uint8_t header[12];
+    if (file.readAt(0, header, sizeof(header)) != int64_t(sizeof(header))) {
+        error = "Not an AIFF file";
+        return false;
+    }
+    bool aifc = std::memcmp(header + 8, "AIFC", 4) == 0;
+    if (std::memcmp(header, "FORM", 4) != 0 || (!aifc && std::memcmp(header + 8, "AIFF", 4) != 0)) {
+        error = "Not an AIFF file";
+        return false;
+    }
+
+    uint64_t fileSize = file.size();
+    uint64_t position = 12;
+    bool haveFormat = false;
+    bigEndian = true;
+    while (position + 8 <= fileSize) {
+        uint8_t chunk[8];
+        if (file.readAt(position, chunk, sizeof(chunk)) != int64_t(sizeof(chunk))) break;
+        uint64_t size = getBe32(chunk + 4);
+        uint64_t body = position + 8;
+
+        if (std::memcmp(chunk, "COMM", 4) == 0) {
+            uint8_t comm[22] = {};
+            uint64_t length = std::min<uint64_t>(size, sizeof(comm));
+            if (length < 18 || file.readAt(body, comm, length) != int64_t(length)) break;
+            layout.channels = getBe16(comm);
+            layout.bitsPerSample = getBe16(comm + 6);
+            layout.sampleRate = static_cast<uint32_t>(std::lround(getExtended(comm + 8)));
+            layout.isFloat = false;
+            if (aifc && length >= 22) {
+                const uint8_t* type = comm + 18;
+                if (std::memcmp(type, "sowt", 4) == 0) {
+                    bigEndian = false;
+                } else if (std::memcmp(type, "fl32", 4) == 0 || std::memcmp(type, "FL32", 4) == 0) {
+                    layout.isFloat = true;
+                    layout.bitsPerSample = 32;
+                } else if (std::memcmp(type, "fl64", 4) == 0 || std::memcmp(type, "FL64", 4) == 0) {
+                    layout.isFloat = true;
+                    layout.bitsPerSample = 64;
+                } else if (std::memcmp(type, "NONE", 4) != 0 && std::memcmp(type, "twos", 4) != 0) {
+                    error = "Compressed AIFC isn't supported";
+                    return false;
+                }
+            }
+            // Sample sizes that aren't whole bytes are stored padded
+            layout.bitsPerSample = (layout.bitsPerSample + 7) / 8 * 8;
+            haveFormat = true;
+        } else if (std::memcmp(chunk, "SSND", 4) == 0 && size >= 8) {
+            uint8_t offset[4];
+            if (file.readAt(body, offset, sizeof(offset)) != int64_t(sizeof(offset))) break;
+            layout.dataOffset = body + 8 + getBe32(offset);
+            layout.dataBytes = size - 8 - std::min<uint64_t>(getBe32(offset), size - 8);
+        }
+        position = body + size + (size & 1);
+    }
+
+    if (!haveFormat || layout.dataOffset == 0) {
+        error = "No audio data found";
+        return false;
+    }
+    if (layout.channels == 0 || layout.sampleRate == 0 || layout.bitsPerSample == 0 || layout.bitsPerSample > 64 ||
+        (!bigEndian && layout.bitsPerSample == 8)) {
+        error = "Unsupported sample format";
+        return false;
+    }
+    layout.dataBytes = std::min(layout.dataBytes, fileSize - std::min(fileSize, layout.dataOffset));
+    return true;
+}
+
+bool hasExtension(const std::filesystem::path& path, std::initializer_list<const char*> extensions) {
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    for (const char* candidate : extensions) {
+        if (extension == candidate) return true;
+    }
+    return false;
+}
+
+} // namespace
+
+std::unique_ptr<AudioDecoder> AudioDecoder::open(const std::filesystem::path& path, std::string& error) {
+    uint8_t start[4] = {};
+    {
+        DiskFile file;
+        if (!file.open(path, DiskFile::Mode::Read, false)) {
+            error = file.getError();
+            return nullptr;
+        }
+        file.readAt(0, start, sizeof(start));
+    }
+
+    auto is = [&start](const char* magic) { return std::memcmp(start, magic, 4) == 0; };
+    if (is("RIFF") || is("RF64") || is("riff")) return openWav(path, error);
+    if (is("FORM")) return openAiff(path, error);
+    if (is("fLaC")) return openFlac(path, error);
+    // An ID3 tag or an MPEG frame sync
+    if (std::memcmp(start, "ID3", 3) == 0 || (start[0] == 0xFF && (start[1] & 0xE0) == 0xE0)) {
+        return openMp3(path, error);
+    }
+
+    if (hasExtension(path, { ".mp3", ".mp2", ".mpga" })) return openMp3(path, error);
+    if (hasExtension(path, { ".flac" })) return openFlac(path, error);
+    error = "Unsupported audio file format";
+    return nullptr;
+}
+
+std::unique_ptr<AudioDecoder> AudioDecoder::openWav(const std::filesystem::path& path, std::string& error) {
+    AudioFileInfo layout;
+    if (!AudioFile::readInfo(path, layout, error)) return nullptr;
+    auto decoder = std::make_unique<PcmDecoder>();
+    const char* format = layout.format == AudioFileFormat::W64 ? "W64"
+                       : layout.format == AudioFileFormat::Rf64 ? "RF64" : "WAV";
+    if (!decoder->open(path, layout, false, format, error)) return nullptr;
+    return decoder;
+}
+
+std::unique_ptr<AudioDecoder> AudioDecoder::openAiff(const std::filesystem::path& path, std::string& error) {
+    AudioFileInfo layout;
+    bool bigEndian = true;
+    {
+        DiskFile file;
+        if (!file.open(path, DiskFile::Mode::Read, false)) {
+            error = file.getError();
+            return nullptr;
+        }
+        if (!readAiffLayout(file, layout, bigEndian, error)) return nullptr;
+    }
+    auto decoder = std::make_unique<PcmDecoder>();
+    if (!decoder->open(path, layout, bigEndian, "AIFF", error)) return nullptr;
+    return decoder;
+}
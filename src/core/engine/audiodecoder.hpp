@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+
+// Reads an audio file as planar float, from any frame on.
+//
+// WAV (with RF64 and Wave64) and AIFF/AIFC are read directly, FLAC through
+// libFLAC and MP3 through mpg123. Seeking is exact for all of them: FLAC
+// uses the file's seek table, MP3 the frame index mpg123 keeps, skimming
+// frame headers where the index doesn't reach yet. A decoder is used by
+// one thread at a time.
+class AudioDecoder {
+public:
+    struct Info {
+        uint32_t channels = 0;
+        uint32_t sampleRate = 0;
+        // May be an estimate for MP3 files without a frame count in their
+        // header, and is 0 when unknown, as for FLAC streams written without
+        // one; read() returning 0 marks the real end
+        uint64_t frames = 0;
+        // Whether frames is the file's real length
+        bool exactLength = false;
+        const char* format = "";
+    };
+
+    virtual ~AudioDecoder() = default;
+
+    // Picks the decoder by the file's contents, falling back on its extension
+    static std::unique_ptr<AudioDecoder> open(const std::filesystem::path& path, std::string& error);
+
+    const Info& info() const { return m_info; }
+
+    virtual bool seek(uint64_t frame) = 0;
+    // Decodes up to frames into one buffer per channel; returns the frames
+    // decoded, 0 at the end or after an error
+    virtual uint32_t read(float* const* channels, uint32_t frames) = 0;
+
+    bool hasFailed() const { return !m_error.empty(); }
+    const std::string& getError() const { return m_error; }
+
+protected:
+    static std::unique_ptr<AudioDecoder> openWav(const std::filesystem::path& path, std::string& error);
+    static std::unique_ptr<AudioDecoder> openAiff(const std::filesystem::path& path, std::string& error);
+    static std::unique_ptr<AudioDecoder> openFlac(const std::filesystem::path& path, std::string& error);
+    static std::unique_ptr<AudioDecoder> openMp3(const std::filesystem::path& path, std::string& error);
+
+    Info m_info;
+    std::string m_error;
+};
@@ -0,0 +1,343 @@
+#include "audiofile.hpp"
+#include "diskfile.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+constexpr uint16_t kFormatPcm = 1;
+constexpr uint16_t kFormatFloat = 3;
+constexpr uint16_t kFormatExtensible = 0xFFFE;
+
+// Wave64 names chunks with GUIDs; all but RIFF's share this tail after the
+// four-character code
+constexpr uint8_t kW64Tail[12] = { 0xF3, 0xAC, 0xD3, 0x11, 0x8C, 0xD1, 0x00, 0xC0, 0x4F, 0x8E, 0xDB, 0x8A };
+constexpr uint8_t kW64Riff[16] = { 'r', 'i', 'f', 'f', 0x2E, 0x91, 0xCF, 0x11,
+                                   0xA5, 0xD6, 0x28, 0xDB, 0x04, 0xC1, 0x00, 0x00 };
+
+// Tail of the KSDATAFORMAT_SUBTYPE GUIDs in WAVE_FORMAT_EXTENSIBLE, after
+// the format tag
+constexpr uint8_t kSubtypeTail[14] = { 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80,
+                                       0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71 };
+
+void put16(uint8_t* p, uint16_t value) {
+    p[0] = static_cast<uint8_t>(value);
+    p[1] = static_cast<uint8_t>(value >> 8);
+}
+
+void put32(uint8_t* p, uint32_t value) {
+    for (int i = 0; i < 4; i++) p[i] = static_cast<uint8_t>(value >> (8 * i));
+}
+
+void put64(uint8_t* p, uint64_t value) {
+    for (int i = 0; i < 8; i++) p[i] = static_cast<uint8_t>(value >> (8 * i));
+}
+
+uint16_t get16(const uint8_t* p) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+uint32_t get32(const uint8_t* p) {
+    return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+}
+
+uint64_t get64(const uint8_t* p) {
+    return uint64_t(get32(p)) | (uint64_t(get32(p + 4)) << 32);
+}
+
+void putW64Id(uint8_t* p, const char* id) {
+    std::memcpy(p, id, 4);
+    std::memcpy(p + 4, kW64Tail, sizeof(kW64Tail));
+}
+
+bool isW64Id(const uint8_t* p, const char* id) {
+    return std::memcmp(p, id, 4) == 0 && std::memcmp(p + 4, kW64Tail, sizeof(kW64Tail)) == 0;
+}
+
+// The format chunk's body for 32-bit float; returns its size
+uint32_t putFormat(uint8_t* p, uint32_t channels, uint32_t sampleRate) {
+    bool extensible = channels > 2;
+    put16(p, extensible ? kFormatExtensible : kFormatFloat);
+    put16(p + 2, static_cast<uint16_t>(channels));
+    put32(p + 4, sampleRate);
+    put32(p + 8, sampleRate * channels * 4);
+    put16(p + 12, static_cast<uint16_t>(channels * 4));
+    put16(p + 14, 32);
+    if (!extensible) {
+        put16(p + 16, 0);
+        return 18;
+    }
+    put16(p + 16, 22);
+    put16(p + 18, 32);
+    put32(p + 20, 0);    // No speaker positions
+    put16(p + 24, kFormatFloat);
+    std::memcpy(p + 26, kSubtypeTail, sizeof(kSubtypeTail));
+    return 40;
+}
+
+bool parseFormat(const uint8_t* p, uint64_t size, AudioFileInfo& info) {
+    if (size < 16) return false;
+    uint16_t tag = get16(p);
+    info.channels = get16(p + 2);
+    info.sampleRate = get32(p + 4);
+    info.bitsPerSample = get16(p + 14);
+    if (tag == kFormatExtensible && size >= 40) tag = get16(p + 24);
+    info.isFloat = tag == kFormatFloat;
+    if (tag != kFormatPcm && tag != kFormatFloat) return false;
+    if (info.isFloat) return info.bitsPerSample == 32 || info.bitsPerSample == 64;
+    return info.bitsPerSample == 8 || info.bitsPerSample == 16 || info.bitsPerSample == 24 ||
+           info.bitsPerSample == 32;
+}
+
+void writeRiffHeader(uint8_t* header, bool rf64, uint32_t channels, uint32_t sampleRate, uint64_t dataBytes) {
+    bool known = dataBytes != AudioFile::kUnknownSize;
+    uint64_t riffSize = known ? AudioFile::kHeaderSize + dataBytes - 8 : AudioFile::kUnknownSize;
+    uint64_t frames = known ? dataBytes / (channels * 4) : AudioFile::kUnknownSize;
+    auto clamp32 = [rf64](uint64_t value) {
+        return rf64 || value > 0xFFFFFFFFu ? 0xFFFFFFFFu : static_cast<uint32_t>(value);
+    };
+
+    std::memcpy(header, rf64 ? "RF64" : "RIFF", 4);
+    put32(header + 4, clamp32(riffSize));
+    std::memcpy(header + 8, "WAVE", 4);
+
+    // ds64 for RF64, otherwise a JUNK chunk of the same size holding its place
+    uint8_t* p = header + 12;
+    std::memcpy(p, rf64 ? "ds64" : "JUNK", 4);
+    put32(p + 4, 28);
+    if (rf64) {
+        put64(p + 8, riffSize);
+        put64(p + 16, dataBytes);
+        put64(p + 24, frames);
+        put32(p + 32, 0);
+    }
+    p += 36;
+
+    std::memcpy(p, "fmt ", 4);
+    uint32_t formatSize = putFormat(p + 8, channels, sampleRate);
+    put32(p + 4, formatSize);
+    p += 8 + formatSize;
+
+    std::memcpy(p, "fact", 4);
+    put32(p + 4, 4);
+    put32(p + 8, clamp32(frames));
+    p += 12;
+
+    // Pad so the samples start at kHeaderSize
+    uint8_t* data = header + AudioFile::kHeaderSize - 8;
+    std::memcpy(p, "JUNK", 4);
+    put32(p + 4, static_cast<uint32_t>(data - p - 8));
+
+    std::memcpy(data, "data", 4);
+    put32(data + 4, clamp32(dataBytes));
+}
+
+void writeW64Header(uint8_t* header, uint32_t channels, uint32_t sampleRate, uint64_t dataBytes) {
+    bool known = dataBytes != AudioFile::kUnknownSize;
+    std::memcpy(header, kW64Riff, 16);
+    put64(header + 16, known ? AudioFile::kHeaderSize + dataBytes : AudioFile::kUnknownSize);
+    putW64Id(header + 24, "wave");
+
+    // Chunk sizes count their 24-byte header; chunks start on 8 bytes
+    uint8_t* p = header + 40;
+    putW64Id(p, "fmt ");
+    uint32_t formatSize = putFormat(p + 24, channels, sampleRate);
+    put64(p + 16, 24 + formatSize);
+    p += (24 + formatSize + 7) / 8 * 8;
+
+    uint8_t* data = header + AudioFile::kHeaderSize - 24;
+    putW64Id(p, "junk");
+    put64(p + 16, static_cast<uint64_t>(data - p));
+
+    putW64Id(data, "data");
+    put64(data + 16, known ? 24 + dataBytes : AudioFile::kUnknownSize);
+}
+
+template <typename File>
+bool readRiff(File& file, uint64_t fileSize, AudioFileInfo& info, std::string& error) {
+    uint64_t dataSize64 = AudioFile::kUnknownSize;
+    bool haveFormat = false;
+    uint64_t position = 12;
+    uint8_t chunk[40];
+    while (position + 8 <= fileSize) {
+        if (file.readAt(position, chunk, 8) != 8) break;
+        uint64_t size = get32(chunk + 4);
+        uint64_t body = position + 8;
+
+        if (std::memcmp(chunk, "ds64", 4) == 0 && size >= 24) {
+            if (file.readAt(body, chunk, 24) != 24) break;
+            dataSize64 = get64(chunk + 8);
+        } else if (std::memcmp(chunk, "fmt ", 4) == 0) {
+            uint8_t format[40] = {};
+            uint64_t length = std::min<uint64_t>(size, sizeof(format));
+            if (file.readAt(body, format, length) != int64_t(length) || !parseFormat(format, length, info)) {
+                error = "Unsupported sample format";
+                return false;
+            }
+            haveFormat = true;
+        } else if (std::memcmp(chunk, "data", 4) == 0) {
+            if (!haveFormat) break;
+            info.dataOffset = body;
+            info.dataBytes = size == 0xFFFFFFFFu ? dataSize64 : size;
+            return true;
+        }
+        position = body + size + (size & 1);
+    }
+    error = "No audio data found";
+    return false;
+}
+
+template <typename File>
+bool readW64(File& file, uint64_t fileSize, AudioFileInfo& info, std::string& error) {
+    bool haveFormat = false;
+    uint64_t position = 40;
+    uint8_t chunk[24];
+    while (position + 24 <= fileSize) {
+        if (file.readAt(position, chunk, 24) != 24) break;
+        uint64_t size = get64(chunk + 16);
+        if (size < 24) break;
+        uint64_t body = position + 24;
+
+        if (isW64Id(chunk, "fmt ")) {
+            uint8_t format[40] = {};
+            uint64_t length = std::min<uint64_t>(size - 24, sizeof(format));
+            if (file.readAt(body, format, length) != int64_t(length) || !parseFormat(format, length, info)) {
+                error = "Unsupported sample format";
+                return false;
+            }
+            haveFormat = true;
+        } else if (isW64Id(chunk, "data")) {
+            if (!haveFormat) break;
+            info.dataOffset = body;
+            info.dataBytes = size == AudioFile::kUnknownSize ? size : size - 24;
+            return true;
+        }
+        if (size > fileSize - position) break;
+        position += (size + 7) / 8 * 8;
+    }
+    error = "No audio data found";
+    return false;
+}
+
+// A file already in memory, read through the same calls as a DiskFile
+class MemoryFile {
+public:
+    MemoryFile(const uint8_t* data, size_t size) : m_data(data), m_size(size) {}
+
+    int64_t readAt(uint64_t offset, void* data, size_t size) const {
+        if (offset >= m_size) return 0;
+        size_t count = std::min<uint64_t>(size, m_size - offset);
+        std::memcpy(data, m_data + offset, count);
+        return static_cast<int64_t>(count);
+    }
+
+private:
+    const uint8_t* m_data;
+    size_t m_size;
+};
+
+template <typename File>
+bool readHeaders(File& file, uint64_t fileSize, AudioFileInfo& info, std::string& error) {
+    uint8_t start[16] = {};
+    if (file.readAt(0, start, sizeof(start)) != int64_t(sizeof(start))) {
+        error = "Not an audio file";
+        return false;
+    }
+
+    info = AudioFileInfo();
+    bool ok = false;
+    if (std::memcmp(start, kW64Riff, 16) == 0) {
+        info.format = AudioFileFormat::W64;
+        ok = readW64(file, fileSize, info, error);
+    } else if ((std::memcmp(start, "RIFF", 4) == 0 || std::memcmp(start, "RF64", 4) == 0) &&
+               std::memcmp(start + 8, "WAVE", 4) == 0) {
+        info.format = std::memcmp(start, "RF64", 4) == 0 ? AudioFileFormat::Rf64 : AudioFileFormat::Wav;
+        ok = readRiff(file, fileSize, info, error);
+    } else {
+        error = "Not a WAV, RF64 or Wave64 file";
+    }
+    if (!ok) return false;
+
+    if (info.channels == 0 || info.sampleRate == 0) {
+        error = "Invalid audio format";
+        return false;
+    }
+    info.dataBytes = std::min(info.dataBytes, fileSize - std::min(fileSize, info.dataOffset));
+    info.dataBytes -= info.dataBytes % info.bytesPerFrame();
+    return true;
+}
+
+} // namespace
+
+void AudioFile::writeHeader(uint8_t* header, AudioFileFormat format, uint32_t channels, uint32_t sampleRate,
+                            uint64_t dataBytes) {
+    std::memset(header, 0, kHeaderSize);
+    if (format == AudioFileFormat::W64) {
+        writeW64Header(header, channels, sampleRate, dataBytes);
+        return;
+    }
+    bool rf64 = format == AudioFileFormat::Rf64 ||
+                (dataBytes != kUnknownSize && kHeaderSize + dataBytes - 8 > 0xFFFFFFFFu);
+    writeRiffHeader(header, rf64, channels, sampleRate, dataBytes);
+}
+
+bool AudioFile::readInfo(const std::filesystem::path& path, AudioFileInfo& info, std::string& error) {
+    DiskFile file;
+    if (!file.open(path, DiskFile::Mode::Read, false)) {
+        error = file.getError();
+        return false;
+    }
+    return readHeaders(file, file.size(), info, error);
+}
+
+bool AudioFile::readInfo(const uint8_t* data, size_t size, AudioFileInfo& info, std::string& error) {
+    MemoryFile file(data, size);
+    return readHeaders(file, size, info, error);
+}
+
+void AudioFile::decode(const AudioFileInfo& info, const uint8_t* data, size_t samples, float* output) {
+    if (info.isFloat && info.bitsPerSample == 32) {
+        std::memcpy(output, data, samples * sizeof(float));
+        return;
+    }
+    if (info.isFloat) {
+        for (size_t i = 0; i < samples; i++) {
+            double value;
+            std::memcpy(&value, data + i * 8, sizeof(value));
+            output[i] = static_cast<float>(value);
+        }
+        return;
+    }
+
+    switch (info.bitsPerSample) {
+    case 8:     // Unsigned
+        for (size_t i = 0; i < samples; i++) output[i] = (float(data[i]) - 128.0f) * (1.0f / 128.0f);
+        break;
+    case 16:
+        for (size_t i = 0; i < samples; i++) {
+            output[i] = float(static_cast<int16_t>(get16(data + i * 2))) * (1.0f / 32768.0f);
+        }
+        break;
+    case 24:
+        for (size_t i = 0; i < samples; i++) {
+            const uint8_t* p = data + i * 3;
+            // Shift into the top of an int32 so the sign comes along
+            auto value = static_cast<int32_t>((uint32_t(p[0]) << 8) | (uint32_t(p[1]) << 16) |
+                                              (uint32_t(p[2]) << 24));
+            output[i] = float(value) * (1.0f / 2147483648.0f);
+        }
+        break;
+    case 32:
+        for (size_t i = 0; i < samples; i++) {
+            output[i] = float(static_cast<int32_t>(get32(data + i * 4))) * (1.0f / 2147483648.0f);
+        }
+        break;
+    default:
+        std::fill(output, output + samples, 0.0f);
+        break;
+    }
+}
+
+const char* AudioFile::extension(AudioFileFormat format) {
+    return format == AudioFileFormat::W64 ? ".w64" : ".wav";
+}
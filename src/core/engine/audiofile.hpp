@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+enum class AudioFileFormat {
+    Wav,    // Becomes RF64 once the data passes 4 GB
+    Rf64,
+    W64,    // Sony Wave64
+};
+
+// Where a file's samples are and how they're stored
+struct AudioFileInfo {
+    AudioFileFormat format = AudioFileFormat::Wav;
+    uint32_t channels = 0;
+    uint32_t sampleRate = 0;
+    uint32_t bitsPerSample = 0;
+    bool isFloat = false;
+    uint64_t dataOffset = 0;
+    uint64_t dataBytes = 0;
+
+    uint32_t bytesPerFrame() const { return channels * (bitsPerSample / 8); }
+    uint64_t frames() const { return bytesPerFrame() ? dataBytes / bytesPerFrame() : 0; }
+};
+
+// Headers of WAV, RF64 and Wave64 files.
+//
+// Written headers are always kHeaderSize bytes with the samples, 32-bit
+// float, right after them, so a recorder can stream the samples with
+// aligned writes and fill in the header once it knows the length. The
+// WAV header holds a JUNK chunk where RF64's ds64 goes, so a recording
+// turns into RF64 past 4 GB by rewriting the header alone.
+class AudioFile {
+public:
+    static constexpr size_t kHeaderSize = 4096;
+    // Length for a header written before the recording ends; readers take
+    // the samples to the end of the file
+    static constexpr uint64_t kUnknownSize = UINT64_MAX;
+
+    static void writeHeader(uint8_t* header, AudioFileFormat format, uint32_t channels, uint32_t sampleRate,
+                            uint64_t dataBytes);
+
+    // Reads any WAV, RF64 or Wave64 header; a data length that runs past
+    // the end of the file, as left by an interrupted recording, is cut to it
+    static bool readInfo(const std::filesystem::path& path, AudioFileInfo& info, std::string& error);
+    // The same for a whole file held in memory, such as a Qt resource;
+    // dataOffset is then from data
+    static bool readInfo(const uint8_t* data, size_t size, AudioFileInfo& info, std::string& error);
+
+    // Converts samples as stored in the file to float, interleaved as they are
+    static void decode(const AudioFileInfo& info, const uint8_t* data, size_t samples, float* output);
+
+    static const char* extension(AudioFileFormat format);
+};
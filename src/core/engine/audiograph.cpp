@@ -0,0 +1,541 @@
+#include "audiograph.hpp"
+#include "audiothread.hpp"
+#include "crossfadenode.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+// Everything the audio thread needs for one graph layout. Pointers into
+// memory and the event lists are resolved when the plan is built.
+struct AudioGraph::RenderPlan {
+    // Several sources feeding one input are summed into destination first
+    struct Mix {
+        float* destination;
+        uint8_t* destinationSilent;
+        std::vector<const float*> sources;
+        std::vector<const uint8_t*> sourcesSilent;
+    };
+
+    struct Step {
+        AudioNode* node = nullptr;  // Null for kOutputNode
+        std::vector<Mix> mixes;
+        std::vector<const float*> inputs;
+        std::vector<float*> outputs;
+        // Silence flags of the buffers above
+        std::vector<const uint8_t*> inputsSilent;
+        std::vector<uint8_t*> outputsSilent;
+        // Merged into ownEvents when there is more than one
+        std::vector<const EventList*> eventSources;
+        EventList* ownEvents = nullptr;
+        const EventList* inEvents = nullptr;
+        EventList* outEvents = nullptr;
+    };
+
+    uint32_t maxFrames = 0;
+    std::vector<float> memory;
+    std::vector<uint8_t> silent;        // One flag per buffer in memory
+    std::vector<float*> deviceInputs;   // kInputNode's outputs
+    std::vector<uint8_t*> deviceInputsSilent;
+    std::vector<Step> steps;            // kOutputNode last
+    std::vector<std::unique_ptr<EventList>> eventLists;
+    std::unique_ptr<EventList> chunkEvents;     // kInputNode's events for one chunk
+    std::unique_ptr<EventList> noEvents;
+    // Keeps the nodes alive while the audio thread may still use them
+    std::vector<std::shared_ptr<AudioNode>> nodes;
+};
+
+namespace {
+
+// Copies a buffer and reports whether it is all zeros in the same pass.
+// ORing the sample bits keeps the loop free of branches.
+bool copyCheckingSilence(float* destination, const float* source, uint32_t frames) {
+    uint32_t bits = 0;
+    for (uint32_t i = 0; i < frames; i++) {
+        uint32_t sample;
+        std::memcpy(&sample, &source[i], sizeof(sample));
+        bits |= sample;
+        destination[i] = source[i];
+    }
+    // Either sign of zero
+    return (bits & 0x7fffffffu) == 0;
+}
+
+} // namespace
+
+bool AudioGraph::Connection::operator==(const Connection& other) const {
+    return source == other.source && sourceChannel == other.sourceChannel &&
+           destination == other.destination && destinationChannel == other.destinationChannel;
+}
+
+bool AudioGraph::EventConnection::operator==(const EventConnection& other) const {
+    return source == other.source && destination == other.destination;
+}
+
+AudioGraph::AudioGraph(uint32_t numInputs, uint32_t numOutputs)
+    : m_numInputs(numInputs)
+    , m_numOutputs(numOutputs)
+    , m_nodes(2)
+{
+}
+
+AudioGraph::~AudioGraph() {
+    publish(nullptr);
+    for (auto& slot : m_nodes) {
+        if (slot.node && slot.prepared) slot.node->release();
+    }
+    releaseRemovedNodes();
+}
+
+// --- Editing
+
+AudioGraph::NodeId AudioGraph::addNode(std::shared_ptr<AudioNode> node) {
+    if (!node) return kInvalidNode;
+    m_nodes.push_back({ std::move(node), false });
+    return static_cast<NodeId>(m_nodes.size() - 1);
+}
+
+bool AudioGraph::removeNode(NodeId id) {
+    if (id == kInputNode || id == kOutputNode || !isValid(id)) return false;
+
+    auto& slot = m_nodes[id];
+    if (slot.prepared) m_removed.push_back(slot.node);
+    slot = NodeSlot();
+
+    m_connections.erase(std::remove_if(m_connections.begin(), m_connections.end(),
+                                       [id](const Connection& c) { return c.source == id || c.destination == id; }),
+                        m_connections.end());
+    m_eventConnections.erase(std::remove_if(m_eventConnections.begin(), m_eventConnections.end(),
+                                            [id](const EventConnection& c) {
+                                                return c.source == id || c.destination == id;
+                                            }),
+                             m_eventConnections.end());
+    return true;
+}
+
+bool AudioGraph::replaceNode(NodeId id, std::shared_ptr<AudioNode> node) {
+    if (id == kInputNode || id == kOutputNode || !isValid(id) || !node) return false;
+
+    bool prepared = false;
+    if (m_maxFrames > 0) {
+        if (!node->prepare(m_sampleRate, m_maxFrames)) {
+            m_error = "Node " + std::to_string(id) + " failed to prepare";
+            return false;
+        }
+        prepared = true;
+    }
+
+    auto& slot = m_nodes[id];
+    if (slot.prepared) m_removed.push_back(slot.node);
+    slot = { std::move(node), prepared };
+
+    uint32_t inputs = numInputs(id);
+    uint32_t outputs = numOutputs(id);
+    m_connections.erase(std::remove_if(m_connections.begin(), m_connections.end(),
+                                       [&](const Connection& c) {
+                                           return (c.source == id && c.sourceChannel >= outputs) ||
+                                                  (c.destination == id && c.destinationChannel >= inputs);
+                                       }),
+                        m_connections.end());
+    return true;
+}
+
+bool AudioGraph::crossfadeNode(NodeId id, std::shared_ptr<AudioNode> node, double fadeSeconds) {
+    if (id == kInputNode || id == kOutputNode || !isValid(id) || !node) return false;
+
+    // Nothing is heard yet to fade from
+    auto& slot = m_nodes[id];
+    if (!slot.prepared || m_maxFrames == 0) return replaceNode(id, std::move(node));
+
+    if (node->numInputs() != slot.node->numInputs() || node->numOutputs() != slot.node->numOutputs()) {
+        m_error = "Node " + std::to_string(id) + " can only fade to a node with the same channels";
+        return false;
+    }
+    auto fade = std::make_shared<CrossfadeNode>(slot.node, std::move(node), fadeSeconds);
+    if (!fade->prepare(m_sampleRate, m_maxFrames)) {
+        m_error = "Node " + std::to_string(id) + " failed to prepare";
+        return false;
+    }
+    // The old node lives on inside the fade
+    slot.node = std::move(fade);
+    return true;
+}
+
+AudioNode* AudioGraph::node(NodeId id) const {
+    if (id >= m_nodes.size()) return nullptr;
+    if (auto* fade = dynamic_cast<CrossfadeNode*>(m_nodes[id].node.get())) return fade->target().get();
+    return m_nodes[id].node.get();
+}
+
+bool AudioGraph::isValid(NodeId id) const {
+    return id == kInputNode || id == kOutputNode || (id < m_nodes.size() && m_nodes[id].node);
+}
+
+uint32_t AudioGraph::numInputs(NodeId id) const {
+    if (id == kInputNode) return 0;
+    if (id == kOutputNode) return m_numOutputs;
+    return m_nodes[id].node->numInputs();
+}
+
+uint32_t AudioGraph::numOutputs(NodeId id) const {
+    if (id == kInputNode) return m_numInputs;
+    if (id == kOutputNode) return 0;
+    return m_nodes[id].node->numOutputs();
+}
+
+bool AudioGraph::connect(NodeId source, uint32_t sourceChannel, NodeId destination, uint32_t destinationChannel) {
+    if (!isValid(source) || !isValid(destination) || source == destination) return false;
+    if (sourceChannel >= numOutputs(source) || destinationChannel >= numInputs(destination)) return false;
+
+    Connection connection{ source, sourceChannel, destination, destinationChannel };
+    if (std::find(m_connections.begin(), m_connections.end(), connection) == m_connections.end()) {
+        m_connections.push_back(connection);
+    }
+    return true;
+}
+
+bool AudioGraph::disconnect(NodeId source, uint32_t sourceChannel, NodeId destination, uint32_t destinationChannel) {
+    auto it = std::find(m_connections.begin(), m_connections.end(),
+                        Connection{ source, sourceChannel, destination, destinationChannel });
+    if (it == m_connections.end()) return false;
+    m_connections.erase(it);
+    return true;
+}
+
+bool AudioGraph::connectEvents(NodeId source, NodeId destination) {
+    if (!isValid(source) || !isValid(destination) || source == destination) return false;
+    if (source == kOutputNode || destination == kInputNode) return false;
+
+    EventConnection connection{ source, destination };
+    if (std::find(m_eventConnections.begin(), m_eventConnections.end(), connection) == m_eventConnections.end()) {
+        m_eventConnections.push_back(connection);
+    }
+    return true;
+}
+
+bool AudioGraph::disconnectEvents(NodeId source, NodeId destination) {
+    auto it = std::find(m_eventConnections.begin(), m_eventConnections.end(), EventConnection{ source, destination });
+    if (it == m_eventConnections.end()) return false;
+    m_eventConnections.erase(it);
+    return true;
+}
+
+// --- Preparing and publishing
+
+bool AudioGraph::prepare(double sampleRate, uint32_t maxFrames) {
+    if (sampleRate <= 0.0 || maxFrames == 0) {
+        m_error = "Invalid sample rate or block size";
+        return false;
+    }
+
+    // Take the running plan away first, nodes can't be prepared while the
+    // audio thread processes them. Fades end early, with nothing playing.
+    publish(nullptr);
+    for (auto& fade : endCrossfades(true)) fade->releaseSource();
+    for (auto& slot : m_nodes) {
+        if (slot.node && slot.prepared) {
+            slot.node->release();
+            slot.prepared = false;
+        }
+    }
+    releaseRemovedNodes();
+
+    m_sampleRate = sampleRate;
+    m_maxFrames = maxFrames;
+    m_steadyTime = 0;
+    return commit();
+}
+
+bool AudioGraph::commit() {
+    if (m_maxFrames == 0) {
+        m_error = "Graph not prepared";
+        return false;
+    }
+
+    std::vector<NodeId> order;
+    if (!sortNodes(order)) {
+        m_error = "Connections form a cycle";
+        return false;
+    }
+
+    for (NodeId id : order) {
+        auto& slot = m_nodes[id];
+        if (!slot.node || slot.prepared) continue;
+        if (!slot.node->prepare(m_sampleRate, m_maxFrames)) {
+            m_error = "Node " + std::to_string(id) + " failed to prepare";
+            return false;
+        }
+        slot.prepared = true;
+    }
+
+    auto fades = endCrossfades(false);
+    publish(buildPlan(order));
+    for (auto& fade : fades) fade->releaseSource();
+    releaseRemovedNodes();
+    m_error.clear();
+    return true;
+}
+
+std::vector<std::shared_ptr<CrossfadeNode>> AudioGraph::endCrossfades(bool all) {
+    std::vector<std::shared_ptr<CrossfadeNode>> ended;
+    for (auto& slot : m_nodes) {
+        auto fade = std::dynamic_pointer_cast<CrossfadeNode>(slot.node);
+        if (!fade || !(all || fade->isFinished())) continue;
+        slot.node = fade->target();
+        ended.push_back(std::move(fade));
+    }
+    return ended;
+}
+
+bool AudioGraph::sortNodes(std::vector<NodeId>& order) {
+    // Kahn's algorithm over audio and event connections. kInputNode is
+    // filled from the device and kOutputNode always goes last.
+    std::vector<uint32_t> incoming(m_nodes.size(), 0);
+    std::vector<std::vector<NodeId>> edges(m_nodes.size());
+    auto addEdge = [&](NodeId source, NodeId destination) {
+        if (source == kInputNode) return;
+        edges[source].push_back(destination);
+        incoming[destination]++;
+    };
+    for (const auto& c : m_connections) addEdge(c.source, c.destination);
+    for (const auto& c : m_eventConnections) addEdge(c.source, c.destination);
+
+    std::vector<NodeId> ready;
+    size_t nodeCount = 0;
+    for (NodeId id = 2; id < m_nodes.size(); id++) {
+        if (!m_nodes[id].node) continue;
+        nodeCount++;
+        if (incoming[id] == 0) ready.push_back(id);
+    }
+
+    order.clear();
+    while (!ready.empty()) {
+        NodeId id = ready.back();
+        ready.pop_back();
+        order.push_back(id);
+        for (NodeId next : edges[id]) {
+            if (--incoming[next] == 0 && next != kOutputNode) ready.push_back(next);
+        }
+    }
+
+    if (order.size() != nodeCount) return false;
+    order.push_back(kOutputNode);
+    return true;
+}
+
+std::unique_ptr<AudioGraph::RenderPlan> AudioGraph::buildPlan(const std::vector<NodeId>& order) {
+    auto plan = std::make_unique<RenderPlan>();
+    plan->maxFrames = m_maxFrames;
+    plan->chunkEvents = std::make_unique<EventList>();
+    plan->noEvents = std::make_unique<EventList>(0, 0);
+
+    // Count the buffers first so memory is allocated once and the pointers
+    // handed out below stay valid
+    size_t bufferCount = 1 + m_numInputs;  // Silence, device inputs
+    for (NodeId id : order) {
+        uint32_t inputs = numInputs(id);
+        if (id != kOutputNode) bufferCount += numOutputs(id);
+        for (uint32_t channel = 0; channel < inputs; channel++) {
+            size_t sources = std::count_if(m_connections.begin(), m_connections.end(), [&](const Connection& c) {
+                return c.destination == id && c.destinationChannel == channel;
+            });
+            if (sources > 1) bufferCount++;
+        }
+    }
+    plan->memory.assign(bufferCount * m_maxFrames, 0.0f);
+    plan->silent.assign(bufferCount, 0);
+
+    float* next = plan->memory.data();
+    auto allocate = [&]() {
+        float* buffer = next;
+        next += m_maxFrames;
+        return buffer;
+    };
+    auto silentFlag = [&](const float* buffer) {
+        return &plan->silent[static_cast<size_t>(buffer - plan->memory.data()) / m_maxFrames];
+    };
+
+    const float* silence = allocate();
+    *silentFlag(silence) = 1;
+    std::vector<std::vector<float*>> outputBuffers(m_nodes.size());
+    std::vector<EventList*> outputEvents(m_nodes.size(), nullptr);
+
+    for (uint32_t channel = 0; channel < m_numInputs; channel++) {
+        plan->deviceInputs.push_back(allocate());
+        plan->deviceInputsSilent.push_back(silentFlag(plan->deviceInputs.back()));
+    }
+    outputBuffers[kInputNode] = plan->deviceInputs;
+    outputEvents[kInputNode] = plan->chunkEvents.get();
+
+    for (NodeId id : order) {
+        RenderPlan::Step step;
+        if (id != kOutputNode) {
+            step.node = m_nodes[id].node.get();
+            plan->nodes.push_back(m_nodes[id].node);
+        }
+
+        // Inputs read straight from a single source, sum several into a mix
+        // buffer or read silence
+        for (uint32_t channel = 0; channel < numInputs(id); channel++) {
+            RenderPlan::Mix mix{ nullptr, nullptr, {}, {} };
+            for (const auto& c : m_connections) {
+                if (c.destination == id && c.destinationChannel == channel) {
+                    mix.sources.push_back(outputBuffers[c.source][c.sourceChannel]);
+                    mix.sourcesSilent.push_back(silentFlag(mix.sources.back()));
+                }
+            }
+            if (mix.sources.empty()) {
+                step.inputs.push_back(silence);
+            } else if (mix.sources.size() == 1) {
+                step.inputs.push_back(mix.sources.front());
+            } else {
+                mix.destination = allocate();
+                mix.destinationSilent = silentFlag(mix.destination);
+                step.inputs.push_back(mix.destination);
+                step.mixes.push_back(std::move(mix));
+            }
+            step.inputsSilent.push_back(silentFlag(step.inputs.back()));
+        }
+
+        for (const auto& c : m_eventConnections) {
+            if (c.destination == id) step.eventSources.push_back(outputEvents[c.source]);
+        }
+        if (step.eventSources.empty()) {
+            step.inEvents = plan->noEvents.get();
+        } else if (step.eventSources.size() == 1) {
+            step.inEvents = step.eventSources.front();
+        } else {
+            plan->eventLists.push_back(std::make_unique<EventList>());
+            step.ownEvents = plan->eventLists.back().get();
+            step.inEvents = step.ownEvents;
+        }
+
+        if (id != kOutputNode) {
+            for (uint32_t channel = 0; channel < numOutputs(id); channel++) {
+                step.outputs.push_back(allocate());
+                step.outputsSilent.push_back(silentFlag(step.outputs.back()));
+            }
+            outputBuffers[id] = step.outputs;
+
+            plan->eventLists.push_back(std::make_unique<EventList>());
+            step.outEvents = plan->eventLists.back().get();
+            outputEvents[id] = step.outEvents;
+        }
+
+        plan->steps.push_back(std::move(step));
+    }
+
+    return plan;
+}
+
+void AudioGraph::publish(std::unique_ptr<RenderPlan> plan) {
+    RenderPlan* previous = m_plan.exchange(plan.get());
+    while (previous && m_planInUse.load() == previous) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    m_ownedPlan = std::move(plan);
+}
+
+void AudioGraph::releaseRemovedNodes() {
+    for (auto& node : m_removed) node->release();
+    m_removed.clear();
+}
+
+// --- Processing
+
+void AudioGraph::process(const float* const* inputs, float* const* outputs, uint32_t frames) {
+    // Announce the plan before using it; publish() won't free a plan that
+    // is announced. Retry if it was swapped in between.
+    RenderPlan* plan;
+    do {
+        plan = m_plan.load();
+        m_planInUse.store(plan);
+    } while (plan != m_plan.load());
+
+    if (!plan) {
+        for (uint32_t channel = 0; channel < m_numOutputs; channel++) {
+            std::memset(outputs[channel], 0, frames * sizeof(float));
+        }
+    } else {
+        audiothread::Scope audioThread;
+        for (uint32_t offset = 0; offset < frames; offset += plan->maxFrames) {
+            renderChunk(*plan, inputs, outputs, offset, std::min(plan->maxFrames, frames - offset));
+        }
+    }
+
+    m_planInUse.store(nullptr);
+    m_inputEvents.clear();
+    m_steadyTime.fetch_add(frames, std::memory_order_relaxed);
+}
+
+void AudioGraph::renderChunk(RenderPlan& plan, const float* const* inputs, float* const* outputs,
+                             uint32_t offset, uint32_t frames) {
+    for (uint32_t channel = 0; channel < m_numInputs; channel++) {
+        float* buffer = plan.deviceInputs[channel];
+        uint8_t& silent = *plan.deviceInputsSilent[channel];
+        if (inputs && inputs[channel]) {
+            silent = copyCheckingSilence(buffer, inputs[channel] + offset, frames);
+        } else {
+            std::memset(buffer, 0, frames * sizeof(float));
+            silent = 1;
+        }
+    }
+    plan.chunkEvents->clear();
+    plan.chunkEvents->appendRange(m_inputEvents, offset, offset + frames);
+
+    AudioBlock block;
+    block.frames = frames;
+    block.steadyTime = m_steadyTime.load(std::memory_order_relaxed) + offset;
+    block.workers = m_workers;
+
+    for (auto& step : plan.steps) {
+        // Silent sources add nothing, so they are left out of the sum
+        for (auto& mix : step.mixes) {
+            bool empty = true;
+            for (size_t s = 0; s < mix.sources.size(); s++) {
+                if (*mix.sourcesSilent[s]) continue;
+                const float* source = mix.sources[s];
+                if (empty) {
+                    std::memcpy(mix.destination, source, frames * sizeof(float));
+                    empty = false;
+                } else {
+                    for (uint32_t i = 0; i < frames; i++) mix.destination[i] += source[i];
+                }
+            }
+            if (empty) std::memset(mix.destination, 0, frames * sizeof(float));
+            *mix.destinationSilent = empty;
+        }
+        if (step.ownEvents) {
+            step.ownEvents->clear();
+            for (const auto* source : step.eventSources) step.ownEvents->appendRange(*source, 0, frames);
+        }
+
+        if (!step.node) {
+            for (uint32_t channel = 0; channel < m_numOutputs; channel++) {
+                std::memcpy(outputs[channel] + offset, step.inputs[channel], frames * sizeof(float));
+            }
+            continue;
+        }
+
+        uint64_t silentInputs = 0;
+        uint32_t flagged = std::min<uint32_t>(static_cast<uint32_t>(step.inputsSilent.size()),
+                                              AudioBlock::kMaxSilenceChannels);
+        for (uint32_t channel = 0; channel < flagged; channel++) {
+            if (*step.inputsSilent[channel]) silentInputs |= uint64_t(1) << channel;
+        }
+        uint64_t silentOutputs = 0;
+
+        step.outEvents->clear();
+        block.inputs = step.inputs.data();
+        block.outputs = step.outputs.data();
+        block.inEvents = step.inEvents;
+        block.outEvents = step.outEvents;
+        block.silentInputs = silentInputs;
+        block.silentOutputs = &silentOutputs;
+        step.node->process(block);
+
+        for (uint32_t channel = 0; channel < step.outputsSilent.size(); channel++) {
+            *step.outputsSilent[channel] = channel < AudioBlock::kMaxSilenceChannels && (silentOutputs >> channel) & 1;
+        }
+    }
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include "audionode.hpp"
+#include "eventlist.hpp"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+class AudioWorkerPool;
+class CrossfadeNode;
+
+// The processing graph the audio device renders. Nodes are connected
+// channel by channel, and event outputs (notes, parameter changes) can be
+// routed to other nodes' event inputs. Two built-in nodes stand for the
+// device: kInputNode outputs the device inputs and the events given to
+// inputEvents(), kOutputNode's inputs are written to the device outputs.
+//
+// Edits happen on the main thread and take effect on commit(), which
+// prepares any new nodes, orders the graph and builds a render plan with
+// every buffer and event list allocated. The plan is swapped in atomically,
+// so the audio thread never waits for the main thread and never allocates.
+class AudioGraph {
+public:
+    using NodeId = uint32_t;
+
+    static constexpr NodeId kInputNode = 0;
+    static constexpr NodeId kOutputNode = 1;
+    static constexpr NodeId kInvalidNode = 0xffffffffu;
+
+    AudioGraph(uint32_t numInputs, uint32_t numOutputs);
+    ~AudioGraph();
+
+    AudioGraph(const AudioGraph&) = delete;
+    AudioGraph& operator=(const AudioGraph&) = delete;
+
+    // Handed to nodes with every block, e.g. for plugin thread pools
+    void setWorkerPool(AudioWorkerPool* workers) { m_workers = workers; }
+
+    // --- Main thread
+
+    NodeId addNode(std::shared_ptr<AudioNode> node);
+    // Also drops the node's connections. It is released on the next commit().
+    bool removeNode(NodeId id);
+    // Puts node in id's place, keeping the connections its channels still
+    // have. The new node is prepared right away, so a failure leaves the
+    // graph as it was; the old one keeps playing until the next commit()
+    // swaps them at a block boundary and is released after that.
+    bool replaceNode(NodeId id, std::shared_ptr<AudioNode> node);
+    // Like replaceNode(), but the old node keeps playing after the next
+    // commit(), fading out over fadeSeconds while the new one fades in (see
+    // CrossfadeNode). The first commit() after the fade drops the old node.
+    // Both need the same channels.
+    bool crossfadeNode(NodeId id, std::shared_ptr<AudioNode> node, double fadeSeconds);
+    // A node being faded in already counts as the one in id's place
+    AudioNode* node(NodeId id) const;
+
+    bool connect(NodeId source, uint32_t sourceChannel, NodeId destination, uint32_t destinationChannel);
+    bool disconnect(NodeId source, uint32_t sourceChannel, NodeId destination, uint32_t destinationChannel);
+    bool connectEvents(NodeId source, NodeId destination);
+    bool disconnectEvents(NodeId source, NodeId destination);
+
+    // Sets the sample rate and largest block size and prepares every node
+    // again. Processing outputs silence until the following commit().
+    bool prepare(double sampleRate, uint32_t maxFrames);
+    // Publishes the current nodes and connections to the audio thread.
+    // Fails, leaving the running plan in place, when the graph has a cycle
+    // or a new node fails to prepare; getError() says why.
+    bool commit();
+    const std::string& getError() const { return m_error; }
+
+    // --- Audio thread
+
+    // Events for kInputNode, with times relative to the next process()
+    // call. Cleared by process().
+    EventList& inputEvents() { return m_inputEvents; }
+    // Blocks larger than the prepared size are rendered in several parts.
+    // inputs may be null; outputs are always fully written.
+    void process(const float* const* inputs, float* const* outputs, uint32_t frames);
+
+private:
+    struct RenderPlan;
+
+    struct NodeSlot {
+        std::shared_ptr<AudioNode> node;
+        bool prepared = false;
+    };
+
+    struct Connection {
+        NodeId source;
+        uint32_t sourceChannel;
+        NodeId destination;
+        uint32_t destinationChannel;
+
+        bool operator==(const Connection& other) const;
+    };
+
+    struct EventConnection {
+        NodeId source;
+        NodeId destination;
+
+        bool operator==(const EventConnection& other) const;
+    };
+
+    bool isValid(NodeId id) const;
+    uint32_t numInputs(NodeId id) const;
+    uint32_t numOutputs(NodeId id) const;
+
+    bool sortNodes(std::vector<NodeId>& order);
+    std::unique_ptr<RenderPlan> buildPlan(const std::vector<NodeId>& order);
+    // Swaps in plan and waits until the audio thread let go of the old one
+    void publish(std::unique_ptr<RenderPlan> plan);
+    void releaseRemovedNodes();
+    // Puts the new node of every finished fade, or of all of them, in its
+    // place; the old nodes are returned to be released once unused
+    std::vector<std::shared_ptr<CrossfadeNode>> endCrossfades(bool all);
+
+    void renderChunk(RenderPlan& plan, const float* const* inputs, float* const* outputs,
+                     uint32_t offset, uint32_t frames);
+
+    uint32_t m_numInputs;
+    uint32_t m_numOutputs;
+    double m_sampleRate = 0.0;
+    uint32_t m_maxFrames = 0;
+    AudioWorkerPool* m_workers = nullptr;
+
+    std::vector<NodeSlot> m_nodes;  // Indexed by NodeId, empty slots are removed nodes
+    std::vector<Connection> m_connections;
+    std::vector<EventConnection> m_eventConnections;
+    std::vector<std::shared_ptr<AudioNode>> m_removed;
+    std::string m_error;
+
+    std::unique_ptr<RenderPlan> m_ownedPlan;
+    std::atomic<RenderPlan*> m_plan{nullptr};
+    std::atomic<RenderPlan*> m_planInUse{nullptr};
+
+    EventList m_inputEvents;
+    std::atomic<int64_t> m_steadyTime{0};
+};
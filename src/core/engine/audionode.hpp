@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+class AudioWorkerPool;
+class EventList;
+
+// What a node sees of one audio block. Channel pointers hold frames
+// samples; outputs are not cleared beforehand.
+//
+// Silence is tracked per channel so nodes fed only silence can skip their
+// work: bit n of silentInputs is set when input channel n is all zeros. A
+// node that wrote all zeros to output channel n may set bit n of
+// *silentOutputs, which the graph clears before process() and passes on
+// to the nodes downstream. Channels past 63 are never flagged.
+struct AudioBlock {
+    uint32_t frames = 0;
+    int64_t steadyTime = 0;             // Sample position since the graph was prepared
+    const float* const* inputs = nullptr;
+    float* const* outputs = nullptr;
+    const EventList* inEvents = nullptr;
+    EventList* outEvents = nullptr;
+    AudioWorkerPool* workers = nullptr; // May be null
+    uint64_t silentInputs = 0;
+    uint64_t* silentOutputs = nullptr;
+
+    static constexpr uint32_t kMaxSilenceChannels = 64;
+    bool isInputSilent(uint32_t channel) const {
+        return channel < kMaxSilenceChannels && (silentInputs >> channel) & 1;
+    }
+    void setOutputSilent(uint32_t channel) const {
+        if (silentOutputs && channel < kMaxSilenceChannels) *silentOutputs |= uint64_t(1) << channel;
+    }
+};
+
+// True when every sample is zero, of either sign. ORing the sample bits
+// keeps the loop free of branches.
+inline bool isBufferSilent(const float* buffer, uint32_t frames) {
+    uint32_t bits = 0;
+    for (uint32_t i = 0; i < frames; i++) {
+        uint32_t sample;
+        std::memcpy(&sample, &buffer[i], sizeof(sample));
+        bits |= sample;
+    }
+    return (bits & 0x7fffffffu) == 0;
+}
+
+// Something that renders audio inside an AudioGraph: a plugin, a mixer
+// channel, a generator.
+//
+// prepare() and release() are called on the main thread while the node is
+// not being processed. process() is called on the audio thread and must
+// not allocate, lock or block.
+class AudioNode {
+public:
+    virtual ~AudioNode() = default;
+
+    virtual uint32_t numInputs() const = 0;
+    virtual uint32_t numOutputs() const = 0;
+
+    // maxFrames is the largest block process() will get
+    virtual bool prepare(double sampleRate, uint32_t maxFrames) = 0;
+    virtual void release() = 0;
+    virtual void process(const AudioBlock& block) = 0;
+};
@@ -0,0 +1,25 @@
+#pragma once
+
+// Marks the threads that render audio: the device callback thread while it
+// runs an AudioGraph, and the AudioWorkerPool threads. Plugin hosts use it
+// to answer thread checks and to refuse audio-thread-only calls elsewhere.
+namespace audiothread {
+
+inline thread_local bool t_isAudioThread = false;
+
+inline bool isCurrent() { return t_isAudioThread; }
+
+// Marks the current thread as an audio thread for the scope's lifetime
+class Scope {
+public:
+    Scope() : m_previous(t_isAudioThread) { t_isAudioThread = true; }
+    ~Scope() { t_isAudioThread = m_previous; }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+private:
+    bool m_previous;
+};
+
+} // namespace audiothread
@@ -0,0 +1,113 @@
+#include "audioworkerpool.hpp"
+#include "audiothread.hpp"
+#include <algorithm>
+#include <chrono>
+
+namespace {
+
+// How long an idle worker keeps polling for the next job before sleeping.
+// Plugins usually ask for the pool every block, so this covers the gap
+// between two blocks at common buffer sizes.
+constexpr auto kSpinTime = std::chrono::microseconds(500);
+
+} // namespace
+
+AudioWorkerPool::AudioWorkerPool(int threadCount) {
+    m_threads.reserve(std::max(threadCount, 0));
+    for (int i = 0; i < threadCount; i++) {
+        m_threads.emplace_back(&AudioWorkerPool::workerLoop, this);
+    }
+}
+
+AudioWorkerPool::~AudioWorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_wake.notify_all();
+    for (auto& thread : m_threads) thread.join();
+}
+
+int AudioWorkerPool::defaultThreadCount() {
+    int cores = static_cast<int>(std::thread::hardware_concurrency());
+    return std::max(cores - 1, 0);
+}
+
+bool AudioWorkerPool::execute(uint32_t count, Task task, void* context) {
+    if (count == 0) return true;
+
+    bool expected = false;
+    if (!m_busy.compare_exchange_strong(expected, true)) return false;
+
+    if (m_threads.empty() || count == 1) {
+        for (uint32_t i = 0; i < count; i++) task(context, i);
+        m_busy = false;
+        return true;
+    }
+
+    // An odd generation tells workers a job is being written. Workers that
+    // got into runTasks() before that are still on the previous job, which
+    // is finished, so wait for them to leave before touching its fields.
+    m_generation.fetch_add(1);
+    while (m_active.load() != 0) std::this_thread::yield();
+
+    m_task = task;
+    m_context = context;
+    m_count = count;
+    m_next.store(0, std::memory_order_relaxed);
+    m_done.store(0, std::memory_order_relaxed);
+    m_generation.fetch_add(1);
+
+    if (m_sleeping.load() > 0) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_wake.notify_all();
+    }
+
+    runTasks();
+    while (m_done.load(std::memory_order_acquire) < count) std::this_thread::yield();
+
+    m_busy = false;
+    return true;
+}
+
+void AudioWorkerPool::runTasks() {
+    uint32_t index;
+    while ((index = m_next.fetch_add(1, std::memory_order_relaxed)) < m_count) {
+        m_task(m_context, index);
+        m_done.fetch_add(1, std::memory_order_release);
+    }
+}
+
+bool AudioWorkerPool::waitForJob(uint64_t seen) {
+    auto isNewJob = [&](uint64_t generation) { return generation % 2 == 0 && generation != seen; };
+
+    auto spinUntil = std::chrono::steady_clock::now() + kSpinTime;
+    while (std::chrono::steady_clock::now() < spinUntil) {
+        if (m_quit.load(std::memory_order_relaxed)) return false;
+        if (isNewJob(m_generation.load())) return true;
+        std::this_thread::yield();
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_sleeping.fetch_add(1);
+    m_wake.wait(lock, [&] { return m_quit.load() || isNewJob(m_generation.load()); });
+    m_sleeping.fetch_sub(1);
+    return !m_quit;
+}
+
+void AudioWorkerPool::workerLoop() {
+    audiothread::Scope audioThread;
+    uint64_t seen = 0;
+
+    while (waitForJob(seen)) {
+        // Announce ourselves before looking at the job so execute() can't
+        // start rewriting it underneath us
+        m_active.fetch_add(1);
+        uint64_t generation = m_generation.load();
+        if (generation % 2 == 0 && generation != seen) {
+            seen = generation;
+            runTasks();
+        }
+        m_active.fetch_sub(1);
+    }
+}
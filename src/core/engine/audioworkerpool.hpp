@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of audio threads that share out the work of one audio block.
+// The engine owns a single pool; hosted plugins use it through the CLAP
+// thread-pool extension instead of starting threads of their own.
+//
+// execute() hands out task indices through an atomic counter and the
+// calling thread works on them too, so a job never waits for a worker to
+// wake up before it can make progress. Workers spin briefly after a job and
+// then sleep until the next one.
+class AudioWorkerPool {
+public:
+    using Task = void (*)(void* context, uint32_t index);
+
+    // threadCount extra threads besides the caller; 0 runs everything inline
+    explicit AudioWorkerPool(int threadCount = defaultThreadCount());
+    ~AudioWorkerPool();
+
+    AudioWorkerPool(const AudioWorkerPool&) = delete;
+    AudioWorkerPool& operator=(const AudioWorkerPool&) = delete;
+
+    // One less than the number of cores, leaving one for the device thread.
+    // On a single core everything runs on the caller.
+    static int defaultThreadCount();
+    int threadCount() const { return static_cast<int>(m_threads.size()); }
+
+    // Runs task(context, i) for every i below count and returns once all of
+    // them finished. Returns false without running anything when another
+    // job is in progress, e.g. when called from inside a task.
+    bool execute(uint32_t count, Task task, void* context);
+
+private:
+    void workerLoop();
+    bool waitForJob(uint64_t seen);
+    void runTasks();
+
+    std::vector<std::thread> m_threads;
+
+    // The job. Written by execute() while m_generation is odd and no worker
+    // is inside runTasks(), read by workers once it is even again.
+    Task m_task = nullptr;
+    void* m_context = nullptr;
+    uint32_t m_count = 0;
+    std::atomic<uint32_t> m_next{0};
+    std::atomic<uint32_t> m_done{0};
+
+    std::atomic<uint64_t> m_generation{0};
+    std::atomic<int> m_active{0};
+    std::atomic<int> m_sleeping{0};
+    std::atomic<bool> m_busy{false};
+    std::atomic<bool> m_quit{false};
+
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+};
@@ -0,0 +1,571 @@
+#include "clappluginnode.hpp"
+#include "audiothread.hpp"
+#include "audioworkerpool.hpp"
+#include "eventlist.hpp"
+#include "spscring.hpp"
+#include "BinaryInspector.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <mutex>
+
+namespace {
+
+std::mutex s_modulesMutex;
+std::map<std::string, std::weak_ptr<ClapModule>> s_modules;
+
+// Messages logged off the main thread, such as from process(), wait here
+// for flushLog(). Only one thread writes at a time; one that finds another
+// writing drops its message instead of waiting, and so does one that finds
+// the queue full.
+struct LogEntry {
+    clap_log_severity severity = CLAP_LOG_INFO;
+    char plugin[64] = {};
+    char message[256] = {};
+};
+
+constexpr size_t kLogEntries = 128;
+
+SpscRing<LogEntry> s_log(kLogEntries);
+std::atomic_flag s_logWriting = ATOMIC_FLAG_INIT;
+std::atomic<uint32_t> s_logDropped{0};
+ClapPluginNode::LogHandler s_logHandler;
+
+// Cuts text that doesn't fit, without allocating
+template <size_t N>
+void copyText(char (&to)[N], const char* from) {
+    size_t i = 0;
+    for (; from && from[i] && i + 1 < N; i++) to[i] = from[i];
+    to[i] = '\0';
+}
+
+const char* severityName(clap_log_severity severity) {
+    switch (severity) {
+        case CLAP_LOG_DEBUG: return "debug";
+        case CLAP_LOG_INFO: return "info";
+        case CLAP_LOG_WARNING: return "warning";
+        case CLAP_LOG_ERROR: return "error";
+        case CLAP_LOG_FATAL: return "fatal";
+        case CLAP_LOG_HOST_MISBEHAVING: return "host misbehaving";
+        case CLAP_LOG_PLUGIN_MISBEHAVING: return "plugin misbehaving";
+        default: return "log";
+    }
+}
+
+} // namespace
+
+// --- ClapModule
+
+std::shared_ptr<ClapModule> ClapModule::open(const std::filesystem::path& path, std::string& error) {
+    std::lock_guard<std::mutex> lock(s_modulesMutex);
+
+    auto key = path.string();
+    if (auto existing = s_modules[key].lock()) return existing;
+
+    std::shared_ptr<ClapModule> module(new ClapModule());
+    module->m_path = path;
+
+    // On macOS a .clap is a bundle; clap_entry.init still gets the bundle path
+    if (!module->m_library.open(futureboard::BinaryInspector::resolveBinary(path))) {
+        error = module->m_library.getError();
+        return nullptr;
+    }
+
+    auto entry = static_cast<const clap_plugin_entry_t*>(module->m_library.getSymbol("clap_entry"));
+    if (!entry) {
+        error = "No clap_entry found";
+        return nullptr;
+    }
+    if (!clap_version_is_compatible(entry->clap_version)) {
+        error = "Unsupported CLAP version";
+        return nullptr;
+    }
+    if (!entry->init(key.c_str())) {
+        error = "clap_entry.init failed";
+        return nullptr;
+    }
+    module->m_entry = entry;
+
+    module->m_factory = static_cast<const clap_plugin_factory_t*>(entry->get_factory(CLAP_PLUGIN_FACTORY_ID));
+    if (!module->m_factory) {
+        error = "No plugin factory";
+        return nullptr;
+    }
+
+    s_modules[key] = module;
+    return module;
+}
+
+ClapModule::~ClapModule() {
+    if (m_entry) m_entry->deinit();
+}
+
+// --- ClapPluginNode
+
+std::shared_ptr<ClapPluginNode> ClapPluginNode::create(const std::filesystem::path& path, const std::string& pluginId,
+                                                       std::string& error) {
+    auto module = ClapModule::open(path, error);
+    if (!module) return nullptr;
+
+    const auto* factory = module->factory();
+    const clap_plugin_descriptor_t* descriptor = nullptr;
+    for (uint32_t i = 0; i < factory->get_plugin_count(factory); i++) {
+        const auto* candidate = factory->get_plugin_descriptor(factory, i);
+        if (candidate && (pluginId.empty() || pluginId == candidate->id)) {
+            descriptor = candidate;
+            break;
+        }
+    }
+    if (!descriptor) {
+        error = pluginId.empty() ? "File contains no plugins" : "No plugin with id " + pluginId;
+        return nullptr;
+    }
+
+    std::shared_ptr<ClapPluginNode> node(new ClapPluginNode(std::move(module)));
+    node->m_plugin = factory->create_plugin(factory, &node->m_host, descriptor->id);
+    if (!node->m_plugin) {
+        error = "Failed to create " + std::string(descriptor->id);
+        return nullptr;
+    }
+    if (!node->m_plugin->init(node->m_plugin)) {
+        error = "Failed to initialise " + std::string(descriptor->id);
+        return nullptr;
+    }
+    node->queryAudioPorts();
+
+    node->m_threadPool = static_cast<const clap_plugin_thread_pool_t*>(
+        node->m_plugin->get_extension(node->m_plugin, CLAP_EXT_THREAD_POOL));
+    node->m_tail = static_cast<const clap_plugin_tail_t*>(node->m_plugin->get_extension(node->m_plugin, CLAP_EXT_TAIL));
+    return node;
+}
+
+ClapPluginNode::ClapPluginNode(std::shared_ptr<ClapModule> module)
+    : m_module(std::move(module))
+    , m_mainThread(std::this_thread::get_id())
+{
+    m_host.clap_version = CLAP_VERSION;
+    m_host.host_data = this;
+    m_host.name = "Futureboard";
+    m_host.vendor = "Futureboard";
+    m_host.url = "";
+    m_host.version = "1.0";
+    m_host.get_extension = &ClapPluginNode::hostGetExtension;
+    m_host.request_restart = &ClapPluginNode::hostRequestRestart;
+    m_host.request_process = &ClapPluginNode::hostRequestProcess;
+    m_host.request_callback = &ClapPluginNode::hostRequestCallback;
+}
+
+ClapPluginNode::~ClapPluginNode() {
+    if (!m_plugin) return;
+    release();
+    m_plugin->destroy(m_plugin);
+}
+
+std::string ClapPluginNode::name() const {
+    return m_plugin && m_plugin->desc && m_plugin->desc->name ? m_plugin->desc->name : "";
+}
+
+bool ClapPluginNode::saveState(PluginPreset& preset, std::string& error) const {
+    preset = PluginPreset();
+    preset.pluginId = m_plugin->desc->id;
+    preset.pluginVersion = m_plugin->desc->version ? m_plugin->desc->version : "";
+
+    auto state = static_cast<const clap_plugin_state_t*>(m_plugin->get_extension(m_plugin, CLAP_EXT_STATE));
+    if (state) {
+        clap_ostream_t stream;
+        stream.ctx = &preset.state;
+        stream.write = [](const clap_ostream_t* stream, const void* buffer, uint64_t size) -> int64_t {
+            auto* bytes = static_cast<std::vector<uint8_t>*>(stream->ctx);
+            const auto* data = static_cast<const uint8_t*>(buffer);
+            bytes->insert(bytes->end(), data, data + size);
+            return static_cast<int64_t>(size);
+        };
+        if (!state->save(m_plugin, &stream)) {
+            error = "The plugin failed to save its state";
+            return false;
+        }
+    }
+
+    auto params = static_cast<const clap_plugin_params_t*>(m_plugin->get_extension(m_plugin, CLAP_EXT_PARAMS));
+    if (params) {
+        uint32_t count = params->count(m_plugin);
+        preset.parameters.reserve(count);
+        for (uint32_t i = 0; i < count; i++) {
+            clap_param_info_t info{};
+            double value;
+            if (!params->get_info(m_plugin, i, &info) || (info.flags & CLAP_PARAM_IS_READONLY)) continue;
+            if (params->get_value(m_plugin, info.id, &value)) preset.parameters.push_back({ info.id, value });
+        }
+    }
+
+    if (!state && !params) {
+        error = "The plugin has no state or parameters to save";
+        return false;
+    }
+    return true;
+}
+
+bool ClapPluginNode::loadState(const PluginPreset& preset, std::string& error) {
+    if (preset.pluginId != m_plugin->desc->id) {
+        error = "The preset is for " + preset.pluginId;
+        return false;
+    }
+    // Parameters of an inactive plugin are flushed on the main thread
+    if (m_activated) {
+        error = "Presets are loaded before the plugin is activated";
+        return false;
+    }
+
+    auto state = static_cast<const clap_plugin_state_t*>(m_plugin->get_extension(m_plugin, CLAP_EXT_STATE));
+    if (state && !preset.state.empty()) {
+        struct Reader {
+            const std::vector<uint8_t>* bytes;
+            size_t offset;
+        } reader{ &preset.state, 0 };
+
+        clap_istream_t stream;
+        stream.ctx = &reader;
+        stream.read = [](const clap_istream_t* stream, void* buffer, uint64_t size) -> int64_t {
+            auto* reader = static_cast<Reader*>(stream->ctx);
+            size_t count = std::min<uint64_t>(size, reader->bytes->size() - reader->offset);
+            std::memcpy(buffer, reader->bytes->data() + reader->offset, count);
+            reader->offset += count;
+            return static_cast<int64_t>(count);
+        };
+        if (!state->load(m_plugin, &stream)) {
+            error = "The plugin failed to load the preset";
+            return false;
+        }
+        return true;
+    }
+
+    auto params = static_cast<const clap_plugin_params_t*>(m_plugin->get_extension(m_plugin, CLAP_EXT_PARAMS));
+    if (!params) {
+        error = "The plugin can't load this preset";
+        return false;
+    }
+
+    EventList in(static_cast<uint32_t>(preset.parameters.size()),
+                 static_cast<uint32_t>(preset.parameters.size() * sizeof(clap_event_param_value_t)));
+    EventList out(0, 0);
+    for (const auto& parameter : preset.parameters) {
+        clap_event_param_value_t event{};
+        event.header.size = sizeof(event);
+        event.header.space_id = CLAP_CORE_EVENT_SPACE_ID;
+        event.header.type = CLAP_EVENT_PARAM_VALUE;
+        event.param_id = parameter.id;
+        event.note_id = -1;
+        event.port_index = -1;
+        event.channel = -1;
+        event.key = -1;
+        event.value = parameter.value;
+        in.push(&event.header);
+    }
+    params->flush(m_plugin, in.input(), out.output());
+    return true;
+}
+
+void ClapPluginNode::queryAudioPorts() {
+    m_inputPorts.clear();
+    m_outputPorts.clear();
+    m_inputChannels.clear();
+    m_outputChannels.clear();
+
+    auto ports = static_cast<const clap_plugin_audio_ports_t*>(m_plugin->get_extension(m_plugin, CLAP_EXT_AUDIO_PORTS));
+    if (!ports) return;
+
+    for (bool isInput : { true, false }) {
+        auto& buffers = isInput ? m_inputPorts : m_outputPorts;
+        auto& channels = isInput ? m_inputChannels : m_outputChannels;
+
+        uint32_t count = ports->count(m_plugin, isInput);
+        for (uint32_t i = 0; i < count; i++) {
+            clap_audio_port_info_t info{};
+            if (!ports->get(m_plugin, i, isInput, &info)) continue;
+
+            // Every CLAP plugin handles 32-bit samples, which is what the graph uses
+            clap_audio_buffer_t buffer{};
+            buffer.channel_count = info.channel_count;
+            buffers.push_back(buffer);
+            channels.resize(channels.size() + info.channel_count, nullptr);
+        }
+
+        // The channel arrays are complete, so the port pointers are stable
+        size_t offset = 0;
+        for (auto& buffer : buffers) {
+            buffer.data32 = channels.data() + offset;
+            offset += buffer.channel_count;
+        }
+    }
+}
+
+bool ClapPluginNode::prepare(double sampleRate, uint32_t maxFrames) {
+    release();
+    m_failed = false;
+    m_sleeping = false;
+    m_lastStatus = CLAP_PROCESS_CONTINUE;
+    m_quietFrames = 0;
+    m_outputsQuiet = false;
+    m_activated = m_plugin->activate(m_plugin, sampleRate, 1, maxFrames);
+    return m_activated;
+}
+
+void ClapPluginNode::release() {
+    if (!m_activated) return;
+
+    // The graph only releases nodes the audio thread no longer processes,
+    // so this thread can stand in for it
+    if (m_processing) {
+        audiothread::Scope audioThread;
+        m_plugin->stop_processing(m_plugin);
+        m_processing = false;
+    }
+    m_plugin->deactivate(m_plugin);
+    m_activated = false;
+}
+
+void ClapPluginNode::idle() {
+    if (m_callbackRequested.exchange(false)) m_plugin->on_main_thread(m_plugin);
+    flushLog();
+}
+
+void ClapPluginNode::silenceOutputs(const AudioBlock& block) {
+    for (uint32_t channel = 0; channel < numOutputs(); channel++) {
+        std::memset(block.outputs[channel], 0, block.frames * sizeof(float));
+        block.setOutputSilent(channel);
+    }
+}
+
+bool ClapPluginNode::inputsQuiet(const AudioBlock& block) const {
+    if (block.inEvents->size() > 0) return false;
+    for (uint32_t channel = 0; channel < numInputs(); channel++) {
+        if (!block.isInputSilent(channel)) return false;
+    }
+    return true;
+}
+
+bool ClapPluginNode::readyToSleep() const {
+    switch (m_lastStatus) {
+        case CLAP_PROCESS_SLEEP:
+            return true;
+        case CLAP_PROCESS_CONTINUE_IF_NOT_QUIET:
+            // Let a reverb or delay ring out even if the plugin says otherwise
+            return m_outputsQuiet;
+        case CLAP_PROCESS_TAIL: {
+            if (!m_tail) return m_outputsQuiet;
+            // INT32_MAX and above mean the tail never ends
+            uint32_t tail = m_tail->get(m_plugin);
+            return tail < INT32_MAX && m_quietFrames >= tail;
+        }
+        default:
+            return false;
+    }
+}
+
+void ClapPluginNode::process(const AudioBlock& block) {
+    if (m_failed || !m_activated) {
+        silenceOutputs(block);
+        return;
+    }
+
+    bool wake = m_wakeRequested.exchange(false);
+    bool quiet = !wake && inputsQuiet(block);
+    if (quiet && (m_sleeping || readyToSleep())) {
+        if (m_processing) {
+            m_plugin->stop_processing(m_plugin);
+            m_processing = false;
+        }
+        m_sleeping = true;
+        silenceOutputs(block);
+        return;
+    }
+    m_sleeping = false;
+    if (!quiet) m_quietFrames = 0;
+
+    if (!m_processing) {
+        if (!m_plugin->start_processing(m_plugin)) {
+            m_failed = true;
+            silenceOutputs(block);
+            return;
+        }
+        m_processing = true;
+    }
+
+    // Plugins only read their inputs, CLAP just has no const channel type
+    for (size_t i = 0; i < m_inputChannels.size(); i++) m_inputChannels[i] = const_cast<float*>(block.inputs[i]);
+    for (size_t i = 0; i < m_outputChannels.size(); i++) m_outputChannels[i] = block.outputs[i];
+
+    // Silent inputs are passed on as constant channels
+    uint32_t channel = 0;
+    for (auto& port : m_inputPorts) {
+        port.constant_mask = 0;
+        for (uint32_t i = 0; i < port.channel_count; i++, channel++) {
+            if (i < 64 && block.isInputSilent(channel)) port.constant_mask |= uint64_t(1) << i;
+        }
+    }
+    for (auto& port : m_outputPorts) port.constant_mask = 0;
+
+    clap_process_t process{};
+    process.steady_time = block.steadyTime;
+    process.frames_count = block.frames;
+    process.audio_inputs = m_inputPorts.data();
+    process.audio_outputs = m_outputPorts.data();
+    process.audio_inputs_count = static_cast<uint32_t>(m_inputPorts.size());
+    process.audio_outputs_count = static_cast<uint32_t>(m_outputPorts.size());
+    process.in_events = block.inEvents->input();
+    process.out_events = block.outEvents->output();
+
+    m_workers = block.workers;
+    clap_process_status status = m_plugin->process(m_plugin, &process);
+    m_workers = nullptr;
+
+    if (status == CLAP_PROCESS_ERROR) {
+        m_failed = true;
+        silenceOutputs(block);
+        return;
+    }
+    m_lastStatus = status;
+    if (quiet) m_quietFrames += block.frames;
+
+    // Flag silent outputs for the nodes downstream. Outputs the plugin
+    // marked constant are free to check; the rest are only scanned while
+    // the inputs are quiet, since that is when they can be silent.
+    m_outputsQuiet = true;
+    channel = 0;
+    for (const auto& port : m_outputPorts) {
+        for (uint32_t i = 0; i < port.channel_count; i++, channel++) {
+            const float* samples = port.data32[i];
+            bool constant = i < 64 && (port.constant_mask >> i) & 1;
+            bool silent = constant ? block.frames == 0 || samples[0] == 0.0f
+                                   : quiet && isBufferSilent(samples, block.frames);
+            if (silent) {
+                block.setOutputSilent(channel);
+            } else {
+                m_outputsQuiet = false;
+            }
+        }
+    }
+}
+
+// --- Host callbacks
+
+ClapPluginNode* ClapPluginNode::fromHost(const clap_host_t* host) {
+    return static_cast<ClapPluginNode*>(host->host_data);
+}
+
+const void* ClapPluginNode::hostGetExtension(const clap_host_t* host, const char* extensionId) {
+    static const clap_host_thread_pool_t threadPool = {
+        &ClapPluginNode::hostRequestExec,
+    };
+    static const clap_host_thread_check_t threadCheck = {
+        &ClapPluginNode::hostIsMainThread,
+        &ClapPluginNode::hostIsAudioThread,
+    };
+    static const clap_host_log_t log = {
+        &ClapPluginNode::hostLog,
+    };
+    static const clap_host_audio_ports_t audioPorts = {
+        &ClapPluginNode::hostIsRescanFlagSupported,
+        &ClapPluginNode::hostRescanAudioPorts,
+    };
+    static const clap_host_tail_t tail = {
+        &ClapPluginNode::hostTailChanged,
+    };
+
+    if (!std::strcmp(extensionId, CLAP_EXT_THREAD_POOL)) return &threadPool;
+    if (!std::strcmp(extensionId, CLAP_EXT_THREAD_CHECK)) return &threadCheck;
+    if (!std::strcmp(extensionId, CLAP_EXT_LOG)) return &log;
+    if (!std::strcmp(extensionId, CLAP_EXT_AUDIO_PORTS)) return &audioPorts;
+    if (!std::strcmp(extensionId, CLAP_EXT_TAIL)) return &tail;
+    return nullptr;
+}
+
+void ClapPluginNode::hostRequestRestart(const clap_host_t* host) {
+    fromHost(host)->m_restartRequested = true;
+}
+
+void ClapPluginNode::hostRequestProcess(const clap_host_t* host) {
+    // Nodes are processed every block unless they sleep
+    fromHost(host)->m_wakeRequested = true;
+}
+
+void ClapPluginNode::hostRequestCallback(const clap_host_t* host) {
+    fromHost(host)->m_callbackRequested = true;
+}
+
+bool ClapPluginNode::hostIsMainThread(const clap_host_t* host) {
+    return std::this_thread::get_id() == fromHost(host)->m_mainThread;
+}
+
+bool ClapPluginNode::hostIsAudioThread(const clap_host_t*) {
+    return audiothread::isCurrent();
+}
+
+void ClapPluginNode::hostLog(const clap_host_t* host, clap_log_severity severity, const char* message) {
+    auto* node = fromHost(host);
+    const char* plugin = node->m_plugin && node->m_plugin->desc ? node->m_plugin->desc->name : nullptr;
+    if (std::this_thread::get_id() == node->m_mainThread) {
+        flushLog();
+        writeLog(plugin ? plugin : "", severity, message ? message : "");
+        return;
+    }
+
+    if (s_logWriting.test_and_set(std::memory_order_acquire)) {
+        s_logDropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    LogEntry entry;
+    entry.severity = severity;
+    copyText(entry.plugin, plugin);
+    copyText(entry.message, message);
+    if (s_log.write(&entry, 1) == 0) s_logDropped.fetch_add(1, std::memory_order_relaxed);
+    s_logWriting.clear(std::memory_order_release);
+}
+
+void ClapPluginNode::setLogHandler(LogHandler handler) {
+    s_logHandler = std::move(handler);
+}
+
+void ClapPluginNode::flushLog() {
+    LogEntry entry;
+    while (s_log.read(&entry, 1) == 1) writeLog(entry.plugin, entry.severity, entry.message);
+    if (uint32_t dropped = s_logDropped.exchange(0, std::memory_order_relaxed)) {
+        std::string message = std::to_string(dropped) + " plugin log messages dropped";
+        writeLog("", CLAP_LOG_HOST_MISBEHAVING, message.c_str());
+    }
+}
+
+void ClapPluginNode::writeLog(const char* plugin, clap_log_severity severity, const char* message) {
+    if (s_logHandler) {
+        s_logHandler(plugin, severity, message);
+    } else {
+        std::fprintf(stderr, "[%s] %s: %s\n", plugin, severityName(severity), message);
+    }
+}
+
+bool ClapPluginNode::hostRequestExec(const clap_host_t* host, uint32_t taskCount) {
+    // Only valid from inside process(). Returning false makes the plugin do
+    // the work itself, which is also the answer when the pool is taken.
+    auto* node = fromHost(host);
+    if (!audiothread::isCurrent() || !node->m_workers || !node->m_threadPool) return false;
+    return node->m_workers->execute(taskCount, &ClapPluginNode::runPoolTask, node);
+}
+
+void ClapPluginNode::runPoolTask(void* context, uint32_t index) {
+    auto* node = static_cast<ClapPluginNode*>(context);
+    node->m_threadPool->exec(node->m_plugin, index);
+}
+
+bool ClapPluginNode::hostIsRescanFlagSupported(const clap_host_t*, uint32_t) {
+    // Any change to the ports means a new instance
+    return true;
+}
+
+void ClapPluginNode::hostRescanAudioPorts(const clap_host_t* host, uint32_t) {
+    fromHost(host)->m_restartRequested = true;
+}
+
+void ClapPluginNode::hostTailChanged(const clap_host_t*) {
+    // The tail is read again whenever the plugin might go to sleep
+}
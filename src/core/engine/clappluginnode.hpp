@@ -0,0 +1,156 @@
+#pragma once
+
+#include "audionode.hpp"
+#include "DynamicLibrary.hpp"
+#include "presetfile.hpp"
+#include <atomic>
+#include <clap/clap.h>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// A loaded .clap file. Every instance created from it shares the same
+// module; clap_entry.init runs when the first one is opened and deinit
+// after the last one is gone.
+class ClapModule {
+public:
+    static std::shared_ptr<ClapModule> open(const std::filesystem::path& path, std::string& error);
+    ~ClapModule();
+
+    ClapModule(const ClapModule&) = delete;
+    ClapModule& operator=(const ClapModule&) = delete;
+
+    const std::filesystem::path& path() const { return m_path; }
+    const clap_plugin_factory_t* factory() const { return m_factory; }
+
+private:
+    ClapModule() = default;
+
+    std::filesystem::path m_path;
+    futureboard::DynamicLibrary m_library;
+    const clap_plugin_entry_t* m_entry = nullptr;
+    const clap_plugin_factory_t* m_factory = nullptr;
+};
+
+// Hosts one CLAP plugin instance as a graph node.
+//
+// The plugin's audio ports are laid out one after another as the node's
+// channels, main port first, and their clap_audio_buffer_t entries point
+// straight at the graph's buffers, so nothing is copied around process().
+// Events come from and go to the graph's preallocated event lists.
+//
+// The host side implements clap.thread-pool on the engine's
+// AudioWorkerPool, plus clap.thread-check, clap.log, clap.audio-ports and
+// clap.tail. Messages logged off the main thread are queued without
+// blocking and handed on by flushLog().
+//
+// A plugin whose inputs are silent and that gets no events is put to sleep
+// as its last process status allows: at once for CLAP_PROCESS_SLEEP, once
+// its output is silent too for CLAP_PROCESS_CONTINUE_IF_NOT_QUIET, and
+// after clap.tail's length of quiet input for CLAP_PROCESS_TAIL. A sleeping
+// plugin is stopped and its outputs are flagged silent without calling it.
+// The first block with signal, an event or a request_process() wakes it,
+// and it processes that whole block, so nothing arriving mid-block is lost.
+class ClapPluginNode : public AudioNode {
+public:
+    using LogHandler = std::function<void(const char* plugin, clap_log_severity severity, const char* message)>;
+
+    // Main thread. An empty pluginId picks the first plugin in the file.
+    static std::shared_ptr<ClapPluginNode> create(const std::filesystem::path& path, const std::string& pluginId,
+                                                  std::string& error);
+    ~ClapPluginNode() override;
+
+    uint32_t numInputs() const override { return static_cast<uint32_t>(m_inputChannels.size()); }
+    uint32_t numOutputs() const override { return static_cast<uint32_t>(m_outputChannels.size()); }
+
+    bool prepare(double sampleRate, uint32_t maxFrames) override;
+    void release() override;
+    void process(const AudioBlock& block) override;
+
+    const clap_plugin_t* plugin() const { return m_plugin; }
+    const std::filesystem::path& path() const { return m_module->path(); }
+    std::string name() const;
+
+    // Main thread. Fills preset with the plugin's clap.state and the values
+    // of its parameters.
+    bool saveState(PluginPreset& preset, std::string& error) const;
+    // Main thread, before the node is prepared. Restores the plugin's state,
+    // or sets its parameters when the preset has no state.
+    bool loadState(const PluginPreset& preset, std::string& error);
+
+    // Set once process() returned CLAP_PROCESS_ERROR. The node then outputs
+    // silence until it is prepared again.
+    bool hasFailed() const { return m_failed; }
+    // The plugin asked to be restarted or changed its ports; the owner
+    // should create a new instance
+    bool needsRestart() const { return m_restartRequested; }
+    // Skipped by process() until signal or events arrive
+    bool isSleeping() const { return m_sleeping; }
+    // Main thread, regularly: serves the plugin's request_callback and
+    // flushes the log
+    void idle();
+
+    // Main thread, before any plugin is created. Without a handler,
+    // messages go to stderr.
+    static void setLogHandler(LogHandler handler);
+    // Main thread, regularly: hands what plugins logged on other threads to
+    // the handler
+    static void flushLog();
+
+private:
+    explicit ClapPluginNode(std::shared_ptr<ClapModule> module);
+
+    void queryAudioPorts();
+    void silenceOutputs(const AudioBlock& block);
+    bool inputsQuiet(const AudioBlock& block) const;
+    // With quiet inputs, whether the last process status lets the plugin sleep
+    bool readyToSleep() const;
+
+    static ClapPluginNode* fromHost(const clap_host_t* host);
+    static const void* hostGetExtension(const clap_host_t* host, const char* extensionId);
+    static void hostRequestRestart(const clap_host_t* host);
+    static void hostRequestProcess(const clap_host_t* host);
+    static void hostRequestCallback(const clap_host_t* host);
+    static bool hostIsMainThread(const clap_host_t* host);
+    static bool hostIsAudioThread(const clap_host_t* host);
+    static void hostLog(const clap_host_t* host, clap_log_severity severity, const char* message);
+    // Main thread
+    static void writeLog(const char* plugin, clap_log_severity severity, const char* message);
+    static bool hostRequestExec(const clap_host_t* host, uint32_t taskCount);
+    static void runPoolTask(void* context, uint32_t index);
+    static bool hostIsRescanFlagSupported(const clap_host_t* host, uint32_t flag);
+    static void hostRescanAudioPorts(const clap_host_t* host, uint32_t flags);
+    static void hostTailChanged(const clap_host_t* host);
+
+    std::shared_ptr<ClapModule> m_module;
+    clap_host_t m_host;
+    const clap_plugin_t* m_plugin = nullptr;
+    const clap_plugin_thread_pool_t* m_threadPool = nullptr;
+    const clap_plugin_tail_t* m_tail = nullptr;
+    std::thread::id m_mainThread;
+
+    // One entry per port; data32 points into the channel arrays below,
+    // which process() fills with the graph's buffers
+    std::vector<clap_audio_buffer_t> m_inputPorts;
+    std::vector<clap_audio_buffer_t> m_outputPorts;
+    std::vector<float*> m_inputChannels;
+    std::vector<float*> m_outputChannels;
+
+    bool m_activated = false;
+    bool m_processing = false;
+    AudioWorkerPool* m_workers = nullptr;  // The current block's, audio thread only
+
+    // Audio thread
+    clap_process_status m_lastStatus = CLAP_PROCESS_CONTINUE;
+    uint64_t m_quietFrames = 0;     // Processed since the inputs went quiet
+    bool m_outputsQuiet = false;    // Every output was silent in the last block
+
+    std::atomic<bool> m_failed{false};
+    std::atomic<bool> m_restartRequested{false};
+    std::atomic<bool> m_callbackRequested{false};
+    std::atomic<bool> m_wakeRequested{false};
+    std::atomic<bool> m_sleeping{false};
+};
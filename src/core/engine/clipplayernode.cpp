@@ -0,0 +1,22 @@
+#include "clipplayernode.hpp"
+
+ClipPlayerNode::ClipPlayerNode(DiskStreamer& streamer, DiskStreamer::ClipId clip, uint32_t numOutputs)
+    : m_streamer(streamer)
+    , m_clip(clip)
+    , m_numOutputs(numOutputs)
+{
+}
+
+bool ClipPlayerNode::prepare(double sampleRate, uint32_t maxFrames) {
+    (void)maxFrames;
+    // Clips aren't resampled, so they only play at their own rate
+    const AudioFileInfo* info = m_streamer.clipInfo(m_clip);
+    return info && info->sampleRate == static_cast<uint32_t>(sampleRate);
+}
+
+void ClipPlayerNode::process(const AudioBlock& block) {
+    uint32_t missed = m_streamer.play(m_clip, block.outputs, m_numOutputs, block.frames);
+    if (missed == block.frames) {
+        for (uint32_t channel = 0; channel < m_numOutputs; channel++) block.setOutputSilent(channel);
+    }
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "audionode.hpp"
+#include "diskstreamer.hpp"
+
+// Plays one clip streamed by a DiskStreamer into the graph. The transport
+// moves it with DiskStreamer::seek() and setLoop(); outputs the streamer
+// had nothing for are flagged silent.
+class ClipPlayerNode : public AudioNode {
+public:
+    ClipPlayerNode(DiskStreamer& streamer, DiskStreamer::ClipId clip, uint32_t numOutputs);
+
+    uint32_t numInputs() const override { return 0; }
+    uint32_t numOutputs() const override { return m_numOutputs; }
+
+    bool prepare(double sampleRate, uint32_t maxFrames) override;
+    void release() override {}
+    void process(const AudioBlock& block) override;
+
+    DiskStreamer::ClipId clip() const { return m_clip; }
+
+private:
+    DiskStreamer& m_streamer;
+    DiskStreamer::ClipId m_clip;
+    uint32_t m_numOutputs;
+};
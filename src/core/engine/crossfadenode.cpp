@@ -0,0 +1,85 @@
+#include "crossfadenode.hpp"
+#include <algorithm>
+#include <cmath>
+
+CrossfadeNode::CrossfadeNode(std::shared_ptr<AudioNode> from, std::shared_ptr<AudioNode> to, double fadeSeconds)
+    : m_from(std::move(from))
+    , m_to(std::move(to))
+    , m_fadeSeconds(fadeSeconds)
+{
+}
+
+bool CrossfadeNode::prepare(double sampleRate, uint32_t maxFrames) {
+    if (!m_to->prepare(sampleRate, maxFrames)) return false;
+
+    uint32_t outputs = m_to->numOutputs();
+    m_memory.assign(size_t(outputs) * maxFrames, 0.0f);
+    m_fromOutputs.resize(outputs);
+    for (uint32_t channel = 0; channel < outputs; channel++) {
+        m_fromOutputs[channel] = m_memory.data() + size_t(channel) * maxFrames;
+    }
+    m_fadeIn.resize(maxFrames);
+    m_fadeOut.resize(maxFrames);
+    m_fadeFrames = std::max(1u, static_cast<uint32_t>(m_fadeSeconds * sampleRate));
+    m_position = 0;
+    return true;
+}
+
+void CrossfadeNode::release() {
+    releaseSource();
+    m_to->release();
+}
+
+void CrossfadeNode::releaseSource() {
+    if (!m_from) return;
+    m_from->release();
+    m_from.reset();
+}
+
+void CrossfadeNode::process(const AudioBlock& block) {
+    if (m_position >= m_fadeFrames) {
+        m_to->process(block);
+        return;
+    }
+
+    uint64_t toSilent = 0;
+    AudioBlock to = block;
+    to.silentOutputs = &toSilent;
+    m_to->process(to);
+
+    uint64_t fromSilent = 0;
+    m_fromEvents.clear();
+    AudioBlock from = block;
+    from.outputs = m_fromOutputs.data();
+    from.inEvents = &m_noEvents;
+    from.outEvents = &m_fromEvents;
+    from.silentOutputs = &fromSilent;
+    m_from->process(from);
+
+    // Equal power, the two rarely play the same signal
+    constexpr double kQuarterTurn = 1.5707963267948966;
+    for (uint32_t i = 0; i < block.frames; i++) {
+        double x = std::min(1.0, double(m_position + i) / m_fadeFrames) * kQuarterTurn;
+        m_fadeIn[i] = float(std::sin(x));
+        m_fadeOut[i] = float(std::cos(x));
+    }
+    for (uint32_t channel = 0; channel < numOutputs(); channel++) {
+        bool toIsSilent = channel < AudioBlock::kMaxSilenceChannels && (toSilent >> channel) & 1;
+        bool fromIsSilent = channel < AudioBlock::kMaxSilenceChannels && (fromSilent >> channel) & 1;
+        float* output = block.outputs[channel];
+        const float* old = m_fromOutputs[channel];
+        if (toIsSilent && fromIsSilent) {
+            std::fill(output, output + block.frames, 0.0f);
+            block.setOutputSilent(channel);
+        } else if (fromIsSilent) {
+            for (uint32_t i = 0; i < block.frames; i++) output[i] *= m_fadeIn[i];
+        } else if (toIsSilent) {
+            for (uint32_t i = 0; i < block.frames; i++) output[i] = old[i] * m_fadeOut[i];
+        } else {
+            for (uint32_t i = 0; i < block.frames; i++) output[i] = output[i] * m_fadeIn[i] + old[i] * m_fadeOut[i];
+        }
+    }
+
+    m_position = std::min(m_fadeFrames, m_position + block.frames);
+    if (m_position >= m_fadeFrames) m_finished.store(true, std::memory_order_release);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "audionode.hpp"
+#include "eventlist.hpp"
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// Plays a node on its way out next to the one replacing it, fading from
+// one to the other so notes, reverb and delay tails of the old one aren't
+// cut off. AudioGraph::crossfadeNode() puts one in a node's place and
+// swaps in the new node alone once the fade is over.
+//
+// Both nodes have the same channels. from is already prepared and keeps
+// running; prepare() only prepares to. Events go to the new node only.
+class CrossfadeNode : public AudioNode {
+public:
+    CrossfadeNode(std::shared_ptr<AudioNode> from, std::shared_ptr<AudioNode> to, double fadeSeconds);
+
+    uint32_t numInputs() const override { return m_to->numInputs(); }
+    uint32_t numOutputs() const override { return m_to->numOutputs(); }
+
+    bool prepare(double sampleRate, uint32_t maxFrames) override;
+    // Releases both nodes
+    void release() override;
+    void process(const AudioBlock& block) override;
+
+    const std::shared_ptr<AudioNode>& target() const { return m_to; }
+    // Set by the audio thread once from is no longer heard
+    bool isFinished() const { return m_finished.load(std::memory_order_acquire); }
+    // Main thread, once the audio thread no longer processes this node
+    void releaseSource();
+
+private:
+    std::shared_ptr<AudioNode> m_from;
+    std::shared_ptr<AudioNode> m_to;
+    double m_fadeSeconds;
+    uint32_t m_fadeFrames = 0;
+    uint32_t m_position = 0;
+    std::atomic<bool> m_finished{false};
+
+    // The old node's outputs and events, and the gains of one block
+    std::vector<float> m_memory;
+    std::vector<float*> m_fromOutputs;
+    std::vector<float> m_fadeIn;
+    std::vector<float> m_fadeOut;
+    EventList m_noEvents{ 0, 0 };
+    EventList m_fromEvents;
+};
@@ -0,0 +1,378 @@
+#include "decodingservice.hpp"
+#include <algorithm>
+#include <cstring>
+
+DecodingService::~DecodingService() {
+    stop();
+}
+
+bool DecodingService::start(const Options& options, std::string& error) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_running || !m_threads.empty()) {
+        error = "Already decoding";
+        return false;
+    }
+    m_options = options;
+    if (m_options.threads == 0) m_options.threads = std::max(std::thread::hardware_concurrency(), 1u);
+    m_options.blockFrames = std::max(options.blockFrames, 1u);
+    m_options.segmentFrames = std::max<uint64_t>(options.segmentFrames, m_options.blockFrames);
+
+    m_running = true;
+    for (uint32_t i = 0; i < m_options.threads; i++) {
+        m_threads.emplace_back([this] { workerLoop(); });
+    }
+    return true;
+}
+
+void DecodingService::stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_threads.empty()) return;
+        m_running = false;
+        for (auto& job : m_jobs) job->cancelled = true;
+        updateUrgent();
+    }
+    // The workers report every job as cancelled before they leave
+    m_wake.notify_all();
+    for (auto& thread : m_threads) thread.join();
+    m_threads.clear();
+}
+
+DecodingService::JobId DecodingService::decode(const std::filesystem::path& path, uint64_t startFrame,
+                                               uint64_t frames, Priority priority, BlockCallback onBlock,
+                                               FinishedCallback onFinished) {
+    auto job = std::make_shared<Job>();
+    job->path = path;
+    job->startFrame = startFrame;
+    job->frames = frames;
+    job->onBlock = std::move(onBlock);
+    job->onFinished = std::move(onFinished);
+    job->priority = static_cast<int>(priority);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_running) return kInvalidJob;
+        job->id = m_nextId++;
+        job->sequence = m_nextSequence++;
+        m_jobs.push_back(job);
+        updateUrgent();
+    }
+    m_wake.notify_one();
+    return job->id;
+}
+
+void DecodingService::cancel(JobId id) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto job = findJob(id);
+        if (!job) return;
+        job->cancelled = true;
+        updateUrgent();
+    }
+    // A job nobody works on is reported by the next free worker
+    m_wake.notify_one();
+}
+
+void DecodingService::setPriority(JobId id, Priority priority) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto job = findJob(id);
+        if (!job) return;
+        job->priority = static_cast<int>(priority);
+        updateUrgent();
+    }
+    m_wake.notify_one();
+}
+
+DecodingService::Stats DecodingService::stats() const {
+    Stats stats;
+    stats.jobsDone = m_jobsDone.load();
+    stats.jobsCancelled = m_jobsCancelled.load();
+    stats.jobsFailed = m_jobsFailed.load();
+    stats.framesDecoded = m_framesDecoded.load();
+    stats.decodersOpened = m_decodersOpened.load();
+    stats.yields = m_yields.load();
+    return stats;
+}
+
+bool DecodingService::hasWork(const Job& job) {
+    return !job.returned.empty() || !job.exhausted;
+}
+
+std::shared_ptr<DecodingService::Job> DecodingService::findJob(JobId id) const {
+    for (const auto& job : m_jobs) {
+        if (job->id == id) return job;
+    }
+    return nullptr;
+}
+
+// Called with m_mutex held
+bool DecodingService::takeTask(Task& task) {
+    std::shared_ptr<Job> best;
+    for (auto it = m_jobs.begin(); it != m_jobs.end(); ++it) {
+        auto& job = *it;
+        if (job->cancelled.load()) {
+            if (job->running == 0) {
+                task.kind = Task::Kind::Finish;
+                task.job = job;
+                m_jobs.erase(it);
+                updateUrgent();
+                return true;
+            }
+            continue;
+        }
+        // An unplanned job that's running is being opened
+        bool available = job->planned ? hasWork(*job) : job->running == 0;
+        if (!available) continue;
+        int priority = job->priority.load();
+        if (!best || priority > best->priority.load() ||
+            (priority == best->priority.load() && job->sequence < best->sequence)) {
+            best = job;
+        }
+    }
+    if (!best) return false;
+
+    task.job = best;
+    if (best->planned) {
+        task.kind = Task::Kind::Segment;
+        takeSegment(*best, task.from, task.to);
+    } else {
+        task.kind = Task::Kind::Plan;
+    }
+    best->running++;
+    updateUrgent();
+    return true;
+}
+
+// Called with m_mutex held
+bool DecodingService::takeSegment(Job& job, uint64_t& from, uint64_t& to) {
+    if (!job.returned.empty()) {
+        from = job.returned.back().first;
+        to = job.returned.back().second;
+        job.returned.pop_back();
+        return true;
+    }
+    if (job.exhausted) return false;
+
+    from = job.next;
+    if (job.limit <= from || job.limit - from <= m_options.segmentFrames) {
+        to = job.end;
+        job.exhausted = true;
+    } else {
+        to = from + m_options.segmentFrames;
+    }
+    job.next = to;
+    return true;
+}
+
+// Called with m_mutex held
+void DecodingService::plan(Job& job, const AudioDecoder::Info& info) {
+    job.planned = true;
+    job.next = job.startFrame;
+    if (job.frames == kToEnd) {
+        // The length may be an estimate, so the last segment reads on
+        // until the decoder runs out rather than to info.frames
+        job.limit = info.frames;
+        job.end = kToEnd;
+    } else {
+        job.end = job.startFrame + std::min(job.frames, kToEnd - job.startFrame);
+        job.limit = job.end;
+    }
+}
+
+// Called with m_mutex held
+void DecodingService::updateUrgent() {
+    uint32_t urgent = 0;
+    for (const auto& job : m_jobs) {
+        if (job->cancelled.load() || job->priority.load() != static_cast<int>(Priority::Playhead)) continue;
+        if (job->planned ? hasWork(*job) : job->running == 0) urgent++;
+    }
+    m_urgentJobs = urgent;
+}
+
+bool DecodingService::release(Job& job) {
+    job.running--;
+    if (job.running > 0) return false;
+    if (!job.cancelled.load() && !(job.planned && !hasWork(job))) return false;
+
+    m_jobs.erase(std::find_if(m_jobs.begin(), m_jobs.end(),
+                              [&job](const std::shared_ptr<Job>& other) { return other.get() == &job; }));
+    updateUrgent();
+    // stop() waits for the last job to be gone
+    if (!m_running) m_wake.notify_all();
+    return true;
+}
+
+void DecodingService::finish(Job& job) {
+    Result result = Result::Done;
+    if (job.failed) {
+        result = Result::Failed;
+        m_jobsFailed++;
+    } else if (job.cancelled.load()) {
+        result = Result::Cancelled;
+        m_jobsCancelled++;
+    } else {
+        m_jobsDone++;
+    }
+    if (job.onFinished) job.onFinished(job.id, result, job.error);
+}
+
+// Called with m_mutex held
+void DecodingService::fail(Job& job, const std::string& error) {
+    if (!job.failed) {
+        job.failed = true;
+        job.error = error;
+    }
+    // Stops the job's other segments too
+    job.cancelled = true;
+    updateUrgent();
+}
+
+void DecodingService::workerLoop() {
+    Worker worker;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        Task task;
+        if (takeTask(task)) {
+            lock.unlock();
+            switch (task.kind) {
+            case Task::Kind::Plan:
+                runPlan(task, worker);
+                break;
+            case Task::Kind::Segment:
+                runSegment(task, worker);
+                break;
+            case Task::Kind::Finish:
+                finish(*task.job);
+                break;
+            }
+            task.job.reset();
+            lock.lock();
+            continue;
+        }
+
+        if (!m_running && m_jobs.empty()) break;
+        if (worker.decoder) {
+            // Don't hold a file open while there's nothing to do
+            lock.unlock();
+            worker.decoder.reset();
+            worker.job = kInvalidJob;
+            lock.lock();
+            continue;
+        }
+        m_idleWorkers++;
+        m_wake.wait(lock);
+        m_idleWorkers--;
+    }
+}
+
+void DecodingService::runPlan(Task& task, Worker& worker) {
+    Job& job = *task.job;
+    std::string error;
+    std::unique_ptr<AudioDecoder> decoder;
+    if (!job.cancelled.load()) {
+        decoder = AudioDecoder::open(job.path, error);
+        if (decoder) m_decodersOpened++;
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (!decoder && !job.cancelled.load()) fail(job, error);
+    if (job.cancelled.load()) {
+        bool finished = release(job);
+        lock.unlock();
+        if (finished) finish(job);
+        return;
+    }
+
+    // The planning worker keeps the first segment, its decoder already open
+    plan(job, decoder->info());
+    takeSegment(job, task.from, task.to);
+    task.kind = Task::Kind::Segment;
+    updateUrgent();
+    bool more = hasWork(job);
+    lock.unlock();
+    if (more) m_wake.notify_all();
+
+    worker.decoder = std::move(decoder);
+    worker.job = job.id;
+    runSegment(task, worker);
+}
+
+void DecodingService::runSegment(Task& task, Worker& worker) {
+    Job& job = *task.job;
+    std::string error;
+    if (!worker.decoder || worker.job != job.id) {
+        worker.decoder.reset();
+        worker.job = kInvalidJob;
+        auto decoder = AudioDecoder::open(job.path, error);
+        if (!decoder) {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            fail(job, error);
+            bool finished = release(job);
+            lock.unlock();
+            if (finished) finish(job);
+            return;
+        }
+        m_decodersOpened++;
+        worker.decoder = std::move(decoder);
+        worker.job = job.id;
+    }
+
+    AudioDecoder& decoder = *worker.decoder;
+    const auto& info = decoder.info();
+    std::vector<float*> channels(info.channels);
+    uint64_t position = task.from;
+    bool ok = decoder.seek(position);
+    bool yielded = false;
+    if (!ok) error = decoder.getError();
+
+    while (ok && position < task.to && !job.cancelled.load()) {
+        if (job.priority.load() < static_cast<int>(Priority::Playhead) && m_urgentJobs.load() > 0 &&
+            m_idleWorkers.load() == 0) {
+            yielded = true;
+            break;
+        }
+
+        Block block;
+        block.job = job.id;
+        block.startFrame = position;
+        block.channels = info.channels;
+        block.sampleRate = info.sampleRate;
+        block.frames = static_cast<uint32_t>(std::min<uint64_t>(m_options.blockFrames, task.to - position));
+        block.samples.resize(size_t(block.frames) * info.channels);
+        for (uint32_t channel = 0; channel < info.channels; channel++) channels[channel] = block.channel(channel);
+
+        uint32_t done = decoder.read(channels.data(), block.frames);
+        if (decoder.hasFailed()) {
+            error = decoder.getError();
+            ok = false;
+            break;
+        }
+        if (done == 0) break;
+
+        bool atEnd = done < block.frames;
+        if (atEnd) {
+            // Close up the channels to the frames there were
+            for (uint32_t channel = 1; channel < info.channels; channel++) {
+                std::memmove(block.samples.data() + size_t(channel) * done, channels[channel], done * sizeof(float));
+            }
+            block.frames = done;
+            block.samples.resize(size_t(done) * info.channels);
+        }
+        position += done;
+        m_framesDecoded += done;
+        if (job.onBlock) job.onBlock(std::move(block));
+        if (atEnd) break;
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (!ok) {
+        fail(job, error);
+    } else if (yielded) {
+        job.returned.emplace_back(position, task.to);
+        m_yields++;
+        updateUrgent();
+    }
+    bool finished = release(job);
+    lock.unlock();
+    if (finished) finish(job);
+}
@@ -0,0 +1,176 @@
+#pragma once
+
+#include "audiodecoder.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Decodes audio files to planar float on a pool of worker threads, for
+// importing, waveform drawing and anything else that wants whole files or
+// stretches of them.
+//
+// A job decodes a range of frames from one file, all of it by default. Long
+// ranges are split into segments that several workers decode at once, each
+// through its own decoder seeked to its segment, so one big file keeps the
+// whole pool busy as well as many small ones do. Workers take the next
+// segment of the job with the highest priority, oldest job first. A worker
+// on a lower priority job hands the rest of its segment back when a
+// Playhead job is waiting and no worker is free, so what's under the
+// playhead never waits for a background import.
+//
+// Blocks arrive on the worker threads. Within a segment they come in
+// order, but segments overlap, so callers place blocks by startFrame.
+class DecodingService {
+public:
+    using JobId = uint64_t;
+    static constexpr JobId kInvalidJob = 0;
+    // Decodes to the end of the file
+    static constexpr uint64_t kToEnd = UINT64_MAX;
+
+    enum class Priority { Background, Normal, Playhead };
+    enum class Result { Done, Cancelled, Failed };
+
+    struct Options {
+        // 0 uses every core
+        uint32_t threads = 0;
+        uint32_t blockFrames = 65536;
+        // Frames one worker decodes before the job's next stretch can go
+        // to another; smaller spreads a file wider but seeks more
+        uint64_t segmentFrames = 1 << 20;
+    };
+
+    struct Block {
+        JobId job = kInvalidJob;
+        uint64_t startFrame = 0;
+        uint32_t frames = 0;
+        uint32_t channels = 0;
+        uint32_t sampleRate = 0;
+        // One run of frames samples per channel
+        std::vector<float> samples;
+
+        float* channel(uint32_t index) { return samples.data() + size_t(index) * frames; }
+        const float* channel(uint32_t index) const { return samples.data() + size_t(index) * frames; }
+    };
+
+    // Worker threads. May cancel() or decode() from inside.
+    using BlockCallback = std::function<void(Block&& block)>;
+    // Worker threads, once per job and after its last block
+    using FinishedCallback = std::function<void(JobId job, Result result, const std::string& error)>;
+
+    struct Stats {
+        uint64_t jobsDone = 0;
+        uint64_t jobsCancelled = 0;
+        uint64_t jobsFailed = 0;
+        uint64_t framesDecoded = 0;
+        uint64_t decodersOpened = 0;
+        // Segments handed back for a Playhead job
+        uint64_t yields = 0;
+    };
+
+    DecodingService() = default;
+    ~DecodingService();
+
+    DecodingService(const DecodingService&) = delete;
+    DecodingService& operator=(const DecodingService&) = delete;
+
+    bool start(const Options& options, std::string& error);
+    // Cancels every job, waits for their FinishedCallbacks and ends the threads
+    void stop();
+
+    // Any thread. Returns kInvalidJob when the service isn't running.
+    JobId decode(const std::filesystem::path& path, uint64_t startFrame, uint64_t frames, Priority priority,
+                 BlockCallback onBlock, FinishedCallback onFinished);
+    // Any thread. No blocks are delivered for the job once the ones being
+    // decoded are done; its FinishedCallback reports Cancelled.
+    void cancel(JobId job);
+    // Any thread. Applies from the job's next segment on, or at once when
+    // raising a job to Playhead.
+    void setPriority(JobId job, Priority priority);
+
+    Stats stats() const;
+
+private:
+    struct Job {
+        JobId id = kInvalidJob;
+        uint64_t sequence = 0;
+        std::filesystem::path path;
+        uint64_t startFrame = 0;
+        uint64_t frames = 0;
+        BlockCallback onBlock;
+        FinishedCallback onFinished;
+        std::atomic<int> priority{0};
+        std::atomic<bool> cancelled{false};
+
+        // Under m_mutex. A job is planned by the first worker to open its
+        // file; until then its length isn't known.
+        bool planned = false;
+        bool exhausted = false;
+        uint64_t next = 0;
+        // Where splitting stops; the last segment runs to end
+        uint64_t limit = 0;
+        uint64_t end = 0;
+        // Segments handed back, taken before new ones
+        std::vector<std::pair<uint64_t, uint64_t>> returned;
+        // Plans and segments being worked on
+        uint32_t running = 0;
+        bool failed = false;
+        std::string error;
+    };
+
+    struct Task {
+        enum class Kind { Plan, Segment, Finish };
+        Kind kind = Kind::Segment;
+        std::shared_ptr<Job> job;
+        uint64_t from = 0;
+        uint64_t to = 0;
+    };
+
+    // A worker's decoder, kept for the next segment of the same job
+    struct Worker {
+        std::unique_ptr<AudioDecoder> decoder;
+        JobId job = kInvalidJob;
+    };
+
+    static bool hasWork(const Job& job);
+    std::shared_ptr<Job> findJob(JobId id) const;
+    bool takeTask(Task& task);
+    bool takeSegment(Job& job, uint64_t& from, uint64_t& to);
+    void plan(Job& job, const AudioDecoder::Info& info);
+    void updateUrgent();
+    // Called with m_mutex held once a plan or segment is over; returns true
+    // when that finished the job, which the caller then reports
+    bool release(Job& job);
+    void finish(Job& job);
+    void fail(Job& job, const std::string& error);
+
+    void workerLoop();
+    void runPlan(Task& task, Worker& worker);
+    void runSegment(Task& task, Worker& worker);
+
+    Options m_options;
+    std::vector<std::thread> m_threads;
+    bool m_running = false;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::vector<std::shared_ptr<Job>> m_jobs;
+    JobId m_nextId = 1;
+    uint64_t m_nextSequence = 0;
+    // Playhead jobs with segments nobody has taken, and workers waiting
+    std::atomic<uint32_t> m_urgentJobs{0};
+    std::atomic<uint32_t> m_idleWorkers{0};
+
+    std::atomic<uint64_t> m_jobsDone{0};
+    std::atomic<uint64_t> m_jobsCancelled{0};
+    std::atomic<uint64_t> m_jobsFailed{0};
+    std::atomic<uint64_t> m_framesDecoded{0};
+    std::atomic<uint64_t> m_decodersOpened{0};
+    std::atomic<uint64_t> m_yields{0};
+};
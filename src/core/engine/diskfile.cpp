@@ -0,0 +1,215 @@
+#include "diskfile.hpp"
+#include <cstring>
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <cerrno>
+    #include <fcntl.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+DiskFile::~DiskFile() {
+    close();
+}
+
+#ifdef _WIN32
+
+bool DiskFile::open(const std::filesystem::path& path, Mode mode, bool directIo) {
+    close();
+    DWORD access = mode == Mode::Read ? GENERIC_READ : GENERIC_READ | GENERIC_WRITE;
+    DWORD disposition = mode == Mode::Read ? OPEN_EXISTING : CREATE_ALWAYS;
+    DWORD flags = FILE_ATTRIBUTE_NORMAL;
+    if (directIo) flags |= FILE_FLAG_NO_BUFFERING | FILE_FLAG_WRITE_THROUGH;
+    if (mode == Mode::Read && !directIo) flags |= FILE_FLAG_SEQUENTIAL_SCAN;
+
+    HANDLE file = CreateFileW(path.c_str(), access, FILE_SHARE_READ, nullptr, disposition, flags, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        m_error = "Cannot open " + path.string() + " (error " + std::to_string(GetLastError()) + ")";
+        return false;
+    }
+    m_handle = file;
+    m_path = path;
+    return true;
+}
+
+void DiskFile::close() {
+    if (m_handle) CloseHandle(static_cast<HANDLE>(m_handle));
+    m_handle = nullptr;
+}
+
+bool DiskFile::isOpen() const {
+    return m_handle != nullptr;
+}
+
+bool DiskFile::preallocate(uint64_t bytes) {
+    FILE_ALLOCATION_INFO info{};
+    info.AllocationSize.QuadPart = static_cast<LONGLONG>(bytes);
+    return SetFileInformationByHandle(static_cast<HANDLE>(m_handle), FileAllocationInfo, &info, sizeof(info)) != 0;
+}
+
+bool DiskFile::writeAt(uint64_t offset, const void* data, size_t size) {
+    auto* bytes = static_cast<const uint8_t*>(data);
+    while (size > 0) {
+        OVERLAPPED overlapped{};
+        overlapped.Offset = static_cast<DWORD>(offset);
+        overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+        DWORD chunk = static_cast<DWORD>(std::min<size_t>(size, 1u << 30));
+        DWORD written = 0;
+        if (!WriteFile(static_cast<HANDLE>(m_handle), bytes, chunk, &written, &overlapped) || written == 0) {
+            m_error = "Failed writing " + m_path.string() + " (error " + std::to_string(GetLastError()) + ")";
+            return false;
+        }
+        bytes += written;
+        offset += written;
+        size -= written;
+    }
+    return true;
+}
+
+int64_t DiskFile::readAt(uint64_t offset, void* data, size_t size) {
+    auto* bytes = static_cast<uint8_t*>(data);
+    size_t total = 0;
+    while (total < size) {
+        OVERLAPPED overlapped{};
+        overlapped.Offset = static_cast<DWORD>(offset + total);
+        overlapped.OffsetHigh = static_cast<DWORD>((offset + total) >> 32);
+        DWORD chunk = static_cast<DWORD>(std::min<size_t>(size - total, 1u << 30));
+        DWORD read = 0;
+        if (!ReadFile(static_cast<HANDLE>(m_handle), bytes + total, chunk, &read, &overlapped)) {
+            if (GetLastError() == ERROR_HANDLE_EOF) break;
+            m_error = "Failed reading " + m_path.string() + " (error " + std::to_string(GetLastError()) + ")";
+            return -1;
+        }
+        if (read == 0) break;
+        total += read;
+    }
+    return static_cast<int64_t>(total);
+}
+
+bool DiskFile::truncate(uint64_t size) {
+    FILE_END_OF_FILE_INFO info{};
+    info.EndOfFile.QuadPart = static_cast<LONGLONG>(size);
+    if (!SetFileInformationByHandle(static_cast<HANDLE>(m_handle), FileEndOfFileInfo, &info, sizeof(info))) {
+        m_error = "Cannot resize " + m_path.string();
+        return false;
+    }
+    return true;
+}
+
+uint64_t DiskFile::size() const {
+    LARGE_INTEGER size{};
+    if (!GetFileSizeEx(static_cast<HANDLE>(m_handle), &size)) return 0;
+    return static_cast<uint64_t>(size.QuadPart);
+}
+
+#else
+
+bool DiskFile::open(const std::filesystem::path& path, Mode mode, bool directIo) {
+    close();
+    int flags = mode == Mode::Read ? O_RDONLY : O_RDWR | O_CREAT | O_TRUNC;
+#ifdef O_DIRECT
+    if (directIo) flags |= O_DIRECT;
+#endif
+    int fd = ::open(path.c_str(), flags | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        m_error = "Cannot open " + path.string() + ": " + std::strerror(errno);
+        return false;
+    }
+#ifdef F_NOCACHE
+    if (directIo) fcntl(fd, F_NOCACHE, 1);
+#endif
+#ifdef POSIX_FADV_SEQUENTIAL
+    if (mode == Mode::Read && !directIo) posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    m_fd = fd;
+    m_path = path;
+    return true;
+}
+
+void DiskFile::close() {
+    if (m_fd >= 0) ::close(m_fd);
+    m_fd = -1;
+}
+
+bool DiskFile::isOpen() const {
+    return m_fd >= 0;
+}
+
+bool DiskFile::preallocate(uint64_t bytes) {
+#if defined(__linux__)
+    // Keeping the size means a crash leaves no stretch of zeros at the end
+    return fallocate(m_fd, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(bytes)) == 0;
+#elif defined(F_PREALLOCATE)
+    fstore_t store{};
+    store.fst_flags = F_ALLOCATECONTIG;
+    store.fst_posmode = F_PEOFPOSMODE;
+    store.fst_length = static_cast<off_t>(bytes);
+    if (fcntl(m_fd, F_PREALLOCATE, &store) == 0) return true;
+    store.fst_flags = F_ALLOCATEALL;
+    return fcntl(m_fd, F_PREALLOCATE, &store) == 0;
+#else
+    (void)bytes;
+    return false;
+#endif
+}
+
+bool DiskFile::writeAt(uint64_t offset, const void* data, size_t size) {
+    auto* bytes = static_cast<const uint8_t*>(data);
+    while (size > 0) {
+        ssize_t written = pwrite(m_fd, bytes, size, static_cast<off_t>(offset));
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) {
+            m_error = "Failed writing " + m_path.string() + ": " + std::strerror(errno);
+            return false;
+        }
+        bytes += written;
+        offset += static_cast<uint64_t>(written);
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+int64_t DiskFile::readAt(uint64_t offset, void* data, size_t size) {
+    auto* bytes = static_cast<uint8_t*>(data);
+    size_t total = 0;
+    while (total < size) {
+        ssize_t read = pread(m_fd, bytes + total, size - total, static_cast<off_t>(offset + total));
+        if (read < 0 && errno == EINTR) continue;
+        if (read < 0) {
+            m_error = "Failed reading " + m_path.string() + ": " + std::strerror(errno);
+            return -1;
+        }
+        if (read == 0) break;
+        total += static_cast<size_t>(read);
+    }
+    return static_cast<int64_t>(total);
+}
+
+bool DiskFile::truncate(uint64_t size) {
+    if (ftruncate(m_fd, static_cast<off_t>(size)) != 0) {
+        m_error = "Cannot resize " + m_path.string() + ": " + std::strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+uint64_t DiskFile::size() const {
+    struct stat st;
+    if (fstat(m_fd, &st) != 0) return 0;
+    return static_cast<uint64_t>(st.st_size);
+}
+
+#endif
+
+void AlignedBuffer::resize(size_t size) {
+    // Over-allocate and round the start up rather than rely on
+    // aligned_alloc, which MSVC doesn't have
+    m_storage.reset(new uint8_t[size + DiskFile::kAlignment]);
+    auto address = reinterpret_cast<uintptr_t>(m_storage.get());
+    auto aligned = (address + DiskFile::kAlignment - 1) & ~uintptr_t(DiskFile::kAlignment - 1);
+    m_data = m_storage.get() + (aligned - address);
+    m_size = size;
+    std::memset(m_data, 0, size);
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+
+// A file read and written at explicit offsets, for the disk threads that
+// record and stream audio.
+//
+// Direct I/O (O_DIRECT on Linux, F_NOCACHE on macOS, FILE_FLAG_NO_BUFFERING
+// on Windows) bypasses the OS cache so hours of recording don't push
+// everything else out of memory. The platforms then want buffers, offsets
+// and sizes aligned to kAlignment; DiskFile doesn't check.
+class DiskFile {
+public:
+    static constexpr size_t kAlignment = 4096;
+
+    enum class Mode {
+        Read,
+        Create,     // Truncates an existing file
+    };
+
+    DiskFile() = default;
+    ~DiskFile();
+
+    DiskFile(const DiskFile&) = delete;
+    DiskFile& operator=(const DiskFile&) = delete;
+
+    bool open(const std::filesystem::path& path, Mode mode, bool directIo);
+    void close();
+    bool isOpen() const;
+
+    // Reserves disk space up to bytes without changing the file's size, so
+    // later writes don't have to allocate. Best effort.
+    bool preallocate(uint64_t bytes);
+    bool writeAt(uint64_t offset, const void* data, size_t size);
+    // Returns the bytes read, short only at the end of the file, -1 on error
+    int64_t readAt(uint64_t offset, void* data, size_t size);
+    bool truncate(uint64_t size);
+    uint64_t size() const;
+
+    const std::string& getError() const { return m_error; }
+
+private:
+#ifdef _WIN32
+    void* m_handle = nullptr;
+#else
+    int m_fd = -1;
+#endif
+    std::filesystem::path m_path;
+    std::string m_error;
+};
+
+// A buffer aligned for direct I/O
+class AlignedBuffer {
+public:
+    AlignedBuffer() = default;
+    explicit AlignedBuffer(size_t size) { resize(size); }
+
+    void resize(size_t size);
+    uint8_t* data() { return m_data; }
+    const uint8_t* data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+private:
+    std::unique_ptr<uint8_t[]> m_storage;
+    uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+};
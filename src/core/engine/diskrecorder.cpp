@@ -0,0 +1,221 @@
+#include "diskrecorder.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace {
+
+// How long the writer sleeps when no track has a whole chunk to write
+constexpr auto kWriterPoll = std::chrono::milliseconds(2);
+
+size_t alignUp(size_t value) {
+    return (value + DiskFile::kAlignment - 1) / DiskFile::kAlignment * DiskFile::kAlignment;
+}
+
+} // namespace
+
+DiskRecorder::~DiskRecorder() {
+    std::string error;
+    stop(error);
+}
+
+bool DiskRecorder::start(const std::vector<Track>& tracks, uint32_t sampleRate, const Options& options,
+                         std::string& error) {
+    if (m_recording.load() || m_writer.joinable()) {
+        error = "Already recording";
+        return false;
+    }
+    if (tracks.empty() || sampleRate == 0) {
+        error = "Nothing to record";
+        return false;
+    }
+
+    m_options = options;
+    m_options.writeBytes = alignUp(std::max<size_t>(options.writeBytes, DiskFile::kAlignment));
+    m_sampleRate = sampleRate;
+    m_chunkSamples = m_options.writeBytes / sizeof(float);
+    m_staging.resize(m_options.writeBytes);
+    m_bytesWritten = 0;
+    m_error.clear();
+
+    m_tracks.clear();
+    AlignedBuffer header(AudioFile::kHeaderSize);
+    for (const auto& track : tracks) {
+        auto state = std::make_unique<TrackState>();
+        state->path = track.path;
+        state->channels = std::max(track.channels, 1u);
+        // Room for two chunks at least, so the writer can drain one while
+        // the other fills
+        auto samples = static_cast<size_t>(options.bufferSeconds * sampleRate) * state->channels;
+        state->ring.reset(std::max(samples, 2 * m_chunkSamples));
+
+        if (!state->file.open(track.path, DiskFile::Mode::Create, m_options.directIo)) {
+            error = state->file.getError();
+            m_tracks.clear();
+            return false;
+        }
+        state->allocated = AudioFile::kHeaderSize +
+            static_cast<uint64_t>(options.preallocateSeconds * sampleRate) * state->channels * sizeof(float);
+        state->file.preallocate(state->allocated);
+
+        // A take cut short by a crash still opens, to wherever it got to
+        AudioFile::writeHeader(header.data(), m_options.format, state->channels, sampleRate,
+                               AudioFile::kUnknownSize);
+        if (!state->file.writeAt(0, header.data(), header.size())) {
+            error = state->file.getError();
+            m_tracks.clear();
+            return false;
+        }
+        m_tracks.push_back(std::move(state));
+    }
+
+    m_stopWriter = false;
+    m_writer = std::thread([this] { writerLoop(); });
+    m_recording.store(true, std::memory_order_release);
+    return true;
+}
+
+bool DiskRecorder::stop(std::string& error) {
+    if (!m_writer.joinable()) return true;
+
+    // write() announces itself before checking m_recording, so once no
+    // call is active none will touch the rings again
+    m_recording.store(false);
+    while (m_activeWrites.load() > 0) std::this_thread::yield();
+
+    m_stopWriter = true;
+    m_writer.join();
+
+    bool ok = true;
+    for (auto& track : m_tracks) {
+        if (!finish(*track)) ok = false;
+    }
+    if (!ok) {
+        std::lock_guard<std::mutex> lock(m_errorMutex);
+        error = m_error;
+    }
+    return ok;
+}
+
+void DiskRecorder::write(size_t track, const float* const* channels, uint32_t frames) {
+    m_activeWrites.fetch_add(1);
+    if (!m_recording.load() || track >= m_tracks.size()) {
+        m_activeWrites.fetch_sub(1);
+        return;
+    }
+
+    auto& state = *m_tracks[track];
+    uint32_t channelCount = state.channels;
+    size_t samples = size_t(frames) * channelCount;
+    if (state.ring.writeAvailable() < samples) {
+        // Whole blocks only, so the channels stay in step
+        state.droppedFrames.fetch_add(frames, std::memory_order_relaxed);
+    } else {
+        auto regions = state.ring.prepareWrite(samples);
+        uint32_t frame = 0;
+        uint32_t channel = 0;
+        auto fill = [&](float* dest, size_t count) {
+            for (size_t i = 0; i < count; i++) {
+                const float* source = channels[channel];
+                dest[i] = source ? source[frame] : 0.0f;
+                if (++channel == channelCount) {
+                    channel = 0;
+                    frame++;
+                }
+            }
+        };
+        fill(regions.first, regions.firstCount);
+        fill(regions.second, regions.secondCount);
+        state.ring.commitWrite(samples);
+    }
+
+    size_t fill = state.ring.capacity() - state.ring.writeAvailable();
+    if (fill > state.maxFill.load(std::memory_order_relaxed)) state.maxFill.store(fill, std::memory_order_relaxed);
+    m_activeWrites.fetch_sub(1);
+}
+
+DiskRecorder::Stats DiskRecorder::stats() const {
+    Stats stats;
+    stats.bytesWritten = m_bytesWritten.load(std::memory_order_relaxed);
+    for (const auto& track : m_tracks) {
+        stats.droppedFrames += track->droppedFrames.load(std::memory_order_relaxed);
+        double fill = double(track->maxFill.load(std::memory_order_relaxed)) / double(track->ring.capacity());
+        stats.maxBufferFill = std::max(stats.maxBufferFill, fill);
+    }
+    return stats;
+}
+
+void DiskRecorder::writerLoop() {
+    while (!m_stopWriter.load()) {
+        bool wrote = false;
+        for (auto& track : m_tracks) {
+            if (writeChunks(*track)) wrote = true;
+        }
+        if (!wrote) std::this_thread::sleep_for(kWriterPoll);
+    }
+}
+
+bool DiskRecorder::writeChunks(TrackState& track) {
+    bool wrote = false;
+    while (track.ring.readAvailable() >= m_chunkSamples) {
+        writeBlock(track, m_chunkSamples);
+        wrote = true;
+    }
+    return wrote;
+}
+
+bool DiskRecorder::writeBlock(TrackState& track, size_t samples) {
+    auto regions = track.ring.prepareRead(samples);
+    auto* staging = reinterpret_cast<float*>(m_staging.data());
+    std::copy(regions.first, regions.first + regions.firstCount, staging);
+    std::copy(regions.second, regions.second + regions.secondCount, staging + regions.firstCount);
+    track.ring.commitRead(regions.size());
+    // A track that failed keeps being drained so its ring never fills
+    if (track.failed) return false;
+
+    // Direct I/O writes whole sectors; the tail of the last block is cut
+    // off again by finish()
+    size_t bytes = regions.size() * sizeof(float);
+    size_t padded = alignUp(bytes);
+    std::memset(m_staging.data() + bytes, 0, padded - bytes);
+
+    uint64_t end = AudioFile::kHeaderSize + track.dataBytes + padded;
+    if (end > track.allocated) {
+        track.allocated += static_cast<uint64_t>(m_options.preallocateSeconds * m_sampleRate) * track.channels *
+                           sizeof(float);
+        track.allocated = std::max(track.allocated, end);
+        track.file.preallocate(track.allocated);
+    }
+
+    if (!track.file.writeAt(AudioFile::kHeaderSize + track.dataBytes, m_staging.data(), padded)) {
+        fail(track, track.file.getError());
+        return false;
+    }
+    track.dataBytes += bytes;
+    m_bytesWritten.fetch_add(bytes, std::memory_order_relaxed);
+    return true;
+}
+
+bool DiskRecorder::finish(TrackState& track) {
+    while (!track.failed && track.ring.readAvailable() > 0) {
+        writeBlock(track, std::min(track.ring.readAvailable(), m_chunkSamples));
+    }
+    if (track.failed) {
+        track.file.close();
+        return false;
+    }
+
+    AlignedBuffer header(AudioFile::kHeaderSize);
+    AudioFile::writeHeader(header.data(), m_options.format, track.channels, m_sampleRate, track.dataBytes);
+    bool ok = track.file.truncate(AudioFile::kHeaderSize + track.dataBytes) &&
+              track.file.writeAt(0, header.data(), header.size());
+    if (!ok) fail(track, track.file.getError());
+    track.file.close();
+    return ok;
+}
+
+void DiskRecorder::fail(TrackState& track, const std::string& error) {
+    track.failed = true;
+    std::lock_guard<std::mutex> lock(m_errorMutex);
+    if (m_error.empty()) m_error = error;
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "audiofile.hpp"
+#include "diskfile.hpp"
+#include "spscring.hpp"
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Records any number of tracks to disk without the audio thread ever
+// waiting on it.
+//
+// The audio thread only interleaves each track's block into that track's
+// ring. A writer thread drains the rings in large chunks and writes each
+// one sequentially into the track's file, 32-bit float WAV, RF64 or Wave64,
+// which is preallocated so the filesystem doesn't have to find space in the
+// middle of a take. The headers are filled in when recording stops.
+//
+// When the disk can't keep up a ring fills and write() drops the block,
+// counting it in Stats::droppedFrames, rather than block the audio thread.
+class DiskRecorder {
+public:
+    struct Options {
+        AudioFileFormat format = AudioFileFormat::Wav;
+        // Bypass the OS cache; takes less memory for long takes of many
+        // tracks but needs a disk that keeps up on its own
+        bool directIo = false;
+        // How long the disk may stall before blocks are dropped
+        double bufferSeconds = 2.0;
+        // Disk space reserved ahead of the recording, and again whenever
+        // it's used up
+        double preallocateSeconds = 600.0;
+        // Size of each write per track, a multiple of DiskFile::kAlignment
+        size_t writeBytes = 256 * 1024;
+    };
+
+    struct Track {
+        std::filesystem::path path;
+        uint32_t channels = 1;
+    };
+
+    struct Stats {
+        uint64_t droppedFrames = 0;
+        uint64_t bytesWritten = 0;
+        // Fullest any ring has been, 0 to 1
+        double maxBufferFill = 0.0;
+    };
+
+    DiskRecorder() = default;
+    ~DiskRecorder();
+
+    DiskRecorder(const DiskRecorder&) = delete;
+    DiskRecorder& operator=(const DiskRecorder&) = delete;
+
+    // Main thread. Creates the files and starts the writer thread; write()
+    // records from then on.
+    bool start(const std::vector<Track>& tracks, uint32_t sampleRate, const Options& options, std::string& error);
+    // Main thread. Waits for write() calls in progress, writes out what's
+    // left and finishes the files. False if anything failed to be written.
+    bool stop(std::string& error);
+    bool isRecording() const { return m_recording.load(std::memory_order_acquire); }
+
+    // Audio thread. channels holds one buffer per channel of the track;
+    // null ones record silence. Does nothing while not recording.
+    void write(size_t track, const float* const* channels, uint32_t frames);
+
+    Stats stats() const;
+
+private:
+    struct TrackState {
+        DiskFile file;
+        std::filesystem::path path;
+        uint32_t channels = 1;
+        SpscRing<float> ring;
+
+        // Writer thread
+        uint64_t dataBytes = 0;
+        uint64_t allocated = 0;
+        bool failed = false;
+
+        // Audio thread
+        std::atomic<uint64_t> droppedFrames{0};
+        std::atomic<size_t> maxFill{0};
+    };
+
+    void writerLoop();
+    // Writes whole chunks while there are any; true if it wrote one
+    bool writeChunks(TrackState& track);
+    bool writeBlock(TrackState& track, size_t samples);
+    bool finish(TrackState& track);
+    void fail(TrackState& track, const std::string& error);
+
+    std::vector<std::unique_ptr<TrackState>> m_tracks;
+    Options m_options;
+    uint32_t m_sampleRate = 0;
+    size_t m_chunkSamples = 0;
+    AlignedBuffer m_staging;
+
+    std::thread m_writer;
+    std::atomic<bool> m_recording{false};
+    std::atomic<bool> m_stopWriter{false};
+    std::atomic<int> m_activeWrites{0};
+    std::atomic<uint64_t> m_bytesWritten{0};
+
+    std::mutex m_errorMutex;
+    std::string m_error;
+};
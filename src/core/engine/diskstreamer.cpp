@@ -0,0 +1,465 @@
+#include "diskstreamer.hpp"
+#include <algorithm>
+#include <chrono>
+
+namespace {
+
+// How often the scheduler looks at the playheads when nothing wakes it
+constexpr auto kSchedulerPoll = std::chrono::milliseconds(2);
+// Reads queued per I/O thread; more would only delay the reads a seek needs
+constexpr size_t kRequestsPerThread = 2;
+constexpr size_t kMinPoolBlocks = 16;
+
+} // namespace
+
+DiskStreamer::~DiskStreamer() {
+    stop();
+}
+
+bool DiskStreamer::start(const Options& options, std::string& error) {
+    if (m_running.load()) {
+        error = "Already streaming";
+        return false;
+    }
+    m_options = options;
+    m_options.ioThreads = std::max(options.ioThreads, 1u);
+    m_options.maxBatchBlocks = std::max(options.maxBatchBlocks, 1u);
+
+    size_t blocks = std::max(options.memoryBudget / (kBlockSamples * sizeof(float)), kMinPoolBlocks);
+    m_pool.clear();
+    m_freeBlocks.clear();
+    for (size_t i = 0; i < blocks; i++) {
+        auto block = std::make_unique<Block>();
+        block->samples.reset(new float[kBlockSamples]);
+        m_freeBlocks.push_back(block.get());
+        m_pool.push_back(std::move(block));
+    }
+    m_clips.clear();
+    m_clips.resize(options.maxClips);
+    m_clipCount = 0;
+
+    m_running = true;
+    m_scheduler = std::thread([this] { schedulerLoop(); });
+    for (uint32_t i = 0; i < m_options.ioThreads; i++) {
+        m_ioThreads.emplace_back([this] { ioLoop(); });
+    }
+    return true;
+}
+
+void DiskStreamer::stop() {
+    if (!m_running.load()) return;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+    }
+    m_wakeScheduler.notify_all();
+    m_wakeIo.notify_all();
+    m_scheduler.join();
+    for (auto& thread : m_ioThreads) thread.join();
+    m_ioThreads.clear();
+
+    m_requests.clear();
+    m_completed.clear();
+    m_requestsInFlight = 0;
+    m_lru.clear();
+    m_wanted.clear();
+    m_clipCount = 0;
+    m_clips.clear();
+    m_freeBlocks.clear();
+    m_pool.clear();
+    m_residentBlocks = 0;
+}
+
+DiskStreamer::ClipId DiskStreamer::addClip(const std::filesystem::path& path, std::string& error) {
+    uint32_t id = m_clipCount.load();
+    if (!m_running.load() || id >= m_clips.size()) {
+        error = m_running.load() ? "Too many clips" : "Streaming isn't started";
+        return kInvalidClip;
+    }
+
+    auto clip = std::make_unique<Clip>();
+    if (!AudioFile::readInfo(path, clip->info, error)) return kInvalidClip;
+    if (clip->info.channels > kBlockSamples) {
+        error = "Too many channels";
+        return kInvalidClip;
+    }
+    if (!clip->file.open(path, DiskFile::Mode::Read, false)) {
+        error = clip->file.getError();
+        return kInvalidClip;
+    }
+
+    clip->blockFrames = kBlockSamples / clip->info.channels;
+    clip->blockCount = (clip->info.frames() + clip->blockFrames - 1) / clip->blockFrames;
+    clip->blocks = std::make_unique<std::atomic<Block*>[]>(clip->blockCount);
+    clip->loading.assign(clip->blockCount, false);
+    clip->readAheadFrames = std::max<uint64_t>(
+        static_cast<uint64_t>(m_options.readAheadSeconds * clip->info.sampleRate), clip->blockFrames);
+
+    m_clips[id] = std::move(clip);
+    m_clipCount.store(id + 1, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_clipsChanged = true;
+    }
+    m_wakeScheduler.notify_one();
+    return id;
+}
+
+void DiskStreamer::removeClip(ClipId clip) {
+    if (clip >= m_clipCount.load(std::memory_order_acquire)) return;
+    m_clips[clip]->removed = true;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_clipsChanged = true;
+    }
+    m_wakeScheduler.notify_one();
+}
+
+const AudioFileInfo* DiskStreamer::clipInfo(ClipId clip) const {
+    if (clip >= m_clipCount.load(std::memory_order_acquire)) return nullptr;
+    return &m_clips[clip]->info;
+}
+
+void DiskStreamer::seek(ClipId clip, uint64_t frame) {
+    if (clip >= m_clipCount.load(std::memory_order_acquire)) return;
+    m_clips[clip]->seekTo.store(frame, std::memory_order_release);
+}
+
+void DiskStreamer::setLoop(ClipId clip, uint64_t start, uint64_t end) {
+    if (clip >= m_clipCount.load(std::memory_order_acquire)) return;
+    m_clips[clip]->loopStart.store(start, std::memory_order_relaxed);
+    m_clips[clip]->loopEnd.store(end, std::memory_order_relaxed);
+}
+
+bool DiskStreamer::isReady(ClipId id) const {
+    if (id >= m_clipCount.load(std::memory_order_acquire)) return false;
+    const Clip& clip = *m_clips[id];
+    bool ready = true;
+    forWindow(clip, windowOrigin(clip), clip.readAheadFrames / 2, [&](uint64_t index) {
+        ready = clip.blocks[index].load(std::memory_order_acquire) != nullptr;
+        return ready;
+    });
+    return ready;
+}
+
+template <typename Visit>
+void DiskStreamer::forWindow(const Clip& clip, uint64_t origin, uint64_t frames, Visit&& visit) const {
+    uint64_t loopStart = clip.loopStart.load(std::memory_order_relaxed);
+    uint64_t loopEnd = std::min(clip.loopEnd.load(std::memory_order_relaxed), clip.info.frames());
+    bool looping = loopEnd > loopStart;
+
+    uint64_t position = origin;
+    int wraps = 0;
+    while (frames > 0) {
+        if (looping && position >= loopEnd) {
+            // A loop shorter than the window only needs going round once
+            if (++wraps > 1) break;
+            position = loopStart;
+        }
+        uint64_t end = looping ? loopEnd : clip.info.frames();
+        if (position >= end) break;
+
+        uint64_t index = position / clip.blockFrames;
+        if (!visit(index)) break;
+        uint64_t step = std::min({ end, (index + 1) * clip.blockFrames, position + frames }) - position;
+        position += step;
+        frames -= step;
+    }
+}
+
+uint64_t DiskStreamer::windowOrigin(const Clip& clip) {
+    uint64_t seek = clip.seekTo.load(std::memory_order_acquire);
+    return seek != kNoSeek ? seek : clip.playhead.load(std::memory_order_relaxed);
+}
+
+DiskStreamer::Block* DiskStreamer::pin(const Clip& clip, uint64_t index) const {
+    Block* block = clip.blocks[index].load(std::memory_order_acquire);
+    if (!block) return nullptr;
+    // Pin, then check the block is still the one published. evict() does
+    // the opposite, so one of the two sees the other.
+    block->pins.fetch_add(1);
+    if (clip.blocks[index].load() != block) {
+        block->pins.fetch_sub(1, std::memory_order_release);
+        return nullptr;
+    }
+    return block;
+}
+
+uint32_t DiskStreamer::play(ClipId id, float* const* outputs, uint32_t numOutputs, uint32_t frames) {
+    auto silence = [&](uint32_t offset, uint32_t count) {
+        for (uint32_t output = 0; output < numOutputs; output++) {
+            std::fill(outputs[output] + offset, outputs[output] + offset + count, 0.0f);
+        }
+    };
+    if (id >= m_clipCount.load(std::memory_order_acquire) || m_clips[id]->removed.load(std::memory_order_relaxed)) {
+        silence(0, frames);
+        return 0;
+    }
+
+    Clip& clip = *m_clips[id];
+    uint64_t position = clip.playhead.load(std::memory_order_relaxed);
+    if (clip.seekTo.load(std::memory_order_relaxed) != kNoSeek) {
+        uint64_t seek = clip.seekTo.exchange(kNoSeek, std::memory_order_acq_rel);
+        if (seek != kNoSeek) position = seek;
+    }
+    uint64_t loopStart = clip.loopStart.load(std::memory_order_relaxed);
+    uint64_t loopEnd = std::min(clip.loopEnd.load(std::memory_order_relaxed), clip.info.frames());
+    bool looping = loopEnd > loopStart;
+    uint64_t pass = m_pass.load(std::memory_order_relaxed);
+    uint32_t channels = clip.info.channels;
+
+    uint32_t done = 0;
+    uint32_t missed = 0;
+    while (done < frames) {
+        if (looping && position >= loopEnd) position = loopStart;
+        uint64_t end = looping ? loopEnd : clip.info.frames();
+        if (position >= end) {
+            silence(done, frames - done);
+            break;
+        }
+
+        uint64_t index = position / clip.blockFrames;
+        uint64_t offset = position - index * clip.blockFrames;
+        auto count = static_cast<uint32_t>(
+            std::min<uint64_t>({ frames - done, end - position, clip.blockFrames - offset }));
+
+        if (Block* block = pin(clip, index)) {
+            block->lastUsed.store(pass, std::memory_order_relaxed);
+            const float* source = block->samples.get() + offset * channels;
+            for (uint32_t output = 0; output < numOutputs; output++) {
+                const float* channel = source + std::min(output, channels - 1);
+                float* dest = outputs[output] + done;
+                for (uint32_t i = 0; i < count; i++) dest[i] = channel[size_t(i) * channels];
+            }
+            block->pins.fetch_sub(1, std::memory_order_release);
+        } else {
+            silence(done, count);
+            missed += count;
+        }
+        position += count;
+        done += count;
+    }
+
+    clip.playhead.store(position, std::memory_order_relaxed);
+    if (missed > 0) m_missedFrames.fetch_add(missed, std::memory_order_relaxed);
+    return missed;
+}
+
+DiskStreamer::Stats DiskStreamer::stats() const {
+    Stats stats;
+    stats.missedFrames = m_missedFrames.load(std::memory_order_relaxed);
+    stats.blocksLoaded = m_blocksLoaded.load(std::memory_order_relaxed);
+    stats.bytesRead = m_bytesRead.load(std::memory_order_relaxed);
+    stats.evictions = m_evictions.load(std::memory_order_relaxed);
+    stats.residentBlocks = m_residentBlocks.load(std::memory_order_relaxed);
+    stats.poolBlocks = m_pool.size();
+    return stats;
+}
+
+void DiskStreamer::schedulerLoop() {
+    while (m_running.load()) {
+        schedule();
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_wakeScheduler.wait_for(lock, kSchedulerPoll,
+                                 [this] { return !m_running || !m_completed.empty() || m_clipsChanged; });
+        m_clipsChanged = false;
+    }
+}
+
+void DiskStreamer::schedule() {
+    // Blocks play() touches from now on count as used in this pass
+    uint64_t pass = m_pass.fetch_add(1, std::memory_order_relaxed) + 1;
+
+    std::deque<ReadRequest> completed;
+    size_t inFlight;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        completed.swap(m_completed);
+        inFlight = m_requestsInFlight;
+    }
+    publish(completed, pass);
+
+    uint32_t clipCount = m_clipCount.load(std::memory_order_acquire);
+    m_wanted.resize(clipCount);
+    for (uint32_t id = 0; id < clipCount; id++) {
+        Clip& clip = *m_clips[id];
+        Wanted& wanted = m_wanted[id];
+        wanted.clip = &clip;
+        wanted.missing.clear();
+        wanted.next = 0;
+
+        if (clip.removed.load(std::memory_order_relaxed)) {
+            for (uint64_t index = 0; index < clip.blockCount && clip.resident > 0; index++) {
+                if (Block* block = clip.blocks[index].load(std::memory_order_relaxed)) evict(block);
+            }
+            continue;
+        }
+
+        // Mark what's cached as wanted so it isn't evicted, and list what isn't
+        forWindow(clip, windowOrigin(clip), clip.readAheadFrames, [&](uint64_t index) {
+            if (Block* block = clip.blocks[index].load(std::memory_order_relaxed)) {
+                block->lastUsed.store(pass, std::memory_order_relaxed);
+            } else if (!clip.loading[index] &&
+                       std::find(wanted.missing.begin(), wanted.missing.end(), index) == wanted.missing.end()) {
+                wanted.missing.push_back(index);
+            }
+            return true;
+        });
+    }
+
+    // Clips take turns, each handing over its nearest run of missing blocks,
+    // so every playhead gets its next block before any gets further ahead
+    std::vector<ReadRequest> requests;
+    size_t maxInFlight = m_options.ioThreads * kRequestsPerThread;
+    bool cacheFull = false;
+    bool progress = true;
+    while (progress && !cacheFull && inFlight < maxInFlight) {
+        progress = false;
+        for (auto& wanted : m_wanted) {
+            if (wanted.next >= wanted.missing.size()) continue;
+
+            ReadRequest request{ wanted.clip, wanted.missing[wanted.next], {} };
+            while (wanted.next < wanted.missing.size() && request.blocks.size() < m_options.maxBatchBlocks &&
+                   wanted.missing[wanted.next] == request.firstIndex + request.blocks.size()) {
+                Block* block = allocateBlock(pass);
+                if (!block) {
+                    cacheFull = true;
+                    break;
+                }
+                wanted.clip->loading[wanted.missing[wanted.next]] = true;
+                request.blocks.push_back(block);
+                wanted.next++;
+            }
+            if (!request.blocks.empty()) {
+                requests.push_back(std::move(request));
+                inFlight++;
+                progress = true;
+            }
+            if (cacheFull || inFlight >= maxInFlight) break;
+        }
+    }
+
+    if (requests.empty()) return;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto& request : requests) m_requests.push_back(std::move(request));
+        m_requestsInFlight += requests.size();
+    }
+    m_wakeIo.notify_all();
+}
+
+// The I/O threads hand blocks back under m_mutex, so their samples are
+// complete by the time they are published here
+void DiskStreamer::publish(std::deque<ReadRequest>& completed, uint64_t pass) {
+    for (auto& request : completed) {
+        Clip* clip = request.clip;
+        for (size_t i = 0; i < request.blocks.size(); i++) {
+            Block* block = request.blocks[i];
+            uint64_t index = request.firstIndex + i;
+            clip->loading[index] = false;
+            if (clip->removed.load(std::memory_order_relaxed)) {
+                m_freeBlocks.push_back(block);
+                continue;
+            }
+
+            block->clip = clip;
+            block->index = index;
+            block->lastUsed.store(pass, std::memory_order_relaxed);
+            block->listStamp = pass;
+            m_lru.push_front(block);
+            block->lruPosition = m_lru.begin();
+            clip->resident++;
+            m_residentBlocks.fetch_add(1, std::memory_order_relaxed);
+            clip->blocks[index].store(block, std::memory_order_release);
+        }
+    }
+}
+
+DiskStreamer::Block* DiskStreamer::allocateBlock(uint64_t pass) {
+    if (!m_freeBlocks.empty()) {
+        Block* block = m_freeBlocks.back();
+        m_freeBlocks.pop_back();
+        return block;
+    }
+
+    // Walk up from the least recently used end. A block played since it
+    // was put in its place, or wanted in this pass, goes back to the front.
+    for (size_t checked = 0, count = m_lru.size(); checked < count && !m_lru.empty(); checked++) {
+        Block* block = m_lru.back();
+        uint64_t used = block->lastUsed.load(std::memory_order_relaxed);
+        if (used < pass && used <= block->listStamp && evict(block)) {
+            m_freeBlocks.pop_back();
+            return block;
+        }
+        block->listStamp = std::max(used, block->listStamp);
+        m_lru.splice(m_lru.begin(), m_lru, block->lruPosition);
+    }
+    return nullptr;
+}
+
+bool DiskStreamer::evict(Block* block) {
+    auto& slot = block->clip->blocks[block->index];
+    slot.store(nullptr);
+    if (block->pins.load() != 0) {
+        slot.store(block, std::memory_order_release);
+        return false;
+    }
+
+    m_lru.erase(block->lruPosition);
+    block->clip->resident--;
+    block->clip = nullptr;
+    m_freeBlocks.push_back(block);
+    m_residentBlocks.fetch_sub(1, std::memory_order_relaxed);
+    m_evictions.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void DiskStreamer::ioLoop() {
+    std::vector<uint8_t> scratch;
+    while (true) {
+        ReadRequest request;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wakeIo.wait(lock, [this] { return !m_running || !m_requests.empty(); });
+            if (!m_running) return;
+            request = std::move(m_requests.front());
+            m_requests.pop_front();
+        }
+
+        load(request, scratch);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_completed.push_back(std::move(request));
+            m_requestsInFlight--;
+        }
+        m_wakeScheduler.notify_one();
+    }
+}
+
+void DiskStreamer::load(ReadRequest& request, std::vector<uint8_t>& scratch) {
+    const Clip& clip = *request.clip;
+    const AudioFileInfo& info = clip.info;
+    uint32_t bytesPerFrame = info.bytesPerFrame();
+    uint64_t firstFrame = request.firstIndex * clip.blockFrames;
+    uint64_t frames = std::min<uint64_t>(request.blocks.size() * clip.blockFrames, info.frames() - firstFrame);
+
+    // One read for the whole run, then decoded block by block
+    size_t bytes = static_cast<size_t>(frames * bytesPerFrame);
+    if (scratch.size() < bytes) scratch.resize(bytes);
+    int64_t read = request.clip->file.readAt(info.dataOffset + firstFrame * bytesPerFrame, scratch.data(), bytes);
+    size_t valid = read > 0 ? static_cast<size_t>(read) : 0;
+    std::fill(scratch.begin() + valid, scratch.begin() + bytes, 0);
+    m_bytesRead.fetch_add(valid, std::memory_order_relaxed);
+
+    for (size_t i = 0; i < request.blocks.size(); i++) {
+        Block* block = request.blocks[i];
+        uint64_t start = i * clip.blockFrames;
+        uint64_t count = start < frames ? std::min<uint64_t>(clip.blockFrames, frames - start) : 0;
+        size_t samples = static_cast<size_t>(count) * info.channels;
+        AudioFile::decode(info, scratch.data() + start * bytesPerFrame, samples, block->samples.get());
+        std::fill(block->samples.get() + samples, block->samples.get() + kBlockSamples, 0.0f);
+    }
+    m_blocksLoaded.fetch_add(request.blocks.size(), std::memory_order_relaxed);
+}
@@ -0,0 +1,191 @@
+#pragma once
+
+#include "audiofile.hpp"
+#include "diskfile.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Plays audio clips straight from disk instead of loading whole files.
+//
+// Each clip's file is read in blocks of kBlockSamples samples, decoded to
+// float, into a cache whose size is fixed by Options::memoryBudget. A
+// scheduler thread keeps every clip's read-ahead window resident: the
+// blocks from its playhead on, following the loop, nearest first and
+// taking turns between clips so none falls behind. Missing blocks go to a
+// pool of I/O threads, adjacent ones merged into one read. When the cache
+// is full the least recently used block outside every window is evicted.
+//
+// play() on the audio thread only ever copies from blocks already in the
+// cache. A block that isn't there plays as silence and counts as missed;
+// a transport waits for isReady() after locating to avoid that.
+class DiskStreamer {
+public:
+    using ClipId = uint32_t;
+    static constexpr ClipId kInvalidClip = UINT32_MAX;
+    // Samples per cached block, over all channels: 128 KiB of floats
+    static constexpr uint32_t kBlockSamples = 32768;
+
+    struct Options {
+        // Should hold the read-ahead windows of all clips playing at once;
+        // what's left over keeps blocks around for jumping back
+        size_t memoryBudget = 512 * 1024 * 1024;
+        double readAheadSeconds = 2.0;
+        uint32_t ioThreads = 4;
+        // Adjacent blocks read at once
+        uint32_t maxBatchBlocks = 8;
+        uint32_t maxClips = 1024;
+    };
+
+    struct Stats {
+        uint64_t missedFrames = 0;
+        uint64_t blocksLoaded = 0;
+        uint64_t bytesRead = 0;
+        uint64_t evictions = 0;
+        size_t residentBlocks = 0;
+        size_t poolBlocks = 0;
+    };
+
+    DiskStreamer() = default;
+    ~DiskStreamer();
+
+    DiskStreamer(const DiskStreamer&) = delete;
+    DiskStreamer& operator=(const DiskStreamer&) = delete;
+
+    // Main thread. Allocates the cache and starts the threads.
+    bool start(const Options& options, std::string& error);
+    void stop();
+
+    // Main thread. The clip starts at frame 0, without a loop.
+    ClipId addClip(const std::filesystem::path& path, std::string& error);
+    // Main thread. The clip plays silence from now on and its blocks are
+    // given up; its id isn't reused until stop().
+    void removeClip(ClipId clip);
+    const AudioFileInfo* clipInfo(ClipId clip) const;
+
+    // Any thread. Moves the playhead; takes effect at the next play().
+    void seek(ClipId clip, uint64_t frame);
+    // Any thread. Playback wraps from end back to start; end <= start
+    // turns the loop off.
+    void setLoop(ClipId clip, uint64_t start, uint64_t end);
+    // Any thread. True once the first half of the read-ahead window from
+    // the playhead, or from a pending seek, is cached.
+    bool isReady(ClipId clip) const;
+
+    // Audio thread. Renders frames from the playhead into outputs and moves
+    // it on; a mono clip fills every output. Returns the frames that had to
+    // be silent because they weren't cached yet. Past the end of the clip
+    // it renders silence without counting it.
+    uint32_t play(ClipId clip, float* const* outputs, uint32_t numOutputs, uint32_t frames);
+
+    Stats stats() const;
+
+private:
+    static constexpr uint64_t kNoSeek = UINT64_MAX;
+
+    struct Clip;
+
+    struct Block {
+        std::unique_ptr<float[]> samples;
+
+        // Set by play() while it copies; the scheduler only reuses a block
+        // it has unpublished while nobody holds it
+        std::atomic<uint32_t> pins{0};
+        // Scheduler pass the block was last played or wanted in
+        std::atomic<uint64_t> lastUsed{0};
+
+        // Scheduler
+        Clip* clip = nullptr;
+        uint64_t index = 0;
+        uint64_t listStamp = 0;
+        std::list<Block*>::iterator lruPosition;
+    };
+
+    struct Clip {
+        DiskFile file;
+        AudioFileInfo info;
+        uint32_t blockFrames = 0;
+        uint64_t blockCount = 0;
+        uint64_t readAheadFrames = 0;
+        // Published blocks by index, null when not cached
+        std::unique_ptr<std::atomic<Block*>[]> blocks;
+        // Scheduler: blocks being read, not yet published, and how many
+        // are published
+        std::vector<bool> loading;
+        size_t resident = 0;
+
+        std::atomic<uint64_t> playhead{0};
+        std::atomic<uint64_t> seekTo{kNoSeek};
+        std::atomic<uint64_t> loopStart{0};
+        std::atomic<uint64_t> loopEnd{0};
+        std::atomic<bool> removed{false};
+    };
+
+    struct ReadRequest {
+        Clip* clip;
+        uint64_t firstIndex;
+        std::vector<Block*> blocks;
+    };
+
+    // A clip's blocks still to be read this pass, in playing order
+    struct Wanted {
+        Clip* clip = nullptr;
+        std::vector<uint64_t> missing;
+        size_t next = 0;
+    };
+
+    // Calls visit with each block index of the frames from origin on, in
+    // playing order, until it returns false
+    template <typename Visit>
+    void forWindow(const Clip& clip, uint64_t origin, uint64_t frames, Visit&& visit) const;
+    // The playhead, or where a pending seek moves it
+    static uint64_t windowOrigin(const Clip& clip);
+    Block* pin(const Clip& clip, uint64_t index) const;
+
+    void schedulerLoop();
+    void schedule();
+    void publish(std::deque<ReadRequest>& completed, uint64_t pass);
+    Block* allocateBlock(uint64_t pass);
+    // Takes a published block out of the cache, unless play() holds it
+    bool evict(Block* block);
+    void ioLoop();
+    void load(ReadRequest& request, std::vector<uint8_t>& scratch);
+
+    Options m_options;
+    std::vector<std::unique_ptr<Clip>> m_clips;
+    std::atomic<uint32_t> m_clipCount{0};
+
+    std::vector<std::unique_ptr<Block>> m_pool;
+    std::vector<Block*> m_freeBlocks;
+    // Published blocks, most recently used first. Blocks are
+    // stamped with the pass play() last touched them in and only moved to
+    // the front when they come up for eviction.
+    std::list<Block*> m_lru;
+    std::atomic<uint64_t> m_pass{1};
+    std::atomic<size_t> m_residentBlocks{0};
+    std::vector<Wanted> m_wanted;
+
+    std::thread m_scheduler;
+    std::vector<std::thread> m_ioThreads;
+    std::atomic<bool> m_running{false};
+    std::mutex m_mutex;
+    std::condition_variable m_wakeScheduler;
+    std::condition_variable m_wakeIo;
+    std::deque<ReadRequest> m_requests;
+    std::deque<ReadRequest> m_completed;
+    size_t m_requestsInFlight = 0;
+    bool m_clipsChanged = false;
+
+    std::atomic<uint64_t> m_missedFrames{0};
+    std::atomic<uint64_t> m_blocksLoaded{0};
+    std::atomic<uint64_t> m_bytesRead{0};
+    std::atomic<uint64_t> m_evictions{0};
+};
@@ -0,0 +1,76 @@
+#include "eventlist.hpp"
+#include <cstring>
+
+EventList::EventList(uint32_t capacity, uint32_t bytes)
+    : m_storage((bytes + 7) / 8)
+    , m_offsets(capacity)
+{
+    m_input.ctx = this;
+    m_input.size = &EventList::inputSize;
+    m_input.get = &EventList::inputGet;
+    m_output.ctx = this;
+    m_output.try_push = &EventList::outputPush;
+}
+
+void EventList::clear() {
+    m_used = 0;
+    m_count = 0;
+    m_dropped = 0;
+}
+
+const clap_event_header_t* EventList::get(uint32_t index) const {
+    if (index >= m_count) return nullptr;
+    return reinterpret_cast<const clap_event_header_t*>(m_storage.data() + m_offsets[index]);
+}
+
+bool EventList::push(const clap_event_header_t* event) {
+    return pushShifted(event, 0);
+}
+
+bool EventList::pushShifted(const clap_event_header_t* event, uint32_t shift) {
+    if (!event || event->size < sizeof(clap_event_header_t)) return false;
+
+    size_t words = (event->size + 7) / 8;
+    if (m_count == m_offsets.size() || m_used + words > m_storage.size()) {
+        m_dropped++;
+        return false;
+    }
+
+    auto* copy = reinterpret_cast<clap_event_header_t*>(m_storage.data() + m_used);
+    std::memcpy(copy, event, event->size);
+    copy->time -= shift;
+
+    // Events nearly always arrive in order, so the insertion point is found
+    // from the back
+    size_t position = m_count;
+    while (position > 0 && get(static_cast<uint32_t>(position - 1))->time > copy->time) position--;
+    if (position < m_count) {
+        std::memmove(&m_offsets[position + 1], &m_offsets[position], (m_count - position) * sizeof(uint32_t));
+    }
+    m_offsets[position] = static_cast<uint32_t>(m_used);
+
+    m_used += words;
+    m_count++;
+    return true;
+}
+
+void EventList::appendRange(const EventList& source, uint32_t begin, uint32_t end) {
+    for (uint32_t i = 0; i < source.size(); i++) {
+        const auto* event = source.get(i);
+        if (event->time < begin) continue;
+        if (event->time >= end) break;
+        pushShifted(event, begin);
+    }
+}
+
+uint32_t EventList::inputSize(const clap_input_events_t* list) {
+    return static_cast<const EventList*>(list->ctx)->size();
+}
+
+const clap_event_header_t* EventList::inputGet(const clap_input_events_t* list, uint32_t index) {
+    return static_cast<const EventList*>(list->ctx)->get(index);
+}
+
+bool EventList::outputPush(const clap_output_events_t* list, const clap_event_header_t* event) {
+    return static_cast<EventList*>(list->ctx)->push(event);
+}
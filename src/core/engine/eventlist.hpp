@@ -0,0 +1,52 @@
+#pragma once
+
+#include <clap/clap.h>
+#include <cstdint>
+#include <vector>
+
+// Events of one audio block, in CLAP's own event format so they can be
+// handed to plugins without conversion.
+//
+// All storage is allocated up front; push() copies the event in and never
+// allocates, so a list can be filled and read on the audio thread. Events
+// are kept sorted by time, events with the same time keep their order.
+// When the list is full further events are dropped and counted.
+class EventList {
+public:
+    explicit EventList(uint32_t capacity = 1024, uint32_t bytes = 64 * 1024);
+
+    EventList(const EventList&) = delete;
+    EventList& operator=(const EventList&) = delete;
+
+    void clear();
+    bool push(const clap_event_header_t* event);
+    // Copies the events of source with begin <= time < end, moved to
+    // start at time 0
+    void appendRange(const EventList& source, uint32_t begin, uint32_t end);
+
+    uint32_t size() const { return static_cast<uint32_t>(m_count); }
+    bool empty() const { return m_count == 0; }
+    const clap_event_header_t* get(uint32_t index) const;
+    uint32_t dropped() const { return m_dropped; }
+
+    // Views for clap_process_t. input() reads this list, output() appends to it.
+    const clap_input_events_t* input() const { return &m_input; }
+    const clap_output_events_t* output() const { return &m_output; }
+
+private:
+    bool pushShifted(const clap_event_header_t* event, uint32_t shift);
+
+    static uint32_t inputSize(const clap_input_events_t* list);
+    static const clap_event_header_t* inputGet(const clap_input_events_t* list, uint32_t index);
+    static bool outputPush(const clap_output_events_t* list, const clap_event_header_t* event);
+
+    // 8-byte words so every event starts suitably aligned for its doubles
+    std::vector<uint64_t> m_storage;
+    size_t m_used = 0;                  // Words
+    std::vector<uint32_t> m_offsets;    // Word offset per event, in time order
+    size_t m_count = 0;
+    uint32_t m_dropped = 0;
+
+    clap_input_events_t m_input;
+    clap_output_events_t m_output;
+};
@@ -0,0 +1,154 @@
+#include "audiodecoder.hpp"
+#include <FLAC/stream_decoder.h>
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+// libFLAC hands over whole FLAC frames through a callback; read() keeps
+// what the caller had no room for until the next call.
+class FlacDecoder : public AudioDecoder {
+public:
+    ~FlacDecoder() override {
+        if (m_decoder) {
+            FLAC__stream_decoder_finish(m_decoder);
+            FLAC__stream_decoder_delete(m_decoder);
+        }
+    }
+
+    bool open(const std::filesystem::path& path, std::string& error) {
+#ifdef _WIN32
+        std::FILE* file = _wfopen(path.c_str(), L"rb");
+#else
+        std::FILE* file = std::fopen(path.c_str(), "rb");
+#endif
+        if (!file) {
+            error = "Cannot open " + path.string();
+            return false;
+        }
+        m_decoder = FLAC__stream_decoder_new();
+        if (!m_decoder) {
+            std::fclose(file);
+            error = "Out of memory";
+            return false;
+        }
+        // The decoder owns the file from here on and closes it in finish()
+        if (FLAC__stream_decoder_init_FILE(m_decoder, file, &FlacDecoder::writeCallback, &FlacDecoder::metadataCallback,
+                                           &FlacDecoder::errorCallback, this) != FLAC__STREAM_DECODER_INIT_STATUS_OK) {
+            error = "Cannot read " + path.string() + " as FLAC";
+            return false;
+        }
+        if (!FLAC__stream_decoder_process_until_end_of_metadata(m_decoder) || m_info.channels == 0) {
+            error = m_error.empty() ? "Invalid FLAC file" : m_error;
+            return false;
+        }
+        m_info.format = "FLAC";
+        m_pending.resize(m_info.channels);
+        return true;
+    }
+
+    bool seek(uint64_t frame) override {
+        // A stream written without its length has 0 total samples; libFLAC
+        // bisects on the file size then
+        if (m_info.frames > 0 && frame >= m_info.frames) {
+            // Past the end; seek_absolute would fail, reading just ends
+            clearPending();
+            m_atEnd = true;
+            return true;
+        }
+        // Uses the seek table where the file has one, bisects otherwise.
+        // libFLAC delivers the frame holding the target from the target on.
+        clearPending();
+        m_atEnd = false;
+        if (!FLAC__stream_decoder_seek_absolute(m_decoder, frame)) {
+            if (FLAC__stream_decoder_get_state(m_decoder) == FLAC__STREAM_DECODER_SEEK_ERROR) {
+                FLAC__stream_decoder_flush(m_decoder);
+            }
+            m_error = "Seek failed";
+            return false;
+        }
+        return true;
+    }
+
+    uint32_t read(float* const* channels, uint32_t frames) override {
+        uint32_t done = 0;
+        while (done < frames) {
+            if (m_pendingStart == m_pendingFrames) {
+                if (m_atEnd || hasFailed()) break;
+                clearPending();
+                if (!FLAC__stream_decoder_process_single(m_decoder)) {
+                    if (m_error.empty()) m_error = "FLAC decoding failed";
+                    break;
+                }
+                if (FLAC__stream_decoder_get_state(m_decoder) == FLAC__STREAM_DECODER_END_OF_STREAM) m_atEnd = true;
+                continue;
+            }
+
+            uint32_t count = std::min(frames - done, m_pendingFrames - m_pendingStart);
+            for (uint32_t channel = 0; channel < m_info.channels; channel++) {
+                const float* source = m_pending[channel].data() + m_pendingStart;
+                std::copy(source, source + count, channels[channel] + done);
+            }
+            m_pendingStart += count;
+            done += count;
+        }
+        return done;
+    }
+
+private:
+    void clearPending() {
+        m_pendingStart = 0;
+        m_pendingFrames = 0;
+    }
+
+    static FLAC__StreamDecoderWriteStatus writeCallback(const FLAC__StreamDecoder*, const FLAC__Frame* frame,
+                                                        const FLAC__int32* const buffer[], void* client) {
+        auto* self = static_cast<FlacDecoder*>(client);
+        uint32_t frames = frame->header.blocksize;
+        uint32_t channels = std::min<uint32_t>(frame->header.channels, self->m_info.channels);
+        float scale = 1.0f / float(1u << (frame->header.bits_per_sample - 1));
+
+        // Normally the previous frame is used up; after a seek this is
+        // the target frame, trimmed to start at the target
+        uint32_t keep = self->m_pendingFrames - self->m_pendingStart;
+        for (uint32_t channel = 0; channel < channels; channel++) {
+            auto& pending = self->m_pending[channel];
+            pending.erase(pending.begin(), pending.begin() + self->m_pendingStart);
+            pending.resize(keep + frames);
+            for (uint32_t i = 0; i < frames; i++) pending[keep + i] = float(buffer[channel][i]) * scale;
+        }
+        self->m_pendingStart = 0;
+        self->m_pendingFrames = keep + frames;
+        return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+    }
+
+    static void metadataCallback(const FLAC__StreamDecoder*, const FLAC__StreamMetadata* metadata, void* client) {
+        auto* self = static_cast<FlacDecoder*>(client);
+        if (metadata->type != FLAC__METADATA_TYPE_STREAMINFO) return;
+        const auto& info = metadata->data.stream_info;
+        self->m_info.channels = info.channels;
+        self->m_info.sampleRate = info.sample_rate;
+        self->m_info.frames = info.total_samples;
+        self->m_info.exactLength = info.total_samples > 0;
+    }
+
+    static void errorCallback(const FLAC__StreamDecoder*, FLAC__StreamDecoderErrorStatus, void*) {
+        // Lost sync and corrupt frames: libFLAC resyncs on the next frame
+        // and a damaged file plays on, the way other players treat it
+    }
+
+    FLAC__StreamDecoder* m_decoder = nullptr;
+    std::vector<std::vector<float>> m_pending;
+    uint32_t m_pendingStart = 0;
+    uint32_t m_pendingFrames = 0;
+    bool m_atEnd = false;
+};
+
+} // namespace
+
+std::unique_ptr<AudioDecoder> AudioDecoder::openFlac(const std::filesystem::path& path, std::string& error) {
+    auto decoder = std::make_unique<FlacDecoder>();
+    if (!decoder->open(path, error)) return nullptr;
+    return decoder;
+}
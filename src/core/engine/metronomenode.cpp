@@ -0,0 +1,266 @@
+#include "metronomenode.hpp"
+#include "audiofile.hpp"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+
+// Zero crossings of the resampling filter on either side, at the lower of
+// the two rates
+constexpr int kFilterZeros = 32;
+// Beyond this many phases, between rates with few common factors, the
+// filter is computed for every output frame instead
+constexpr uint64_t kMaxFilterPhases = 4096;
+
+double sinc(double x) {
+    return x == 0.0 ? 1.0 : std::sin(kPi * x) / (kPi * x);
+}
+
+// Blackman, for x from -1 to 1
+double window(double x) {
+    return 0.42 + 0.5 * std::cos(kPi * x) + 0.08 * std::cos(2.0 * kPi * x);
+}
+
+} // namespace
+
+bool MetronomeNode::Sound::fromWav(const uint8_t* data, size_t size, Sound& sound, std::string& error) {
+    AudioFileInfo info;
+    if (!AudioFile::readInfo(data, size, info, error)) return false;
+    sound.channels = info.channels;
+    sound.sampleRate = info.sampleRate;
+    sound.samples.resize(size_t(info.frames() * info.channels));
+    AudioFile::decode(info, data + info.dataOffset, sound.samples.size(), sound.samples.data());
+    return true;
+}
+
+uint32_t MetronomeNode::addSoundSet(Sound accent, Sound beat) {
+    SoundSet set;
+    set.sounds[0] = std::move(accent);
+    set.sounds[1] = std::move(beat);
+    m_soundSets.push_back(std::move(set));
+    return static_cast<uint32_t>(m_soundSets.size() - 1);
+}
+
+void MetronomeNode::setTempo(double bpm) {
+    if (std::isfinite(bpm)) m_tempo.store(std::clamp(bpm, kMinTempo, kMaxTempo), std::memory_order_relaxed);
+}
+
+void MetronomeNode::setTimeSignature(uint32_t numerator, uint32_t denominator) {
+    if (numerator == 0 || numerator > 0xffff || denominator == 0 || denominator > 0xffff) return;
+    m_signature.store(packSignature(numerator, denominator), std::memory_order_relaxed);
+}
+
+void MetronomeNode::start(int64_t frame, uint32_t countInBars) {
+    m_startFrame.store(frame, std::memory_order_relaxed);
+    m_countInBars.store(countInBars, std::memory_order_relaxed);
+    m_runningRequested.store(true, std::memory_order_relaxed);
+    m_requests.fetch_add(1, std::memory_order_release);
+}
+
+void MetronomeNode::stop() {
+    m_runningRequested.store(false, std::memory_order_relaxed);
+    m_requests.fetch_add(1, std::memory_order_release);
+}
+
+bool MetronomeNode::prepare(double sampleRate, uint32_t maxFrames) {
+    (void)maxFrames;
+    if (sampleRate <= 0.0) return false;
+    if (sampleRate != m_sampleRate) {
+        for (auto& set : m_soundSets) {
+            for (int i = 0; i < 2; i++) resample(set.sounds[i], sampleRate, set.clicks[i]);
+        }
+    }
+    m_sampleRate = sampleRate;
+
+    // Not processed while being prepared; a start() from before is dropped
+    m_seenRequests = m_requests.load(std::memory_order_acquire);
+    m_runningRequested.store(false, std::memory_order_relaxed);
+    m_running = false;
+    m_activeVoices = 0;
+    latchSettings();
+    return true;
+}
+
+void MetronomeNode::resample(const Sound& sound, double sampleRate, Click& click) {
+    click = Click();
+    if (sound.channels == 0 || sound.sampleRate == 0) return;
+    uint64_t inFrames = sound.samples.size() / sound.channels;
+    double ratio = sampleRate / sound.sampleRate;
+    click.frames = static_cast<uint32_t>(std::ceil(double(inFrames) * ratio));
+    for (auto& channel : click.channels) channel.assign(click.frames, 0.0f);
+
+    // Mono goes to both outputs, channels past the outputs are left out
+    auto sourceChannel = [&sound](uint32_t output) { return std::min(output, sound.channels - 1); };
+    if (sound.sampleRate == static_cast<uint32_t>(sampleRate)) {
+        for (uint32_t output = 0; output < kOutputs; output++) {
+            uint32_t source = sourceChannel(output);
+            for (uint32_t i = 0; i < click.frames; i++) {
+                click.channels[output][i] = sound.samples[size_t(i) * sound.channels + source];
+            }
+        }
+        return;
+    }
+
+    // Windowed sinc, cut off below the lower of the two Nyquist rates.
+    // Output frame i lies phase / up of the way from input frame base to
+    // the next, with base and phase the quotient and remainder of
+    // i * down / up. Rates in use share large factors, which leaves a few
+    // hundred phases, so the filter is only computed once for each.
+    uint32_t outRate = static_cast<uint32_t>(std::lround(sampleRate));
+    uint32_t common = std::gcd(outRate, sound.sampleRate);
+    uint64_t up = outRate / common;
+    uint64_t down = sound.sampleRate / common;
+    double cutoff = std::min(1.0, ratio);
+    double halfWidth = kFilterZeros / cutoff;
+    auto reach = static_cast<int64_t>(std::ceil(halfWidth));
+    size_t taps = size_t(2 * reach + 1);
+    auto computeFilter = [&](uint64_t phase, double* weights) {
+        for (int64_t tap = -reach; tap <= reach; tap++) {
+            double distance = double(tap) - double(phase) / double(up);
+            weights[tap + reach] = std::abs(distance) < halfWidth
+                                       ? cutoff * sinc(cutoff * distance) * window(distance / halfWidth) : 0.0;
+        }
+    };
+    bool tabled = up <= kMaxFilterPhases;
+    std::vector<double> filters(tabled ? up * taps : taps);
+    if (tabled) {
+        for (uint64_t phase = 0; phase < up; phase++) computeFilter(phase, &filters[phase * taps]);
+    }
+
+    for (uint32_t i = 0; i < click.frames; i++) {
+        auto base = static_cast<int64_t>(i * down / up);
+        uint64_t phase = i * down % up;
+        const double* weights = &filters[tabled ? phase * taps : 0];
+        if (!tabled) computeFilter(phase, filters.data());
+        int64_t first = std::max<int64_t>(base - reach, 0);
+        int64_t last = std::min<int64_t>(base + reach, int64_t(inFrames) - 1);
+        double sums[kOutputs] = {};
+        for (int64_t j = first; j <= last; j++) {
+            double weight = weights[j - base + reach];
+            for (uint32_t output = 0; output < kOutputs; output++) {
+                sums[output] += weight * sound.samples[size_t(j) * sound.channels + sourceChannel(output)];
+            }
+        }
+        for (uint32_t output = 0; output < kOutputs; output++) click.channels[output][i] = float(sums[output]);
+    }
+}
+
+void MetronomeNode::latchSettings() {
+    m_bpm = m_tempo.load(std::memory_order_relaxed);
+    uint32_t signature = m_signature.load(std::memory_order_relaxed);
+    m_numerator = signature >> 16;
+    m_denominator = signature & 0xffff;
+    m_framesPerBeat = m_sampleRate * 60.0 / m_bpm * 4.0 / m_denominator;
+}
+
+void MetronomeNode::applyRequests() {
+    uint32_t requests = m_requests.load(std::memory_order_acquire);
+    if (requests != m_seenRequests) {
+        m_seenRequests = requests;
+        m_running = m_runningRequested.load(std::memory_order_relaxed);
+        if (m_running) {
+            // A fresh grid with bar one at frame 0; the count-in runs on it
+            latchSettings();
+            m_anchorFrame = 0;
+            m_anchorBeat = 0;
+            m_barOrigin = 0;
+            m_playFrom = m_startFrame.load(std::memory_order_relaxed);
+            uint32_t countIn = m_countInBars.load(std::memory_order_relaxed);
+            m_frame = m_playFrom - std::llround(double(countIn) * m_numerator * m_framesPerBeat);
+            m_nextBeat = firstBeatFrom(m_frame);
+            m_nextBeatFrame = frameOfBeat(m_nextBeat);
+        }
+        return;
+    }
+
+    if (m_running && (m_tempo.load(std::memory_order_relaxed) != m_bpm ||
+                      m_signature.load(std::memory_order_relaxed) != packSignature(m_numerator, m_denominator))) {
+        reanchor();
+    }
+}
+
+void MetronomeNode::reanchor() {
+    // The next beat stays where it was; only later ones move. A new
+    // signature starts a bar on it.
+    uint32_t numerator = m_numerator;
+    uint32_t denominator = m_denominator;
+    latchSettings();
+    m_anchorFrame = m_nextBeatFrame;
+    m_anchorBeat = m_nextBeat;
+    if (m_numerator != numerator || m_denominator != denominator) m_barOrigin = m_nextBeat;
+}
+
+int64_t MetronomeNode::frameOfBeat(int64_t beat) const {
+    return m_anchorFrame + std::llround(double(beat - m_anchorBeat) * m_framesPerBeat);
+}
+
+int64_t MetronomeNode::firstBeatFrom(int64_t frame) const {
+    int64_t beat = m_anchorBeat + static_cast<int64_t>(std::ceil(double(frame - m_anchorFrame) / m_framesPerBeat));
+    // Rounding to frames may put the estimate one beat off
+    while (frameOfBeat(beat) < frame) beat++;
+    while (frameOfBeat(beat - 1) >= frame) beat--;
+    return beat;
+}
+
+bool MetronomeNode::isDownbeat(int64_t beat) const {
+    // Also right for the negative beats of a count-in
+    return (beat - m_barOrigin) % int64_t(m_numerator) == 0;
+}
+
+void MetronomeNode::startVoice(const Click& click, uint32_t delay) {
+    if (click.frames == 0) return;
+    if (m_activeVoices == kMaxVoices) {
+        // The oldest has the least left to ring
+        std::move(m_voices + 1, m_voices + kMaxVoices, m_voices);
+        m_activeVoices--;
+    }
+    m_voices[m_activeVoices++] = { &click, 0, delay };
+}
+
+void MetronomeNode::process(const AudioBlock& block) {
+    applyRequests();
+    for (uint32_t channel = 0; channel < kOutputs; channel++) {
+        std::fill(block.outputs[channel], block.outputs[channel] + block.frames, 0.0f);
+    }
+
+    if (m_running) {
+        int64_t end = m_frame + block.frames;
+        if (m_nextBeatFrame < end && !m_soundSets.empty()) {
+            uint32_t setIndex = m_soundSet.load(std::memory_order_relaxed);
+            const SoundSet& set = m_soundSets[setIndex < m_soundSets.size() ? setIndex : 0];
+            bool enabled = m_enabled.load(std::memory_order_relaxed);
+            while (m_nextBeatFrame < end) {
+                if (enabled || m_nextBeatFrame < m_playFrom) {
+                    startVoice(set.clicks[isDownbeat(m_nextBeat) ? 0 : 1], uint32_t(m_nextBeatFrame - m_frame));
+                }
+                m_nextBeat++;
+                m_nextBeatFrame = frameOfBeat(m_nextBeat);
+            }
+        }
+        m_frame = end;
+        m_position.store(m_frame, std::memory_order_relaxed);
+    }
+
+    if (m_activeVoices == 0) {
+        for (uint32_t channel = 0; channel < kOutputs; channel++) block.setOutputSilent(channel);
+        return;
+    }
+
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < m_activeVoices; i++) {
+        Voice voice = m_voices[i];
+        uint32_t frames = std::min(block.frames - voice.delay, voice.click->frames - voice.position);
+        for (uint32_t channel = 0; channel < kOutputs; channel++) {
+            const float* source = voice.click->channels[channel].data() + voice.position;
+            float* output = block.outputs[channel] + voice.delay;
+            for (uint32_t frame = 0; frame < frames; frame++) output[frame] += source[frame];
+        }
+        voice.position += frames;
+        voice.delay = 0;
+        if (voice.position < voice.click->frames) m_voices[kept++] = voice;
+    }
+    m_activeVoices = kept;
+}
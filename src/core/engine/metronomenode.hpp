@@ -0,0 +1,133 @@
+#pragma once
+
+#include "audionode.hpp"
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Clicks on every beat, with its own sounds for the first beat of a bar.
+//
+// The sounds are decoded once and resampled to the graph's rate in
+// prepare(), so process() only adds samples that are already there. Beats
+// fall on exact frames computed from the tempo and time signature, and a
+// tempo or signature change takes effect from the next beat on. start()
+// can put bars of count-in before the position playback starts from;
+// those click even while the metronome is disabled.
+//
+// Outside clicks a block costs clearing the outputs, which are flagged
+// silent.
+class MetronomeNode : public AudioNode {
+public:
+    static constexpr uint32_t kOutputs = 2;
+    // A long click still ringing when this many later ones start is cut
+    static constexpr uint32_t kMaxVoices = 8;
+    static constexpr double kMinTempo = 10.0;
+    static constexpr double kMaxTempo = 999.0;
+
+    // Interleaved samples as decoded from a file
+    struct Sound {
+        uint32_t channels = 0;
+        uint32_t sampleRate = 0;
+        std::vector<float> samples;
+
+        // From a whole WAV file held in memory
+        static bool fromWav(const uint8_t* data, size_t size, Sound& sound, std::string& error);
+    };
+
+    MetronomeNode() = default;
+
+    uint32_t numInputs() const override { return 0; }
+    uint32_t numOutputs() const override { return kOutputs; }
+
+    // Main thread, before the node is prepared. Returns the index to pass to
+    // setSoundSet(); the first set added is used until then.
+    uint32_t addSoundSet(Sound accent, Sound beat);
+
+    // --- Any thread
+
+    void setEnabled(bool enabled) { m_enabled.store(enabled, std::memory_order_relaxed); }
+    bool isEnabled() const { return m_enabled.load(std::memory_order_relaxed); }
+    void setTempo(double bpm);
+    // The beat is a 1/denominator note
+    void setTimeSignature(uint32_t numerator, uint32_t denominator);
+    void setSoundSet(uint32_t index) { m_soundSet.store(index, std::memory_order_relaxed); }
+
+    // Starts counting beats from frame, countInBars bars ahead of it. Frame
+    // 0 is the first beat of bar one. Takes effect with the next block.
+    void start(int64_t frame, uint32_t countInBars);
+    void stop();
+    bool isRunning() const { return m_runningRequested.load(std::memory_order_relaxed); }
+    // The frame the last block ended on; negative during a count-in from 0
+    int64_t position() const { return m_position.load(std::memory_order_relaxed); }
+
+    // Preparing again, as a device change does, stops counting
+    bool prepare(double sampleRate, uint32_t maxFrames) override;
+    void release() override {}
+    void process(const AudioBlock& block) override;
+
+private:
+    // A sound at the graph's rate, one buffer per output
+    struct Click {
+        std::vector<float> channels[kOutputs];
+        uint32_t frames = 0;
+    };
+
+    struct SoundSet {
+        Sound sounds[2];    // Accent, beat
+        Click clicks[2];
+    };
+
+    struct Voice {
+        const Click* click = nullptr;
+        uint32_t position = 0;
+        uint32_t delay = 0;     // Frames into the block before it starts
+    };
+
+    static void resample(const Sound& sound, double sampleRate, Click& click);
+    static uint32_t packSignature(uint32_t numerator, uint32_t denominator) { return numerator << 16 | denominator; }
+
+    // --- Audio thread
+    void applyRequests();
+    void latchSettings();
+    // Moves the beat grid to new settings from the next beat on
+    void reanchor();
+    int64_t frameOfBeat(int64_t beat) const;
+    int64_t firstBeatFrom(int64_t frame) const;
+    bool isDownbeat(int64_t beat) const;
+    void startVoice(const Click& click, uint32_t delay);
+
+    std::vector<SoundSet> m_soundSets;
+    double m_sampleRate = 0.0;
+
+    std::atomic<bool> m_enabled{false};
+    std::atomic<double> m_tempo{120.0};
+    std::atomic<uint32_t> m_signature{packSignature(4, 4)};
+    std::atomic<uint32_t> m_soundSet{0};
+
+    // start() and stop() write these before bumping m_requests
+    std::atomic<int64_t> m_startFrame{0};
+    std::atomic<uint32_t> m_countInBars{0};
+    std::atomic<bool> m_runningRequested{false};
+    std::atomic<uint32_t> m_requests{0};
+    std::atomic<int64_t> m_position{0};
+
+    // Audio thread state. Beat n sounds at m_anchorFrame plus
+    // (n - m_anchorBeat) beats; bars start on beats m_barOrigin plus a
+    // multiple of the numerator.
+    uint32_t m_seenRequests = 0;
+    bool m_running = false;
+    int64_t m_frame = 0;
+    int64_t m_playFrom = 0;     // Clicks before it are count-in
+    double m_bpm = 120.0;
+    uint32_t m_numerator = 4;
+    uint32_t m_denominator = 4;
+    double m_framesPerBeat = 0.0;
+    int64_t m_anchorFrame = 0;
+    int64_t m_anchorBeat = 0;
+    int64_t m_barOrigin = 0;
+    int64_t m_nextBeat = 0;
+    int64_t m_nextBeatFrame = 0;
+    Voice m_voices[kMaxVoices];
+    uint32_t m_activeVoices = 0;
+};
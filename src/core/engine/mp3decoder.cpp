@@ -0,0 +1,177 @@
+#include "audiodecoder.hpp"
+#include "diskfile.hpp"
+#include <mpg123.h>
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+// Frames asked from mpg123 per call; it returns interleaved float
+constexpr uint32_t kChunkFrames = 4096;
+// How far past the ID3 tags the first frame is looked for
+constexpr size_t kFrameSearchBytes = 4096;
+
+// Whether the first frame is a Xing/Info or VBRI header giving the number
+// of frames, which libmpg123 then reports the length from. Without one it
+// estimates the length from the file size and the first frame's bitrate.
+bool hasFrameCount(const std::filesystem::path& path) {
+    DiskFile file;
+    if (!file.open(path, DiskFile::Mode::Read, false)) return false;
+
+    // ID3v2 tags come first, each with a syncsafe size and maybe a footer
+    uint64_t offset = 0;
+    uint8_t id3[10];
+    while (file.readAt(offset, id3, sizeof(id3)) == int64_t(sizeof(id3)) && std::memcmp(id3, "ID3", 3) == 0) {
+        uint64_t size = (uint64_t(id3[6] & 0x7f) << 21) | (uint64_t(id3[7] & 0x7f) << 14) |
+                        (uint64_t(id3[8] & 0x7f) << 7) | uint64_t(id3[9] & 0x7f);
+        offset += sizeof(id3) + size + ((id3[5] & 0x10) ? 10 : 0);
+    }
+
+    std::vector<uint8_t> bytes(kFrameSearchBytes + 64);
+    int64_t read = file.readAt(offset, bytes.data(), bytes.size());
+    if (read < 64) return false;
+    for (size_t i = 0; i + 64 <= size_t(read); i++) {
+        const uint8_t* header = bytes.data() + i;
+        // Frame sync, a valid MPEG version, layer III and a usable bitrate
+        if (header[0] != 0xff || (header[1] & 0xe0) != 0xe0) continue;
+        uint32_t version = (header[1] >> 3) & 3;
+        uint32_t layer = (header[1] >> 1) & 3;
+        uint32_t bitrate = header[2] >> 4;
+        if (version == 1 || layer != 1 || bitrate == 0 || bitrate == 15) continue;
+
+        // Xing/Info follows the side information, VBRI is always 32 bytes in
+        bool mpeg1 = version == 3;
+        bool mono = (header[3] >> 6) == 3;
+        size_t sideInfo = mpeg1 ? (mono ? 17 : 32) : (mono ? 9 : 17);
+        const uint8_t* xing = header + 4 + sideInfo;
+        if (std::memcmp(xing, "Xing", 4) == 0 || std::memcmp(xing, "Info", 4) == 0) {
+            return (xing[7] & 0x01) != 0;
+        }
+        return std::memcmp(header + 4 + 32, "VBRI", 4) == 0;
+    }
+    return false;
+}
+
+class Mp3Decoder : public AudioDecoder {
+public:
+    ~Mp3Decoder() override {
+        if (m_handle) {
+            mpg123_close(m_handle);
+            mpg123_delete(m_handle);
+        }
+    }
+
+    bool open(const std::filesystem::path& path, std::string& error) {
+        // Only needed by older libmpg123 versions, harmless in newer ones
+        static std::once_flag initialized;
+        std::call_once(initialized, []() { mpg123_init(); });
+
+        int result = MPG123_OK;
+        m_handle = mpg123_new(nullptr, &result);
+        if (!m_handle) {
+            error = mpg123_plain_strerror(result);
+            return false;
+        }
+        // Gapless drops the encoder delay and padding the LAME header notes,
+        // so frame 0 is the first real sample like in the other formats
+        mpg123_param(m_handle, MPG123_ADD_FLAGS, MPG123_GAPLESS | MPG123_QUIET, 0.0);
+        // The output format is settled when the file is opened; formats set
+        // later only apply to the next file
+        const long* rates = nullptr;
+        size_t rateCount = 0;
+        mpg123_rates(&rates, &rateCount);
+        mpg123_format_none(m_handle);
+        for (size_t i = 0; i < rateCount; i++) {
+            mpg123_format(m_handle, rates[i], MPG123_MONO | MPG123_STEREO, MPG123_ENC_FLOAT_32);
+        }
+
+        // libmpg123 takes UTF-8 paths on Windows as well
+        if (mpg123_open(m_handle, reinterpret_cast<const char*>(path.u8string().c_str())) != MPG123_OK) {
+            error = "Cannot open " + path.string() + ": " + mpg123_strerror(m_handle);
+            return false;
+        }
+
+        long rate = 0;
+        int channels = 0;
+        int encoding = 0;
+        if (mpg123_getformat(m_handle, &rate, &channels, &encoding) != MPG123_OK || rate <= 0 || channels <= 0) {
+            error = "Invalid MP3 file";
+            return false;
+        }
+        if (encoding != MPG123_ENC_FLOAT_32) {
+            error = "libmpg123 was built without float output";
+            return false;
+        }
+        // Keep this format through the whole file
+        mpg123_format_none(m_handle);
+        mpg123_format(m_handle, rate, channels, MPG123_ENC_FLOAT_32);
+
+        m_info.channels = static_cast<uint32_t>(channels);
+        m_info.sampleRate = static_cast<uint32_t>(rate);
+        // Exact with a Xing/LAME header, estimated from the file size without
+        off_t length = mpg123_length(m_handle);
+        m_info.frames = length > 0 ? static_cast<uint64_t>(length) : 0;
+        m_info.exactLength = m_info.frames > 0 && hasFrameCount(path);
+        m_info.format = "MP3";
+        m_interleaved.resize(size_t(kChunkFrames) * m_info.channels);
+        return true;
+    }
+
+    bool seek(uint64_t frame) override {
+        // Sample-accurate: mpg123 jumps through its frame index and decodes
+        // forward from the frame before, skimming headers past the index
+        m_atEnd = false;
+        if (mpg123_seek(m_handle, static_cast<off_t>(frame), SEEK_SET) < 0) {
+            // Seeking past the end just ends reading
+            if (m_info.frames > 0 && frame >= m_info.frames) {
+                m_atEnd = true;
+                return true;
+            }
+            m_error = std::string("Seek failed: ") + mpg123_strerror(m_handle);
+            return false;
+        }
+        return true;
+    }
+
+    uint32_t read(float* const* channels, uint32_t frames) override {
+        uint32_t done = 0;
+        uint32_t channelCount = m_info.channels;
+        size_t frameBytes = sizeof(float) * channelCount;
+        while (done < frames && !m_atEnd && !hasFailed()) {
+            uint32_t count = std::min(frames - done, kChunkFrames);
+            size_t bytes = 0;
+            int result = mpg123_read(m_handle, reinterpret_cast<unsigned char*>(m_interleaved.data()),
+                                     count * frameBytes, &bytes);
+            if (result == MPG123_DONE) {
+                m_atEnd = true;
+            } else if (result != MPG123_OK && result != MPG123_NEW_FORMAT) {
+                m_error = std::string("MP3 decoding failed: ") + mpg123_strerror(m_handle);
+            }
+
+            count = static_cast<uint32_t>(bytes / frameBytes);
+            if (count == 0 && result == MPG123_OK) break;
+            for (uint32_t channel = 0; channel < channelCount; channel++) {
+                float* dest = channels[channel] + done;
+                const float* source = m_interleaved.data() + channel;
+                for (uint32_t i = 0; i < count; i++) dest[i] = source[size_t(i) * channelCount];
+            }
+            done += count;
+        }
+        return done;
+    }
+
+private:
+    mpg123_handle* m_handle = nullptr;
+    std::vector<float> m_interleaved;
+    bool m_atEnd = false;
+};
+
+} // namespace
+
+std::unique_ptr<AudioDecoder> AudioDecoder::openMp3(const std::filesystem::path& path, std::string& error) {
+    auto decoder = std::make_unique<Mp3Decoder>();
+    if (!decoder->open(path, error)) return nullptr;
+    return decoder;
+}
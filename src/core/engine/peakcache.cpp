@@ -0,0 +1,167 @@
+#include "peakcache.hpp"
+#include "audiodecoder.hpp"
+#include <cstdio>
+
+namespace {
+
+// Blocks are whole multiples of the coarsest bin, so each block fills its
+// own bins of every level
+constexpr uint32_t kBlockFrames = 2 * PeakWriter::kAlignment;
+static_assert(DecodingService::Options().segmentFrames % PeakWriter::kAlignment == 0,
+              "Segments must start on a peak bin of every level");
+
+std::filesystem::path normalized(const std::filesystem::path& path) {
+    std::error_code ec;
+    auto absolute = std::filesystem::absolute(path, ec);
+    return (ec ? path : absolute).lexically_normal();
+}
+
+} // namespace
+
+PeakCache::~PeakCache() {
+    stop();
+}
+
+bool PeakCache::start(const Options& options, std::string& error) {
+    m_options = options;
+    if (!m_options.folder.empty()) {
+        std::error_code ec;
+        std::filesystem::create_directories(m_options.folder, ec);
+        if (ec) {
+            error = "Cannot create " + m_options.folder.string() + ": " + ec.message();
+            return false;
+        }
+    }
+    DecodingService::Options decoding;
+    decoding.threads = options.threads;
+    decoding.blockFrames = kBlockFrames;
+    return m_decoder.start(decoding, error);
+}
+
+void PeakCache::stop() {
+    // Cancels every build; their callbacks run before this returns
+    m_decoder.stop();
+}
+
+std::filesystem::path PeakCache::peakPath(const std::filesystem::path& source) const {
+    auto path = normalized(source);
+    if (m_options.folder.empty()) {
+        path += PeakFile::kExtension;
+        return path;
+    }
+
+    // Files of the same name from different folders don't collide
+    uint64_t hash = 14695981039346656037ull;
+    for (char c : path.u8string()) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ull;
+    }
+    char suffix[24];
+    std::snprintf(suffix, sizeof(suffix), "-%016llx", static_cast<unsigned long long>(hash));
+    auto name = path.stem();
+    name += suffix;
+    name += PeakFile::kExtension;
+    return m_options.folder / name;
+}
+
+std::unique_ptr<PeakFile> PeakCache::open(const std::filesystem::path& source, std::string& error) const {
+    PeakFingerprint fingerprint;
+    if (!PeakFingerprint::of(source, fingerprint, error)) return nullptr;
+    auto file = std::make_unique<PeakFile>();
+    if (!file->open(peakPath(source), &fingerprint, error)) return nullptr;
+    return file;
+}
+
+bool PeakCache::ensure(const std::filesystem::path& source, DecodingService::Priority priority,
+                       BuiltCallback onBuilt) {
+    std::string error;
+    PeakFingerprint fingerprint;
+    if (!PeakFingerprint::of(source, fingerprint, error)) {
+        if (onBuilt) onBuilt(source, DecodingService::Result::Failed, error);
+        return false;
+    }
+    auto path = peakPath(source);
+    {
+        PeakFile existing;
+        if (existing.open(path, &fingerprint, error)) return true;
+    }
+
+    auto key = normalized(source);
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto it = m_builds.find(key);
+    if (it != m_builds.end()) {
+        auto& build = *it->second;
+        if (onBuilt) build.callbacks.push_back(std::move(onBuilt));
+        if (priority > build.priority) {
+            build.priority = priority;
+            m_decoder.setPriority(build.job, priority);
+        }
+        return false;
+    }
+
+    // Sizes the peak file; the service opens its own decoders
+    auto decoder = AudioDecoder::open(source, error);
+    auto build = std::make_shared<Build>();
+    // The writer drops frames past the length it's given, so an estimated
+    // one won't do
+    uint64_t frames = decoder && decoder->info().exactLength ? decoder->info().frames : PeakWriter::kUnknownLength;
+    if (!decoder || !build->writer.create(path, decoder->info().channels, decoder->info().sampleRate,
+                                          frames, fingerprint, error)) {
+        lock.unlock();
+        if (onBuilt) onBuilt(source, DecodingService::Result::Failed, error);
+        return false;
+    }
+    decoder.reset();
+    build->source = source;
+    build->priority = priority;
+    if (onBuilt) build->callbacks.push_back(std::move(onBuilt));
+
+    auto onBlock = [build](DecodingService::Block&& block) {
+        std::vector<const float*> channels(block.channels);
+        for (uint32_t channel = 0; channel < block.channels; channel++) channels[channel] = block.channel(channel);
+        // A failed write is reported once the job is done
+        build->writer.add(block.startFrame, channels.data(), block.frames);
+    };
+    auto onFinished = [this, key](DecodingService::JobId, DecodingService::Result result, const std::string& error) {
+        finishBuild(key, result, error);
+    };
+    build->job = m_decoder.decode(source, 0, DecodingService::kToEnd, priority, onBlock, onFinished);
+    if (build->job == DecodingService::kInvalidJob) {
+        build->writer.abandon();
+        auto callbacks = std::move(build->callbacks);
+        lock.unlock();
+        for (auto& callback : callbacks) {
+            callback(source, DecodingService::Result::Failed, "Peak computing isn't running");
+        }
+        return false;
+    }
+    m_builds.emplace(key, build);
+    return false;
+}
+
+void PeakCache::cancel(const std::filesystem::path& source) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_builds.find(normalized(source));
+    if (it != m_builds.end()) m_decoder.cancel(it->second->job);
+}
+
+void PeakCache::finishBuild(const std::filesystem::path& key, DecodingService::Result result,
+                            const std::string& error) {
+    std::shared_ptr<Build> build;
+    {
+        // ensure() holds the lock until the build is in the map
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_builds.find(key);
+        if (it == m_builds.end()) return;
+        build = std::move(it->second);
+        m_builds.erase(it);
+    }
+
+    std::string message = error;
+    if (result == DecodingService::Result::Done) {
+        if (!build->writer.finish(message)) result = DecodingService::Result::Failed;
+    } else {
+        build->writer.abandon();
+    }
+    for (auto& callback : build->callbacks) callback(build->source, result, message);
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "decodingservice.hpp"
+#include "peakfile.hpp"
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Keeps a peak file for every audio file that gets drawn.
+//
+// ensure() checks the peak file against the audio file's fingerprint and
+// has it computed on the DecodingService pool when it is missing or stale,
+// many files at once and long files spread over several workers. Once a
+// peak file is up to date nothing is decoded for that audio file again,
+// across sessions too.
+class PeakCache {
+public:
+    struct Options {
+        // Where peak files go, for audio in folders that aren't writable;
+        // empty puts each next to its audio file as <name>.ftpeaks
+        std::filesystem::path folder;
+        uint32_t threads = 0;
+    };
+
+    // Worker thread; error is set when result is Failed
+    using BuiltCallback = std::function<void(const std::filesystem::path& source, DecodingService::Result result,
+                                             const std::string& error)>;
+
+    PeakCache() = default;
+    ~PeakCache();
+
+    PeakCache(const PeakCache&) = delete;
+    PeakCache& operator=(const PeakCache&) = delete;
+
+    bool start(const Options& options, std::string& error);
+    void stop();
+
+    std::filesystem::path peakPath(const std::filesystem::path& source) const;
+
+    // Any thread. Returns true when source has an up to date peak file.
+    // Otherwise it is computed and onBuilt called once it's written, or
+    // right away when source can't be read; asking again meanwhile only
+    // adds the callback and raises the priority.
+    bool ensure(const std::filesystem::path& source, DecodingService::Priority priority, BuiltCallback onBuilt);
+    // Any thread. The peak file for source, null unless it's up to date
+    std::unique_ptr<PeakFile> open(const std::filesystem::path& source, std::string& error) const;
+    void cancel(const std::filesystem::path& source);
+
+private:
+    struct Build {
+        // As the first ensure() for it named it
+        std::filesystem::path source;
+        PeakWriter writer;
+        DecodingService::JobId job = DecodingService::kInvalidJob;
+        DecodingService::Priority priority = DecodingService::Priority::Normal;
+        std::vector<BuiltCallback> callbacks;
+    };
+
+    void finishBuild(const std::filesystem::path& key, DecodingService::Result result, const std::string& error);
+
+    Options m_options;
+    DecodingService m_decoder;
+    std::mutex m_mutex;
+    std::map<std::filesystem::path, std::shared_ptr<Build>> m_builds;
+};
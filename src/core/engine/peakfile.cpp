@@ -0,0 +1,426 @@
+#include "peakfile.hpp"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <initializer_list>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define PEAKFILE_SSE 1
+#endif
+
+namespace {
+
+constexpr uint32_t kLevelFactor = 8;
+constexpr size_t kHashedBytes = 64 * 1024;
+
+void put32(uint8_t* p, uint32_t value) {
+    for (int i = 0; i < 4; i++) p[i] = static_cast<uint8_t>(value >> (8 * i));
+}
+
+void put64(uint8_t* p, uint64_t value) {
+    for (int i = 0; i < 8; i++) p[i] = static_cast<uint8_t>(value >> (8 * i));
+}
+
+uint32_t get32(const uint8_t* p) {
+    return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+}
+
+uint64_t get64(const uint8_t* p) {
+    return uint64_t(get32(p)) | (uint64_t(get32(p + 4)) << 32);
+}
+
+// FNV-1a, 64-bit
+uint64_t hashBytes(uint64_t hash, const uint8_t* data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+uint64_t binsFor(uint64_t frames, uint32_t level) {
+    return (frames + PeakFile::kSamplesPerBin[level] - 1) / PeakFile::kSamplesPerBin[level];
+}
+
+// Minimum, maximum and sum of squares of one bin's samples
+struct BinStats {
+    float min;
+    float max;
+    float sumSquares;
+};
+
+BinStats measure(const float* samples, uint32_t count) {
+    float low = FLT_MAX;
+    float high = -FLT_MAX;
+    float sum = 0.0f;
+    uint32_t i = 0;
+#ifdef PEAKFILE_SSE
+    if (count >= 4) {
+        __m128 vlow = _mm_set1_ps(FLT_MAX);
+        __m128 vhigh = _mm_set1_ps(-FLT_MAX);
+        __m128 vsum = _mm_setzero_ps();
+        for (; i + 4 <= count; i += 4) {
+            __m128 v = _mm_loadu_ps(samples + i);
+            vlow = _mm_min_ps(vlow, v);
+            vhigh = _mm_max_ps(vhigh, v);
+            vsum = _mm_add_ps(vsum, _mm_mul_ps(v, v));
+        }
+        alignas(16) float lows[4], highs[4], sums[4];
+        _mm_store_ps(lows, vlow);
+        _mm_store_ps(highs, vhigh);
+        _mm_store_ps(sums, vsum);
+        low = std::min(std::min(lows[0], lows[1]), std::min(lows[2], lows[3]));
+        high = std::max(std::max(highs[0], highs[1]), std::max(highs[2], highs[3]));
+        sum = (sums[0] + sums[1]) + (sums[2] + sums[3]);
+    }
+#endif
+    for (; i < count; i++) {
+        low = std::min(low, samples[i]);
+        high = std::max(high, samples[i]);
+        sum += samples[i] * samples[i];
+    }
+    return { low, high, sum };
+}
+
+int16_t quantizePeak(float value) {
+    // NaN ends up at -1 as well
+    value = value > 1.0f ? 1.0f : (value >= -1.0f ? value : -1.0f);
+    return static_cast<int16_t>(std::lround(value * 32767.0f));
+}
+
+uint16_t quantizeRms(float value) {
+    value = value > 1.0f ? 1.0f : (value >= 0.0f ? value : 0.0f);
+    return static_cast<uint16_t>(std::lround(value * 65535.0f));
+}
+
+void putBin(uint8_t* p, const BinStats& stats, uint32_t frames) {
+    auto low = static_cast<uint16_t>(quantizePeak(stats.min));
+    auto high = static_cast<uint16_t>(quantizePeak(stats.max));
+    uint16_t rms = quantizeRms(std::sqrt(stats.sumSquares / float(frames)));
+    p[0] = static_cast<uint8_t>(low);
+    p[1] = static_cast<uint8_t>(low >> 8);
+    p[2] = static_cast<uint8_t>(high);
+    p[3] = static_cast<uint8_t>(high >> 8);
+    p[4] = static_cast<uint8_t>(rms);
+    p[5] = static_cast<uint8_t>(rms >> 8);
+}
+
+} // namespace
+
+bool PeakFingerprint::of(const std::filesystem::path& source, PeakFingerprint& fingerprint, std::string& error) {
+    std::error_code ec;
+    fingerprint = PeakFingerprint();
+    fingerprint.size = std::filesystem::file_size(source, ec);
+    if (ec) {
+        error = "Cannot read " + source.string() + ": " + ec.message();
+        return false;
+    }
+    auto modified = std::filesystem::last_write_time(source, ec);
+    if (!ec) fingerprint.modifiedTime = static_cast<int64_t>(modified.time_since_epoch().count());
+
+    DiskFile file;
+    if (!file.open(source, DiskFile::Mode::Read, false)) {
+        error = file.getError();
+        return false;
+    }
+    std::vector<uint8_t> buffer(kHashedBytes);
+    uint64_t hash = 14695981039346656037ull;
+    uint64_t tail = fingerprint.size > kHashedBytes ? fingerprint.size - kHashedBytes : 0;
+    for (uint64_t offset : { uint64_t(0), tail }) {
+        int64_t read = file.readAt(offset, buffer.data(), buffer.size());
+        if (read < 0) {
+            error = file.getError();
+            return false;
+        }
+        hash = hashBytes(hash, buffer.data(), size_t(read));
+        if (tail == 0) break;
+    }
+    fingerprint.hash = hash;
+    return true;
+}
+
+bool PeakFile::open(const std::filesystem::path& path, const PeakFingerprint* expected, std::string& error) {
+    if (!m_file.open(path, DiskFile::Mode::Read, false)) {
+        error = m_file.getError();
+        return false;
+    }
+    uint8_t header[kHeaderSize];
+    if (m_file.readAt(0, header, sizeof(header)) != int64_t(sizeof(header)) || std::memcmp(header, "FTPK", 4) != 0) {
+        error = "Not a peak file";
+        return false;
+    }
+    if (get32(header + 4) != kVersion || get32(header + 48) != kLevels) {
+        error = "Unsupported peak file version";
+        return false;
+    }
+
+    m_channels = get32(header + 8);
+    m_sampleRate = get32(header + 12);
+    m_frames = get64(header + 16);
+    m_fingerprint.size = get64(header + 24);
+    m_fingerprint.modifiedTime = static_cast<int64_t>(get64(header + 32));
+    m_fingerprint.hash = get64(header + 40);
+    if (expected && *expected != m_fingerprint) {
+        error = "The audio file has changed";
+        return false;
+    }
+
+    uint64_t fileSize = m_file.size();
+    for (uint32_t level = 0; level < kLevels; level++) {
+        const uint8_t* entry = header + 56 + 24 * level;
+        m_levels[level].bins = get64(entry + 8);
+        m_levels[level].offset = get64(entry + 16);
+        bool fits = m_channels > 0 && m_levels[level].bins <= fileSize &&
+                    m_levels[level].offset + m_levels[level].bins * m_channels * kBinBytes <= fileSize;
+        if (get32(entry) != kSamplesPerBin[level] || m_levels[level].bins != binsFor(m_frames, level) || !fits) {
+            error = "Damaged peak file";
+            return false;
+        }
+    }
+    return true;
+}
+
+uint32_t PeakFile::levelFor(double framesPerPixel) {
+    uint32_t level = 0;
+    while (level + 1 < kLevels && kSamplesPerBin[level + 1] <= framesPerPixel) level++;
+    return level;
+}
+
+bool PeakFile::read(uint32_t channel, double startFrame, double framesPerPixel, uint32_t pixels, Peak* peaks) {
+    std::fill(peaks, peaks + pixels, Peak());
+    if (channel >= m_channels || framesPerPixel <= 0.0 || pixels == 0) return true;
+
+    uint32_t level = levelFor(framesPerPixel);
+    const Level& info = m_levels[level];
+    double binFrames = kSamplesPerBin[level];
+    double endFrame = startFrame + framesPerPixel * pixels;
+    auto firstBin = static_cast<uint64_t>(std::max(0.0, std::floor(startFrame / binFrames)));
+    auto endBin = static_cast<uint64_t>(std::clamp(std::ceil(endFrame / binFrames), 0.0, double(info.bins)));
+    if (firstBin >= endBin) return true;
+
+    size_t binStride = size_t(m_channels) * kBinBytes;
+    size_t bytes = size_t(endBin - firstBin) * binStride;
+    m_scratch.resize(bytes);
+    if (m_file.readAt(info.offset + firstBin * binStride, m_scratch.data(), bytes) != int64_t(bytes)) {
+        m_error = m_file.getError().empty() ? "Damaged peak file" : m_file.getError();
+        return false;
+    }
+
+    for (uint32_t pixel = 0; pixel < pixels; pixel++) {
+        double from = startFrame + framesPerPixel * pixel;
+        double to = from + framesPerPixel;
+        if (to <= 0.0 || from >= double(m_frames)) continue;
+
+        // Zoomed in past the finest level, neighbouring pixels share a bin
+        auto bin = static_cast<uint64_t>(std::max(0.0, std::floor(from / binFrames)));
+        auto end = static_cast<uint64_t>(std::ceil(to / binFrames));
+        bin = std::max(bin, firstBin);
+        end = std::min(std::max(end, bin + 1), endBin);
+        if (end <= bin) continue;
+
+        int low = INT16_MAX;
+        int high = INT16_MIN;
+        double squares = 0.0;
+        for (uint64_t i = bin; i < end; i++) {
+            const uint8_t* p = m_scratch.data() + (i - firstBin) * binStride + size_t(channel) * kBinBytes;
+            low = std::min(low, int(static_cast<int16_t>(p[0] | (p[1] << 8))));
+            high = std::max(high, int(static_cast<int16_t>(p[2] | (p[3] << 8))));
+            double rms = double(p[4] | (p[5] << 8)) / 65535.0;
+            squares += rms * rms;
+        }
+        peaks[pixel].min = float(low) / 32767.0f;
+        peaks[pixel].max = float(high) / 32767.0f;
+        peaks[pixel].rms = static_cast<float>(std::sqrt(squares / double(end - bin)));
+    }
+    return true;
+}
+
+PeakWriter::~PeakWriter() {
+    if (m_file.isOpen()) abandon();
+}
+
+bool PeakWriter::create(const std::filesystem::path& path, uint32_t channels, uint32_t sampleRate,
+                        uint64_t maxFrames, const PeakFingerprint& fingerprint, std::string& error) {
+    if (channels == 0) {
+        error = "No channels";
+        return false;
+    }
+    m_path = path;
+    m_tempPath = path;
+    m_tempPath += ".tmp";
+    m_channels = channels;
+    m_sampleRate = sampleRate;
+    m_maxFrames = maxFrames;
+    m_fingerprint = fingerprint;
+    m_frames = 0;
+    m_failed = false;
+    m_error.clear();
+    for (auto& held : m_heldLevels) held.clear();
+
+    uint64_t offset = PeakFile::kHeaderSize;
+    for (uint32_t level = 0; level < PeakFile::kLevels; level++) {
+        m_levels[level].bins = maxFrames == kUnknownLength ? 0 : binsFor(maxFrames, level);
+        m_levels[level].offset = offset;
+        offset += m_levels[level].bins * channels * PeakFile::kBinBytes;
+    }
+    if (!m_file.open(m_tempPath, DiskFile::Mode::Create, false)) {
+        error = m_file.getError();
+        return false;
+    }
+    if (maxFrames != kUnknownLength) m_file.preallocate(offset);
+    return true;
+}
+
+void PeakWriter::setError(const std::string& error) {
+    std::lock_guard<std::mutex> lock(m_errorMutex);
+    if (!m_failed.exchange(true)) m_error = error;
+}
+
+bool PeakWriter::add(uint64_t startFrame, const float* const* channels, uint32_t frames) {
+    if (m_failed.load()) return false;
+    if (startFrame % kAlignment != 0) {
+        setError("Peak blocks must start on a multiple of " + std::to_string(kAlignment) + " frames");
+        return false;
+    }
+    if (startFrame >= m_maxFrames) return true;
+    frames = static_cast<uint32_t>(std::min<uint64_t>(frames, m_maxFrames - startFrame));
+    if (frames == 0) return true;
+
+    // Bins of the finest level are measured from the samples, those of
+    // each coarser level from the eight below it. The block starts on a
+    // bin of every level, so none is shared with another block.
+    std::vector<BinStats> stats[PeakFile::kLevels];
+    std::vector<uint8_t> bytes;
+    for (uint32_t level = 0; level < PeakFile::kLevels; level++) {
+        stats[level].resize(size_t(binsFor(frames, level)) * m_channels);
+    }
+    for (uint32_t channel = 0; channel < m_channels; channel++) {
+        uint32_t binFrames = PeakFile::kSamplesPerBin[0];
+        for (size_t bin = 0; bin * binFrames < frames; bin++) {
+            auto count = static_cast<uint32_t>(std::min<size_t>(binFrames, frames - bin * binFrames));
+            stats[0][bin * m_channels + channel] = measure(channels[channel] + bin * binFrames, count);
+        }
+    }
+    for (uint32_t level = 1; level < PeakFile::kLevels; level++) {
+        const auto& finer = stats[level - 1];
+        size_t finerBins = finer.size() / m_channels;
+        for (size_t bin = 0; bin < stats[level].size() / m_channels; bin++) {
+            size_t first = bin * kLevelFactor;
+            size_t last = std::min(first + kLevelFactor, finerBins);
+            for (uint32_t channel = 0; channel < m_channels; channel++) {
+                BinStats combined = finer[first * m_channels + channel];
+                for (size_t i = first + 1; i < last; i++) {
+                    const BinStats& part = finer[i * m_channels + channel];
+                    combined.min = std::min(combined.min, part.min);
+                    combined.max = std::max(combined.max, part.max);
+                    combined.sumSquares += part.sumSquares;
+                }
+                stats[level][bin * m_channels + channel] = combined;
+            }
+        }
+    }
+
+    for (uint32_t level = 0; level < PeakFile::kLevels; level++) {
+        uint32_t binFrames = PeakFile::kSamplesPerBin[level];
+        size_t bins = stats[level].size() / m_channels;
+        bytes.resize(stats[level].size() * PeakFile::kBinBytes);
+        for (size_t bin = 0; bin < bins; bin++) {
+            auto count = static_cast<uint32_t>(std::min<uint64_t>(binFrames, frames - bin * binFrames));
+            for (uint32_t channel = 0; channel < m_channels; channel++) {
+                size_t index = bin * m_channels + channel;
+                putBin(bytes.data() + index * PeakFile::kBinBytes, stats[level][index], count);
+            }
+        }
+        uint64_t position = startFrame / binFrames * m_channels * PeakFile::kBinBytes;
+        if (m_maxFrames == kUnknownLength && level > 0) {
+            std::lock_guard<std::mutex> lock(m_heldMutex);
+            auto& held = m_heldLevels[level];
+            if (held.size() < position + bytes.size()) held.resize(size_t(position + bytes.size()));
+            std::memcpy(held.data() + position, bytes.data(), bytes.size());
+            continue;
+        }
+        if (!m_file.writeAt(m_levels[level].offset + position, bytes.data(), bytes.size())) {
+            setError("Cannot write " + m_tempPath.string());
+            return false;
+        }
+    }
+
+    uint64_t end = startFrame + frames;
+    uint64_t known = m_frames.load();
+    while (end > known && !m_frames.compare_exchange_weak(known, end)) {
+    }
+    return true;
+}
+
+bool PeakWriter::finish(std::string& error) {
+    if (m_failed.load()) {
+        error = m_error;
+        abandon();
+        return false;
+    }
+
+    uint64_t frames = m_frames.load();
+    if (m_maxFrames == kUnknownLength) {
+        // The finest level is in place; the others follow it
+        uint64_t offset = PeakFile::kHeaderSize;
+        for (uint32_t level = 0; level < PeakFile::kLevels; level++) {
+            uint64_t bytes = binsFor(frames, level) * m_channels * PeakFile::kBinBytes;
+            m_levels[level].offset = offset;
+            if (level > 0 && bytes > 0) {
+                auto& held = m_heldLevels[level];
+                held.resize(size_t(bytes));
+                if (!m_file.writeAt(offset, held.data(), held.size())) {
+                    error = m_file.getError();
+                    abandon();
+                    return false;
+                }
+                held = {};
+            }
+            offset += bytes;
+        }
+    }
+
+    uint8_t header[PeakFile::kHeaderSize] = {};
+    std::memcpy(header, "FTPK", 4);
+    put32(header + 4, PeakFile::kVersion);
+    put32(header + 8, m_channels);
+    put32(header + 12, m_sampleRate);
+    put64(header + 16, frames);
+    put64(header + 24, m_fingerprint.size);
+    put64(header + 32, static_cast<uint64_t>(m_fingerprint.modifiedTime));
+    put64(header + 40, m_fingerprint.hash);
+    put32(header + 48, PeakFile::kLevels);
+    for (uint32_t level = 0; level < PeakFile::kLevels; level++) {
+        uint8_t* entry = header + 56 + 24 * level;
+        put32(entry, PeakFile::kSamplesPerBin[level]);
+        put64(entry + 8, binsFor(frames, level));
+        put64(entry + 16, m_levels[level].offset);
+    }
+    // The last level ends the file; with fewer frames than expected there
+    // is a gap before it, never anything past it
+    uint64_t size = m_levels[PeakFile::kLevels - 1].offset +
+                    binsFor(frames, PeakFile::kLevels - 1) * m_channels * PeakFile::kBinBytes;
+    if (!m_file.writeAt(0, header, sizeof(header)) || !m_file.truncate(size)) {
+        error = m_file.getError();
+        abandon();
+        return false;
+    }
+    m_file.close();
+
+    std::error_code ec;
+    std::filesystem::rename(m_tempPath, m_path, ec);
+    if (ec) {
+        std::filesystem::remove(m_tempPath, ec);
+        error = "Cannot write " + m_path.string();
+        return false;
+    }
+    return true;
+}
+
+void PeakWriter::abandon() {
+    m_file.close();
+    std::error_code ec;
+    std::filesystem::remove(m_tempPath, ec);
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include "diskfile.hpp"
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Identifies the audio file a peak file was computed from. The hash covers
+// the first and last 64 KiB, which catches a rewrite that keeps the size
+// and the modification time without reading hours of audio.
+struct PeakFingerprint {
+    uint64_t size = 0;
+    int64_t modifiedTime = 0;
+    uint64_t hash = 0;
+
+    static bool of(const std::filesystem::path& source, PeakFingerprint& fingerprint, std::string& error);
+    bool operator==(const PeakFingerprint& other) const {
+        return size == other.size && modifiedTime == other.modifiedTime && hash == other.hash;
+    }
+    bool operator!=(const PeakFingerprint& other) const { return !(*this == other); }
+};
+
+// Waveform overviews of one audio file, stored next to it so drawing a
+// clip at any zoom never reads the audio itself.
+//
+// Every level holds, per channel, the minimum, maximum and RMS of each bin
+// of kSamplesPerBin[level] frames, 6 bytes per bin and channel. Levels go
+// up by a factor of 8; all of them together take about 5% of the size of
+// a 16-bit original.
+//
+// PeakWriter builds the file, PeakFile reads it; a reader is used by one
+// thread at a time.
+class PeakFile {
+public:
+    static constexpr uint32_t kLevels = 4;
+    static constexpr uint32_t kSamplesPerBin[kLevels] = { 64, 512, 4096, 32768 };
+    static constexpr const char* kExtension = ".ftpeaks";
+
+    struct Peak {
+        float min = 0.0f;
+        float max = 0.0f;
+        float rms = 0.0f;
+    };
+
+    // Fails when the file is damaged or, with expected set, when it was
+    // computed from a different version of the audio
+    bool open(const std::filesystem::path& path, const PeakFingerprint* expected, std::string& error);
+
+    uint32_t channels() const { return m_channels; }
+    uint32_t sampleRate() const { return m_sampleRate; }
+    uint64_t frames() const { return m_frames; }
+    const PeakFingerprint& fingerprint() const { return m_fingerprint; }
+
+    // The coarsest level with at least one bin per pixel; the finest one
+    // when zoomed in further than that
+    static uint32_t levelFor(double framesPerPixel);
+
+    // Fills pixels peaks for one channel, each summarizing framesPerPixel
+    // frames from startFrame on. Pixels outside the file are silent.
+    bool read(uint32_t channel, double startFrame, double framesPerPixel, uint32_t pixels, Peak* peaks);
+
+    const std::string& getError() const { return m_error; }
+
+private:
+    friend class PeakWriter;
+
+    static constexpr uint32_t kVersion = 1;
+    static constexpr size_t kHeaderSize = 56 + 24 * kLevels;
+    static constexpr size_t kBinBytes = 6;
+
+    struct Level {
+        uint64_t bins = 0;
+        uint64_t offset = 0;
+    };
+
+    DiskFile m_file;
+    uint32_t m_channels = 0;
+    uint32_t m_sampleRate = 0;
+    uint64_t m_frames = 0;
+    PeakFingerprint m_fingerprint;
+    Level m_levels[kLevels];
+    std::vector<uint8_t> m_scratch;
+    std::string m_error;
+};
+
+// Computes a peak file from decoded audio. Blocks can arrive in any order
+// and from several threads at once, as long as they cover different frames
+// and each starts on a multiple of kAlignment. The file is written under a
+// temporary name and only moved in place by finish().
+class PeakWriter {
+public:
+    static constexpr uint32_t kAlignment = PeakFile::kSamplesPerBin[PeakFile::kLevels - 1];
+    // For maxFrames when the source doesn't know its length. The finest
+    // level then goes to the file as it arrives and the coarser ones,
+    // an eighth of its size together, are held until finish().
+    static constexpr uint64_t kUnknownLength = UINT64_MAX;
+
+    PeakWriter() = default;
+    ~PeakWriter();
+
+    PeakWriter(const PeakWriter&) = delete;
+    PeakWriter& operator=(const PeakWriter&) = delete;
+
+    // Frames past maxFrames are left out; the file records how many frames
+    // actually arrived
+    bool create(const std::filesystem::path& path, uint32_t channels, uint32_t sampleRate, uint64_t maxFrames,
+                const PeakFingerprint& fingerprint, std::string& error);
+    bool add(uint64_t startFrame, const float* const* channels, uint32_t frames);
+    bool finish(std::string& error);
+    // Deletes the unfinished file
+    void abandon();
+
+private:
+    void setError(const std::string& error);
+
+    DiskFile m_file;
+    std::filesystem::path m_path;
+    std::filesystem::path m_tempPath;
+    uint32_t m_channels = 0;
+    uint32_t m_sampleRate = 0;
+    uint64_t m_maxFrames = 0;
+    PeakFingerprint m_fingerprint;
+    PeakFile::Level m_levels[PeakFile::kLevels];
+    std::mutex m_heldMutex;
+    std::vector<uint8_t> m_heldLevels[PeakFile::kLevels];
+    std::atomic<uint64_t> m_frames{0};
+    std::atomic<bool> m_failed{false};
+    std::mutex m_errorMutex;
+    std::string m_error;
+};
@@ -0,0 +1,188 @@
+#include "presetfile.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+namespace {
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t chunkCount;
+};
+
+struct ChunkHeader {
+    char id[4];
+    uint32_t flags;
+    uint64_t size;
+};
+
+struct StoredParameter {
+    uint32_t id;
+    uint32_t reserved;
+    double value;
+};
+
+static_assert(sizeof(FileHeader) == 16, "preset file header layout changed");
+static_assert(sizeof(ChunkHeader) == 16, "preset chunk header layout changed");
+static_assert(sizeof(StoredParameter) == 16, "preset parameter layout changed");
+
+struct FileCloser {
+    void operator()(std::FILE* file) const { std::fclose(file); }
+};
+using File = std::unique_ptr<std::FILE, FileCloser>;
+
+File openFile(const std::filesystem::path& path, bool write) {
+#ifdef _WIN32
+    return File(_wfopen(path.c_str(), write ? L"wb" : L"rb"));
+#else
+    return File(std::fopen(path.c_str(), write ? "wb" : "rb"));
+#endif
+}
+
+uint64_t padding(uint64_t size) {
+    return (8 - size % 8) % 8;
+}
+
+bool isChunk(const ChunkHeader& chunk, const char* id) {
+    return std::memcmp(chunk.id, id, 4) == 0;
+}
+
+bool writeChunk(std::FILE* file, const char* id, const void* data, uint64_t size) {
+    static const char zeros[8] = {};
+    ChunkHeader chunk{};
+    std::memcpy(chunk.id, id, 4);
+    chunk.size = size;
+    return std::fwrite(&chunk, sizeof(chunk), 1, file) == 1 &&
+           (size == 0 || std::fwrite(data, 1, size, file) == size) &&
+           std::fwrite(zeros, 1, padding(size), file) == padding(size);
+}
+
+bool readExactly(std::FILE* file, void* data, uint64_t size) {
+    return size == 0 || std::fread(data, 1, size, file) == size;
+}
+
+bool skip(std::FILE* file, uint64_t size) {
+    while (size > 0) {
+        long step = static_cast<long>(std::min<uint64_t>(size, 1u << 30));
+        if (std::fseek(file, step, SEEK_CUR) != 0) return false;
+        size -= step;
+    }
+    return true;
+}
+
+} // namespace
+
+bool PresetFile::write(const std::filesystem::path& path, const PluginPreset& preset, std::string& error) {
+    std::vector<StoredParameter> parameters;
+    parameters.reserve(preset.parameters.size());
+    for (const auto& parameter : preset.parameters) parameters.push_back({ parameter.id, 0, parameter.value });
+
+    auto tempPath = path;
+    tempPath += ".tmp";
+    {
+        File file = openFile(tempPath, true);
+        if (!file) {
+            error = "Cannot write " + tempPath.string();
+            return false;
+        }
+
+        FileHeader header{};
+        std::memcpy(header.magic, kMagic, sizeof(header.magic));
+        header.version = kVersion;
+        header.chunkCount = 4;
+        bool ok = std::fwrite(&header, sizeof(header), 1, file.get()) == 1 &&
+                  writeChunk(file.get(), "PLUG", preset.pluginId.data(), preset.pluginId.size()) &&
+                  writeChunk(file.get(), "VERS", preset.pluginVersion.data(), preset.pluginVersion.size()) &&
+                  writeChunk(file.get(), "STAT", preset.state.data(), preset.state.size()) &&
+                  writeChunk(file.get(), "PARM", parameters.data(), parameters.size() * sizeof(StoredParameter)) &&
+                  std::fflush(file.get()) == 0;
+        if (!ok) {
+            file.reset();
+            std::error_code ec;
+            std::filesystem::remove(tempPath, ec);
+            error = "Failed writing " + tempPath.string();
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tempPath, path, ec);
+    if (ec) {
+        std::filesystem::remove(tempPath, ec);
+        error = "Cannot replace " + path.string();
+        return false;
+    }
+    return true;
+}
+
+bool PresetFile::read(const std::filesystem::path& path, PluginPreset& preset, std::string& error) {
+    File file = openFile(path, false);
+    if (!file) {
+        error = "Cannot open " + path.string();
+        return false;
+    }
+
+    std::error_code ec;
+    uint64_t fileSize = std::filesystem::file_size(path, ec);
+    if (ec) fileSize = 0;
+
+    FileHeader header{};
+    if (!readExactly(file.get(), &header, sizeof(header)) ||
+        std::memcmp(header.magic, kMagic, sizeof(header.magic)) != 0) {
+        error = path.string() + " is not a preset file";
+        return false;
+    }
+    if (header.version > kVersion) {
+        error = path.string() + " was written by a newer version";
+        return false;
+    }
+
+    preset = PluginPreset();
+    bool hasPlugin = false;
+    uint64_t offset = sizeof(header);
+    for (uint32_t i = 0; i < header.chunkCount; i++) {
+        ChunkHeader chunk{};
+        if (!readExactly(file.get(), &chunk, sizeof(chunk))) break;
+        offset += sizeof(chunk);
+        // Don't let a damaged size make us allocate gigabytes
+        if (fileSize && chunk.size > fileSize - offset) {
+            error = path.string() + " is truncated";
+            return false;
+        }
+
+        bool ok = true;
+        if (isChunk(chunk, "PLUG")) {
+            preset.pluginId.resize(chunk.size);
+            ok = readExactly(file.get(), preset.pluginId.data(), chunk.size);
+            hasPlugin = true;
+        } else if (isChunk(chunk, "VERS")) {
+            preset.pluginVersion.resize(chunk.size);
+            ok = readExactly(file.get(), preset.pluginVersion.data(), chunk.size);
+        } else if (isChunk(chunk, "STAT")) {
+            preset.state.resize(chunk.size);
+            ok = readExactly(file.get(), preset.state.data(), chunk.size);
+        } else if (isChunk(chunk, "PARM")) {
+            std::vector<StoredParameter> stored(chunk.size / sizeof(StoredParameter));
+            ok = readExactly(file.get(), stored.data(), stored.size() * sizeof(StoredParameter)) &&
+                 skip(file.get(), chunk.size % sizeof(StoredParameter));
+            preset.parameters.reserve(stored.size());
+            for (const auto& parameter : stored) preset.parameters.push_back({ parameter.id, parameter.value });
+        } else {
+            ok = skip(file.get(), chunk.size);
+        }
+        ok = ok && skip(file.get(), padding(chunk.size));
+        if (!ok) {
+            error = path.string() + " is truncated";
+            return false;
+        }
+        offset += chunk.size + padding(chunk.size);
+    }
+
+    if (!hasPlugin || preset.pluginId.empty()) {
+        error = path.string() + " doesn't say which plugin it is for";
+        return false;
+    }
+    return true;
+}
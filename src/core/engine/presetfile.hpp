@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// One plugin's settings: the opaque state the plugin saved and a snapshot
+// of its parameter values, for plugins without a state of their own and
+// for showing a preset's values without loading it.
+struct PluginPreset {
+    struct Parameter {
+        uint32_t id;
+        double value;
+    };
+
+    std::string pluginId;
+    std::string pluginVersion;
+    std::vector<uint8_t> state;
+    std::vector<Parameter> parameters;
+};
+
+// Reads and writes .ftpreset files.
+//
+// Layout (little-endian):
+//   char   magic[8]        "FTPRESET"
+//   uint32 version
+//   uint32 chunkCount
+//   then per chunk:
+//   char   id[4]
+//   uint32 flags           0
+//   uint64 size
+//   uint8  data[size]      padded to 8 bytes
+//
+// Chunks: "PLUG" plugin id, "VERS" plugin version, "STAT" state blob,
+// "PARM" { uint32 id, uint32 0, double value } per parameter.
+// Readers skip chunks they don't know, so later versions can add more.
+// The state is read straight into its final buffer, which keeps loading
+// a sampler's multi-megabyte state down to one read.
+class PresetFile {
+public:
+    static constexpr char kMagic[8] = { 'F', 'T', 'P', 'R', 'E', 'S', 'E', 'T' };
+    static constexpr uint32_t kVersion = 1;
+
+    // Writes to a temporary file and renames it over path
+    static bool write(const std::filesystem::path& path, const PluginPreset& preset, std::string& error);
+    static bool read(const std::filesystem::path& path, PluginPreset& preset, std::string& error);
+};
@@ -0,0 +1,269 @@
+#include "sandboxchannel.hpp"
+#include "eventlist.hpp"
+#include <cstring>
+#include <new>
+#include <thread>
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <unistd.h>
+    #ifdef __linux__
+        #include <climits>
+        #include <linux/futex.h>
+        #include <sys/syscall.h>
+        #include <time.h>
+    #endif
+#endif
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "doorbells must work across processes");
+
+namespace {
+
+// Spinning covers a plugin that answers within a few microseconds without
+// a trip through the scheduler; beyond that both sides sleep
+constexpr auto kSpinTime = std::chrono::microseconds(50);
+
+enum { kRequestEvent = 0, kResponseEvent = 1 };
+
+size_t alignUp(size_t value) {
+    return (value + 63) & ~size_t(63);
+}
+
+struct Layout {
+    size_t inputs;
+    size_t outputs;
+    size_t inEvents;
+    size_t outEvents;
+    size_t total;
+};
+
+Layout layoutFor(uint32_t maxFrames) {
+    size_t channelBytes = size_t(SandboxChannel::kMaxChannels) * maxFrames * sizeof(float);
+    Layout layout;
+    layout.inputs = alignUp(sizeof(SandboxChannel::Header));
+    layout.outputs = alignUp(layout.inputs + channelBytes);
+    layout.inEvents = alignUp(layout.outputs + channelBytes);
+    layout.outEvents = alignUp(layout.inEvents + sizeof(SandboxChannel::EventArea));
+    layout.total = alignUp(layout.outEvents + sizeof(SandboxChannel::EventArea));
+    return layout;
+}
+
+#ifdef _WIN32
+std::string eventName(const std::string& name, int which) {
+    return name + (which == kRequestEvent ? "-request" : "-response");
+}
+#endif
+
+} // namespace
+
+SandboxChannel::~SandboxChannel() {
+    close();
+}
+
+std::string SandboxChannel::makeName() {
+    static std::atomic<uint32_t> counter{0};
+#ifdef _WIN32
+    auto pid = static_cast<unsigned long>(GetCurrentProcessId());
+    return "Local\\futureboard-sandbox-" + std::to_string(pid) + "-" + std::to_string(counter++);
+#else
+    auto pid = static_cast<long>(getpid());
+    return "/futureboard-sandbox-" + std::to_string(pid) + "-" + std::to_string(counter++);
+#endif
+}
+
+bool SandboxChannel::create(const std::string& name, uint32_t maxFrames) {
+    close();
+    auto layout = layoutFor(maxFrames);
+    if (!m_memory.create(name, layout.total)) {
+        m_error = m_memory.getError();
+        return false;
+    }
+
+    auto* base = static_cast<char*>(m_memory.data());
+    m_header = new (base) Header();
+    m_header->magic = kMagic;
+    m_header->version = kVersion;
+    m_header->maxFrames = maxFrames;
+    m_header->state.store(static_cast<uint32_t>(HostState::Starting));
+    m_inputs = reinterpret_cast<float*>(base + layout.inputs);
+    m_outputs = reinterpret_cast<float*>(base + layout.outputs);
+    m_inEvents = reinterpret_cast<EventArea*>(base + layout.inEvents);
+    m_outEvents = reinterpret_cast<EventArea*>(base + layout.outEvents);
+    m_name = name;
+
+#ifdef _WIN32
+    for (int which : { kRequestEvent, kResponseEvent }) {
+        m_events[which] = CreateEventA(nullptr, FALSE, FALSE, eventName(name, which).c_str());
+        if (!m_events[which]) {
+            m_error = "CreateEvent failed for " + name;
+            close();
+            return false;
+        }
+    }
+#endif
+    return true;
+}
+
+bool SandboxChannel::open(const std::string& name) {
+    close();
+
+    // Map the header first to learn the size of the rest
+    if (!m_memory.open(name, sizeof(Header))) {
+        m_error = m_memory.getError();
+        return false;
+    }
+    auto* header = static_cast<const Header*>(m_memory.data());
+    if (header->magic != kMagic || header->version != kVersion) {
+        m_error = "Not a sandbox channel: " + name;
+        m_memory.close();
+        return false;
+    }
+    uint32_t maxFrames = header->maxFrames;
+
+    auto layout = layoutFor(maxFrames);
+    if (!m_memory.open(name, layout.total)) {
+        m_error = m_memory.getError();
+        return false;
+    }
+
+    auto* base = static_cast<char*>(m_memory.data());
+    m_header = reinterpret_cast<Header*>(base);
+    m_inputs = reinterpret_cast<float*>(base + layout.inputs);
+    m_outputs = reinterpret_cast<float*>(base + layout.outputs);
+    m_inEvents = reinterpret_cast<EventArea*>(base + layout.inEvents);
+    m_outEvents = reinterpret_cast<EventArea*>(base + layout.outEvents);
+    m_name = name;
+
+#ifdef _WIN32
+    for (int which : { kRequestEvent, kResponseEvent }) {
+        m_events[which] = OpenEventA(EVENT_MODIFY_STATE | SYNCHRONIZE, FALSE, eventName(name, which).c_str());
+        if (!m_events[which]) {
+            m_error = "OpenEvent failed for " + name;
+            close();
+            return false;
+        }
+    }
+#endif
+    return true;
+}
+
+void SandboxChannel::close() {
+#ifdef _WIN32
+    for (auto& event : m_events) {
+        if (event) CloseHandle(static_cast<HANDLE>(event));
+        event = nullptr;
+    }
+#endif
+    m_memory.close();
+    m_header = nullptr;
+    m_inputs = nullptr;
+    m_outputs = nullptr;
+    m_inEvents = nullptr;
+    m_outEvents = nullptr;
+}
+
+// --- Events
+
+void SandboxChannel::writeEvents(EventArea& area, const EventList& events) {
+    area.count = 0;
+    area.usedWords = 0;
+    for (uint32_t i = 0; i < events.size() && area.count < kMaxEvents; i++) {
+        const auto* event = events.get(i);
+        uint32_t words = (event->size + 7) / 8;
+        if (area.usedWords + words > kEventWords) break;
+        std::memcpy(&area.words[area.usedWords], event, event->size);
+        area.offsets[area.count++] = area.usedWords;
+        area.usedWords += words;
+    }
+}
+
+void SandboxChannel::readEvents(const EventArea& area, EventList& events) {
+    uint32_t count = area.count < kMaxEvents ? area.count : kMaxEvents;
+    for (uint32_t i = 0; i < count; i++) {
+        // The other process may be misbehaving, so don't trust offsets or sizes
+        uint32_t offset = area.offsets[i];
+        if (offset >= kEventWords) break;
+        const auto* event = reinterpret_cast<const clap_event_header_t*>(&area.words[offset]);
+        if (event->size > (kEventWords - offset) * 8) break;
+        events.push(event);
+    }
+}
+
+// --- Doorbells
+
+bool SandboxChannel::call(std::chrono::microseconds timeout) {
+    uint32_t seq = ++m_seq;
+    m_header->requestSeq.store(seq, std::memory_order_release);
+    wake(m_header->requestSeq, kRequestEvent);
+
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    uint32_t response;
+    while ((response = m_header->responseSeq.load(std::memory_order_acquire)) != seq) {
+        auto now = std::chrono::steady_clock::now();
+        if (now >= deadline) return false;
+        waitUntilChanged(m_header->responseSeq, response, kResponseEvent,
+                         std::chrono::duration_cast<std::chrono::microseconds>(deadline - now));
+    }
+    return true;
+}
+
+bool SandboxChannel::waitForRequest(uint32_t lastSeen, std::chrono::microseconds timeout) {
+    if (m_header->requestSeq.load(std::memory_order_acquire) != lastSeen) return true;
+    return waitUntilChanged(m_header->requestSeq, lastSeen, kRequestEvent, timeout);
+}
+
+void SandboxChannel::respond(uint32_t seq) {
+    m_header->responseSeq.store(seq, std::memory_order_release);
+    wake(m_header->responseSeq, kResponseEvent);
+}
+
+void SandboxChannel::wake(std::atomic<uint32_t>& word, int which) {
+#if defined(_WIN32)
+    (void)word;
+    SetEvent(static_cast<HANDLE>(m_events[which]));
+#elif defined(__linux__)
+    (void)which;
+    // Not FUTEX_PRIVATE: the waiter is in another process
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#else
+    (void)word;
+    (void)which;
+#endif
+}
+
+bool SandboxChannel::waitUntilChanged(std::atomic<uint32_t>& word, uint32_t from, int which,
+                                      std::chrono::microseconds timeout) {
+    using Clock = std::chrono::steady_clock;
+    auto start = Clock::now();
+    auto deadline = start + timeout;
+
+    // With a single core the other side can't make progress while we spin
+    static const bool canSpin = std::thread::hardware_concurrency() > 1;
+    while (canSpin && Clock::now() - start < kSpinTime) {
+        if (word.load(std::memory_order_acquire) != from) return true;
+    }
+
+    while (word.load(std::memory_order_acquire) == from) {
+        auto now = Clock::now();
+        if (now >= deadline) return false;
+        auto remaining = std::chrono::duration_cast<std::chrono::microseconds>(deadline - now);
+#if defined(_WIN32)
+        (void)word;
+        auto ms = static_cast<DWORD>((remaining.count() + 999) / 1000);
+        WaitForSingleObject(static_cast<HANDLE>(m_events[which]), ms);
+#elif defined(__linux__)
+        (void)which;
+        timespec wait;
+        wait.tv_sec = static_cast<time_t>(remaining.count() / 1000000);
+        wait.tv_nsec = static_cast<long>(remaining.count() % 1000000) * 1000;
+        // Returns at once if the word already changed
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, from, &wait, nullptr, 0);
+#else
+        (void)which;
+        (void)remaining;
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+#endif
+    }
+    return true;
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include "sharedmemory.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+class EventList;
+
+// Shared memory between the engine and a sandboxed plugin host process
+// (applications/pluginhost), one per hosted plugin.
+//
+// The region holds one block slot: a header, the audio channels and the
+// events in each direction. Audio is plain float arrays that the plugin in
+// the host process reads and writes in place; events are copied byte for
+// byte in CLAP's own layout. Nothing is serialized.
+//
+// Each block is one request and one response. The caller fills the slot,
+// bumps requestSeq and wakes the host; the host processes, bumps
+// responseSeq and wakes the caller. Both sides spin briefly before
+// sleeping, on a futex on Linux and on named events on Windows, so a
+// round trip stays within a few microseconds while the host is busy.
+class SandboxChannel {
+public:
+    static constexpr uint32_t kMagic = 0x46425342;  // "FBSB"
+    static constexpr uint32_t kVersion = 2;
+    static constexpr uint32_t kMaxChannels = 32;
+    static constexpr uint32_t kMaxEvents = 1024;
+    static constexpr uint32_t kEventWords = 8 * 1024;
+
+    enum class HostState : uint32_t {
+        Starting,
+        Ready,
+        Failed,
+    };
+
+    enum class Command : uint32_t {
+        Process,
+        Prepare,
+        Release,
+        Quit,
+    };
+
+    // CLAP events packed back to back on 8-byte boundaries
+    struct EventArea {
+        uint32_t count;
+        uint32_t usedWords;
+        uint32_t offsets[kMaxEvents];
+        uint64_t words[kEventWords];
+    };
+
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t maxFrames;             // Capacity of each channel
+
+        // Written by the host once the plugin is loaded
+        std::atomic<uint32_t> state;
+        uint32_t numInputs;
+        uint32_t numOutputs;
+        char pluginId[128];
+        char pluginName[128];
+        char error[256];
+
+        // Doorbells, also the futex words
+        std::atomic<uint32_t> requestSeq;
+        std::atomic<uint32_t> responseSeq;
+
+        // Request
+        Command command;
+        uint32_t frames;
+        int64_t steadyTime;
+        double sampleRate;
+        uint64_t silentInputs;          // AudioBlock's silence flags
+
+        // Response
+        uint32_t succeeded;
+        uint32_t failed;                // The plugin returned CLAP_PROCESS_ERROR
+        uint32_t sleeping;              // The plugin went to sleep on silence
+        uint64_t silentOutputs;
+    };
+
+    SandboxChannel() = default;
+    ~SandboxChannel();
+
+    SandboxChannel(const SandboxChannel&) = delete;
+    SandboxChannel& operator=(const SandboxChannel&) = delete;
+
+    static std::string makeName();
+
+    // Engine side
+    bool create(const std::string& name, uint32_t maxFrames);
+    // Host side
+    bool open(const std::string& name);
+    void close();
+
+    bool isOpen() const { return m_header != nullptr; }
+    const std::string& name() const { return m_name; }
+    const std::string& getError() const { return m_error; }
+
+    Header& header() const { return *m_header; }
+    float* input(uint32_t channel) const { return m_inputs + size_t(channel) * m_header->maxFrames; }
+    float* output(uint32_t channel) const { return m_outputs + size_t(channel) * m_header->maxFrames; }
+    EventArea& inEvents() const { return *m_inEvents; }
+    EventArea& outEvents() const { return *m_outEvents; }
+
+    static void writeEvents(EventArea& area, const EventList& events);
+    static void readEvents(const EventArea& area, EventList& events);
+
+    // Engine side: rings the host and waits for its response. False on
+    // timeout, in which case the host should be considered gone.
+    bool call(std::chrono::microseconds timeout);
+    // Host side: waits up to timeout for a request newer than lastSeen
+    bool waitForRequest(uint32_t lastSeen, std::chrono::microseconds timeout);
+    void respond(uint32_t seq);
+
+private:
+    void wake(std::atomic<uint32_t>& word, int which);
+    bool waitUntilChanged(std::atomic<uint32_t>& word, uint32_t from, int which, std::chrono::microseconds timeout);
+
+    SharedMemory m_memory;
+    std::string m_name;
+    std::string m_error;
+
+    Header* m_header = nullptr;
+    float* m_inputs = nullptr;
+    float* m_outputs = nullptr;
+    EventArea* m_inEvents = nullptr;
+    EventArea* m_outEvents = nullptr;
+
+    uint32_t m_seq = 0;
+    void* m_events[2] = { nullptr, nullptr };   // Windows: request and response events
+};
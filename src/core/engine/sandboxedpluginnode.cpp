@@ -0,0 +1,279 @@
+#include "sandboxedpluginnode.hpp"
+#include "eventlist.hpp"
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <csignal>
+    #include <spawn.h>
+    #include <sys/wait.h>
+    #include <unistd.h>
+    extern char** environ;
+#endif
+
+namespace {
+
+// Loading a large plugin can take a while
+constexpr auto kStartTimeout = std::chrono::seconds(30);
+constexpr auto kCommandTimeout = std::chrono::seconds(5);
+
+} // namespace
+
+// The host process. On Windows it lives in a job object that kills it when
+// the engine goes away; the host watches its parent elsewhere.
+struct SandboxedPluginNode::HostProcess {
+#ifdef _WIN32
+    PROCESS_INFORMATION info{};
+    HANDLE job = nullptr;
+#else
+    pid_t pid = -1;
+#endif
+
+    bool start(const std::filesystem::path& executable, const std::vector<std::string>& arguments, std::string& error);
+    bool isRunning();
+    // Any thread, without waiting for the process to go
+    void terminate();
+    // Main thread; waits for it and closes the handles
+    void kill();
+
+    ~HostProcess() { kill(); }
+};
+
+#ifdef _WIN32
+
+bool SandboxedPluginNode::HostProcess::start(const std::filesystem::path& executable,
+                                             const std::vector<std::string>& arguments, std::string& error) {
+    std::wstring commandLine = L"\"" + executable.wstring() + L"\"";
+    for (const auto& argument : arguments) {
+        commandLine += L" \"" + std::filesystem::path(argument).wstring() + L"\"";
+    }
+
+    job = CreateJobObjectW(nullptr, nullptr);
+    if (job) {
+        JOBOBJECT_EXTENDED_LIMIT_INFORMATION limits{};
+        limits.BasicLimitInformation.LimitFlags = JOB_OBJECT_LIMIT_KILL_ON_JOB_CLOSE;
+        SetInformationJobObject(job, JobObjectExtendedLimitInformation, &limits, sizeof(limits));
+    }
+
+    STARTUPINFOW startup{};
+    startup.cb = sizeof(startup);
+    if (!CreateProcessW(nullptr, commandLine.data(), nullptr, nullptr, FALSE, CREATE_NO_WINDOW | CREATE_SUSPENDED,
+                        nullptr, nullptr, &startup, &info)) {
+        error = "Failed to start " + executable.string();
+        return false;
+    }
+    if (job) AssignProcessToJobObject(job, info.hProcess);
+    ResumeThread(info.hThread);
+    return true;
+}
+
+bool SandboxedPluginNode::HostProcess::isRunning() {
+    return info.hProcess && WaitForSingleObject(info.hProcess, 0) == WAIT_TIMEOUT;
+}
+
+void SandboxedPluginNode::HostProcess::terminate() {
+    // Asynchronous; the process goes once its pending I/O is cancelled
+    if (info.hProcess) TerminateProcess(info.hProcess, 1);
+}
+
+void SandboxedPluginNode::HostProcess::kill() {
+    if (info.hProcess) {
+        TerminateProcess(info.hProcess, 1);
+        WaitForSingleObject(info.hProcess, 1000);
+        CloseHandle(info.hProcess);
+        CloseHandle(info.hThread);
+        info = PROCESS_INFORMATION{};
+    }
+    if (job) {
+        CloseHandle(job);
+        job = nullptr;
+    }
+}
+
+#else
+
+bool SandboxedPluginNode::HostProcess::start(const std::filesystem::path& executable,
+                                             const std::vector<std::string>& arguments, std::string& error) {
+    std::string program = executable.string();
+    std::vector<char*> argv;
+    argv.push_back(program.data());
+    std::vector<std::string> copies(arguments);
+    for (auto& argument : copies) argv.push_back(argument.data());
+    argv.push_back(nullptr);
+
+    int result = posix_spawn(&pid, program.c_str(), nullptr, nullptr, argv.data(), environ);
+    if (result != 0) {
+        pid = -1;
+        error = "Failed to start " + program + ": " + std::strerror(result);
+        return false;
+    }
+    return true;
+}
+
+bool SandboxedPluginNode::HostProcess::isRunning() {
+    if (pid <= 0) return false;
+    int status;
+    if (waitpid(pid, &status, WNOHANG) == 0) return true;
+    pid = -1;
+    return false;
+}
+
+void SandboxedPluginNode::HostProcess::terminate() {
+    // Until kill() reaps it the pid can't be reused, even once it exited
+    if (pid > 0) ::kill(pid, SIGKILL);
+}
+
+void SandboxedPluginNode::HostProcess::kill() {
+    if (pid <= 0) return;
+    ::kill(pid, SIGKILL);
+    int status;
+    waitpid(pid, &status, 0);
+    pid = -1;
+}
+
+#endif
+
+// --- SandboxedPluginNode
+
+SandboxedPluginNode::SandboxedPluginNode()
+    : m_process(std::make_unique<HostProcess>())
+{
+}
+
+std::shared_ptr<SandboxedPluginNode> SandboxedPluginNode::create(const std::filesystem::path& hostExecutable,
+                                                                 const std::filesystem::path& pluginPath,
+                                                                 const std::string& pluginId, std::string& error) {
+    std::shared_ptr<SandboxedPluginNode> node(new SandboxedPluginNode());
+    auto& channel = node->m_channel;
+    if (!channel.create(SandboxChannel::makeName(), kMaxFrames)) {
+        error = channel.getError();
+        return nullptr;
+    }
+
+    std::vector<std::string> arguments = { channel.name(), pluginPath.string() };
+    if (!pluginId.empty()) arguments.push_back(pluginId);
+    if (!node->m_process->start(hostExecutable, arguments, error)) return nullptr;
+
+    auto& header = channel.header();
+    auto deadline = std::chrono::steady_clock::now() + kStartTimeout;
+    while (header.state.load() == static_cast<uint32_t>(SandboxChannel::HostState::Starting)) {
+        if (!node->m_process->isRunning()) {
+            error = "Plugin host exited while loading " + pluginPath.string();
+            return nullptr;
+        }
+        if (std::chrono::steady_clock::now() > deadline) {
+            error = "Plugin host timed out loading " + pluginPath.string();
+            return nullptr;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    if (header.state.load() != static_cast<uint32_t>(SandboxChannel::HostState::Ready)) {
+        error = std::string(header.error, strnlen(header.error, sizeof(header.error)));
+        return nullptr;
+    }
+
+    node->m_pluginId.assign(header.pluginId, strnlen(header.pluginId, sizeof(header.pluginId)));
+    node->m_name.assign(header.pluginName, strnlen(header.pluginName, sizeof(header.pluginName)));
+    node->m_numInputs = std::min(header.numInputs, SandboxChannel::kMaxChannels);
+    node->m_numOutputs = std::min(header.numOutputs, SandboxChannel::kMaxChannels);
+    return node;
+}
+
+SandboxedPluginNode::~SandboxedPluginNode() {
+    if (!m_crashed && m_channel.isOpen() && m_channel.header().state.load() == static_cast<uint32_t>(SandboxChannel::HostState::Ready)) {
+        sendCommand(SandboxChannel::Command::Quit, std::chrono::seconds(1));
+    }
+    m_process->kill();
+}
+
+bool SandboxedPluginNode::sendCommand(SandboxChannel::Command command, std::chrono::microseconds timeout) {
+    if (m_crashed) return false;
+
+    m_channel.header().command = command;
+    if (!m_channel.call(timeout)) {
+        markCrashed();
+        return false;
+    }
+    return m_channel.header().succeeded != 0;
+}
+
+bool SandboxedPluginNode::prepare(double sampleRate, uint32_t maxFrames) {
+    if (maxFrames > kMaxFrames) return false;
+
+    auto& header = m_channel.header();
+    header.sampleRate = sampleRate;
+    header.frames = maxFrames;
+    m_failed = false;
+    m_hostSleeping = false;
+    return sendCommand(SandboxChannel::Command::Prepare, kCommandTimeout);
+}
+
+void SandboxedPluginNode::release() {
+    sendCommand(SandboxChannel::Command::Release, kCommandTimeout);
+}
+
+void SandboxedPluginNode::markCrashed() {
+    // A host that missed its deadline may still be running the plugin, or
+    // hung in it; it won't be called again, so it goes now rather than
+    // with the node
+    m_crashed = true;
+    m_process->terminate();
+}
+
+void SandboxedPluginNode::silenceOutputs(const AudioBlock& block) {
+    for (uint32_t channel = 0; channel < m_numOutputs; channel++) {
+        std::memset(block.outputs[channel], 0, block.frames * sizeof(float));
+        block.setOutputSilent(channel);
+    }
+}
+
+void SandboxedPluginNode::process(const AudioBlock& block) {
+    if (m_crashed || m_failed) {
+        silenceOutputs(block);
+        return;
+    }
+
+    if (m_hostSleeping && block.inEvents->size() == 0 && ++m_blocksSlept < kSleepPollBlocks) {
+        bool quiet = true;
+        for (uint32_t channel = 0; channel < m_numInputs && quiet; channel++) quiet = block.isInputSilent(channel);
+        if (quiet) {
+            silenceOutputs(block);
+            return;
+        }
+    }
+    m_blocksSlept = 0;
+
+    for (uint32_t channel = 0; channel < m_numInputs; channel++) {
+        std::memcpy(m_channel.input(channel), block.inputs[channel], block.frames * sizeof(float));
+    }
+    SandboxChannel::writeEvents(m_channel.inEvents(), *block.inEvents);
+
+    auto& header = m_channel.header();
+    header.command = SandboxChannel::Command::Process;
+    header.frames = block.frames;
+    header.steadyTime = block.steadyTime;
+    header.silentInputs = block.silentInputs;
+
+    if (!m_channel.call(m_processTimeout)) {
+        markCrashed();
+        silenceOutputs(block);
+        return;
+    }
+    if (header.failed) {
+        m_failed = true;
+        silenceOutputs(block);
+        return;
+    }
+
+    m_hostSleeping = header.sleeping != 0;
+    for (uint32_t channel = 0; channel < m_numOutputs; channel++) {
+        std::memcpy(block.outputs[channel], m_channel.output(channel), block.frames * sizeof(float));
+        if (channel < AudioBlock::kMaxSilenceChannels && (header.silentOutputs >> channel) & 1) block.setOutputSilent(channel);
+    }
+    SandboxChannel::readEvents(m_channel.outEvents(), *block.outEvents);
+}
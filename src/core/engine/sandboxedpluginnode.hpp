@@ -0,0 +1,77 @@
+#pragma once
+
+#include "audionode.hpp"
+#include "sandboxchannel.hpp"
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <string>
+
+// Runs a CLAP plugin in its own futureboard-pluginhost process and renders
+// it through a SandboxChannel, for plugins that aren't trusted to share the
+// engine's process. If the host crashes or stops answering, the node goes
+// silent, terminates it and reports hasCrashed(); the rest of the graph
+// keeps playing.
+//
+// process() copies the node's inputs into shared memory, rings the host
+// and copies the outputs back once it answers. The plugin itself processes
+// in place in shared memory. While the plugin sleeps on silence and the
+// node's inputs stay silent, blocks skip the round trip and only every
+// kSleepPollBlocks-th is sent, so a plugin that asks to be woken still is.
+class SandboxedPluginNode : public AudioNode {
+public:
+    // Blocks between calls to a sleeping host
+    static constexpr uint32_t kSleepPollBlocks = 64;
+    // Largest block the channel is sized for
+    static constexpr uint32_t kMaxFrames = 8192;
+
+    // Main thread. Starts the host and waits for it to load the plugin.
+    static std::shared_ptr<SandboxedPluginNode> create(const std::filesystem::path& hostExecutable,
+                                                       const std::filesystem::path& pluginPath,
+                                                       const std::string& pluginId, std::string& error);
+    ~SandboxedPluginNode() override;
+
+    uint32_t numInputs() const override { return m_numInputs; }
+    uint32_t numOutputs() const override { return m_numOutputs; }
+
+    bool prepare(double sampleRate, uint32_t maxFrames) override;
+    void release() override;
+    void process(const AudioBlock& block) override;
+
+    const std::string& pluginId() const { return m_pluginId; }
+    const std::string& name() const { return m_name; }
+    // The host process died or missed the process timeout
+    bool hasCrashed() const { return m_crashed; }
+    // The plugin returned CLAP_PROCESS_ERROR
+    bool hasFailed() const { return m_failed; }
+    // The plugin sleeps on silence in the host
+    bool isSleeping() const { return m_hostSleeping; }
+
+    // How long process() waits for the host before declaring it crashed
+    void setProcessTimeout(std::chrono::microseconds timeout) { m_processTimeout = timeout; }
+
+private:
+    SandboxedPluginNode();
+
+    bool sendCommand(SandboxChannel::Command command, std::chrono::microseconds timeout);
+    // Any thread. Stops calling the host and terminates it.
+    void markCrashed();
+    void silenceOutputs(const AudioBlock& block);
+
+    struct HostProcess;
+    std::unique_ptr<HostProcess> m_process;
+    SandboxChannel m_channel;
+
+    std::string m_pluginId;
+    std::string m_name;
+    uint32_t m_numInputs = 0;
+    uint32_t m_numOutputs = 0;
+    std::chrono::microseconds m_processTimeout{ 100000 };
+
+    uint32_t m_blocksSlept = 0;     // Audio thread
+
+    std::atomic<bool> m_crashed{false};
+    std::atomic<bool> m_failed{false};
+    std::atomic<bool> m_hostSleeping{false};
+};
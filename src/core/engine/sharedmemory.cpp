@@ -0,0 +1,127 @@
+#include "sharedmemory.hpp"
+#include <cstring>
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <cerrno>
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <unistd.h>
+#endif
+
+SharedMemory::~SharedMemory() {
+    close();
+}
+
+#ifdef _WIN32
+
+bool SharedMemory::create(const std::string& name, size_t size) {
+    close();
+    auto high = static_cast<DWORD>(static_cast<unsigned long long>(size) >> 32);
+    auto low = static_cast<DWORD>(size & 0xffffffffu);
+    HANDLE mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, high, low, name.c_str());
+    if (!mapping || GetLastError() == ERROR_ALREADY_EXISTS) {
+        if (mapping) CloseHandle(mapping);
+        m_error = "CreateFileMapping failed for " + name;
+        return false;
+    }
+    m_data = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    if (!m_data) {
+        CloseHandle(mapping);
+        m_error = "MapViewOfFile failed for " + name;
+        return false;
+    }
+    // Pagefile-backed mappings start zeroed
+    m_handle = mapping;
+    m_size = size;
+    m_name = name;
+    m_owner = true;
+    return true;
+}
+
+bool SharedMemory::open(const std::string& name, size_t size) {
+    close();
+    HANDLE mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, name.c_str());
+    if (!mapping) {
+        m_error = "OpenFileMapping failed for " + name;
+        return false;
+    }
+    m_data = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    if (!m_data) {
+        CloseHandle(mapping);
+        m_error = "MapViewOfFile failed for " + name;
+        return false;
+    }
+    m_handle = mapping;
+    m_size = size;
+    m_name = name;
+    return true;
+}
+
+void SharedMemory::close() {
+    if (m_data) UnmapViewOfFile(m_data);
+    if (m_handle) CloseHandle(static_cast<HANDLE>(m_handle));
+    m_data = nullptr;
+    m_handle = nullptr;
+    m_size = 0;
+    m_owner = false;
+}
+
+#else
+
+bool SharedMemory::create(const std::string& name, size_t size) {
+    close();
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        m_error = "shm_open failed for " + name + ": " + std::strerror(errno);
+        return false;
+    }
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        m_error = "ftruncate failed for " + name + ": " + std::strerror(errno);
+        ::close(fd);
+        shm_unlink(name.c_str());
+        return false;
+    }
+    void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        m_error = "mmap failed for " + name + ": " + std::strerror(errno);
+        shm_unlink(name.c_str());
+        return false;
+    }
+    m_data = data;
+    m_size = size;
+    m_name = name;
+    m_owner = true;
+    return true;
+}
+
+bool SharedMemory::open(const std::string& name, size_t size) {
+    close();
+    int fd = shm_open(name.c_str(), O_RDWR, 0600);
+    if (fd < 0) {
+        m_error = "shm_open failed for " + name + ": " + std::strerror(errno);
+        return false;
+    }
+    void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        m_error = "mmap failed for " + name + ": " + std::strerror(errno);
+        return false;
+    }
+    m_data = data;
+    m_size = size;
+    m_name = name;
+    return true;
+}
+
+void SharedMemory::close() {
+    if (m_data) munmap(m_data, m_size);
+    if (m_owner) shm_unlink(m_name.c_str());
+    m_data = nullptr;
+    m_size = 0;
+    m_owner = false;
+}
+
+#endif
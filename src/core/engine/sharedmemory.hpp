@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// A named shared memory region, mapped into this process. One side
+// create()s it, the other open()s it by name; the creator removes the name
+// again when it closes.
+class SharedMemory {
+public:
+    SharedMemory() = default;
+    ~SharedMemory();
+
+    SharedMemory(const SharedMemory&) = delete;
+    SharedMemory& operator=(const SharedMemory&) = delete;
+
+    // Zero-filled. On failure getError() says why.
+    bool create(const std::string& name, size_t size);
+    bool open(const std::string& name, size_t size);
+    void close();
+
+    void* data() const { return m_data; }
+    size_t size() const { return m_size; }
+    const std::string& getError() const { return m_error; }
+
+private:
+    void* m_data = nullptr;
+    size_t m_size = 0;
+    std::string m_name;
+    bool m_owner = false;
+    void* m_handle = nullptr;   // Windows file mapping
+    std::string m_error;
+};
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Ring buffer for one producer thread and one consumer thread, such as the
+// audio thread handing samples to a disk thread. Neither side ever waits
+// for the other, locks or allocates; each only stores its own position.
+//
+// Besides copying in and out, either side can ask for the free or filled
+// space as at most two contiguous regions, fill or drain them in place and
+// then commit, so samples can be interleaved straight into the ring.
+template <typename T>
+class SpscRing {
+public:
+    // The two parts of a region that wraps around the end of the buffer
+    struct Regions {
+        T* first = nullptr;
+        size_t firstCount = 0;
+        T* second = nullptr;
+        size_t secondCount = 0;
+
+        size_t size() const { return firstCount + secondCount; }
+    };
+
+    SpscRing() = default;
+    explicit SpscRing(size_t capacity) { reset(capacity); }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    // Empties the ring and makes room for at least capacity items, rounded
+    // up to a power of two. Neither side may be using the ring meanwhile.
+    void reset(size_t capacity) {
+        size_t size = 1;
+        while (size < capacity) size <<= 1;
+        m_buffer.assign(size, T());
+        m_mask = size - 1;
+        m_writePosition.store(0, std::memory_order_relaxed);
+        m_readPosition.store(0, std::memory_order_relaxed);
+    }
+
+    size_t capacity() const { return m_buffer.size(); }
+
+    // Producer
+    size_t writeAvailable() const {
+        return capacity() - (m_writePosition.load(std::memory_order_relaxed) -
+                             m_readPosition.load(std::memory_order_acquire));
+    }
+
+    Regions prepareWrite(size_t count) {
+        count = std::min(count, writeAvailable());
+        return regionsAt(m_writePosition.load(std::memory_order_relaxed), count);
+    }
+
+    void commitWrite(size_t count) {
+        m_writePosition.store(m_writePosition.load(std::memory_order_relaxed) + count, std::memory_order_release);
+    }
+
+    // Copies in as much as fits and returns how much that was
+    size_t write(const T* items, size_t count) {
+        Regions regions = prepareWrite(count);
+        std::copy(items, items + regions.firstCount, regions.first);
+        std::copy(items + regions.firstCount, items + regions.size(), regions.second);
+        commitWrite(regions.size());
+        return regions.size();
+    }
+
+    // Consumer
+    size_t readAvailable() const {
+        return m_writePosition.load(std::memory_order_acquire) - m_readPosition.load(std::memory_order_relaxed);
+    }
+
+    Regions prepareRead(size_t count) {
+        count = std::min(count, readAvailable());
+        return regionsAt(m_readPosition.load(std::memory_order_relaxed), count);
+    }
+
+    void commitRead(size_t count) {
+        m_readPosition.store(m_readPosition.load(std::memory_order_relaxed) + count, std::memory_order_release);
+    }
+
+    size_t read(T* items, size_t count) {
+        Regions regions = prepareRead(count);
+        std::copy(regions.first, regions.first + regions.firstCount, items);
+        std::copy(regions.second, regions.second + regions.secondCount, items + regions.firstCount);
+        commitRead(regions.size());
+        return regions.size();
+    }
+
+private:
+    Regions regionsAt(size_t position, size_t count) {
+        Regions regions;
+        if (count == 0) return regions;
+        size_t start = position & m_mask;
+        regions.first = m_buffer.data() + start;
+        regions.firstCount = std::min(count, capacity() - start);
+        regions.second = m_buffer.data();
+        regions.secondCount = count - regions.firstCount;
+        return regions;
+    }
+
+    std::vector<T> m_buffer;
+    size_t m_mask = 0;
+
+    // Free-running counts of items written and read, on separate cache
+    // lines so the two threads don't invalidate each other's
+    alignas(64) std::atomic<size_t> m_writePosition{0};
+    alignas(64) std::atomic<size_t> m_readPosition{0};
+};
@@ -0,0 +1,211 @@
+#include "pluginbrowsermodel.hpp"
+#include "../logger.hpp"
+
+namespace {
+
+QString toQString(std::string_view text) {
+    return QString::fromUtf8(text.data(), static_cast<qsizetype>(text.size()));
+}
+
+// Matches futureboard::PluginFormat in the scanner
+QString formatName(uint8_t format) {
+    switch (format) {
+        case 0: return QStringLiteral("VST2");
+        case 1: return QStringLiteral("VST3");
+        case 2: return QStringLiteral("CLAP");
+        default: return QStringLiteral("Unknown");
+    }
+}
+
+int formatIndex(const QString &name) {
+    for (uint8_t format = 0; format < 3; format++) {
+        if (formatName(format) == name) return format;
+    }
+    return -1;
+}
+
+} // namespace
+
+PluginBrowserModel::PluginBrowserModel(QObject *parent)
+    : QAbstractListModel(parent) {}
+
+int PluginBrowserModel::rowCount(const QModelIndex &parent) const {
+    if (parent.isValid()) return 0;
+    return static_cast<int>(m_rows.size());
+}
+
+QVariant PluginBrowserModel::data(const QModelIndex &index, int role) const {
+    if (!index.isValid() || index.row() >= static_cast<int>(m_rows.size())) return QVariant();
+
+    const auto& record = m_database.record(m_rows[index.row()]);
+    switch (role) {
+        case Qt::DisplayRole:
+        case NameRole: return toQString(m_database.string(record.name));
+        case VendorRole: return toQString(m_database.string(record.vendor));
+        case VersionRole: return toQString(m_database.string(record.version));
+        case FormatRole: return formatName(record.format);
+        case CategoryRole:
+            return record.categoriesCount > 0 ? toQString(m_database.category(record, 0)) : QString();
+        case PathRole: return toQString(m_database.string(record.path));
+        case UniqueIdRole: return toQString(m_database.string(record.uniqueId));
+        case IsInstrumentRole: return (record.flags & futureboard::plugindb::IsSynth) != 0;
+        case CpuLoadRole: {
+            using Catalogue = futureboard::PluginCatalogue;
+            float costUs = m_catalogue.costUs(m_rows[index.row()]);
+            if (costUs < 0.0f) return -1.0;
+            return costUs * 1e-6 * Catalogue::costSampleRate / Catalogue::costBlockSize;
+        }
+        case PluginIdRole: return toQString(m_database.string(record.clapId));
+        default: return QVariant();
+    }
+}
+
+QHash<int, QByteArray> PluginBrowserModel::roleNames() const {
+    return {
+        {NameRole, "name"},
+        {VendorRole, "vendor"},
+        {VersionRole, "version"},
+        {FormatRole, "format"},
+        {CategoryRole, "category"},
+        {PathRole, "path"},
+        {UniqueIdRole, "uniqueId"},
+        {IsInstrumentRole, "isInstrument"},
+        {CpuLoadRole, "cpuLoad"},
+        {PluginIdRole, "pluginId"}
+    };
+}
+
+void PluginBrowserModel::setQuery(const QString &query) {
+    if (m_query == query) return;
+    m_query = query;
+    updateResults();
+    emit queryChanged();
+}
+
+void PluginBrowserModel::setVendorFilter(const QString &vendor) {
+    if (m_vendorFilter == vendor) return;
+    m_vendorFilter = vendor;
+    updateResults();
+    emit filtersChanged();
+}
+
+void PluginBrowserModel::setTagFilter(const QString &tag) {
+    if (m_tagFilter == tag) return;
+    m_tagFilter = tag;
+    updateResults();
+    emit filtersChanged();
+}
+
+void PluginBrowserModel::setFormatFilter(const QString &format) {
+    if (m_formatFilter == format) return;
+    m_formatFilter = format;
+    updateResults();
+    emit filtersChanged();
+}
+
+void PluginBrowserModel::setInstrumentsOnly(bool instrumentsOnly) {
+    if (m_instrumentsOnly == instrumentsOnly) return;
+    m_instrumentsOnly = instrumentsOnly;
+    updateResults();
+    emit filtersChanged();
+}
+
+QStringList PluginBrowserModel::vendors() const {
+    QStringList result;
+    for (auto vendor : m_catalogue.vendors()) result.append(toQString(vendor));
+    return result;
+}
+
+QStringList PluginBrowserModel::tags() const {
+    // Categories are mostly features too (VST3 subcategories), so offer features
+    QStringList result;
+    for (auto feature : m_catalogue.features()) result.append(toQString(feature));
+    return result;
+}
+
+bool PluginBrowserModel::loadDatabase(const QString &filePath) {
+    m_databasePath = filePath;
+    beginResetModel();
+    m_rows.clear();
+    m_recordOf.clear();
+    m_index.clear();
+    m_catalogue.clear();
+
+    bool opened = m_database.open(filePath.toStdString());
+    if (opened) {
+        m_index.reserve(m_database.size());
+        m_recordOf.reserve(m_database.size());
+
+        // Failed scans stay in the database as rescan cache, not in the browser
+        for (uint32_t i = 0; i < m_database.size(); i++) {
+            const auto& record = m_database.record(i);
+            if (!(record.flags & futureboard::plugindb::IsValid)) continue;
+
+            PluginSearchIndex::Document document;
+            document.name = std::string(m_database.string(record.name));
+            document.vendor = std::string(m_database.string(record.vendor));
+            for (uint32_t c = 0; c < record.categoriesCount; c++) {
+                document.categories.emplace_back(m_database.category(record, c));
+            }
+            for (uint32_t f = 0; f < record.featuresCount; f++) {
+                document.features.emplace_back(m_database.feature(record, f));
+            }
+
+            m_index.add(document);
+            m_recordOf.push_back(i);
+        }
+
+        // Build the lookup tables now rather than on the first keystroke
+        m_index.finalize();
+        m_catalogue.load(m_database);
+        collectRows();
+        LOG_INFO(QString("Loaded %1 plugins from %2").arg(m_recordOf.size()).arg(filePath));
+    } else {
+        LOG_WARNING(QString("Failed to open plugin database: %1").arg(filePath));
+    }
+
+    endResetModel();
+    emit databaseLoaded();
+    emit countChanged();
+    return opened;
+}
+
+bool PluginBrowserModel::reloadDatabase() {
+    if (m_databasePath.isEmpty()) return false;
+    return loadDatabase(m_databasePath);
+}
+
+void PluginBrowserModel::updateResults() {
+    if (!m_database.isOpen()) return;
+
+    beginResetModel();
+    collectRows();
+    endResetModel();
+    emit countChanged();
+}
+
+void PluginBrowserModel::collectRows() {
+    m_rows.clear();
+    const auto& matches = m_index.search(m_query.toStdString());
+
+    bool filtered = m_instrumentsOnly || !m_vendorFilter.isEmpty() || !m_tagFilter.isEmpty() ||
+                    !m_formatFilter.isEmpty();
+    if (!filtered) {
+        for (uint32_t id : matches) m_rows.push_back(m_recordOf[id]);
+        return;
+    }
+
+    // Catalogue records share the database record indices
+    std::string vendor = m_vendorFilter.toStdString();
+    std::string tag = m_tagFilter.toStdString();
+    futureboard::PluginCatalogue::Filter filter;
+    filter.flags = m_instrumentsOnly ? futureboard::plugindb::IsSynth : 0;
+    filter.format = formatIndex(m_formatFilter);
+    filter.vendor = vendor;
+    if (!tag.empty()) filter.tags.push_back(tag);
+
+    auto selection = m_catalogue.select(filter);
+    for (uint32_t id : matches) {
+        if (selection.test(m_recordOf[id])) m_rows.push_back(m_recordOf[id]);
+    }
+}
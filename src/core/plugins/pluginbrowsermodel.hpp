@@ -0,0 +1,93 @@
+#pragma once
+
+#include <QObject>
+#include <QAbstractListModel>
+#include <QStringList>
+#include <vector>
+#include "PluginDatabase.hpp"
+#include "PluginCatalogue.hpp"
+#include "pluginsearchindex.hpp"
+
+// List of scanned plugins for the browser, filtered by the search query and
+// the vendor/tag/instrument filters. Rows are read straight from the
+// memory-mapped plugin database; the filters are bitset scans over a
+// PluginCatalogue built alongside it.
+class PluginBrowserModel : public QAbstractListModel {
+    Q_OBJECT
+    Q_PROPERTY(QString query READ query WRITE setQuery NOTIFY queryChanged)
+    Q_PROPERTY(QString vendorFilter READ vendorFilter WRITE setVendorFilter NOTIFY filtersChanged)
+    Q_PROPERTY(QString tagFilter READ tagFilter WRITE setTagFilter NOTIFY filtersChanged)
+    Q_PROPERTY(QString formatFilter READ formatFilter WRITE setFormatFilter NOTIFY filtersChanged)
+    Q_PROPERTY(bool instrumentsOnly READ instrumentsOnly WRITE setInstrumentsOnly NOTIFY filtersChanged)
+    Q_PROPERTY(QStringList vendors READ vendors NOTIFY databaseLoaded)
+    Q_PROPERTY(QStringList tags READ tags NOTIFY databaseLoaded)
+    Q_PROPERTY(int count READ rowCount NOTIFY countChanged)
+
+public:
+    enum Roles {
+        NameRole = Qt::UserRole + 1,
+        VendorRole,
+        VersionRole,
+        FormatRole,
+        CategoryRole,
+        PathRole,
+        UniqueIdRole,
+        IsInstrumentRole,
+        // Share of a 256-frame block at 48 kHz the plugin took to process
+        // in vstscanner --bench, -1 when it wasn't benchmarked
+        CpuLoadRole,
+        // The CLAP plugin id within its file, empty for other formats
+        PluginIdRole
+    };
+
+    explicit PluginBrowserModel(QObject *parent = nullptr);
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+    QString query() const { return m_query; }
+    void setQuery(const QString &query);
+
+    // Empty for any; the tag matches a category or a feature
+    QString vendorFilter() const { return m_vendorFilter; }
+    void setVendorFilter(const QString &vendor);
+    QString tagFilter() const { return m_tagFilter; }
+    void setTagFilter(const QString &tag);
+    // "VST2", "VST3" or "CLAP", as the format role reads
+    QString formatFilter() const { return m_formatFilter; }
+    void setFormatFilter(const QString &format);
+    bool instrumentsOnly() const { return m_instrumentsOnly; }
+    void setInstrumentsOnly(bool instrumentsOnly);
+
+    QStringList vendors() const;
+    QStringList tags() const;
+
+public slots:
+    bool loadDatabase(const QString &filePath);
+    // Reopens the database after the scanner rewrote it (see PluginScanFeed),
+    // keeping the query and filters
+    bool reloadDatabase();
+
+signals:
+    void queryChanged();
+    void filtersChanged();
+    void databaseLoaded();
+    void countChanged();
+
+private:
+    void updateResults();
+    void collectRows();
+
+    futureboard::PluginDatabase m_database;
+    QString m_databasePath;
+    futureboard::PluginCatalogue m_catalogue;
+    PluginSearchIndex m_index;
+    // Search document id -> database record index
+    std::vector<uint32_t> m_recordOf;
+    std::vector<uint32_t> m_rows;
+    QString m_query;
+    QString m_vendorFilter;
+    QString m_tagFilter;
+    QString m_formatFilter;
+    bool m_instrumentsOnly = false;
+};
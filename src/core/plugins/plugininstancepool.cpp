@@ -0,0 +1,445 @@
+#include "plugininstancepool.hpp"
+#include "../config/configmanager.hpp"
+#include "../engine/clappluginnode.hpp"
+#include "../logger.hpp"
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QThread>
+#include <algorithm>
+#include <cmath>
+
+#ifdef _WIN32
+    #include <windows.h>
+    #include <psapi.h>
+#else
+    #include <unistd.h>
+#endif
+
+namespace {
+
+// Matches futureboard::PluginFormat::CLAP in the scanner
+constexpr uint8_t kClapFormat = 2;
+
+// An insert a month ago counts half as much as one today
+constexpr double kUsageHalfLife = 30.0 * 24 * 60 * 60;
+
+// Instances are created on the main thread, one per tick
+constexpr int kTickInterval = 50;
+
+QString toQString(std::string_view text) {
+    return QString::fromUtf8(text.data(), static_cast<qsizetype>(text.size()));
+}
+
+std::filesystem::path toPath(const QString &path) {
+    return std::filesystem::path(path.toStdU16String());
+}
+
+// Private memory of this process, for measuring what an instance allocates
+qint64 processMemory() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS_EX counters{};
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&counters),
+                              sizeof(counters))) {
+        return 0;
+    }
+    return static_cast<qint64>(counters.PrivateUsage);
+#else
+    // Private_Clean and Private_Dirty, in kB; pages of the plugin's binary
+    // that other processes map too aren't its cost
+    QFile rollup("/proc/self/smaps_rollup");
+    if (rollup.open(QIODevice::ReadOnly)) {
+        qint64 kilobytes = 0;
+        for (const QByteArray &line : rollup.readAll().split('\n')) {
+            if (!line.startsWith("Private_")) continue;
+            QList<QByteArray> fields = line.simplified().split(' ');
+            if (fields.size() >= 2) kilobytes += fields[1].toLongLong();
+        }
+        return kilobytes * 1024;
+    }
+
+    // Before Linux 4.14 there is no rollup; resident pages that no file
+    // backs come closest
+    QFile statm("/proc/self/statm");
+    if (!statm.open(QIODevice::ReadOnly)) return 0;
+    QList<QByteArray> fields = statm.readAll().split(' ');
+    if (fields.size() < 3) return 0;
+    return (fields[1].toLongLong() - fields[2].toLongLong()) * sysconf(_SC_PAGESIZE);
+#endif
+}
+
+} // namespace
+
+PluginInstancePool& PluginInstancePool::instance() {
+    static PluginInstancePool instance;
+    return instance;
+}
+
+PluginInstancePool::PluginInstancePool() {
+    m_usagePath = QFileInfo(ConfigManager::instance().getConfigPath()).dir().filePath("plugin-usage.json");
+    loadUsage();
+
+    // Loading one binary at a time keeps the disk and the other cores free
+    // for whatever the user is doing
+    m_loader.setMaxThreadCount(1);
+    m_loader.setThreadPriority(QThread::LowPriority);
+
+    m_timer.setInterval(kTickInterval);
+    connect(&m_timer, &QTimer::timeout, this, &PluginInstancePool::tick);
+
+    // Plugins have to be gone before the application is
+    if (auto *app = QCoreApplication::instance()) {
+        connect(app, &QCoreApplication::aboutToQuit, this, &PluginInstancePool::clear);
+    }
+}
+
+PluginInstancePool::~PluginInstancePool() {
+    clear();
+}
+
+void PluginInstancePool::setMemoryBudget(qint64 bytes) {
+    if (m_memoryBudget == bytes) return;
+    m_memoryBudget = bytes;
+    plan();
+    emit settingsChanged();
+}
+
+void PluginInstancePool::setMaxPlugins(int count) {
+    if (m_maxPlugins == count) return;
+    m_maxPlugins = count;
+    plan();
+    emit settingsChanged();
+}
+
+void PluginInstancePool::setInstancesPerPlugin(int count) {
+    if (m_instancesPerPlugin == count) return;
+    m_instancesPerPlugin = count;
+    plan();
+    emit settingsChanged();
+}
+
+int PluginInstancePool::warmCount() const {
+    int count = 0;
+    for (const auto &entry : m_entries) count += static_cast<int>(entry.instances.size());
+    return count;
+}
+
+qint64 PluginInstancePool::memoryUsage() const {
+    qint64 bytes = 0;
+    for (auto it = m_entries.cbegin(); it != m_entries.cend(); ++it) {
+        if (!it->module) continue;
+        bytes += it->moduleBytes + static_cast<qint64>(it->instances.size()) * instanceBytes(it.key(), it->moduleBytes);
+    }
+    return bytes;
+}
+
+QString PluginInstancePool::keyFor(const QString &path, const QString &pluginId) {
+    return path + QLatin1Char('|') + pluginId;
+}
+
+double PluginInstancePool::scoreOf(const QString &key, qint64 now) const {
+    auto it = m_usage.constFind(key);
+    if (it == m_usage.cend() || it->score <= 0.0) return 0.0;
+    double age = static_cast<double>(std::max<qint64>(now - it->lastUsed, 0));
+    return it->score * std::pow(0.5, age / kUsageHalfLife);
+}
+
+qint64 PluginInstancePool::instanceBytes(const QString &key, qint64 moduleBytes) const {
+    auto it = m_usage.constFind(key);
+    if (it != m_usage.cend() && it->instanceBytes >= 0) return it->instanceBytes;
+    // Until one has been measured, guess an instance costs about its binary
+    return moduleBytes;
+}
+
+const PluginInstancePool::Target *PluginInstancePool::findTarget(const QString &path, const QString &pluginId) const {
+    for (const auto &target : m_targets) {
+        if (target.path == path && (pluginId.isEmpty() || target.pluginId == pluginId)) return &target;
+    }
+    return nullptr;
+}
+
+// --- Usage history
+
+void PluginInstancePool::loadUsage() {
+    QFile file(m_usagePath);
+    if (!file.open(QIODevice::ReadOnly)) return;
+
+    QJsonObject plugins = QJsonDocument::fromJson(file.readAll()).object().value("plugins").toObject();
+    for (auto it = plugins.begin(); it != plugins.end(); ++it) {
+        QJsonObject object = it.value().toObject();
+        Usage usage;
+        usage.score = object.value("score").toDouble();
+        usage.lastUsed = object.value("lastUsed").toInteger();
+        usage.instanceBytes = object.value("instanceBytes").toInteger(-1);
+        m_usage.insert(it.key(), usage);
+    }
+}
+
+void PluginInstancePool::saveUsage() const {
+    QJsonObject plugins;
+    for (auto it = m_usage.cbegin(); it != m_usage.cend(); ++it) {
+        QJsonObject object;
+        object["score"] = it->score;
+        object["lastUsed"] = it->lastUsed;
+        object["instanceBytes"] = it->instanceBytes;
+        plugins[it.key()] = object;
+    }
+
+    QJsonObject root;
+    root["plugins"] = plugins;
+    QFile file(m_usagePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        LOG_WARNING(QString("Failed to write %1").arg(m_usagePath));
+        return;
+    }
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+}
+
+void PluginInstancePool::recordUse(const QString &key) {
+    qint64 now = QDateTime::currentSecsSinceEpoch();
+    double score = scoreOf(key, now);
+    auto &usage = m_usage[key];
+    usage.score = score + 1.0;
+    usage.lastUsed = now;
+    saveUsage();
+}
+
+// --- Database and planning
+
+bool PluginInstancePool::loadDatabase(const QString &filePath) {
+    m_databasePath = filePath;
+    return reloadDatabase();
+}
+
+bool PluginInstancePool::reloadDatabase() {
+    m_database.close();
+    m_broken.clear();
+    if (!m_database.open(m_databasePath.toStdString())) {
+        LOG_WARNING(QString("Failed to open plugin database %1").arg(m_databasePath));
+        plan();
+        return false;
+    }
+    plan();
+    return true;
+}
+
+void PluginInstancePool::plan() {
+    struct Candidate {
+        uint32_t record;
+        QString key;
+        double score;
+        bool instrument;
+    };
+
+    qint64 now = QDateTime::currentSecsSinceEpoch();
+    std::vector<Candidate> candidates;
+    for (uint32_t i = 0; i < m_database.size(); i++) {
+        const auto &record = m_database.record(i);
+        if (record.format != kClapFormat || !(record.flags & futureboard::plugindb::IsValid)) continue;
+        if (!m_database.string(record.error).empty()) continue;
+
+        QString key = keyFor(toQString(m_database.string(record.path)), toQString(m_database.string(record.clapId)));
+        if (m_broken.contains(key)) continue;
+
+        double score = scoreOf(key, now);
+        bool instrument = (record.flags & futureboard::plugindb::IsSynth) != 0;
+        // Effects are quick to load; only ones the user reaches for earn a place
+        if (score <= 0.0 && !instrument) continue;
+        candidates.push_back({ i, key, score, instrument });
+    }
+
+    std::sort(candidates.begin(), candidates.end(), [this](const Candidate &a, const Candidate &b) {
+        if (a.score != b.score) return a.score > b.score;
+        if (a.instrument != b.instrument) return a.instrument;
+        return m_database.record(a.record).fileSize > m_database.record(b.record).fileSize;
+    });
+
+    m_targets.clear();
+    qint64 planned = 0;
+    for (const auto &candidate : candidates) {
+        if (static_cast<int>(m_targets.size()) >= m_maxPlugins) break;
+
+        const auto &record = m_database.record(candidate.record);
+        Target target;
+        target.key = candidate.key;
+        target.path = toQString(m_database.string(record.path));
+        target.pluginId = toQString(m_database.string(record.clapId));
+        target.moduleBytes = static_cast<qint64>(record.fileSize);
+        target.count = m_instancesPerPlugin;
+
+        // A smaller plugin further down may still fit
+        qint64 cost = target.moduleBytes + target.count * instanceBytes(target.key, target.moduleBytes);
+        if (planned + cost > m_memoryBudget) continue;
+        planned += cost;
+        m_targets.push_back(target);
+    }
+
+    evictUnplanned();
+    if (!m_targets.empty()) m_timer.start();
+}
+
+void PluginInstancePool::evictUnplanned() {
+    bool changed = false;
+    for (auto it = m_entries.begin(); it != m_entries.end();) {
+        auto target = std::find_if(m_targets.begin(), m_targets.end(),
+                                   [&](const Target &candidate) { return candidate.key == it.key(); });
+        if (target == m_targets.end()) {
+            changed = changed || !it->instances.empty();
+            it = m_entries.erase(it);
+            continue;
+        }
+        if (static_cast<int>(it->instances.size()) > target->count) {
+            it->instances.resize(target->count);
+            changed = true;
+        }
+        ++it;
+    }
+    if (changed) emit poolChanged();
+}
+
+// --- Refilling
+
+void PluginInstancePool::tick() {
+    // Warm instances still get their main-thread callbacks
+    for (auto &entry : m_entries) {
+        for (auto &node : entry.instances) node->idle();
+    }
+
+    bool pending = false;
+    for (const auto &target : m_targets) {
+        auto it = m_entries.find(target.key);
+        if (it == m_entries.end()) {
+            startLoading(target);
+            pending = true;
+            continue;
+        }
+        if (it->loading) {
+            pending = true;
+            continue;
+        }
+        if (static_cast<int>(it->instances.size()) >= target.count) continue;
+
+        // createInstance() may re-plan, which invalidates target
+        Target copy = target;
+        if (createInstance(copy, *it)) emit poolChanged();
+        return;
+    }
+
+    if (!pending && m_entries.isEmpty()) m_timer.stop();
+}
+
+void PluginInstancePool::startLoading(const Target &target) {
+    Entry entry;
+    entry.moduleBytes = target.moduleBytes;
+    entry.loading = true;
+    m_entries.insert(target.key, entry);
+
+    QString key = target.key;
+    std::filesystem::path path = toPath(target.path);
+    m_loader.start([this, key, path]() {
+        std::string error;
+        auto module = ClapModule::open(path, error);
+        QMetaObject::invokeMethod(this, [this, key, module, error]() {
+            moduleLoaded(key, module, QString::fromStdString(error));
+        }, Qt::QueuedConnection);
+    });
+}
+
+void PluginInstancePool::moduleLoaded(const QString &key, std::shared_ptr<ClapModule> module, const QString &error) {
+    // Dropped from the plan while it was loading
+    auto it = m_entries.find(key);
+    if (it == m_entries.end() || !it->loading) return;
+
+    if (!module) {
+        LOG_WARNING(QString("Not preloading %1: %2").arg(key, error));
+        m_entries.erase(it);
+        m_broken.insert(key);
+        plan();
+        return;
+    }
+    it->module = std::move(module);
+    it->loading = false;
+}
+
+bool PluginInstancePool::createInstance(const Target &target, Entry &entry) {
+    std::string error;
+    qint64 before = processMemory();
+    // Finds the module entry holds, so this is only the plugin's own setup
+    auto node = ClapPluginNode::create(toPath(target.path), target.pluginId.toStdString(), error);
+    qint64 allocated = std::max<qint64>(processMemory() - before, 0);
+
+    if (!node) {
+        LOG_WARNING(QString("Not preloading %1: %2").arg(target.key, QString::fromStdString(error)));
+        m_entries.remove(target.key);
+        m_broken.insert(target.key);
+        plan();
+        return false;
+    }
+
+    // Averaged, since other threads allocate in the meantime too
+    auto &usage = m_usage[target.key];
+    usage.instanceBytes = usage.instanceBytes < 0 ? allocated : (usage.instanceBytes + allocated) / 2;
+    entry.instances.push_back(std::move(node));
+    return true;
+}
+
+std::shared_ptr<ClapPluginNode> PluginInstancePool::take(const QString &path, const QString &pluginId, QString *error) {
+    auto node = takeInstance(path, pluginId, error);
+    if (!node) return nullptr;
+
+    recordUse(keyFor(path, QString::fromUtf8(node->plugin()->desc->id)));
+    // The insert may have changed the ranking
+    plan();
+    emit poolChanged();
+    return node;
+}
+
+std::shared_ptr<ClapPluginNode> PluginInstancePool::takeReplacement(const QString &path, const QString &pluginId,
+                                                                    QString *error) {
+    auto node = takeInstance(path, pluginId, error);
+    if (!node) return nullptr;
+
+    // The ranking stands; the timer makes up for the instance handed out
+    if (!m_targets.empty()) m_timer.start();
+    emit poolChanged();
+    return node;
+}
+
+std::shared_ptr<ClapPluginNode> PluginInstancePool::takeInstance(const QString &path, const QString &pluginId,
+                                                                 QString *error) {
+    std::shared_ptr<ClapPluginNode> node;
+
+    if (const Target *target = findTarget(path, pluginId)) {
+        auto it = m_entries.find(target->key);
+        while (it != m_entries.end() && !it->instances.empty() && !node) {
+            node = std::move(it->instances.back());
+            it->instances.pop_back();
+            // Asked for a restart while waiting, so not usable as it is
+            if (node->needsRestart()) node.reset();
+        }
+    }
+
+    if (!node) {
+        std::string message;
+        node = ClapPluginNode::create(toPath(path), pluginId.toStdString(), message);
+        if (!node) {
+            if (error) *error = QString::fromStdString(message);
+            return nullptr;
+        }
+    }
+    return node;
+}
+
+void PluginInstancePool::clear() {
+    m_timer.stop();
+    m_targets.clear();
+    // Loads still running finish first; their results are then ignored
+    m_loader.waitForDone();
+    m_entries.clear();
+    saveUsage();
+    emit poolChanged();
+}
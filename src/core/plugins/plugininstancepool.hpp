@@ -0,0 +1,133 @@
+#pragma once
+
+#include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QString>
+#include <QThreadPool>
+#include <QTimer>
+#include <memory>
+#include <vector>
+#include "PluginDatabase.hpp"
+
+class ClapModule;
+class ClapPluginNode;
+
+// Keeps instances of the user's most-used plugins loaded ahead of time so
+// inserting one on a track doesn't stall the UI.
+//
+// Plugins are ranked by how often and how recently they were inserted
+// (kept in plugin-usage.json next to config.json). Instruments from the
+// scanner's database fill any remaining places, largest binaries first.
+// Only CLAP plugins are pooled since those are the ones the engine hosts.
+//
+// Loading a plugin's binary and running clap_entry.init happens on a
+// background thread. CLAP wants instances created on the main thread, so
+// the pool makes them there, one per timer tick. take() hands out a warm
+// instance straight away and the pool makes a replacement afterwards. The
+// plan stays within memoryBudget, using each plugin's binary size and the
+// memory its instances were seen to allocate.
+class PluginInstancePool : public QObject {
+    Q_OBJECT
+    Q_PROPERTY(qint64 memoryBudget READ memoryBudget WRITE setMemoryBudget NOTIFY settingsChanged)
+    Q_PROPERTY(int maxPlugins READ maxPlugins WRITE setMaxPlugins NOTIFY settingsChanged)
+    Q_PROPERTY(int instancesPerPlugin READ instancesPerPlugin WRITE setInstancesPerPlugin NOTIFY settingsChanged)
+    Q_PROPERTY(int warmCount READ warmCount NOTIFY poolChanged)
+    Q_PROPERTY(qint64 memoryUsage READ memoryUsage NOTIFY poolChanged)
+
+public:
+    static PluginInstancePool& instance();
+
+    qint64 memoryBudget() const { return m_memoryBudget; }
+    void setMemoryBudget(qint64 bytes);
+    int maxPlugins() const { return m_maxPlugins; }
+    void setMaxPlugins(int count);
+    int instancesPerPlugin() const { return m_instancesPerPlugin; }
+    void setInstancesPerPlugin(int count);
+
+    // Instances ready to hand out
+    int warmCount() const;
+    // Estimated memory held by loaded modules and warm instances
+    qint64 memoryUsage() const;
+
+    // Main thread. Hands out a warm instance when there is one and creates
+    // it on the spot otherwise. Either way the insert counts towards the
+    // plugin's rank. An empty pluginId picks the first plugin in the file.
+    std::shared_ptr<ClapPluginNode> take(const QString &path, const QString &pluginId, QString *error = nullptr);
+    // The same for an instance that stands in for one already inserted, as
+    // when loading a preset; it doesn't count towards the rank
+    std::shared_ptr<ClapPluginNode> takeReplacement(const QString &path, const QString &pluginId,
+                                                    QString *error = nullptr);
+
+public slots:
+    bool loadDatabase(const QString &filePath);
+    // Re-ranks after the scanner rewrote the database
+    bool reloadDatabase();
+    // Drops every warm instance and loaded module
+    void clear();
+
+signals:
+    void settingsChanged();
+    void poolChanged();
+
+private:
+    struct Usage {
+        double score = 0.0;         // Decayed count of inserts as of lastUsed
+        qint64 lastUsed = 0;        // Seconds since the epoch
+        qint64 instanceBytes = -1;  // Measured memory per instance, -1 when unknown
+    };
+
+    struct Target {
+        QString key;
+        QString path;
+        QString pluginId;
+        qint64 moduleBytes = 0;     // Size of the binary
+        int count = 0;
+    };
+
+    struct Entry {
+        std::shared_ptr<ClapModule> module;
+        std::vector<std::shared_ptr<ClapPluginNode>> instances;
+        qint64 moduleBytes = 0;
+        bool loading = false;
+    };
+
+    PluginInstancePool();
+    ~PluginInstancePool();
+
+    static QString keyFor(const QString &path, const QString &pluginId);
+    double scoreOf(const QString &key, qint64 now) const;
+    qint64 instanceBytes(const QString &key, qint64 moduleBytes) const;
+    // Current target for path; pluginId may be empty for the first in the file
+    const Target *findTarget(const QString &path, const QString &pluginId) const;
+
+    void loadUsage();
+    void saveUsage() const;
+    void recordUse(const QString &key);
+    std::shared_ptr<ClapPluginNode> takeInstance(const QString &path, const QString &pluginId, QString *error);
+
+    // Ranks the database's plugins and decides what to keep warm
+    void plan();
+    void evictUnplanned();
+    void tick();
+    void startLoading(const Target &target);
+    void moduleLoaded(const QString &key, std::shared_ptr<ClapModule> module, const QString &error);
+    bool createInstance(const Target &target, Entry &entry);
+
+    futureboard::PluginDatabase m_database;
+    QString m_databasePath;
+    QString m_usagePath;
+    QHash<QString, Usage> m_usage;
+
+    std::vector<Target> m_targets;
+    QHash<QString, Entry> m_entries;
+    // Plugins that failed to load, not retried until the database changes
+    QSet<QString> m_broken;
+
+    QThreadPool m_loader;
+    QTimer m_timer;
+
+    qint64 m_memoryBudget = 512ll * 1024 * 1024;
+    int m_maxPlugins = 8;
+    int m_instancesPerPlugin = 1;
+};
@@ -0,0 +1,91 @@
+#include "pluginscanfeed.hpp"
+#include "../logger.hpp"
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+PluginScanFeed::PluginScanFeed(QObject *parent)
+    : QObject(parent) {
+    connect(&m_watcher, &QFileSystemWatcher::fileChanged, this, &PluginScanFeed::readNewLines);
+    // The scanner may create the stream after we start following it
+    connect(&m_watcher, &QFileSystemWatcher::directoryChanged, this, &PluginScanFeed::readNewLines);
+}
+
+void PluginScanFeed::setStreamPath(const QString &path) {
+    if (m_streamPath == path) return;
+
+    if (!m_watcher.files().isEmpty()) m_watcher.removePaths(m_watcher.files());
+    if (!m_watcher.directories().isEmpty()) m_watcher.removePaths(m_watcher.directories());
+
+    m_streamPath = path;
+    m_partialLine.clear();
+    m_added.clear();
+    m_removed.clear();
+
+    // Only what is written from now on is news
+    QFileInfo info(path);
+    m_offset = info.exists() ? info.size() : 0;
+
+    if (!path.isEmpty()) {
+        m_watcher.addPath(info.absolutePath());
+        if (info.exists()) m_watcher.addPath(path);
+    }
+    emit streamPathChanged();
+}
+
+void PluginScanFeed::readNewLines() {
+    if (m_streamPath.isEmpty()) return;
+
+    QFile file(m_streamPath);
+    if (!file.exists()) return;
+    // Watches are dropped when the file is replaced
+    if (!m_watcher.files().contains(m_streamPath)) m_watcher.addPath(m_streamPath);
+    if (!file.open(QIODevice::ReadOnly)) return;
+
+    // A new scan truncates the stream
+    if (file.size() < m_offset) {
+        m_offset = 0;
+        m_partialLine.clear();
+    }
+    if (file.size() == m_offset) return;
+
+    file.seek(m_offset);
+    QByteArray data = m_partialLine + file.readAll();
+    m_offset = file.pos();
+
+    // The scanner flushes whole lines, but a read can still land mid-write
+    qsizetype start = 0;
+    for (qsizetype end = data.indexOf('\n'); end >= 0; end = data.indexOf('\n', start)) {
+        handleLine(data.mid(start, end - start));
+        start = end + 1;
+    }
+    m_partialLine = data.mid(start);
+}
+
+void PluginScanFeed::handleLine(const QByteArray &line) {
+    QJsonParseError error;
+    QJsonDocument document = QJsonDocument::fromJson(line, &error);
+    if (error.error != QJsonParseError::NoError || !document.isObject()) {
+        LOG_WARNING(QString("Ignoring malformed scan stream line: %1").arg(error.errorString()));
+        return;
+    }
+
+    QJsonObject object = document.object();
+    QString event = object.value("event").toString();
+    if (event == "plugin") {
+        m_added.append(object.value("name").toString());
+    } else if (event == "removed") {
+        m_removed.append(object.value("path").toString());
+    } else if (event == "delta") {
+        emit pluginsChanged(m_added, m_removed);
+        m_added.clear();
+        m_removed.clear();
+    } else if (event == "complete") {
+        m_added.clear();
+        emit scanCompleted(object.value("count").toInt());
+    } else if (event == "start") {
+        m_added.clear();
+        m_removed.clear();
+    }
+}
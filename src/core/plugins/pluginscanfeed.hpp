@@ -0,0 +1,40 @@
+#pragma once
+
+#include <QObject>
+#include <QByteArray>
+#include <QFileSystemWatcher>
+#include <QStringList>
+
+// Follows the NDJSON result stream of a running `vstscanner -s -w -n <file>`
+// (see PluginResultStream in the scanner) and reports each batch of plugin
+// changes once its "delta" line has been written. By then the scanner has
+// rewritten the plugin database, so listeners can reopen it straight away.
+class PluginScanFeed : public QObject {
+    Q_OBJECT
+    Q_PROPERTY(QString streamPath READ streamPath WRITE setStreamPath NOTIFY streamPathChanged)
+
+public:
+    explicit PluginScanFeed(QObject *parent = nullptr);
+
+    QString streamPath() const { return m_streamPath; }
+    void setStreamPath(const QString &path);
+
+signals:
+    void streamPathChanged();
+    void scanCompleted(int count);
+    // Names of added or rescanned plugins and paths that no longer hold one
+    void pluginsChanged(const QStringList &added, const QStringList &removedPaths);
+
+private slots:
+    void readNewLines();
+
+private:
+    void handleLine(const QByteArray &line);
+
+    QFileSystemWatcher m_watcher;
+    QString m_streamPath;
+    qint64 m_offset = 0;
+    QByteArray m_partialLine;
+    QStringList m_added;
+    QStringList m_removed;
+};
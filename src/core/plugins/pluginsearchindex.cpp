@@ -0,0 +1,362 @@
+#include "pluginsearchindex.hpp"
+#include <algorithm>
+#include <cctype>
+#include <numeric>
+
+namespace {
+
+constexpr char kFieldSeparator = '\x1f';
+
+// Posting entries are (position << kScoreBits) | best score of that n-gram
+// in the entry, so one- to three-character queries need no verification.
+constexpr uint32_t kScoreBits = 7;
+constexpr uint32_t kScoreMask = (1u << kScoreBits) - 1;
+
+bool isWordStart(std::string_view text, size_t pos) {
+    if (pos == 0) return true;
+    unsigned char prev = static_cast<unsigned char>(text[pos - 1]);
+    return !(std::isalnum(prev) || prev >= 0x80);
+}
+
+// Name hits rank above vendor hits, which rank above category/feature hits
+int occurrenceScore(std::string_view text, size_t pos, size_t length, size_t nameEnd, size_t vendorEnd) {
+    if (pos + length <= nameEnd) {
+        return pos == 0 ? 100 : isWordStart(text, pos) ? 80 : 60;
+    }
+
+    bool fieldStart = text[pos - 1] == kFieldSeparator;
+    if (pos + length <= vendorEnd) {
+        return fieldStart ? 50 : isWordStart(text, pos) ? 40 : 35;
+    }
+
+    bool fieldEnd = pos + length == text.size() || text[pos + length] == kFieldSeparator;
+    return fieldStart && fieldEnd ? 45 : fieldStart ? 40 : isWordStart(text, pos) ? 30 : 25;
+}
+
+} // namespace
+
+void PluginSearchIndex::clear() {
+    m_entries.clear();
+    m_text.clear();
+    m_grams.clear();
+    m_finalized = false;
+    m_hasLastQuery = false;
+    m_lastMatches.clear();
+    m_results.clear();
+}
+
+void PluginSearchIndex::reserve(size_t count) {
+    m_entries.reserve(count);
+    m_text.reserve(count * 64);
+}
+
+uint32_t PluginSearchIndex::add(const Document& document) {
+    // Posting lists use the entry position, which finalize() later turns
+    // into name order. The document id returned to the caller never changes.
+    auto id = static_cast<uint32_t>(m_entries.size());
+
+    Entry entry;
+    entry.documentId = id;
+    entry.textBegin = static_cast<uint32_t>(m_text.size());
+    m_text += normalize(document.name);
+    entry.nameEnd = static_cast<uint32_t>(m_text.size());
+    m_text += kFieldSeparator;
+    m_text += normalize(document.vendor);
+    entry.vendorEnd = static_cast<uint32_t>(m_text.size());
+    for (const auto& category : document.categories) {
+        m_text += kFieldSeparator;
+        m_text += normalize(category);
+    }
+    for (const auto& feature : document.features) {
+        m_text += kFieldSeparator;
+        m_text += normalize(feature);
+    }
+    entry.textEnd = static_cast<uint32_t>(m_text.size());
+    m_entries.push_back(entry);
+
+    // Ids only grow, so each posting list stays sorted
+    indexText(id, entry);
+
+    m_finalized = false;
+    m_hasLastQuery = false;
+    return id;
+}
+
+void PluginSearchIndex::indexText(uint32_t id, const Entry& entry) {
+    std::string_view text = entryText(entry);
+    size_t nameEnd = entry.nameEnd - entry.textBegin;
+    size_t vendorEnd = entry.vendorEnd - entry.textBegin;
+
+    for (size_t n = 1; n <= 3; n++) {
+        for (size_t i = 0; i + n <= text.size(); i++) {
+            // n-grams never span two fields
+            if (text.substr(i, n).find(kFieldSeparator) != std::string_view::npos) continue;
+
+            auto score = static_cast<uint32_t>(occurrenceScore(text, i, n, nameEnd, vendorEnd));
+            auto& list = m_grams[gramKey(text.data() + i, n)];
+            if (list.empty() || (list.back() >> kScoreBits) != id) {
+                list.push_back((id << kScoreBits) | score);
+            } else if ((list.back() & kScoreMask) < score) {
+                list.back() = (id << kScoreBits) | score;
+            }
+        }
+    }
+}
+
+void PluginSearchIndex::finalize() {
+    if (m_finalized) return;
+
+    // Renumber entries in name order so that walking any id list visits
+    // entries alphabetically; ranking then only has to bucket by score.
+    // The text is rewritten in the same order to keep scans sequential.
+    auto nameOf = [this](const Entry& entry) {
+        return std::string_view(m_text).substr(entry.textBegin, entry.nameEnd - entry.textBegin);
+    };
+
+    std::vector<uint32_t> order(m_entries.size());
+    std::iota(order.begin(), order.end(), 0u);
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return nameOf(m_entries[a]) < nameOf(m_entries[b]);
+    });
+
+    std::vector<uint32_t> positionOf(m_entries.size());
+    std::vector<Entry> sorted;
+    std::string text;
+    sorted.reserve(m_entries.size());
+    text.reserve(m_text.size());
+
+    for (uint32_t position = 0; position < order.size(); position++) {
+        const Entry& old = m_entries[order[position]];
+        positionOf[order[position]] = position;
+
+        Entry entry = old;
+        auto newBegin = static_cast<uint32_t>(text.size());
+        entry.textBegin = newBegin;
+        entry.nameEnd = newBegin + (old.nameEnd - old.textBegin);
+        entry.vendorEnd = newBegin + (old.vendorEnd - old.textBegin);
+        entry.textEnd = newBegin + (old.textEnd - old.textBegin);
+        text.append(m_text, old.textBegin, old.textEnd - old.textBegin);
+        sorted.push_back(entry);
+    }
+
+    m_entries = std::move(sorted);
+    m_text = std::move(text);
+
+    for (auto& [key, list] : m_grams) {
+        for (auto& packed : list) packed = (positionOf[packed >> kScoreBits] << kScoreBits) | (packed & kScoreMask);
+        std::sort(list.begin(), list.end());
+    }
+
+    m_hits.assign(m_entries.size(), 0);
+    m_hasLastQuery = false;
+    m_finalized = true;
+}
+
+const std::vector<uint32_t>& PluginSearchIndex::search(const std::string& query) {
+    finalize();
+
+    std::string normalized = normalize(query);
+    std::vector<std::string> terms = splitTerms(normalized);
+
+    if (terms.empty()) {
+        m_results.clear();
+        for (const auto& entry : m_entries) m_results.push_back(entry.documentId);
+        m_hasLastQuery = false;
+        return m_results;
+    }
+
+    if (terms.size() == 1 && terms.front().size() <= 3) {
+        // The posting list is exactly the match set, with scores
+        rankPostings(postings(terms.front().data(), terms.front().size()));
+    } else {
+        // Extending the previous query can only remove exact matches
+        bool refine = m_hasLastQuery && normalized.size() > m_lastQuery.size() &&
+                      normalized.compare(0, m_lastQuery.size(), m_lastQuery) == 0;
+
+        if (refine) {
+            m_scratch.swap(m_lastMatches);
+        } else {
+            auto longest = std::max_element(terms.begin(), terms.end(),
+                [](const std::string& a, const std::string& b) { return a.size() < b.size(); });
+            collectCandidates(*longest, m_scratch);
+        }
+
+        rank(m_scratch, terms);
+    }
+
+    m_lastQuery = normalized;
+    m_hasLastQuery = true;
+
+    if (m_results.size() < kFuzzyThreshold) {
+        collectFuzzy(terms);
+    }
+
+    for (auto& id : m_results) id = m_entries[id].documentId;
+    return m_results;
+}
+
+void PluginSearchIndex::rank(const std::vector<uint32_t>& candidates, const std::vector<std::string>& terms) {
+    m_scored.clear();
+    m_lastMatches.clear();
+
+    for (uint32_t id : candidates) {
+        int score = scoreEntry(m_entries[id], terms);
+        if (score > 0) {
+            m_scored.emplace_back(score, id);
+            m_lastMatches.push_back(id);
+        }
+    }
+
+    bucketByScore();
+}
+
+void PluginSearchIndex::rankPostings(const Postings* list) {
+    m_scored.clear();
+    m_lastMatches.clear();
+
+    if (list) {
+        for (uint32_t packed : *list) {
+            m_scored.emplace_back(static_cast<int>(packed & kScoreMask), packed >> kScoreBits);
+            m_lastMatches.push_back(packed >> kScoreBits);
+        }
+    }
+
+    bucketByScore();
+}
+
+void PluginSearchIndex::bucketByScore() {
+    // Matches were collected in name order, so a stable counting sort on the
+    // score gives "best score first, then alphabetical" without comparisons.
+    int maxScore = 0;
+    for (const auto& [score, id] : m_scored) maxScore = std::max(maxScore, score);
+
+    m_bucketStart.assign(static_cast<size_t>(maxScore) + 2, 0);
+    for (const auto& [score, id] : m_scored) m_bucketStart[maxScore - score + 1]++;
+    for (size_t i = 1; i < m_bucketStart.size(); i++) m_bucketStart[i] += m_bucketStart[i - 1];
+
+    m_results.resize(m_scored.size());
+    for (const auto& [score, id] : m_scored) m_results[m_bucketStart[maxScore - score]++] = id;
+}
+
+void PluginSearchIndex::collectCandidates(const std::string& term, std::vector<uint32_t>& out) const {
+    out.clear();
+    size_t n = std::min<size_t>(3, term.size());
+
+    std::vector<const Postings*> lists;
+    for (size_t i = 0; i + n <= term.size(); i++) {
+        const Postings* list = postings(term.data() + i, n);
+        if (!list) return;
+        lists.push_back(list);
+    }
+
+    std::sort(lists.begin(), lists.end(), [](const Postings* a, const Postings* b) { return a->size() < b->size(); });
+    for (uint32_t packed : *lists.front()) out.push_back(packed >> kScoreBits);
+
+    for (size_t l = 1; l < lists.size() && !out.empty(); l++) {
+        const Postings& other = *lists[l];
+        auto keep = std::remove_if(out.begin(), out.end(), [&other](uint32_t id) {
+            auto it = std::lower_bound(other.begin(), other.end(), id << kScoreBits);
+            return it == other.end() || (*it >> kScoreBits) != id;
+        });
+        out.erase(keep, out.end());
+    }
+}
+
+void PluginSearchIndex::collectFuzzy(const std::vector<std::string>& terms) {
+    // Typo tolerance: entries sharing most of the longest term's trigrams
+    const std::string& term = *std::max_element(terms.begin(), terms.end(),
+        [](const std::string& a, const std::string& b) { return a.size() < b.size(); });
+    if (term.size() < 4) return;
+
+    size_t trigramCount = term.size() - 2;
+    size_t needed = trigramCount - trigramCount / 3;
+
+    std::vector<uint32_t> touched;
+    for (size_t i = 0; i + 3 <= term.size(); i++) {
+        const Postings* list = postings(term.data() + i, 3);
+        if (!list) continue;
+        for (uint32_t packed : *list) {
+            uint32_t id = packed >> kScoreBits;
+            if (m_hits[id]++ == 0) touched.push_back(id);
+        }
+    }
+
+    // Keep fuzzy matches alphabetical within the same hit count
+    std::sort(touched.begin(), touched.end());
+
+    std::vector<std::pair<size_t, uint32_t>> fuzzy;
+    for (uint32_t id : touched) {
+        size_t hits = m_hits[id];
+        m_hits[id] = 0;
+        if (hits < needed) continue;
+        if (std::binary_search(m_lastMatches.begin(), m_lastMatches.end(), id)) continue;
+        fuzzy.emplace_back(hits, id);
+    }
+
+    std::stable_sort(fuzzy.begin(), fuzzy.end(),
+        [](const auto& a, const auto& b) { return a.first > b.first; });
+    for (const auto& [hits, id] : fuzzy) m_results.push_back(id);
+}
+
+std::string_view PluginSearchIndex::entryText(const Entry& entry) const {
+    return std::string_view(m_text).substr(entry.textBegin, entry.textEnd - entry.textBegin);
+}
+
+int PluginSearchIndex::scoreTerm(const Entry& entry, const std::string& term) const {
+    std::string_view text = entryText(entry);
+    size_t nameEnd = entry.nameEnd - entry.textBegin;
+    size_t vendorEnd = entry.vendorEnd - entry.textBegin;
+
+    int best = 0;
+    for (size_t pos = text.find(term); pos != std::string_view::npos && best < 100; pos = text.find(term, pos + 1)) {
+        best = std::max(best, occurrenceScore(text, pos, term.size(), nameEnd, vendorEnd));
+    }
+    return best;
+}
+
+int PluginSearchIndex::scoreEntry(const Entry& entry, const std::vector<std::string>& terms) const {
+    int total = 0;
+    for (const auto& term : terms) {
+        int score = scoreTerm(entry, term);
+        if (score == 0) return 0;
+        total += score;
+    }
+    return total;
+}
+
+const PluginSearchIndex::Postings* PluginSearchIndex::postings(const char* gram, size_t length) const {
+    auto it = m_grams.find(gramKey(gram, length));
+    return it == m_grams.end() ? nullptr : &it->second;
+}
+
+std::string PluginSearchIndex::normalize(const std::string& text) {
+    std::string out;
+    out.reserve(text.size());
+    for (unsigned char c : text) {
+        if (c == static_cast<unsigned char>(kFieldSeparator)) c = ' ';
+        out.push_back(c < 0x80 ? static_cast<char>(std::tolower(c)) : static_cast<char>(c));
+    }
+    return out;
+}
+
+std::vector<std::string> PluginSearchIndex::splitTerms(const std::string& query) {
+    std::vector<std::string> terms;
+    size_t pos = 0;
+    while (pos < query.size()) {
+        size_t start = query.find_first_not_of(" \t", pos);
+        if (start == std::string::npos) break;
+        size_t end = query.find_first_of(" \t", start);
+        if (end == std::string::npos) end = query.size();
+        terms.push_back(query.substr(start, end - start));
+        pos = end;
+    }
+    return terms;
+}
+
+uint32_t PluginSearchIndex::gramKey(const char* gram, size_t length) {
+    uint32_t key = static_cast<uint32_t>(length) << 24;
+    for (size_t i = 0; i < length; i++) {
+        key |= static_cast<uint32_t>(static_cast<unsigned char>(gram[i])) << (16 - 8 * i);
+    }
+    return key;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// N-gram index over the plugin catalogue used by the plugin browser.
+//
+// A query is split into whitespace separated terms and an entry matches when
+// every term is a substring of its name, vendor, a category or a feature.
+// Candidates come from unigram/bigram/trigram posting lists and are then
+// verified and ranked; a single term of up to three characters is answered
+// from its posting list alone. Because substring matches only shrink as a
+// term grows, a query that extends the previous one just re-filters the
+// previous matches.
+// When few entries match exactly, typo-tolerant trigram matches are appended.
+class PluginSearchIndex {
+public:
+    struct Document {
+        std::string name;
+        std::string vendor;
+        std::vector<std::string> categories;
+        std::vector<std::string> features;
+    };
+
+    void clear();
+    void reserve(size_t count);
+    // Returns the document id, which is what search() reports
+    uint32_t add(const Document& document);
+    // Optional: prepares the index up front instead of on the first search
+    void finalize();
+    size_t size() const { return m_entries.size(); }
+
+    // Document ids, best match first. The reference stays valid until the
+    // next search() or clear().
+    const std::vector<uint32_t>& search(const std::string& query);
+
+    static constexpr size_t kFuzzyThreshold = 10;
+
+private:
+    // Fields live in m_text as "name \x1f vendor \x1f tag \x1f tag ..."
+    struct Entry {
+        uint32_t documentId = 0;
+        uint32_t textBegin = 0;
+        uint32_t nameEnd = 0;
+        uint32_t vendorEnd = 0;
+        uint32_t textEnd = 0;
+    };
+
+    using Postings = std::vector<uint32_t>;
+
+    void indexText(uint32_t id, const Entry& entry);
+    const Postings* postings(const char* gram, size_t length) const;
+    void collectCandidates(const std::string& term, std::vector<uint32_t>& out) const;
+    void collectFuzzy(const std::vector<std::string>& terms);
+
+    std::string_view entryText(const Entry& entry) const;
+    int scoreTerm(const Entry& entry, const std::string& term) const;
+    int scoreEntry(const Entry& entry, const std::vector<std::string>& terms) const;
+    void rank(const std::vector<uint32_t>& candidates, const std::vector<std::string>& terms);
+    void rankPostings(const Postings* list);
+    void bucketByScore();
+
+    static std::string normalize(const std::string& text);
+    static std::vector<std::string> splitTerms(const std::string& query);
+    static uint32_t gramKey(const char* gram, size_t length);
+
+    std::vector<Entry> m_entries;
+    std::string m_text;
+    std::unordered_map<uint32_t, Postings> m_grams;
+    bool m_finalized = false;
+
+    // Previous query and its exact matches (sorted entry positions), for
+    // per-keystroke refinement
+    std::string m_lastQuery;
+    std::vector<uint32_t> m_lastMatches;
+    bool m_hasLastQuery = false;
+
+    std::vector<uint32_t> m_results;
+    std::vector<uint32_t> m_scratch;
+    std::vector<std::pair<int, uint32_t>> m_scored;
+    std::vector<size_t> m_bucketStart;
+    std::vector<uint16_t> m_hits;
+};
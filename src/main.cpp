@@ -20,6 +20,9 @@
 #include "core/logger.hpp"
 #include "core/system/performancemeter.hpp"
 #include "core/trackmanager.hpp"
+#include "core/plugins/pluginbrowsermodel.hpp"
+#include "core/plugins/pluginscanfeed.hpp"
+#include "core/plugins/plugininstancepool.hpp"
 #include <QQmlEngine>
 
 class DeviceScanThread : public QThread {
@@ -227,6 +230,15 @@ int main(int argc, char *argv[]) {
                 return &TrackManager::instance();
             });
 
+        qmlRegisterType<PluginBrowserModel>("com.futureboard.core", 1, 0, "PluginBrowserModel");
+        qmlRegisterType<PluginScanFeed>("com.futureboard.core", 1, 0, "PluginScanFeed");
+
+        qmlRegisterSingletonType<PluginInstancePool>("com.futureboard.core", 1, 0, 
+            "PluginInstancePool", [](QQmlEngine *engine, QJSEngine *) -> QObject* {
+                engine->setObjectOwnership(&PluginInstancePool::instance(), QQmlEngine::CppOwnership);
+                return &PluginInstancePool::instance();
+            });
+
         qmlRegisterSingletonType<PerformanceMeter>("com.futureboard.system", 1, 0, 
             "PerformanceMeter", [](QQmlEngine *engine, QJSEngine *) -> QObject* {
                 engine->setObjectOwnership(&PerformanceMeter::instance(), QQmlEngine::CppOwnership);
@@ -270,6 +282,17 @@ int main(int argc, char *argv[]) {
             return 1;
         }
 
+        // Start warming up the plugins inserted most, and keep the ranking
+        // current while a scanner rewrites the database
+        showMessage("Loading plugins...");
+        PluginInstancePool::instance().loadDatabase(ConfigManager::instance().getPluginDatabasePath());
+        PluginScanFeed scanFeed;
+        scanFeed.setStreamPath(ConfigManager::instance().getPluginScanStreamPath());
+        QObject::connect(&scanFeed, &PluginScanFeed::pluginsChanged,
+                         &PluginInstancePool::instance(), &PluginInstancePool::reloadDatabase);
+        QObject::connect(&scanFeed, &PluginScanFeed::scanCompleted,
+                         &PluginInstancePool::instance(), &PluginInstancePool::reloadDatabase);
+
         // Create and show main window
         showMessage("Launching Futureboard Studio...");
         MainWindow mainWindow;